@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+/* SUMMARY - background traffic generators for the MPI replay.
+ *
+ * A background job is a set of nw LPs that send messages at a fixed mean
+ * interval instead of replaying a workload. Each of its LPs emulates
+ * ranks_per_lp background ranks, so the job has
+ * num_lps * ranks_per_lp ranks and rank r lives on LP r / ranks_per_lp.
+ * Each time an LP generates, every one of its ranks asks the job's
+ * generator for the destinations of one message.
+ *
+ * Generators are looked up by name in a registry. New ones can be added
+ * with bg_traffic_add_gen. A generator picks destinations through
+ * bg_rand_integer / bg_rand_unif so that the replay can reverse its draws.
+ */
+
+#ifndef CODES_BG_TRAFFIC_H
+#define CODES_BG_TRAFFIC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <ross.h>
+
+#define BG_GEN_NAME_LEN 32
+#define BG_FILE_NAME_LEN 256
+
+/* configuration of the background traffic of a job */
+struct bg_traffic_params
+{
+    char gen_name[BG_GEN_NAME_LEN];
+    /* mean time between two messages of a rank (ns) */
+    tw_stime interval;
+    int payload_sz;
+    /* 0: "high" and 1: "medium" priority category */
+    int qos_level;
+    int ranks_per_lp;
+
+    /* hotspot: fraction of the messages sent to hot_rank */
+    double hot_fraction;
+    int hot_rank;
+    /* nearest_group: ranks per group, destinations stay in the group */
+    int group_size;
+    /* permutation: bytes a rank sends before the permutation changes */
+    unsigned long perm_bytes;
+    /* onoff: ON and OFF period lengths (ns), or a file of "on off" lines
+     * replayed cyclically */
+    tw_stime on_time;
+    tw_stime off_time;
+    char onoff_file[BG_FILE_NAME_LEN];
+
+    /* filled in by bg_traffic_setup */
+    struct bg_traffic_gen const * gen;
+    int num_ranks;
+    /* onoff periods as (on, off) pairs and the length of a cycle */
+    tw_stime * periods;
+    int num_periods;
+    tw_stime cycle;
+};
+
+/* arguments of one generator call */
+struct bg_traffic_ctx
+{
+    struct bg_traffic_params const * p;
+    tw_lp * lp;
+    /* sending rank and the bytes it sent so far */
+    int rank;
+    unsigned long long sent;
+    /* random numbers drawn, to be reversed by the caller */
+    int num_rngs;
+};
+
+struct bg_traffic_gen
+{
+    char const * name;
+    /* checks and completes the job parameters, 0 on success (optional) */
+    int (*setup)(struct bg_traffic_params * p);
+    /* writes the destination ranks of one message of ctx->rank into dests
+     * (room for p->num_ranks) and returns their count */
+    int (*dests)(struct bg_traffic_ctx * ctx, int * dests);
+    /* time until the next generation of an LP at time now (optional,
+     * interval plus exponential noise otherwise) */
+    tw_stime (*next)(struct bg_traffic_ctx * ctx, tw_stime now);
+};
+
+/* dynamically add to the generator table. Must be done before
+ * bg_traffic_setup */
+void bg_traffic_add_gen(struct bg_traffic_gen const * gen);
+
+/* sets the defaults of the parameters, including payload_sz and interval */
+void bg_traffic_params_init(struct bg_traffic_params * p,
+        char const * gen_name, int payload_sz, tw_stime interval);
+
+/* reads a configuration file of "<job> <generator> [key=value ...]" lines
+ * (keys: interval, payload, qos, ranks_per_lp, hot_fraction, hot_rank,
+ * group_size, perm_bytes, on, off, onoff_file). Parameters of the listed
+ * jobs are overwritten, with has_conf[job] set. Returns -1 on error */
+int bg_traffic_read_conf(char const * path, struct bg_traffic_params * p,
+        int * has_conf, int max_jobs);
+
+/* resolves the generator of a job with num_lps LPs, -1 on error */
+int bg_traffic_setup(struct bg_traffic_params * p, int num_lps);
+
+void bg_traffic_finalize(struct bg_traffic_params * p);
+
+/* random draws of generators, counted in ctx->num_rngs */
+long bg_rand_integer(struct bg_traffic_ctx * ctx, long lo, long hi);
+double bg_rand_unif(struct bg_traffic_ctx * ctx);
+double bg_rand_exponential(struct bg_traffic_ctx * ctx, double mean);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of include guard: CODES_BG_TRAFFIC_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
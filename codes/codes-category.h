@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2013 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#ifndef CODES_CATEGORY_H
+#define CODES_CATEGORY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Interning of the category strings attached to model-net and storage
+ * traffic. Each distinct string is given a small, dense integer id the first
+ * time it is seen so that per-category statistics can be kept in arrays
+ * indexed by id rather than found by string comparisons.
+ *
+ * Ids are assigned in order of first use and are therefore only meaningful
+ * within a single PE; anything shared between PEs should use the name. */
+
+/* return the id of category, registering it if it has not been seen */
+int codes_category_id(char const * category);
+
+/* name of a registered category id */
+char const * codes_category_name(int id);
+
+/* number of categories registered so far (ids are 0 .. count-1) */
+int codes_category_count(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of include guard: CODES_CATEGORY_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
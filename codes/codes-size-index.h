@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2013 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#ifndef CODES_SIZE_INDEX_H
+#define CODES_SIZE_INDEX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/* Lookup of size-binned parameter tables (netgauge output for loggp, the
+ * request_sizes bins of the local storage model, ...).
+ *
+ * The sorted list of measured sizes is preprocessed once into a direct index
+ * over power-of-two buckets, so that finding the bin of a message is a bucket
+ * computation plus a scan over the (usually zero or one) table entries that
+ * share the message's bucket, instead of a scan over the whole table. */
+
+#define CODES_SIZE_INDEX_BUCKETS 65
+
+struct codes_size_index
+{
+    int n;
+    uint64_t *sizes;
+    /* first table entry with size >= the smallest size of each bucket.
+     * Bucket 0 holds size 0, bucket b > 0 holds [2^(b-1), 2^b) */
+    int start[CODES_SIZE_INDEX_BUCKETS];
+};
+
+/* build the index over n sizes, which must be non-decreasing. Returns 0 on
+ * success, -1 if the sizes are not sorted */
+int codes_size_index_init(
+        struct codes_size_index * idx,
+        uint64_t const * sizes,
+        int n);
+
+void codes_size_index_destroy(struct codes_size_index * idx);
+
+/* index of the first entry with a size strictly greater than size, or n if
+ * there is none */
+int codes_size_index_upper(
+        struct codes_size_index const * idx,
+        uint64_t size);
+
+/* linear interpolation position of size: *lo is set to the last entry with a
+ * size <= size (clamped to the table) and the return value is the weight of
+ * entry *lo + 1, in [0,1]. The weight is 0 outside of the measured range */
+double codes_size_index_interp(
+        struct codes_size_index const * idx,
+        uint64_t size,
+        int * lo);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of include guard: CODES_SIZE_INDEX_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
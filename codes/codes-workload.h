@@ -32,6 +32,7 @@ typedef struct recorder_params recorder_params;
 
 /* struct to hold the actual data from a single MPI event*/
 typedef struct dumpi_trace_params dumpi_trace_params;
+typedef struct skeleton_params skeleton_params;
 typedef struct checkpoint_wrkld_params checkpoint_wrkld_params;
 typedef struct online_comm_params online_comm_params;
 
@@ -70,6 +71,10 @@ struct recorder_params
     int64_t nprocs;
 };
 
+/* name of the binary trace cache the recorder workload looks for in the
+ * trace directory; when present it is mmapped instead of parsing log.<rank> */
+#define RECORDER_CACHE_FILE "codes-recorder.bin"
+
 struct dumpi_trace_params {
    char file_name[MAX_NAME_LENGTH_WKLD];
    int num_net_traces;
@@ -81,10 +86,28 @@ struct dumpi_trace_params {
 #endif
 };
 
+/* the skeleton workload replays the communication skeleton of a
+ * num_traced_ranks rank dumpi trace at nprocs ranks, tiling the traced
+ * ranks (nprocs must be a multiple of num_traced_ranks) */
+struct skeleton_params {
+   char file_name[MAX_NAME_LENGTH_WKLD]; /* dumpi trace prefix */
+   int num_traced_ranks;
+   int nprocs;
+   int max_period; /* longest loop body searched for, in ops (<= 0: default) */
+   double delay_tolerance; /* relative difference of compute delays that
+                              are folded into one loop (< 0: default) */
+};
+
 struct online_comm_params {
     char workload_name[MAX_NAME_LENGTH_WKLD];
     char file_path[MAX_NAME_LENGTH_WKLD];
     int nprocs;
+    /* ops an SWM rank may run ahead of the simulation before yielding
+     * (0: yield after every call) */
+    int batch_ops;
+    /* stack of each SWM thread in bytes, taken from a pool of recycled
+     * stacks (0: Argobots default stack) */
+    size_t stack_size;
 };
 struct checkpoint_wrkld_params
 {
@@ -93,6 +116,7 @@ struct checkpoint_wrkld_params
     double checkpoint_wr_bw; /* checkpoint write b/w, in GiB/s */
     int total_checkpoints; /* total number of checkpoint phases */
     double mtti; /* mean time to interrupt, in hours */
+    int collective; /* write each checkpoint phase as one collective op */
 };
 
 /* supported I/O operations */
@@ -241,6 +265,7 @@ struct codes_workload_op
         /* TODO: non-stub for other collectives */
         struct {
             int num_bytes;
+            int root; /* root rank of rooted collectives (bcast, reduce) */
         } collective;
         struct {
             int count;
@@ -303,6 +328,39 @@ int codes_workload_load(
         int app_id,
         int rank);
 
+/* a single rank to be loaded by codes_workload_load_parallel */
+struct codes_workload_load_req
+{
+    int app_id;
+    int rank;
+    const char *params;
+};
+
+/* Loads the workload for count ranks up front, spreading the method's load
+ * calls over nthreads worker threads when the method allows concurrent
+ * loads (serially otherwise). A later codes_workload_load for a preloaded
+ * rank returns the workload id without loading it again. Returns the
+ * workload id, or -1 if any of the ranks failed to load. */
+int codes_workload_load_parallel(
+        const char* type,
+        struct codes_workload_load_req const *reqs,
+        int count,
+        int nthreads);
+
+/* time spent loading the ranks of a workload method on this process */
+struct codes_workload_load_stats
+{
+    int64_t nranks;
+    /* elapsed time of the load calls / load phases */
+    double wall_time;
+    /* sum of the time spent in the method's load function over all threads */
+    double busy_time;
+};
+
+int codes_workload_get_load_stats(
+        int wkld_id,
+        struct codes_workload_load_stats *stats);
+
 /* Retrieves the next I/O operation to execute.  the wkld_id is the
  * identifier returned by the init() function.  The op argument is a pointer
  * to a structure to be filled in with I/O operation information.
@@ -326,6 +384,35 @@ void codes_workload_get_next_rc2(
                 int app_id,
                 int rank);
 
+/* Batched version of codes_workload_get_next: fills ops with up to max_ops
+ * consecutive operations for the rank and returns how many were filled.
+ * The batch stops early after a CODES_WK_END operation, which is included
+ * in the returned count. */
+int codes_workload_get_next_batch(
+        int wkld_id,
+        int app_id,
+        int rank,
+        struct codes_workload_op *ops,
+        int max_ops);
+
+/* Reverse of codes_workload_get_next_batch, for the first count operations
+ * of a batch (count may be smaller than the number returned, e.g. when
+ * only part of the batch has been consumed). */
+void codes_workload_get_next_rc_batch(
+        int wkld_id,
+        int app_id,
+        int rank,
+        const struct codes_workload_op *ops,
+        int count);
+
+/* Batched version of codes_workload_get_next_rc2: rolls back the last count
+ * operations issued to the rank. */
+void codes_workload_get_next_rc2_batch(
+        int wkld_id,
+        int app_id,
+        int rank,
+        int count);
+
 /* Retrieve the number of ranks contained in a workload */
 int codes_workload_get_rank_cnt(
         const char* type,
@@ -351,6 +438,14 @@ int codes_workload_get_time(const char *type,
 		int app_id,
 		int rank, double *read_time, double *write_time, int64_t *read_bytes, int64_t *written_bytes);
 
+/* convert the Recorder text traces of ranks [0, nprocs) in trace_dir into a
+ * single indexed binary file. If out_file is NULL, the cache is written as
+ * RECORDER_CACHE_FILE in trace_dir. Returns 0 on success, -1 on failure */
+int recorder_io_workload_convert(
+        const char *trace_dir,
+        int64_t nprocs,
+        const char *out_file);
+
 /* implementation structure */
 struct codes_workload_method
 {
@@ -365,6 +460,13 @@ struct codes_workload_method
     int (*codes_workload_finalize)(const char* params, int app_id, int rank);
     /* added for get all read or write time */
     int (*codes_workload_get_time)(const char * params, int app_id, int rank, double *read_time, double *write_time, int64_t *read_bytes, int64_t *written_bytes);
+    /* optional batched variants; when NULL, the single-op versions above
+     * are called repeatedly */
+    int (*codes_workload_get_next_batch)(int app_id, int rank, struct codes_workload_op *ops, int max_ops);
+    void (*codes_workload_get_next_rc2_batch)(int app_id, int rank, int count);
+    /* nonzero if codes_workload_load may be called concurrently for
+     * different ranks */
+    int thread_safe_load;
 };
 
 
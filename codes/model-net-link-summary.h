@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+/* Fixed-size, reversible per-port link utilization summaries for router
+ * samplers. Instead of keeping every sample, a router folds each sample into
+ * per-port sums, min/max and a log-linear histogram of utilization (busy time
+ * over the sampling interval), so sampling memory does not grow with the
+ * simulated time.
+ *
+ * Histogram buckets: a utilization u is scaled to x = u * 2^16, clamped to
+ * [0, 2^16 - 1]. Bucket 0 holds x == 0; otherwise with m = floor(log2(x)),
+ * x falls into bucket 1 + 4m + s, s being the two bits below the most
+ * significant one (a quarter-octave resolution, as in HDR histograms). */
+
+#ifndef MODEL_NET_LINK_SUMMARY_H
+#define MODEL_NET_LINK_SUMMARY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <ross.h>
+
+#define MN_LINK_HIST_BITS    16
+#define MN_LINK_HIST_SUB     4
+#define MN_LINK_HIST_BUCKETS (1 + MN_LINK_HIST_BITS * MN_LINK_HIST_SUB)
+
+typedef struct mn_link_summary mn_link_summary;
+
+mn_link_summary * model_net_link_summary_new(int nports);
+void model_net_link_summary_free(mn_link_summary * ls);
+
+/* fold in one sample of busy_time and traffic per port, covering interval
+ * time units. The inputs are kept for model_net_link_summary_add_rc until
+ * GVT passes the sample */
+void model_net_link_summary_add(
+        mn_link_summary * ls,
+        tw_lp * lp,
+        tw_stime const * busy_time,
+        int64_t const * traffic,
+        long fwd_events,
+        long rev_events,
+        tw_stime interval);
+
+/* undo the last add, handing back the values it was given */
+void model_net_link_summary_add_rc(
+        mn_link_summary * ls,
+        tw_stime * busy_time,
+        int64_t * traffic,
+        long * fwd_events,
+        long * rev_events);
+
+/* lower bound of the utilization covered by histogram bucket b */
+double model_net_link_summary_bucket_lower(int b);
+
+/* append one row per port to the summary file at path and offer the ports to
+ * the PE's top-k list of congested links. Called from the router sample
+ * finalizer */
+void model_net_link_summary_write(
+        mn_link_summary const * ls,
+        tw_lpid router_id,
+        char const * path);
+
+/* print the k most utilized links across all PEs (PARAMS:rt_sample_topk,
+ * default 10). Collective over MPI_COMM_CODES; called once by
+ * model_net_report_stats */
+void model_net_link_summary_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of include guard: MODEL_NET_LINK_SUMMARY_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
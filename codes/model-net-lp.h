@@ -127,6 +127,9 @@ typedef struct model_net_base_msg {
     model_net_sched_rc rc; // rc for scheduling events
 } model_net_base_msg;
 
+// the union makes every model-net event as large as the biggest network
+// message, so the network messages group their fields by size (8-byte ones
+// first) to avoid padding
 typedef struct model_net_wrap_msg {
     msg_header h;
     union {
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+/* A shared output path for the per-LP samples collected by model-net models.
+ *
+ * Samples are appended row by row on each PE, buffered column by column in
+ * large blocks and handed to a background thread that writes them (optionally
+ * compressed) to a per-PE spill file. model_net_report_stats then merges the
+ * spill files of every PE into a single self-describing file per sink with
+ * MPI-IO.
+ *
+ * File layout (host byte order):
+ *   mn_sample_file_header
+ *   ncols x mn_sample_file_column
+ *   desc_len bytes of free-form description
+ *   padding up to header_bytes
+ *   blocks, each an mn_sample_block_header followed by stored_bytes of
+ *   payload and padding up to block_bytes. The (uncompressed) payload holds
+ *   each column in turn, nrows x count elements of 8 bytes per column. */
+
+#ifndef MODEL_NET_SAMPLE_SINK_H
+#define MODEL_NET_SAMPLE_SINK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <ross.h>
+
+#define MN_SAMPLE_MAGIC      "CODESSMP"
+#define MN_SAMPLE_BLK_MAGIC  "SBLK"
+#define MN_SAMPLE_VERSION    1
+#define MN_SAMPLE_ALIGN      4096
+#define MN_SAMPLE_NAME_MAX   48
+
+/* file/block flags */
+#define MN_SAMPLE_COMPRESSED 0x1
+
+/* every element is 8 bytes wide */
+enum mn_sample_type
+{
+    MN_SAMPLE_INT64,
+    MN_SAMPLE_UINT64,
+    MN_SAMPLE_DOUBLE
+};
+
+struct mn_sample_column
+{
+    char const * name;
+    enum mn_sample_type type;
+    int count; /* elements per row */
+};
+
+/* on-disk structures */
+struct mn_sample_file_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t ncols;
+    uint32_t flags;
+    uint32_t desc_len;
+    uint64_t header_bytes;
+};
+
+struct mn_sample_file_column
+{
+    uint32_t type;
+    uint32_t count;
+    char name[MN_SAMPLE_NAME_MAX];
+};
+
+struct mn_sample_block_header
+{
+    char magic[4];
+    int32_t pe;
+    uint32_t nrows;
+    uint32_t flags;
+    uint64_t raw_bytes;
+    uint64_t stored_bytes;
+    uint64_t block_bytes;
+};
+
+typedef struct mn_sample_sink mn_sample_sink;
+
+/* return the sink writing to path on this PE, creating it on first use. All
+ * users of a path (on every PE) must pass the same columns. description is
+ * stored in the file header and may be NULL */
+mn_sample_sink * model_net_sample_sink_get(
+        char const * path,
+        struct mn_sample_column const * cols,
+        int ncols,
+        char const * description);
+
+/* append a row. fields[i] points to cols[i].count elements of column i */
+void model_net_sample_sink_append(
+        mn_sample_sink * sink,
+        void const * const * fields);
+
+/* flush and merge every sink into its output file. Collective over
+ * MPI_COMM_CODES; called once by model_net_report_stats */
+void model_net_sample_sinks_close(void);
+
+/* the router and terminal samples of the dragonfly family of models
+ * (dragonfly-custom, dragonfly-plus, dragonfly-dally, express-mesh and the
+ * network template) */
+mn_sample_sink * model_net_sample_router_sink(
+        char const * path,
+        int radix,
+        char const * description);
+
+void model_net_sample_router_append(
+        mn_sample_sink * sink,
+        tw_lpid router_id,
+        tw_stime const * busy_time,
+        int64_t const * link_traffic,
+        tw_stime end_time,
+        long fwd_events,
+        long rev_events);
+
+mn_sample_sink * model_net_sample_terminal_sink(char const * path);
+
+void model_net_sample_terminal_append(
+        mn_sample_sink * sink,
+        tw_lpid terminal_id,
+        long fin_chunks,
+        long data_size,
+        double fin_hops,
+        tw_stime fin_chunks_time,
+        tw_stime busy_time,
+        tw_stime end_time,
+        long fwd_events,
+        long rev_events);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of include guard: MODEL_NET_SAMPLE_SINK_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
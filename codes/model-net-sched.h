@@ -30,6 +30,8 @@ typedef struct mn_sched_params_s mn_sched_params;
     X(MN_SCHED_FCFS_FULL, "fcfs-full",   &fcfs_tab) \
     X(MN_SCHED_RR,        "round-robin", &rr_tab) \
     X(MN_SCHED_PRIO,      "priority",    &prio_tab) \
+    X(MN_SCHED_DRR,       "drr",         &drr_tab) \
+    X(MN_SCHED_WFQ,       "wfq",         &wfq_tab) \
     X(MAX_SCHEDS,         NULL,          NULL)
 
 #define X(a,b,c) a,
@@ -50,6 +52,26 @@ typedef struct mn_prio_params_s {
     enum sched_type sub_stype;
 } mn_prio_params;
 
+// how the flow schedulers (drr, wfq) split requests into flows. Requests of
+// different priorities always belong to different flows
+enum mn_flow_key {
+    MN_FLOW_KEY_DEST, // final destination lp
+    MN_FLOW_KEY_SRC,  // source lp
+    MN_FLOW_KEY_PAIR  // (source, final destination) pair
+};
+
+// flow scheduler (drr, wfq) configuration parameters
+typedef struct mn_flow_params_s {
+    enum mn_flow_key key;
+    // drr: bytes credited to a flow per round, multiplied by its weight. Must
+    // be at least the packet size so that every visit can send a packet
+    uint64_t quantum;
+    // weight of the flows of each priority. The default priority uses
+    // weights[0], priorities past the end use the last weight
+    int num_weights;
+    int *weights;
+} mn_flow_params;
+
 // TODO: other scheduler config params
 
 // initialization parameter set
@@ -57,6 +79,7 @@ typedef struct model_net_sched_cfg_params_s {
     enum sched_type type;
     union {
         mn_prio_params prio;
+        mn_flow_params flow;
     } u;
 } model_net_sched_cfg_params;
 
@@ -142,6 +165,17 @@ struct model_net_sched_rc_s {
     mn_sched_params sched_params; // along with msg params
     int rtn; // return code from a sched_next 
     int prio; // prio when doing priority queue events
+    // flow schedulers (drr, wfq): flow a request was added to or a packet was
+    // scheduled from, and the state needed to undo the scheduling decision
+    int flow;
+    int flow_flags;
+    union {
+        int64_t deficit; // drr: deficit dropped when the flow went idle
+        struct {
+            double vtime;  // system virtual time before the packet
+            double finish; // finish tag of the flow's previous packet
+        } wfq;
+    } flow_saved;
 };
 
 // initialize the scheduler
@@ -197,6 +231,15 @@ void model_net_sched_add_rc(
 // set default parameters for messages that don't specify any
 void model_net_sched_set_default_params(mn_sched_params *sched_params);
 
+// cost instrumentation of the priority scheduler, summed over every priority
+// scheduler on the PE (including work that was later rolled back)
+typedef struct mn_sched_cost {
+    uint64_t next_calls;    // packets asked for
+    uint64_t words_scanned; // non-empty bitmap words examined to pick a level
+} mn_sched_cost;
+
+void model_net_sched_get_prio_cost(mn_sched_cost *cost);
+
 extern char * sched_names[];
 
 #ifdef __cplusplus
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+/* Sampled end-to-end packet tracing.
+ *
+ * With PARAMS:packet_trace_rate set to N > 0, model_net_event tags about one
+ * message in N (chosen by hashing the sender, destination and send time, so
+ * the choice survives rollback). Network models carry the tag on the packets
+ * of the message and report per-hop records from their commit handlers, i.e.
+ * only once GVT has passed the event, so records never need to be undone.
+ * Records are written through the model-net sample sink to
+ * <packet_trace_file>.bin (default model-net-packet-trace.bin). */
+
+#ifndef MODEL_NET_TRACE_H
+#define MODEL_NET_TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <ross.h>
+
+enum mn_trace_kind
+{
+    MN_TRACE_INJECT,  /* packet generated at the source terminal */
+    MN_TRACE_HOP,     /* chunk left a router */
+    MN_TRACE_DELIVER  /* chunk arrived at the destination terminal */
+};
+
+struct mn_trace_record
+{
+    uint64_t packet_id;  /* per source terminal */
+    int64_t chunk_id;
+    int64_t src_terminal;
+    int64_t dest_terminal;
+    int64_t kind;
+    int64_t location;    /* router or terminal id */
+    int64_t port;        /* output port, -1 if not applicable */
+    int64_t vc;          /* output vc, -1 if not applicable */
+    double start_time;   /* packet injection time */
+    double arrive_time;  /* arrival at location */
+    double depart_time;  /* departure from location (queueing delay is
+                            depart_time - arrive_time) */
+};
+
+/* read PARAMS:packet_trace_rate and PARAMS:packet_trace_file. Called by
+ * model_net_configure */
+void model_net_trace_configure(void);
+
+/* 1 if the message should be traced */
+int model_net_trace_select(
+        tw_lpid sender,
+        tw_lpid final_dest_lp,
+        tw_stime now);
+
+/* record a committed hop. Must only be called from commit handlers */
+void model_net_trace_record(struct mn_trace_record const * rec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of include guard: MODEL_NET_TRACE_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
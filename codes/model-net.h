@@ -27,7 +27,6 @@ extern "C" {
 
 #define MAX_NAME_LENGTH 256
 #define CATEGORY_NAME_MAX 16
-#define CATEGORY_MAX 12
 
 // simple deprecation attribute hacking
 #if !defined(DEPRECATED)
@@ -129,15 +128,22 @@ typedef struct model_net_request {
     // modelnet LP processes
     uint64_t msg_id;
     int      net_id;
-    int      is_pull;
     int      queue_offset;
     int      remote_event_size;
     int      self_event_size;
-    char     category[CATEGORY_NAME_MAX];
 
     //for counting msg app id
     int     app_id;
 
+    // requests are copied into every model-net base event (twice for
+    // scheduler rc), so the flags are kept small to avoid padding
+    short    is_pull;
+
+    // set when the message is sampled for packet tracing (see
+    // codes/model-net-trace.h)
+    short    trace;
+
+    char     category[CATEGORY_NAME_MAX];
 } model_net_request;
 
 /* data structure for tracking network statistics */
@@ -153,6 +159,15 @@ struct mn_stats
     long max_event_size;
 };
 
+/* per-LP network statistics, indexed by the interned category id (see
+ * codes/codes-category.h). A zero-initialized table is empty; entries are
+ * added on first use, so there is no limit on the number of categories */
+typedef struct mn_stats_table
+{
+    int count;
+    mn_stats *stats;
+} mn_stats_table;
+
 /* Registers all model-net LPs in ROSS. Should be called after
  * configuration_load, but before codes_mapping_setup */
 void model_net_register();
@@ -174,6 +189,9 @@ void model_net_enable_sampling(tw_stime interval, tw_stime end);
 /* Returns 1 if modelnet is performing sampling, 0 otherwise */
 int model_net_sampling_enabled(void);
 
+/* Returns the sampling interval given to model_net_enable_sampling */
+tw_stime model_net_sampling_interval(void);
+
 /* Initialize/configure the network(s) based on the CODES configuration.
  * returns an array of the network ids, indexed in the order given by the
  * modelnet_order configuration parameter
@@ -412,17 +430,17 @@ uint64_t model_net_get_packet_size(int net_id);
 
 /* used for reporting overall network statistics for e.g. average latency ,
  * maximum latency, total number of packets finished during the entire
- * simulation etc. */
+ * simulation etc. The per-category statistics collected through
+ * model_net_print_stats are reduced across PEs and printed on the first
+ * call. Must be called by all PEs */
 void model_net_report_stats(int net_id);
 
-/* writing model-net statistics on a per LP basis */
-void model_net_write_stats(tw_lpid lpid, mn_stats* stat);
-
-/* printing model-net statistics on a per LP basis */
-void model_net_print_stats(tw_lpid lpid, mn_stats mn_stats_array[]);
+/* called at LP finalize: folds the LP's statistics into the PE-wide totals
+ * reported by model_net_report_stats and releases the table */
+void model_net_print_stats(tw_lpid lpid, mn_stats_table *table);
 
 /* find model-net statistics */
-mn_stats* model_net_find_stats(char const * category, mn_stats mn_stats_array[]);
+mn_stats* model_net_find_stats(char const * category, mn_stats_table *table);
 
 #ifdef ENABLE_CORTEX
 /* structure that gives access to the topology functions */
@@ -18,18 +18,10 @@ typedef struct terminal_dally_message terminal_dally_message;
 /* this message is used for both dragonfly compute nodes and routers */
 struct terminal_dally_message
 {
-  /* magic number */
-  int magic;
   /* flit travel start time*/
   tw_stime travel_start_time;
  /* packet ID of the flit  */
   unsigned long long packet_ID;
-  /* event type of the flit */
-  short  type;
-  /* category: comes from codes */
-  char category[CATEGORY_NAME_MAX];
-  /* store category hash in the event */
-  uint32_t category_hash;
   /* final destination LP ID, this comes from codes can be a server or any other LP type*/
   tw_lpid final_dest_gid;
   /*sending LP ID from CODES, can be a server or any other LP type */
@@ -37,6 +29,30 @@ struct terminal_dally_message
   tw_lpid sender_mn_lp; // source modelnet id
  /* destination terminal ID of the dragonfly */
   tw_lpid dest_terminal_lpid;
+
+   /* new qos rc - These are calloced in forward events, free'd in RC or commit_f */
+   /* note: dynamic memory here is OK since it's only accessed by the LP that alloced it in the first place. */
+   unsigned long long * rc_qos_data;
+   int * rc_qos_status;
+
+   /* for reverse computation */
+   tw_stime saved_available_time;
+   tw_stime saved_avg_time;
+   tw_stime saved_rcv_time;
+   tw_stime saved_busy_time; 
+   tw_stime saved_total_time;
+   tw_stime saved_sample_time;
+   tw_stime msg_start_time;
+   tw_stime saved_busy_time_ross;
+   tw_stime saved_fin_chunks_ross;
+
+   /* packet tracing: the time the chunk arrived at the current router */
+   tw_stime trace_arrive_time;
+
+  /* magic number */
+  int magic;
+  /* hash of the category, used to pick the qos level */
+  uint32_t category_hash;
   int dfdally_dest_terminal_id; //this is the terminal id in the dfdally network in range [0-total_num_terminals)
   /* source terminal ID of the dragonfly */
   unsigned int src_terminal_id;
@@ -44,24 +60,14 @@ struct terminal_dally_message
    * sender_mn_lp??*/
   unsigned int origin_router_id;
 
-  /* number of hops traversed by the packet */
-  short my_N_hop;
-  short my_l_hop, my_g_hop;
-  short saved_channel;
-  short saved_vc;
-
   int next_stop;
 
   /* Intermediate LP ID from which this message is coming */
   unsigned int intm_lp_id;
-  /* last hop of the message, can be a terminal, local router or global router */
-  short last_hop;
    /* For routing */
-  short is_intm_visited;
   int intm_rtr_id;
   int intm_grp_id;
   int saved_src_dest;
-  int saved_src_chan;
 
    uint32_t chunk_id;
    uint32_t packet_size;
@@ -72,13 +78,24 @@ struct terminal_dally_message
    int local_event_size_bytes;
 
   // For buffer message
-   short vc_index;
    int output_chan;
    model_net_event_return event_rc;
    int is_pull;
    uint32_t pull_size;
    int path_type;
 
+  /* event type of the flit */
+  short  type;
+  /* number of hops traversed by the packet */
+  short my_N_hop;
+  short my_l_hop, my_g_hop;
+  short saved_channel;
+  short saved_vc;
+  /* last hop of the message, can be a terminal, local router or global router */
+  short last_hop;
+  short is_intm_visited;
+   short vc_index;
+
    /* for reverse computation */   
    short num_rngs;
    short num_cll;
@@ -87,22 +104,13 @@ struct terminal_dally_message
    short last_saved_qos;
    short qos_reset1;
    short qos_reset2;
-
-   /* new qos rc - These are calloced in forward events, free'd in RC or commit_f */
-   /* note: dynamic memory here is OK since it's only accessed by the LP that alloced it in the first place. */
    short rc_is_qos_set;
-   unsigned long long * rc_qos_data;
-   int * rc_qos_status;
 
-   tw_stime saved_available_time;
-   tw_stime saved_avg_time;
-   tw_stime saved_rcv_time;
-   tw_stime saved_busy_time; 
-   tw_stime saved_total_time;
-   tw_stime saved_sample_time;
-   tw_stime msg_start_time;
-   tw_stime saved_busy_time_ross;
-   tw_stime saved_fin_chunks_ross;
+   /* packet tracing: set if the packet is sampled */
+   short trace;
+
+  /* category: comes from codes */
+  char category[CATEGORY_NAME_MAX];
 };
 
 #ifdef __cplusplus
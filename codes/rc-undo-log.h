@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#ifndef RC_UNDO_LOG_H
+#define RC_UNDO_LOG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <ross.h>
+
+/* A per-LP log of the state words an event overwrote, used in place of
+ * hand-written reverse computation for scalar state.
+ *
+ * The forward handler opens a group with rc_undo_log_begin and then modifies
+ * state through RC_UNDO_SET / RC_UNDO_ADD, which save the old value of the
+ * word (up to 8 bytes) before writing it. The reverse handler calls
+ * rc_undo_log_rollback, which restores the saved words of the most recent
+ * group in reverse order, so the event's message does not need to carry the
+ * old values or bits recording which branches were taken. Anything that is
+ * not a plain state word (rng draws, list moves, sent events) still has to be
+ * reversed by hand.
+ *
+ * Groups are collected once GVT passes the time of the event that opened
+ * them, like the rc stack. Outside of optimistic mode nothing is recorded.
+ */
+
+struct rc_undo_log;
+
+void rc_undo_log_create(struct rc_undo_log **l);
+void rc_undo_log_destroy(struct rc_undo_log *l);
+
+/* open the undo group of the event being processed by lp. Must be called
+ * once per forward event, before any save */
+void rc_undo_log_begin(tw_lp const *lp, struct rc_undo_log *l);
+
+/* save the current value of the size bytes at addr (size <= 8) */
+void rc_undo_log_save(struct rc_undo_log *l, void *addr, size_t size);
+
+/* restore everything saved since the last begin and close the group
+ * (tw_error if there is no open group) */
+void rc_undo_log_rollback(struct rc_undo_log *l);
+
+/* number of saved words, not counting group markers (mostly for debug) */
+int rc_undo_log_count(struct rc_undo_log const *l);
+
+/* drop groups opened at time < GVT (lp->pe->GVT). A NULL lp drops all */
+void rc_undo_log_gc(tw_lp const *lp, struct rc_undo_log *l);
+
+#define RC_UNDO_SET(l, lval, val) \
+    do { \
+        rc_undo_log_save((l), &(lval), sizeof(lval)); \
+        (lval) = (val); \
+    } while (0)
+
+#define RC_UNDO_ADD(l, lval, delta) \
+    do { \
+        rc_undo_log_save((l), &(lval), sizeof(lval)); \
+        (lval) += (delta); \
+    } while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of include guard: RC_UNDO_LOG_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
@@ -20,6 +20,10 @@ typedef struct CodesIOKernelContext
 
     int inst_ready;
 
+    /* program being compiled, if any; the parser then compiles each
+     * statement instead of evaluating it */
+    void *prog;
+
     /* Ning's additions for the bgp storage model */
     /* XXX Does this belong here? */
     int GroupRank;
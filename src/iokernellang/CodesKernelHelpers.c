@@ -110,7 +110,7 @@ static int convertKLInstToEvent(int inst)
     return CL_UNKNOWN;
 }
 
-static void codes_kernel_helper_parse_cf(char * io_kernel_path,
+void codes_kernel_helper_parse_cf(char * io_kernel_path,
         char * io_kernel_meta_path, int task_rank, int max_ranks_default,
         iolang_workload_info * task_info, int use_relpath)
 {
@@ -337,6 +337,7 @@ int codes_kernel_helper_bootstrap(char * io_kernel_path,
 
     /* init the scanner */
     CodesIOKernelScannerInit(c);
+    c->prog = NULL;
 
     if(ret <= ksize)
     {
@@ -69,6 +69,11 @@ typedef struct codeslang_inst
   int64_t var[CL_INST_MAX_ARGS];
 } codeslang_inst;
 
+/* find the kernel file and group of the given rank in the kernel meta file */
+void codes_kernel_helper_parse_cf(char * io_kernel_path,
+        char * io_kernel_meta_path, int task_rank, int max_ranks_default,
+        iolang_workload_info * task_info, int use_relpath);
+
 int codes_kernel_helper_parse_input(CodesIOKernel_pstate * ps,
         CodesIOKernelContext * c, codeslang_inst * inst);
 
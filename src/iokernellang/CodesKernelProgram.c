@@ -0,0 +1,428 @@
+/*
+ * Copyright (C) 2013 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include "CodesKernelProgram.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <assert.h>
+
+/* programs compiled so far, one per kernel file */
+static codes_kernel_program * programs = NULL;
+
+static void ck_emit(codes_kernel_program * prog, int code, int arg,
+        int64_t imm)
+{
+    if(prog->num_ops == prog->max_ops)
+    {
+        prog->max_ops = prog->max_ops ? 2 * prog->max_ops : 64;
+        prog->ops = realloc(prog->ops, prog->max_ops * sizeof(*prog->ops));
+        assert(prog->ops);
+    }
+    prog->ops[prog->num_ops].code = code;
+    prog->ops[prog->num_ops].arg = arg;
+    prog->ops[prog->num_ops].imm = imm;
+    prog->num_ops++;
+}
+
+/* track the evaluation stack depth the emitted code will need */
+static void ck_stack(codes_kernel_program * prog, int delta)
+{
+    prog->depth += delta;
+    assert(prog->depth >= 0);
+    if(prog->depth > prog->max_depth)
+        prog->max_depth = prog->depth;
+}
+
+static int ck_binop(int oper)
+{
+    switch(oper)
+    {
+        case '+': return CK_ADD;
+        case '-': return CK_SUB;
+        case '*': return CK_MUL;
+        case '/': return CK_DIV;
+        case '%': return CK_MOD;
+        case '<': return CK_LT;
+        case '>': return CK_GT;
+        case GE: return CK_GE;
+        case LE: return CK_LE;
+        case NE: return CK_NE;
+        case EQ: return CK_EQ;
+        default: return -1;
+    }
+}
+
+/* statements that produce a simulator event, see convertKLInstToEvent */
+static int ck_event(int oper)
+{
+    switch(oper)
+    {
+        case WRITEAT: return CL_WRITEAT;
+        case READAT: return CL_READAT;
+        case CLOSE: return CL_CLOSE;
+        case OPEN: return CL_OPEN;
+        case SYNC: return CL_SYNC;
+        case SLEEP: return CL_SLEEP;
+        case DELETE: return CL_DELETE;
+        default: return -1;
+    }
+}
+
+/* compile an expression, leaving its value on the stack */
+static void ck_compile_expr(codes_kernel_program * prog, nodeType * p)
+{
+    int i;
+
+    if(!p)
+    {
+        ck_emit(prog, CK_PUSH, 0, 0);
+        ck_stack(prog, 1);
+        return;
+    }
+
+    switch(p->type)
+    {
+        case typeCon:
+            ck_emit(prog, CK_PUSH, 0, p->con.value);
+            ck_stack(prog, 1);
+            return;
+        case typeId:
+            ck_emit(prog, CK_LOAD, p->id.i, 0);
+            ck_stack(prog, 1);
+            return;
+        case typeOpr:
+            break;
+    }
+
+    switch(p->opr.oper)
+    {
+        case UMINUS:
+            ck_compile_expr(prog, p->opr.op[0]);
+            ck_emit(prog, CK_NEG, 0, 0);
+            return;
+        case GETGROUPRANK:
+            ck_compile_expr(prog, p->opr.op[0]);
+            ck_emit(prog, CK_RANK, 0, 0);
+            return;
+        case GETGROUPSIZE:
+            ck_compile_expr(prog, p->opr.op[0]);
+            ck_emit(prog, CK_SIZE, 0, 0);
+            return;
+        /* constants, as evaluated by ex() */
+        case GETNUMGROUPS:
+            ck_emit(prog, CK_PUSH, 0, 32);
+            ck_stack(prog, 1);
+            return;
+        case GETGROUPID:
+            ck_emit(prog, CK_PUSH, 0, 8);
+            ck_stack(prog, 1);
+            return;
+        case GETCURTIME:
+            ck_emit(prog, CK_PUSH, 0, 0);
+            ck_stack(prog, 1);
+            return;
+        default:
+            break;
+    }
+
+    if(ck_binop(p->opr.oper) >= 0)
+    {
+        ck_compile_expr(prog, p->opr.op[0]);
+        ck_compile_expr(prog, p->opr.op[1]);
+        ck_emit(prog, ck_binop(p->opr.oper), 0, 0);
+        ck_stack(prog, -1);
+        return;
+    }
+
+    /* not an expression; evaluate operands for their side effects */
+    for(i = 0 ; i < p->opr.nops ; i++)
+    {
+        ck_compile_expr(prog, p->opr.op[i]);
+        ck_emit(prog, CK_POP, 0, 0);
+        ck_stack(prog, -1);
+    }
+    ck_emit(prog, CK_PUSH, 0, 0);
+    ck_stack(prog, 1);
+}
+
+static void ck_compile_stmt(codes_kernel_program * prog, nodeType * p)
+{
+    int i;
+    int event;
+    int jz, jmp;
+
+    if(!p || p->type != typeOpr)
+        return;
+
+    switch(p->opr.oper)
+    {
+        case ';':
+            ck_compile_stmt(prog, p->opr.op[0]);
+            ck_compile_stmt(prog, p->opr.op[1]);
+            return;
+        case '=':
+            ck_compile_expr(prog, p->opr.op[1]);
+            ck_emit(prog, CK_STORE, p->opr.op[0]->id.i, 0);
+            ck_stack(prog, -1);
+            return;
+        case WHILE:
+            jmp = prog->num_ops;
+            ck_compile_expr(prog, p->opr.op[0]);
+            jz = prog->num_ops;
+            ck_emit(prog, CK_JZ, 0, 0);
+            ck_stack(prog, -1);
+            ck_compile_stmt(prog, p->opr.op[1]);
+            ck_emit(prog, CK_JMP, 0, jmp);
+            prog->ops[jz].imm = prog->num_ops;
+            return;
+        case IF:
+            ck_compile_expr(prog, p->opr.op[0]);
+            jz = prog->num_ops;
+            ck_emit(prog, CK_JZ, 0, 0);
+            ck_stack(prog, -1);
+            ck_compile_stmt(prog, p->opr.op[1]);
+            if(p->opr.nops > 2)
+            {
+                jmp = prog->num_ops;
+                ck_emit(prog, CK_JMP, 0, 0);
+                prog->ops[jz].imm = prog->num_ops;
+                ck_compile_stmt(prog, p->opr.op[2]);
+                prog->ops[jmp].imm = prog->num_ops;
+            }
+            else
+                prog->ops[jz].imm = prog->num_ops;
+            return;
+        case PRINT:
+            ck_compile_expr(prog, p->opr.op[0]);
+            ck_emit(prog, CK_PRINT, 0, 0);
+            ck_stack(prog, -1);
+            return;
+        case EXIT:
+            ck_compile_expr(prog, p->opr.op[0]);
+            ck_emit(prog, CK_POP, 0, 0);
+            ck_stack(prog, -1);
+            ck_emit(prog, CK_HALT, 0, 0);
+            return;
+        default:
+            break;
+    }
+
+    event = ck_event(p->opr.oper);
+    if(event >= 0)
+    {
+        assert(p->opr.nops <= CL_INST_MAX_ARGS);
+        for(i = 0 ; i < p->opr.nops ; i++)
+            ck_compile_expr(prog, p->opr.op[i]);
+        ck_emit(prog, CK_EMIT, event, p->opr.nops);
+        ck_stack(prog, -p->opr.nops);
+        return;
+    }
+
+    /* expression statements and instructions the simulator ignores */
+    ck_compile_expr(prog, p);
+    ck_emit(prog, CK_POP, 0, 0);
+    ck_stack(prog, -1);
+}
+
+void codes_kernel_program_add_stmt(void * prog, nodeType * p)
+{
+    ck_compile_stmt((codes_kernel_program *)prog, p);
+}
+
+static codes_kernel_program * codes_kernel_program_compile(
+        const char * io_kernel_path)
+{
+    codes_kernel_program * prog = NULL;
+    CodesIOKernelContext c;
+    CodesIOKernel_pstate * ps = NULL;
+    char * kbuffer = NULL;
+    struct stat info;
+    int status;
+    int yychar;
+    int fd;
+
+    if(stat(io_kernel_path, &info) != 0)
+    {
+        fprintf(stderr, "%s:%i could not stat kernel file (%s)\n",
+                __func__, __LINE__, io_kernel_path);
+        return NULL;
+    }
+
+    kbuffer = (char *)malloc(sizeof(char) * (info.st_size + 1));
+    assert(kbuffer);
+    kbuffer[info.st_size] = '\0';
+
+    fd = open(io_kernel_path, O_RDONLY);
+    if(fd < 0 || pread(fd, kbuffer, info.st_size, 0) != info.st_size)
+    {
+        fprintf(stderr, "%s:%i could not read kernel file (%s)\n",
+                __func__, __LINE__, io_kernel_path);
+        if(fd >= 0)
+            close(fd);
+        free(kbuffer);
+        return NULL;
+    }
+    close(fd);
+
+    prog = (codes_kernel_program *)calloc(1, sizeof(*prog));
+    assert(prog);
+    strncpy(prog->path, io_kernel_path, MAX_NAME_LENGTH_WKLD - 1);
+
+    /* parse the whole kernel; the parser hands each statement to
+     * codes_kernel_program_add_stmt instead of evaluating it */
+    CodesIOKernelScannerInit(&c);
+    c.prog = prog;
+    CodesIOKernelScannerSetSymTable(&c);
+    CodesIOKernel__scan_string(kbuffer, c.scanner_);
+    ps = CodesIOKernel_pstate_new();
+
+    do
+    {
+        c.locval = CodesIOKernel_get_lloc(*((yyscan_t *)c.scanner_));
+        yychar = CodesIOKernel_lex((codesYYType*)c.lval, (YYLTYPE*)c.locval,
+                c.scanner_);
+        c.locval = NULL;
+        status = CodesIOKernel_push_parse(ps, yychar, (codesYYType*)c.lval,
+                (YYLTYPE*)c.locval, &c);
+    }while(status == YYPUSH_MORE);
+
+    CodesIOKernel_pstate_delete(ps);
+    free(c.lval);
+    CodesIOKernelScannerDestroy(&c);
+    free(kbuffer);
+
+    ck_emit(prog, CK_HALT, 0, 0);
+
+    if(status != 0)
+    {
+        fprintf(stderr, "%s:%i could not parse kernel file (%s)\n",
+                __func__, __LINE__, io_kernel_path);
+        free(prog->ops);
+        free(prog);
+        return NULL;
+    }
+    if(prog->max_depth > CK_STACK_MAX)
+    {
+        fprintf(stderr, "%s:%i kernel file (%s) needs a stack of %d entries, "
+                "max is %d\n", __func__, __LINE__, io_kernel_path,
+                prog->max_depth, CK_STACK_MAX);
+        free(prog->ops);
+        free(prog);
+        return NULL;
+    }
+
+    return prog;
+}
+
+codes_kernel_program * codes_kernel_program_get(const char * io_kernel_path)
+{
+    codes_kernel_program * prog;
+
+    for(prog = programs ; prog != NULL ; prog = prog->next)
+    {
+        if(strcmp(prog->path, io_kernel_path) == 0)
+            return prog;
+    }
+
+    prog = codes_kernel_program_compile(io_kernel_path);
+    if(prog)
+    {
+        prog->next = programs;
+        programs = prog;
+    }
+    return prog;
+}
+
+void codes_kernel_regs_init(codes_kernel_regs * r, int rank, int size)
+{
+    memset(r, 0, sizeof(*r));
+    r->group_rank = rank;
+    r->group_size = size;
+}
+
+int codes_kernel_program_next(const codes_kernel_program * prog,
+        codes_kernel_regs * r, codeslang_inst * inst)
+{
+    const codes_kernel_op * ops = prog->ops;
+    int64_t * st = r->stack;
+    int32_t pc = r->pc;
+    int32_t sp = r->sp;
+    int64_t t;
+
+    for(;;)
+    {
+        const codes_kernel_op * o = &ops[pc++];
+
+        switch(o->code)
+        {
+            case CK_PUSH: st[sp++] = o->imm; break;
+            case CK_LOAD: st[sp++] = r->sym[o->arg]; break;
+            case CK_STORE: r->sym[o->arg] = st[--sp]; break;
+            case CK_POP: sp--; break;
+            case CK_NEG: st[sp-1] = -st[sp-1]; break;
+            case CK_ADD: sp--; st[sp-1] = st[sp-1] + st[sp]; break;
+            case CK_SUB: sp--; st[sp-1] = st[sp-1] - st[sp]; break;
+            case CK_MUL: sp--; st[sp-1] = st[sp-1] * st[sp]; break;
+            case CK_DIV: sp--; st[sp-1] = st[sp-1] / st[sp]; break;
+            case CK_MOD: sp--; st[sp-1] = st[sp-1] % st[sp]; break;
+            case CK_LT: sp--; st[sp-1] = st[sp-1] < st[sp]; break;
+            case CK_GT: sp--; st[sp-1] = st[sp-1] > st[sp]; break;
+            case CK_GE: sp--; st[sp-1] = st[sp-1] >= st[sp]; break;
+            case CK_LE: sp--; st[sp-1] = st[sp-1] <= st[sp]; break;
+            case CK_NE: sp--; st[sp-1] = st[sp-1] != st[sp]; break;
+            case CK_EQ: sp--; st[sp-1] = st[sp-1] == st[sp]; break;
+            case CK_JMP: pc = o->imm; break;
+            case CK_JZ:
+                if(!st[--sp])
+                    pc = o->imm;
+                break;
+            case CK_PRINT:
+                printf("%"PRId64"\n", st[--sp]);
+                fflush(stdout);
+                break;
+            case CK_RANK:
+            case CK_SIZE:
+                t = st[sp-1];
+                st[sp-1] = (o->code == CK_RANK) ? r->group_rank : r->group_size;
+                inst->event_type = (o->code == CK_RANK) ? CL_GETRANK : CL_GETSIZE;
+                inst->num_var = 1;
+                inst->var[0] = t;
+                r->pc = pc;
+                r->sp = sp;
+                return inst->event_type;
+            case CK_EMIT:
+                sp -= o->imm;
+                inst->event_type = o->arg;
+                inst->num_var = o->imm;
+                memcpy(inst->var, &st[sp], o->imm * sizeof(*st));
+                r->pc = pc;
+                r->sp = sp;
+                return inst->event_type;
+            case CK_HALT:
+                /* stay on the halt instruction */
+                inst->event_type = CL_EXIT;
+                inst->num_var = 0;
+                r->pc = pc - 1;
+                r->sp = sp;
+                return CL_EXIT;
+            default:
+                assert(0);
+        }
+    }
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2013 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#ifndef CODES_KERNEL_PROGRAM_H
+#define CODES_KERNEL_PROGRAM_H
+
+#include "CodesKernelHelpers.h"
+
+/* An I/O kernel is compiled once into a flat array of stack machine
+ * instructions. The program is shared read-only by every rank executing the
+ * kernel; each rank only carries a codes_kernel_regs register file that is
+ * advanced by codes_kernel_program_next. */
+
+#define CK_NUM_SYMS 26
+#define CK_STACK_MAX 32
+
+enum codes_kernel_opcode
+{
+    CK_PUSH,        /* push imm */
+    CK_LOAD,        /* push sym[arg] */
+    CK_STORE,       /* sym[arg] = pop */
+    CK_POP,
+    CK_NEG,
+    CK_ADD,
+    CK_SUB,
+    CK_MUL,
+    CK_DIV,
+    CK_MOD,
+    CK_LT,
+    CK_GT,
+    CK_GE,
+    CK_LE,
+    CK_NE,
+    CK_EQ,
+    CK_JMP,         /* pc = imm */
+    CK_JZ,          /* if pop == 0, pc = imm */
+    CK_PRINT,       /* print pop */
+    CK_RANK,        /* replace top with the group rank, yield CL_GETRANK */
+    CK_SIZE,        /* replace top with the group size, yield CL_GETSIZE */
+    CK_EMIT,        /* pop imm args, yield event arg */
+    CK_HALT         /* yield CL_EXIT, forever */
+};
+
+typedef struct codes_kernel_op
+{
+    int32_t code;
+    int32_t arg;
+    int64_t imm;
+} codes_kernel_op;
+
+typedef struct codes_kernel_program
+{
+    char path[MAX_NAME_LENGTH_WKLD];
+    codes_kernel_op *ops;
+    int num_ops;
+    int max_ops;
+    /* stack depth reached while compiling, checked against CK_STACK_MAX */
+    int depth;
+    int max_depth;
+    struct codes_kernel_program *next;
+} codes_kernel_program;
+
+/* per-rank execution state */
+typedef struct codes_kernel_regs
+{
+    int32_t pc;
+    int32_t sp;
+    int64_t group_rank;
+    int64_t group_size;
+    int64_t sym[CK_NUM_SYMS];
+    int64_t stack[CK_STACK_MAX];
+} codes_kernel_regs;
+
+/* compile the kernel at io_kernel_path, or return the already compiled
+ * program for that path. Returns NULL on failure */
+codes_kernel_program * codes_kernel_program_get(const char * io_kernel_path);
+
+/* called by the parser for each top-level statement while compiling */
+void codes_kernel_program_add_stmt(void * prog, nodeType * p);
+
+void codes_kernel_regs_init(codes_kernel_regs * r, int rank, int size);
+
+/* run until the next simulator event, which is stored in inst. Returns the
+ * event type (one of cl_event_t) */
+int codes_kernel_program_next(const codes_kernel_program * prog,
+        codes_kernel_regs * r, codeslang_inst * inst);
+
+#endif
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
@@ -93,6 +93,7 @@ nodeType *id(int64_t i);
 nodeType *con(int64_t value);
 void freeNode(nodeType *p);
 int64_t ex(nodeType *p);
+void codes_kernel_program_add_stmt(void *prog, nodeType *p);
 
 int64_t * sym = NULL; /* symbol table */
 int64_t * var = NULL;
@@ -1842,7 +1843,13 @@ yyreduce:
 
 /* Line 1806 of yacc.c  */
 #line 78 "codesparser.y"
-    { ex((yyvsp[(2) - (2)].nPtr)); freeNode((yyvsp[(2) - (2)].nPtr)); }
+    {
+                                  if(context->prog)
+                                      codes_kernel_program_add_stmt(context->prog, (yyvsp[(2) - (2)].nPtr));
+                                  else
+                                      ex((yyvsp[(2) - (2)].nPtr));
+                                  freeNode((yyvsp[(2) - (2)].nPtr));
+                                }
     break;
 
   case 5:
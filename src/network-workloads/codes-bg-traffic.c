@@ -0,0 +1,441 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <ross.h>
+#include "codes/codes-bg-traffic.h"
+
+long bg_rand_integer(struct bg_traffic_ctx * ctx, long lo, long hi)
+{
+    ctx->num_rngs++;
+    return tw_rand_integer(ctx->lp->rng, lo, hi);
+}
+
+double bg_rand_unif(struct bg_traffic_ctx * ctx)
+{
+    ctx->num_rngs++;
+    return tw_rand_unif(ctx->lp->rng);
+}
+
+double bg_rand_exponential(struct bg_traffic_ctx * ctx, double mean)
+{
+    ctx->num_rngs++;
+    return tw_rand_exponential(ctx->lp->rng, mean);
+}
+
+/* any rank but the sender */
+static int bg_uniform_dests(struct bg_traffic_ctx * ctx, int * dests)
+{
+    int n = ctx->p->num_ranks;
+
+    if(n < 2)
+        return 0;
+    dests[0] = bg_rand_integer(ctx, 0, n - 1);
+    if(dests[0] == ctx->rank)
+        dests[0] = (ctx->rank + 1) % n;
+    return 1;
+}
+
+static int bg_neighbor_dests(struct bg_traffic_ctx * ctx, int * dests)
+{
+    if(ctx->p->num_ranks < 2)
+        return 0;
+    dests[0] = (ctx->rank + 1) % ctx->p->num_ranks;
+    return 1;
+}
+
+static int bg_alltoall_dests(struct bg_traffic_ctx * ctx, int * dests)
+{
+    int i, len = 0;
+
+    for(i = 0; i < ctx->p->num_ranks; i++)
+        if(i != ctx->rank)
+            dests[len++] = i;
+    return len;
+}
+
+/* 2D 4-point stencil on a grid of about sqrt(n) x sqrt(n) ranks */
+static int bg_stencil_dests(struct bg_traffic_ctx * ctx, int * dests)
+{
+    int n = ctx->p->num_ranks;
+    int digits, i, x = 1, y, row, col, temp = n;
+
+    for(digits = 0; temp > 0; temp >>= 1)
+        digits++;
+    digits = digits / 2;
+    for(i = 0; i < digits; i++)
+        x = x * 2;
+    y = n / x;
+    row = ctx->rank / y;
+    col = ctx->rank % y;
+
+    dests[0] = row * y + ((col - 1 + y) % y);   /* left neighbor */
+    dests[1] = row * y + ((col + 1 + y) % y);   /* right neighbor */
+    dests[2] = ((row - 1 + x) % x) * y + col;   /* bottom neighbor */
+    dests[3] = ((row + 1 + x) % x) * y + col;   /* up neighbor */
+    return 4;
+}
+
+/* the ranks of an epoch (perm_bytes sent by each) all send to rank + shift,
+ * with a shift drawn from the epoch number so that nothing has to be saved
+ * or reversed when the permutation changes */
+static int bg_permutation_setup(struct bg_traffic_params * p)
+{
+    if(p->perm_bytes == 0)
+    {
+        fprintf(stderr, "\n permutation: perm_bytes must be positive ");
+        return -1;
+    }
+    return 0;
+}
+
+static int bg_permutation_dests(struct bg_traffic_ctx * ctx, int * dests)
+{
+    int n = ctx->p->num_ranks;
+    uint64_t h = ctx->sent / ctx->p->perm_bytes;
+
+    if(n < 2)
+        return 0;
+    /* splitmix64 finalizer */
+    h += 0x9e3779b97f4a7c15ULL;
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    dests[0] = (ctx->rank + 1 + (int)(h % (uint64_t)(n - 1))) % n;
+    return 1;
+}
+
+static int bg_hotspot_setup(struct bg_traffic_params * p)
+{
+    if(p->hot_rank < 0 || p->hot_rank >= p->num_ranks
+            || p->hot_fraction < 0.0 || p->hot_fraction > 1.0)
+    {
+        fprintf(stderr, "\n hotspot: invalid hot_rank %d or hot_fraction %lf ",
+                p->hot_rank, p->hot_fraction);
+        return -1;
+    }
+    return 0;
+}
+
+/* hot_fraction of the messages go to hot_rank, the others are uniform */
+static int bg_hotspot_dests(struct bg_traffic_ctx * ctx, int * dests)
+{
+    if(ctx->rank != ctx->p->hot_rank
+            && bg_rand_unif(ctx) < ctx->p->hot_fraction)
+    {
+        dests[0] = ctx->p->hot_rank;
+        return 1;
+    }
+    return bg_uniform_dests(ctx, dests);
+}
+
+static int bg_group_setup(struct bg_traffic_params * p)
+{
+    if(p->group_size < 1)
+    {
+        fprintf(stderr, "\n nearest_group: group_size must be positive ");
+        return -1;
+    }
+    return 0;
+}
+
+/* uniform among the other ranks of the group of group_size consecutive
+ * ranks of the sender */
+static int bg_group_dests(struct bg_traffic_ctx * ctx, int * dests)
+{
+    int first = ctx->rank - ctx->rank % ctx->p->group_size;
+    int size = ctx->p->num_ranks - first;
+
+    if(size > ctx->p->group_size)
+        size = ctx->p->group_size;
+    if(size < 2)
+        return 0;
+    dests[0] = first + bg_rand_integer(ctx, 0, size - 2);
+    if(dests[0] >= ctx->rank)
+        dests[0]++;
+    return 1;
+}
+
+static int bg_onoff_setup(struct bg_traffic_params * p)
+{
+    int cap = 16;
+
+    p->num_periods = 0;
+    p->periods = (tw_stime*)malloc(2 * cap * sizeof(tw_stime));
+    assert(p->periods);
+    if(strlen(p->onoff_file) > 0)
+    {
+        double on, off;
+        FILE * f = fopen(p->onoff_file, "r");
+        if(!f)
+        {
+            fprintf(stderr, "\n onoff: could not open %s ", p->onoff_file);
+            return -1;
+        }
+        while(fscanf(f, "%lf %lf", &on, &off) == 2)
+        {
+            if(p->num_periods == cap)
+            {
+                cap *= 2;
+                p->periods = (tw_stime*)realloc(p->periods,
+                        2 * cap * sizeof(tw_stime));
+                assert(p->periods);
+            }
+            p->periods[2 * p->num_periods] = on;
+            p->periods[2 * p->num_periods + 1] = off;
+            p->num_periods++;
+        }
+        fclose(f);
+    }
+    else
+    {
+        p->periods[0] = p->on_time;
+        p->periods[1] = p->off_time;
+        p->num_periods = 1;
+    }
+
+    p->cycle = 0;
+    for(int i = 0; i < 2 * p->num_periods; i++)
+    {
+        if(p->periods[i] < 0)
+        {
+            fprintf(stderr, "\n onoff: negative ON/OFF period ");
+            return -1;
+        }
+        p->cycle += p->periods[i];
+    }
+    if(p->cycle <= 0)
+    {
+        fprintf(stderr, "\n onoff: no valid ON/OFF periods ");
+        return -1;
+    }
+    return 0;
+}
+
+/* t if it falls in an ON period, else the start of the next one. The
+ * periods are a function of the simulated time only, so all ranks of the
+ * job burst together */
+static tw_stime bg_onoff_skip_off(struct bg_traffic_params const * p,
+        tw_stime t)
+{
+    tw_stime base = floor(t / p->cycle) * p->cycle;
+    tw_stime start = base;
+
+    for(int i = 0; i < p->num_periods; i++)
+    {
+        tw_stime on_end = start + p->periods[2 * i];
+        tw_stime off_end = on_end + p->periods[2 * i + 1];
+        if(t < on_end)
+            return t;
+        if(t < off_end)
+            return off_end;
+        start = off_end;
+    }
+    return base + p->cycle;
+}
+
+static tw_stime bg_onoff_next(struct bg_traffic_ctx * ctx, tw_stime now)
+{
+    tw_stime t = now + bg_rand_exponential(ctx, ctx->p->interval);
+    return bg_onoff_skip_off(ctx->p, t) - now;
+}
+
+static struct bg_traffic_gen const bg_uniform_gen =
+    { "uniform", NULL, bg_uniform_dests, NULL };
+static struct bg_traffic_gen const bg_neighbor_gen =
+    { "nearest_neighbor", NULL, bg_neighbor_dests, NULL };
+static struct bg_traffic_gen const bg_alltoall_gen =
+    { "alltoall", NULL, bg_alltoall_dests, NULL };
+static struct bg_traffic_gen const bg_stencil_gen =
+    { "stencil", NULL, bg_stencil_dests, NULL };
+static struct bg_traffic_gen const bg_permutation_gen =
+    { "permutation", bg_permutation_setup, bg_permutation_dests, NULL };
+static struct bg_traffic_gen const bg_hotspot_gen =
+    { "hotspot", bg_hotspot_setup, bg_hotspot_dests, NULL };
+static struct bg_traffic_gen const bg_group_gen =
+    { "nearest_group", bg_group_setup, bg_group_dests, NULL };
+static struct bg_traffic_gen const bg_onoff_gen =
+    { "onoff", bg_onoff_setup, bg_uniform_dests, bg_onoff_next };
+
+static struct bg_traffic_gen const * gen_array_default[] =
+{
+    &bg_uniform_gen,
+    &bg_neighbor_gen,
+    &bg_alltoall_gen,
+    &bg_stencil_gen,
+    &bg_permutation_gen,
+    &bg_hotspot_gen,
+    &bg_group_gen,
+    &bg_onoff_gen,
+    NULL
+};
+
+// user generators come first, so they can replace the default ones
+static struct bg_traffic_gen const ** gen_array_user = NULL;
+static int num_user_gens = 0;
+
+void bg_traffic_add_gen(struct bg_traffic_gen const * gen)
+{
+    gen_array_user = realloc(gen_array_user,
+            (num_user_gens + 1) * sizeof(*gen_array_user));
+    assert(gen_array_user);
+    gen_array_user[num_user_gens++] = gen;
+}
+
+static struct bg_traffic_gen const * find_gen(char const * name)
+{
+    int i;
+
+    for(i = 0; i < num_user_gens; i++)
+        if(strcmp(gen_array_user[i]->name, name) == 0)
+            return gen_array_user[i];
+    for(i = 0; gen_array_default[i] != NULL; i++)
+        if(strcmp(gen_array_default[i]->name, name) == 0)
+            return gen_array_default[i];
+    return NULL;
+}
+
+void bg_traffic_params_init(struct bg_traffic_params * p,
+        char const * gen_name, int payload_sz, tw_stime interval)
+{
+    memset(p, 0, sizeof(*p));
+    strncpy(p->gen_name, gen_name, BG_GEN_NAME_LEN - 1);
+    p->interval = interval;
+    p->payload_sz = payload_sz;
+    p->qos_level = 1;
+    p->ranks_per_lp = 1;
+    p->hot_fraction = 0.5;
+    p->hot_rank = 0;
+    p->group_size = 16;
+    p->perm_bytes = 8388608;
+    p->on_time = 1000000;
+    p->off_time = 1000000;
+}
+
+static int set_param(struct bg_traffic_params * p, char const * key,
+        char const * val)
+{
+    if(strcmp(key, "interval") == 0)
+        p->interval = atof(val);
+    else if(strcmp(key, "payload") == 0)
+        p->payload_sz = atoi(val);
+    else if(strcmp(key, "qos") == 0)
+        p->qos_level = atoi(val);
+    else if(strcmp(key, "ranks_per_lp") == 0)
+        p->ranks_per_lp = atoi(val);
+    else if(strcmp(key, "hot_fraction") == 0)
+        p->hot_fraction = atof(val);
+    else if(strcmp(key, "hot_rank") == 0)
+        p->hot_rank = atoi(val);
+    else if(strcmp(key, "group_size") == 0)
+        p->group_size = atoi(val);
+    else if(strcmp(key, "perm_bytes") == 0)
+        p->perm_bytes = strtoul(val, NULL, 10);
+    else if(strcmp(key, "on") == 0)
+        p->on_time = atof(val);
+    else if(strcmp(key, "off") == 0)
+        p->off_time = atof(val);
+    else if(strcmp(key, "onoff_file") == 0)
+        strncpy(p->onoff_file, val, BG_FILE_NAME_LEN - 1);
+    else
+        return -1;
+    return 0;
+}
+
+int bg_traffic_read_conf(char const * path, struct bg_traffic_params * p,
+        int * has_conf, int max_jobs)
+{
+    char line[1024];
+    int lineno = 0;
+    FILE * f = fopen(path, "r");
+
+    if(!f)
+    {
+        fprintf(stderr, "\n Could not open background traffic file %s ", path);
+        return -1;
+    }
+    while(fgets(line, sizeof(line), f))
+    {
+        char gen_name[BG_GEN_NAME_LEN];
+        char * tok, * save = NULL, * c;
+        int job, pos;
+
+        lineno++;
+        if((c = strchr(line, '#')) != NULL)
+            *c = '\0';
+        if(sscanf(line, "%d %31s%n", &job, gen_name, &pos) < 2)
+            continue;
+        if(job < 0 || job >= max_jobs)
+        {
+            fprintf(stderr, "\n %s:%d: invalid job %d ", path, lineno, job);
+            fclose(f);
+            return -1;
+        }
+        /* parameters of a job not listed keep their default */
+        bg_traffic_params_init(&p[job], gen_name, p[job].payload_sz,
+                p[job].interval);
+        has_conf[job] = 1;
+        for(tok = strtok_r(line + pos, " \t\r\n", &save); tok;
+                tok = strtok_r(NULL, " \t\r\n", &save))
+        {
+            char * eq = strchr(tok, '=');
+            if(eq)
+                *eq = '\0';
+            if(!eq || set_param(&p[job], tok, eq + 1) < 0)
+            {
+                fprintf(stderr, "\n %s:%d: invalid parameter %s ", path,
+                        lineno, tok);
+                fclose(f);
+                return -1;
+            }
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+int bg_traffic_setup(struct bg_traffic_params * p, int num_lps)
+{
+    p->gen = find_gen(p->gen_name);
+    if(!p->gen)
+    {
+        fprintf(stderr, "\n Undefined background traffic generator %s ",
+                p->gen_name);
+        return -1;
+    }
+    if(p->ranks_per_lp < 1 || p->payload_sz <= 0 || p->interval <= 0
+            || p->qos_level < 0 || p->qos_level > 1)
+    {
+        fprintf(stderr, "\n %s: invalid ranks_per_lp %d, payload %d, "
+                "interval %lf or qos %d ", p->gen_name, p->ranks_per_lp,
+                p->payload_sz, p->interval, p->qos_level);
+        return -1;
+    }
+    p->num_ranks = num_lps * p->ranks_per_lp;
+    if(p->gen->setup)
+        return p->gen->setup(p);
+    return 0;
+}
+
+void bg_traffic_finalize(struct bg_traffic_params * p)
+{
+    free(p->periods);
+    p->periods = NULL;
+    p->num_periods = 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
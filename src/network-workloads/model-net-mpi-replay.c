@@ -16,34 +16,57 @@
 #include "codes/quicklist.h"
 #include "codes/quickhash.h"
 #include "codes/codes-jobmap.h"
+#include "codes/codes-bg-traffic.h"
 
 /* turning on track lp will generate a lot of output messages */
 #define MN_LP_NM "modelnet_dragonfly_custom"
 #define CONTROL_MSG_SZ 64
 #define TRACE -1
-#define MAX_WAIT_REQS 1024
+#define COMPLETED_REQS_TABLE_SZ 256
+#define OP_RING_INIT_CAP 4
 #define CS_LP_DBG 1
-#define RANK_HASH_TABLE_SZ 2000
+/* received message size histogram: bucket 0 counts empty messages, bucket
+ * b > 0 sizes in [2^(b-1), 2^b) */
+#define MSG_SZ_BUCKETS 48
+#define COMM_CELL_TABLE_SZ 64
+#define COMM_MATRIX_MAGIC 0x31584d43u /* "CMX1" */
+#define FF_CKPT_MAGIC 0x32504b46u /* "FKP2" */
 #define NW_LP_NM "nw-lp"
 #define lprintf(_fmt, ...) \
         do {if (CS_LP_DBG) printf(_fmt, __VA_ARGS__);} while (0)
 #define MAX_STATS 65536
 #define COL_TAG 1235
 #define BAR_TAG 1234
+/* request ids of the point-to-point operations of an expanded collective,
+ * kept clear of the ids found in the traces */
+#define COL_RECV_REQ 0xfffffff0u
+#define COL_SEND_REQ 0xfffffff1u
+/* algorithm switch points, MPICH defaults */
+#define COL_BCAST_SHORT_MSG 12288
+#define COL_BCAST_MIN_PROCS 8
+#define COL_ALLREDUCE_SHORT_MSG 2048
+#define COL_ALLGATHER_LONG_MSG 524288
 #define PRINT_SYNTH_TRAFFIC 1
 
-static int msg_size_hash_compare(
-            void *key, struct qhash_head *link);
-
 static unsigned long perm_switch_thresh = 8388608;
 
 /* NOTE: Message tracking works in sequential mode only! */
 static int debug_cols = 0;
-static int synthetic_pattern = 1;
+/* expand collectives into point-to-point network traffic instead of
+ * skipping them */
+static int sim_collectives = 0;
 /* Turning on this option slows down optimistic mode substantially. Only turn
  * on if you get issues with wait-all completion with traces. */
 static int preserve_wait_ordering = 0;
 static int enable_msg_tracking = 0;
+/* binary communication matrix written at the end of the run (none if empty) */
+static char comm_matrix_file[512];
+/* fast-forward: the ranks of the trace jobs stop before their
+ * ff_collectives-th collective and the cut is written to ff_checkpoint.
+ * warm_start resumes the ranks from such a cut */
+static int ff_collectives = 0;
+static char ff_checkpoint[8192];
+static char warm_start[8192];
 static int is_synthetic = 0;
 static unsigned long long max_gen_data = 0;
 static int num_qos_levels;
@@ -85,6 +108,13 @@ tw_stime soft_delay_mpi = 2500;
 tw_stime nic_delay = 1000;
 tw_stime copy_per_byte_eager = 0.55;
 char file_name_of_job[5][8192];
+/* background traffic of the synthetic jobs, from bg_traffic_conf or the
+ * synthetic<N> job name */
+static char bg_traffic_conf[8192];
+static struct bg_traffic_params bg_params[5];
+/* destinations of a generation, as LP ranks */
+static int * bg_dests = NULL;
+static int bg_dests_cap = 0;
 
 struct codes_jobmap_ctx *jobmap_ctx;
 struct codes_jobmap_params_list jobmap_p;
@@ -128,6 +158,30 @@ double avg_time = 0, avg_comm_time = 0, avg_wait_time = 0, avg_send_time = 0, av
 
 /* runtime option for disabling computation time simulation */
 static int disable_delay = 0;
+/* fuse runs of local operations (delays, satisfied waits, request frees)
+ * into one timed advance */
+static int fuse_local_ops = 0;
+/* with fuse_local_ops, advances shorter than this (ns) are carried over to
+ * the next one instead of being simulated */
+static tw_stime min_delay = 0;
+/* operations fetched from the workload at once while fusing; the ones
+ * following the run of local operations are handed back */
+#define FUSE_BATCH 8
+
+/* number of threads used to load the traces of this PE before the
+ * simulation starts (0: traces are loaded one by one during LP init) */
+static int preload_threads = 0;
+
+/* skeleton workload: ranks in the dumpi trace (0: as many as the job), and
+ * loop folding knobs */
+static int skel_traced_ranks = 0;
+static int skel_max_period = 0;
+static double skel_delay_tol = 0.1;
+
+/* online workload: ops an SWM rank produces ahead of the simulation before
+ * yielding (0: one call at a time) */
+static int online_batch_ops = 0;
+static unsigned int online_stack_kb = 0;
 static int enable_sampling = 0;
 static double sampling_interval = 5000000;
 static double sampling_end_time = 3000000000;
@@ -163,15 +217,17 @@ enum MPI_NW_EVENTS
     CLI_NBR_FINISH,
 };
 
-/* type of synthetic traffic */
-enum TRAFFIC
+/* generator of the synthetic<N> job names, see codes-bg-traffic.h */
+static char const * const syn_gen_names[] =
 {
-    UNIFORM = 1, /* sends message to a randomly selected node */
-    NEAREST_NEIGHBOR = 2, /* sends message to the next node (potentially connected to the same router) */
-    ALLTOALL = 3, /* sends message to all other nodes */
-    STENCIL = 4, /* sends message to 4 nearby neighbors */
-    PERMUTATION = 5
+    NULL,
+    "uniform", /* sends message to a randomly selected node */
+    "nearest_neighbor", /* sends message to the next node (potentially connected to the same router) */
+    "alltoall", /* sends message to all other nodes */
+    "stencil", /* sends message to 4 nearby neighbors */
+    "permutation"
 };
+#define NUM_SYN_GENS 5
 struct mpi_workload_sample
 {
     /* Sampling data */
@@ -196,33 +252,93 @@ struct mpi_msgs_queue
     struct qlist_head ql;
 };
 
-/* stores request IDs of completed MPI operations (Isends or Irecvs) */
+/* stores request IDs of completed MPI operations (Isends or Irecvs) that
+ * have not been waited on yet, hashed on req_id */
 struct completed_requests
 {
 	unsigned int req_id;
     struct qlist_head ql;
-    int index;
+    struct qhash_head hash_link;
 };
 
-/* for wait operations, store the pending operation and number of completed waits so far. */
+/* for wait operations, store the pending operation and number of completed waits so far.
+ * req_ids (count of them) is sorted and allocated along with the struct. */
 struct pending_waits
 {
     int op_type;
-    unsigned int req_ids[MAX_WAIT_REQS];
 	int num_completed;
 	int count;
     tw_stime start_time;
     struct qlist_head ql;
+    unsigned int req_ids[];
+};
+
+struct msg_sz_bucket
+{
+    int64_t num_msgs;
+    int64_t num_bytes;
+    /* ns, rounded per message so that updates reverse exactly */
+    int64_t latency;
+};
+
+/* messages an nw-lp received from one source rank of its job, i.e. a
+ * non-zero cell of the communication matrix */
+struct comm_cell
+{
+    int src_rank;
+    int64_t num_msgs;
+    int64_t num_bytes;
+    struct qhash_head hash_link;
+    struct qlist_head ql;
+};
+
+/* communication matrix file: a comm_matrix_hdr, num_buckets msg_sz_bucket
+ * (received message sizes of the whole run) and num_ents comm_matrix_ent
+ * sorted by job, destination and source rank */
+struct comm_matrix_hdr
+{
+    uint32_t magic;
+    uint32_t num_buckets;
+    uint64_t num_ents;
+};
+
+struct comm_matrix_ent
+{
+    int32_t app_id;
+    int32_t src_rank;
+    int32_t dst_rank;
+    int32_t pad;
+    int64_t num_msgs;
+    int64_t num_bytes;
+};
+
+/* fast-forward checkpoint file: a ff_ckpt_hdr, num_ents ff_ckpt_ent sorted
+ * by job and rank, then the uint32_t ids of the requests each rank had
+ * completed but not waited on at the cut, in the order of the entries. A
+ * warm started rank skips its first op_seq trace operations (all of them if
+ * it ended before the cut) and gets those requests back */
+struct ff_ckpt_hdr
+{
+    uint32_t magic;
+    uint32_t ff_collectives;
+    uint64_t num_ents;
 };
 
-struct msg_size_info
+struct ff_ckpt_ent
 {
-    int64_t msg_size;
-    int num_msgs;
-    tw_stime agg_latency;
-    tw_stime avg_latency;
-    struct qhash_head  hash_link;
-    struct qlist_head ql; 
+    int32_t app_id;
+    int32_t rank;
+    int64_t op_seq;
+    /* simulated time of the cut, since the start of the first run */
+    double time;
+    /* 0 if the rank ended before its cut */
+    int32_t cut;
+    /* 0 if messages or waits of the rank were still pending at the cut */
+    int32_t quiescent;
+    /* its num_done completed requests start at done_ofs in the id list */
+    int64_t done_ofs;
+    int32_t num_done;
+    int32_t pad;
 };
 
 struct ross_model_sample
@@ -247,6 +363,32 @@ typedef struct mpi_msgs_queue mpi_msgs_queue;
 typedef struct completed_requests completed_requests;
 typedef struct pending_waits pending_waits;
 
+/* what an MPI_OP_GET_NEXT event did to the collective engine */
+enum col_phase
+{
+    COL_PHASE_NONE,
+    COL_PHASE_START, /* trace collective started */
+    COL_PHASE_STEP, /* point-to-point operation of a collective issued */
+    COL_PHASE_END /* collective completed */
+};
+
+/* one round of an expanded collective: each rank receives from at most one
+ * peer and sends to at most one peer, then waits for both */
+struct col_round
+{
+    int recv_peer; /* -1 if nothing is received */
+    int send_peer; /* -1 if nothing is sent */
+    int64_t recv_bytes;
+    int64_t send_bytes;
+};
+
+/* a trace operation kept until the event that issued it is committed */
+struct op_ring_entry
+{
+    struct codes_workload_op op;
+    tw_stime time;
+};
+
 /* state of the network LP. It contains the pointers to send/receive lists */
 struct nw_state
 {
@@ -256,7 +398,8 @@ struct nw_state
     int app_id;
     int local_rank;
 
-    int synthetic_pattern;
+    /* background traffic of the job, for synthetic jobs */
+    struct bg_traffic_params const * bg;
     int is_finished;
     int neighbor_completed;
 
@@ -286,6 +429,14 @@ struct nw_state
     double all_reduce_time;
     int num_all_reduce;
 
+    /* collective being expanded into point-to-point operations */
+    int col_active;
+    int col_type;
+    int col_root;
+    int64_t col_bytes;
+    int col_round;
+    int col_step;
+
 	double elapsed_time;
 	/* time spent in compute operations */
 	double compute_time;
@@ -303,15 +454,37 @@ struct nw_state
 	struct qlist_head pending_recvs_queue;
 	/* List of completed send/receive requests */
 	struct qlist_head completed_reqs;
+    struct qhash_table * completed_reqs_table;
+
+    /* trace operations by value, indexed by the per-rank sequence number
+     * (op_seq & (op_ring_cap - 1)). Entries op_ring_first .. op_seq - 1 may
+     * still be rolled back. */
+    struct op_ring_entry * op_ring;
+    int64_t op_ring_cap;
+    int64_t op_ring_first;
+    int64_t op_seq;
+
+    /* sub min_delay compute time not simulated yet */
+    tw_stime carried_delay;
+
+    /* trace operations skipped by a warm start, and the simulated time they
+     * took in the runs before */
+    int64_t ff_skipped;
+    tw_stime ff_time;
+    /* fast-forward cut (trace position and time), ff_cut_seq < 0 until the
+     * rank reaches it */
+    int64_t ff_cut_seq;
+    tw_stime ff_cut_time;
 
     tw_stime cur_interval_end;
     
     /* Pending wait operation */
     struct pending_waits * wait_op;
 
-    /* Message size latency information */
-    struct qhash_table * msg_sz_table;
-    struct qlist_head msg_sz_list;
+    /* received messages by size and, with comm_matrix_file, by source */
+    struct msg_sz_bucket msg_sz_hist[MSG_SZ_BUCKETS];
+    struct qhash_table * comm_cells;
+    struct qlist_head comm_cell_list;
 
     /* quick hash for maintaining message latencies */
 
@@ -321,9 +494,6 @@ struct nw_state
     unsigned long long syn_data;
     unsigned long long gen_data;
   
-    unsigned long prev_switch;
-    int saved_perm_dest;
-    unsigned long rc_perm;
 
     /* For sampling data */
     int sampling_indx;
@@ -344,7 +514,7 @@ struct nw_message
    int msg_type;
    int op_type;
    model_net_event_return event_rc;
-   struct codes_workload_op * mpi_op;
+   int64_t op_seq;
 
    struct
    {
@@ -366,7 +536,6 @@ struct nw_message
    } fwd;
    struct
    {
-       int saved_perm;
        double saved_send_time;
        double saved_send_time_sample;
        double saved_recv_time;
@@ -377,8 +546,16 @@ struct nw_message
        double saved_delay_sample;
        int64_t saved_num_bytes;
        int saved_syn_length;
-       unsigned long saved_prev_switch;
        double saved_prev_max_time;
+       int col_phase;
+       int saved_col_type;
+       int saved_col_root;
+       int saved_col_round;
+       int saved_col_step;
+       int fused_ops;
+       double saved_carried_delay;
+       /* request added to the completed queue by update_completed_queue */
+       unsigned int saved_completed_req;
    } rc;
 };
 
@@ -435,63 +612,93 @@ static void update_message_time_rc(
 /* conversion from seconds to eanaoseconds */
 static tw_stime s_to_ns(tw_stime ns);
 
-/*static void update_message_size_rc(
-        struct nw_state * ns,
-        tw_lp * lp,
-        tw_bf * bf,
-        struct nw_message * m)
-{*/
-/*TODO: Complete reverse handler */
-/*    (void)ns;
-    (void)lp;
-    (void)bf;
-    (void)m;
-}*/
-/* update the message size */
-static void update_message_size(
+/* received message sizes and matrix cells of the nw-lps of this PE, collected
+ * at LP finalize */
+static struct msg_sz_bucket pe_msg_sz_hist[MSG_SZ_BUCKETS];
+static struct comm_matrix_ent * pe_comm_ents = NULL;
+static int pe_comm_ents_cnt = 0;
+static int pe_comm_ents_cap = 0;
+/* cuts of the ranks of this PE, and the checkpoint read by a warm start */
+static struct ff_ckpt_ent * pe_ff_ents = NULL;
+static int pe_ff_ents_cnt = 0;
+static int pe_ff_ents_cap = 0;
+static uint32_t * pe_ff_done = NULL;
+static int64_t pe_ff_done_cnt = 0;
+static int64_t pe_ff_done_cap = 0;
+static struct ff_ckpt_ent * warm_ents = NULL;
+static uint64_t num_warm_ents = 0;
+static uint32_t * warm_done = NULL;
+static uint64_t num_warm_done = 0;
+
+static int comm_cell_compare(void *key, struct qhash_head *link)
+{
+    int *src_rank = (int*)key;
+    struct comm_cell *c = qhash_entry(link, struct comm_cell, hash_link);
+
+    return c->src_rank == *src_rank;
+}
+
+static int msg_sz_bucket_of(int64_t num_bytes)
+{
+    int b = 0;
+
+    if(num_bytes <= 0)
+        return 0;
+#ifdef __GNUC__
+    b = 64 - __builtin_clzll((unsigned long long)num_bytes);
+#else
+    while(b < 64 && (num_bytes >> b))
+        b++;
+#endif
+    return b < MSG_SZ_BUCKETS ? b : MSG_SZ_BUCKETS - 1;
+}
+
+static long long msg_sz_bucket_min(int b)
+{
+    return b ? 1LL << (b - 1) : 0;
+}
+
+/* accounts a message received from src_rank, sign -1 takes it back */
+static void record_recvd_msg(
         struct nw_state * ns,
         tw_lp * lp,
-        tw_bf * bf,
-        struct nw_message * m,
-        mpi_msgs_queue * qitem,
-        int is_eager,
-        int is_send)
+        int src_rank,
+        int64_t num_bytes,
+        tw_stime start_time,
+        int sign)
 {
-            (void)bf;
-            (void)is_eager;
+    struct msg_sz_bucket * b = &ns->msg_sz_hist[msg_sz_bucket_of(num_bytes)];
+    struct qhash_head * hash_link;
+    struct comm_cell * c;
 
-            struct qhash_head * hash_link = NULL;
-            tw_stime msg_init_time = qitem->req_init_time;
-        
-            if(ns->msg_sz_table == NULL)
-                ns->msg_sz_table = qhash_init(msg_size_hash_compare, quickhash_64bit_hash, RANK_HASH_TABLE_SZ); 
-            
-            hash_link = qhash_search(ns->msg_sz_table, &(qitem->num_bytes));
+    b->num_msgs += sign;
+    b->num_bytes += sign * num_bytes;
+    b->latency += sign * (int64_t)(tw_now(lp) - start_time + 0.5);
 
-            if(is_send)
-                msg_init_time = m->fwd.sim_start_time;
-            
-            /* update hash table */
-            if(!hash_link)
-            {
-                struct msg_size_info * msg_info = (struct msg_size_info*)malloc(sizeof(struct msg_size_info));
-                msg_info->msg_size = qitem->num_bytes;
-                msg_info->num_msgs = 1;
-                msg_info->agg_latency = tw_now(lp) - msg_init_time;
-                msg_info->avg_latency = msg_info->agg_latency;
-                assert(ns->msg_sz_table);
-                qhash_add(ns->msg_sz_table, &(msg_info->msg_size), &(msg_info->hash_link));
-                qlist_add(&msg_info->ql, &ns->msg_sz_list);
-                //printf("\n Msg size %d aggregate latency %f num messages %d ", m->fwd.num_bytes, msg_info->agg_latency, msg_info->num_msgs);
-            }
-            else
-            {
-                struct msg_size_info * tmp = qhash_entry(hash_link, struct msg_size_info, hash_link);
-                tmp->num_msgs++;
-                tmp->agg_latency += tw_now(lp) - msg_init_time;  
-                tmp->avg_latency = (tmp->agg_latency / tmp->num_msgs);
-//                printf("\n Msg size %lld aggregate latency %f num messages %d ", qitem->num_bytes, tmp->agg_latency, tmp->num_msgs);
-            }
+    if(!comm_matrix_file[0])
+        return;
+
+    if(ns->comm_cells == NULL)
+    {
+        ns->comm_cells = qhash_init(comm_cell_compare, quickhash_32bit_hash,
+                COMM_CELL_TABLE_SZ);
+        assert(ns->comm_cells);
+    }
+    hash_link = qhash_search(ns->comm_cells, &src_rank);
+    if(hash_link)
+        c = qhash_entry(hash_link, struct comm_cell, hash_link);
+    else
+    {
+        /* left in place (empty) if the message is rolled back */
+        assert(sign > 0);
+        c = (struct comm_cell*)calloc(1, sizeof(*c));
+        assert(c);
+        c->src_rank = src_rank;
+        qhash_add(ns->comm_cells, &c->src_rank, &c->hash_link);
+        qlist_add_tail(&c->ql, &ns->comm_cell_list);
+    }
+    c->num_msgs += sign;
+    c->num_bytes += sign * num_bytes;
 }
 static void notify_background_traffic_rc(
 	    struct nw_state * ns,
@@ -663,36 +870,31 @@ static void gen_synthetic_tr_rc(nw_state * s, tw_bf * bf, nw_message * m, tw_lp
     if(bf->c0)
         return;
 
-    if(bf->c1)
-    {
-        tw_rand_reverse_unif(lp->rng);
-    }
-    if(bf->c2)
-    {
-        s->prev_switch = m->rc.saved_prev_switch;
-        s->saved_perm_dest = m->rc.saved_perm;
-        tw_rand_reverse_unif(lp->rng);
-    }
-    int i;
-    for (i=0; i < m->rc.saved_syn_length; i++){
-        model_net_event_rc2(lp, &m->event_rc);
-        s->gen_data -= payload_sz;
-        num_syn_bytes_sent -= payload_sz;
-        s->num_bytes_sent -= payload_sz;
-        s->ross_sample.num_bytes_sent -= payload_sz;
-    }
+    model_net_event_rc2(lp, &m->event_rc);
+    for(int i = 0; i < m->rc.saved_syn_length; i++)
         tw_rand_reverse_unif(lp->rng);
-        s->num_sends--;
-        s->ross_sample.num_sends--;
 
-     if(bf->c5)
-         s->is_finished = 0;
-        
-    if(bf->c7)
-        tw_rand_reverse_unif(lp->rng);
+    int64_t bytes = m->rc.saved_num_bytes;
+    s->gen_data -= bytes;
+    num_syn_bytes_sent -= bytes;
+    s->num_bytes_sent -= bytes;
+    s->ross_sample.num_bytes_sent -= bytes;
+    s->num_sends -= bytes / s->bg->payload_sz;
+    s->ross_sample.num_sends -= bytes / s->bg->payload_sz;
+
+    if(bf->c5)
+        s->is_finished = 0;
+}
+
+static int cmp_ints(const void * a, const void * b)
+{
+    int x = *(const int *)a;
+    int y = *(const int *)b;
+    return (x > y) - (x < y);
 }
 
-/* generate synthetic traffic */
+/* generate synthetic traffic: one message of each background rank of the
+ * LP, with the messages to the same LP sent as one network message */
 static void gen_synthetic_tr(nw_state * s, tw_bf * bf, nw_message * m, tw_lp * lp)
 {
     if(s->is_finished == 1)
@@ -701,152 +903,85 @@ static void gen_synthetic_tr(nw_state * s, tw_bf * bf, nw_message * m, tw_lp * l
         return;
     }
 
-    /* Get job information */
-    tw_lpid global_dest_id;
-    int intm_dest_id;
-    nw_message remote_m;
+    struct bg_traffic_params const * bg = s->bg;
+    struct bg_traffic_ctx ctx;
+    int k = bg->ranks_per_lp;
+    int num_dests = 0;
+    int i, j;
+
+    ctx.p = bg;
+    ctx.lp = lp;
+    ctx.sent = s->gen_data / k;
+    ctx.num_rngs = 0;
 
+    if(bg_dests_cap < k * bg->num_ranks)
+    {
+        bg_dests_cap = k * bg->num_ranks;
+        bg_dests = (int*)realloc(bg_dests, bg_dests_cap * sizeof(int));
+        assert(bg_dests);
+    }
+    for(int v = 0; v < k; v++)
+    {
+        ctx.rank = s->local_rank * k + v;
+        int n = bg->gen->dests(&ctx, bg_dests + num_dests);
+        for(i = num_dests; i < num_dests + n; i++)
+            bg_dests[i] /= k;
+        num_dests += n;
+    }
+    qsort(bg_dests, num_dests, sizeof(int), cmp_ints);
+
+    /* Get job information */
     struct codes_jobmap_id jid;
     jid = codes_jobmap_to_local_id(s->nw_id, jobmap_ctx); 
 
-    int num_clients = codes_jobmap_get_num_ranks(jid.job, jobmap_ctx);
-
-    /* Find destination */
-    int* dest_svr = NULL; 
-    int i, length=0;
-    switch(s->synthetic_pattern)
+    m->event_rc = 0;
+    m->rc.saved_num_bytes = 0;
+    for(i = 0; i < num_dests; i = j)
     {
-        case UNIFORM:
-        {
-            bf->c1 = 1;
-            length = 1;
-            dest_svr = (int*) calloc(1, sizeof(int));
-            dest_svr[0] = tw_rand_integer(lp->rng, 0, num_clients - 1);
-            if(dest_svr[0] == s->local_rank)
-                dest_svr[0] = (s->local_rank + 1) % num_clients;
-        }
-        break;
-
-        case PERMUTATION:
-        {
-            m->rc.saved_prev_switch = s->prev_switch; //for reverse computation
+        for(j = i; j < num_dests && bg_dests[j] == bg_dests[i]; j++);
+        /* ranks of the same LP don't use the network */
+        if(bg_dests[i] == s->local_rank)
+            continue;
+
+        tw_lpid global_dest_id;
+        int intm_dest_id;
+        nw_message remote_m;
+        int64_t bytes = (int64_t)(j - i) * bg->payload_sz;
+
+        jid.rank = bg_dests[i];
+        intm_dest_id = codes_jobmap_to_global_id(jid, jobmap_ctx); 
+        global_dest_id = codes_mapping_get_lpid_from_relative(intm_dest_id, NULL, NW_LP_NM, NULL, 0);
 
-            length = 1;
-            dest_svr = (int*) calloc(1, sizeof(int));
-            if(s->gen_data == 0)
-            {
-                /*initialize the perm destination to something that is nonzero and thus preventing 
-                  possible attempt at self message*/
-                bf->c7 = 1;
-                s->saved_perm_dest = tw_rand_integer(lp->rng, 0, num_clients - 1);
-                if (s->saved_perm_dest == s->local_rank)
-                    s->saved_perm_dest = (s->local_rank + num_clients/2) % num_clients;
-            }
+        remote_m.fwd.sim_start_time = tw_now(lp);
+        remote_m.fwd.dest_rank = bg_dests[i];
+        remote_m.msg_type = CLI_BCKGND_ARRIVE;
+        remote_m.fwd.num_bytes = bytes;
+        remote_m.fwd.num_matched = j - i;
+        remote_m.fwd.app_id = s->app_id;
+        remote_m.fwd.src_rank = s->local_rank;
 
-            if(s->gen_data - s->prev_switch >= perm_switch_thresh)
-            {
-                // printf("%d - %d >= %d\n",s->gen_data,s->prev_switch,perm_switch_thresh);
-                bf->c2 = 1;
-                m->rc.saved_prev_switch = s->prev_switch;
-                s->prev_switch = s->gen_data; //Amount of data pushed at time when switch initiated
-                dest_svr[0] = tw_rand_integer(lp->rng, 0, num_clients - 1);
-                if(dest_svr[0] == s->local_rank)
-                    dest_svr[0] = (s->local_rank + num_clients/2) % num_clients;
-                /* TODO: Fix random number generation code */
-                m->rc.saved_perm = s->saved_perm_dest;
-                s->saved_perm_dest = dest_svr[0];
-                assert(s->saved_perm_dest != s->local_rank);
-            }
-            else
-                dest_svr[0] = s->saved_perm_dest;
+        m->event_rc += model_net_event(net_id, bg->qos_level == 0 ? "high" : "medium",
+                global_dest_id, bytes, 0.0,
+                sizeof(nw_message), (const void*)&remote_m, 
+                0, NULL, lp);
 
-            assert(dest_svr[0] != s->local_rank);
-        }
-        break;
-        case NEAREST_NEIGHBOR:
-        {
-            length = 1;
-            dest_svr = (int*) calloc(1, sizeof(int));
-            dest_svr[0] = (s->local_rank + 1) % num_clients;
-        }
-        break;
-        case ALLTOALL:
-        {
-            dest_svr = (int*) calloc(num_clients-1, sizeof(int));
-            int index = 0;
-            for (i=0;i<num_clients;i++)
-            {
-                if(i!=s->local_rank) 
-                {
-                    dest_svr[index] = i;
-                    index++;
-                    length++;
-                }
-            }
-        }
-        break;
-        case STENCIL:  //2D 4-point stencil
-        {
-            /* I think this code snippet is coming from the LLNL stencil patterns. */
-            int digits, x=1, y=1, row, col, temp=num_clients;
-            length = 4;
-            dest_svr = (int*) calloc(4, sizeof(int));
-            for (digits = 0; temp > 0; temp >>= 1)
-                digits++;
-            digits = digits/2;
-            for (i = 0; i < digits; i++)
-                x = x * 2;
-            y = num_clients / x;
-            //printf("\nStencil Syn: x=%d, y=%d", x, y);
-            row = s->local_rank / y;
-            col = s->local_rank % y;
-
-            dest_svr[0] = row * y + ((col-1+y)%y);   /* left neighbor */
-            dest_svr[1] = row * y + ((col+1+y)%y);   /* right neighbor */
-            dest_svr[2] = ((row-1+x)%x) * y + col;   /* bottom neighbor */
-            dest_svr[3] = ((row+1+x)%x) * y + col;   /* up neighbor */
-        }
-        break;
-        default:
-            tw_error(TW_LOC, "Undefined traffic pattern");
-    }   
-    /* Record length for reverse handler*/
-    m->rc.saved_syn_length = length;
-
-    if(length > 0)
-    {
-        // m->event_array_rc = (model_net_event_return) malloc(length * sizeof(model_net_event_return));
-        //printf("\nRANK %d Dests %d", s->local_rank, length);
-        for (i = 0; i < length; i++)
-        {
-            /* Generate synthetic traffic */
-            jid.rank = dest_svr[i];
-            intm_dest_id = codes_jobmap_to_global_id(jid, jobmap_ctx); 
-            global_dest_id = codes_mapping_get_lpid_from_relative(intm_dest_id, NULL, NW_LP_NM, NULL, 0);
-
-            remote_m.fwd.sim_start_time = tw_now(lp);
-            remote_m.fwd.dest_rank = dest_svr[i];
-            remote_m.msg_type = CLI_BCKGND_ARRIVE;
-            remote_m.fwd.num_bytes = payload_sz;
-            remote_m.fwd.app_id = s->app_id;
-            remote_m.fwd.src_rank = s->local_rank;
-
-            // printf("\nAPP %d SRC %d Dest %d (twid %llu)", jid.job, s->local_rank, dest_svr[i], global_dest_id);
-            m->event_rc = model_net_event(net_id, "medium", global_dest_id, payload_sz, 0.0, 
-                    sizeof(nw_message), (const void*)&remote_m, 
-                    0, NULL, lp);
-            
-            s->gen_data += payload_sz;
-            s->num_bytes_sent += payload_sz;
-            s->ross_sample.num_bytes_sent += payload_sz;
-            num_syn_bytes_sent += payload_sz; 
-        }
+        m->rc.saved_num_bytes += bytes;
+        s->num_sends += j - i;
+        s->ross_sample.num_sends += j - i;
     }
-    s->num_sends++;
-    s->ross_sample.num_sends++;
+    s->gen_data += m->rc.saved_num_bytes;
+    s->num_bytes_sent += m->rc.saved_num_bytes;
+    s->ross_sample.num_bytes_sent += m->rc.saved_num_bytes;
+    num_syn_bytes_sent += m->rc.saved_num_bytes;
+
+    /* New event after the generation interval */
+    tw_stime ts;
+    if(bg->gen->next)
+        ts = bg->gen->next(&ctx, tw_now(lp));
+    else
+        ts = bg->interval + bg_rand_exponential(&ctx, noise);
+    m->rc.saved_syn_length = ctx.num_rngs;
 
-    /* New event after MEAN_INTERVAL */  
-    tw_stime ts = mean_interval  + tw_rand_exponential(lp->rng, noise); 
     tw_event * e;
     nw_message * m_new;
     e = tw_event_new(lp->gid, ts, lp);
@@ -855,13 +990,11 @@ static void gen_synthetic_tr(nw_state * s, tw_bf * bf, nw_message * m, tw_lp * l
     tw_event_send(e);
     
     if (max_gen_data != 0) { //max_gen_data is by default 0 (off). If it's on, then we use it to determine when to finish synth ranks
-        if(s->gen_data >= max_gen_data) {
+        if(s->gen_data >= max_gen_data * k) {
             bf->c5 = 1;
             s->is_finished = 1;
         }
     }
-
-    free(dest_svr);
 }
 
 void arrive_syn_tr_rc(nw_state * s, tw_bf * bf, nw_message * m, tw_lp * lp)
@@ -870,8 +1003,8 @@ void arrive_syn_tr_rc(nw_state * s, tw_bf * bf, nw_message * m, tw_lp * lp)
     (void)m;
     (void)lp;
 //    printf("\n Data arrived %d total data %ld ", m->fwd.num_bytes, s->syn_data);
-    s->num_recvs--;
-    s->ross_sample.num_recvs--;
+    s->num_recvs -= m->fwd.num_matched;
+    s->ross_sample.num_recvs -= m->fwd.num_matched;
     int data = m->fwd.num_bytes;
     s->syn_data -= data;
     num_syn_bytes_recvd -= data;
@@ -919,8 +1052,8 @@ void arrive_syn_tr(nw_state * s, tw_bf * bf, nw_message * m, tw_lp * lp)
 
     s->send_time += (tw_now(lp) - m->fwd.sim_start_time);
     s->ross_sample.send_time += (tw_now(lp) - m->fwd.sim_start_time);
-    s->num_recvs++;
-    s->ross_sample.num_recvs++;
+    s->num_recvs += m->fwd.num_matched;
+    s->ross_sample.num_recvs += m->fwd.num_matched;
     int data = m->fwd.num_bytes;
     s->syn_data += data;
     s->num_bytes_recvd += data;
@@ -962,49 +1095,116 @@ static void print_completed_queue(tw_lp * lp, struct qlist_head * head)
             tw_output(lp, " %llu ", current->req_id);
        }
 }
+static int completed_reqs_hash_compare(
+        void *key, struct qhash_head *link)
+{
+    unsigned int *req_id = (unsigned int *)key;
+    struct completed_requests *tmp;
+
+    tmp = qhash_entry(link, struct completed_requests, hash_link);
+    if (tmp->req_id == *req_id)
+        return 1;
+
+    return 0;
+}
+
+/* adds a request to the completed requests (list head and hash table) */
+static void add_completed_req(nw_state * s, completed_requests * req)
+{
+    if(s->completed_reqs_table == NULL)
+        s->completed_reqs_table = qhash_init(completed_reqs_hash_compare,
+                quickhash_32bit_hash, COMPLETED_REQS_TABLE_SZ);
+    assert(s->completed_reqs_table);
+
+    qlist_add(&req->ql, &s->completed_reqs);
+    qhash_add(s->completed_reqs_table, &(req->req_id), &(req->hash_link));
+}
+
+static void del_completed_req(completed_requests * req)
+{
+    qlist_del(&req->ql);
+    qhash_del(&req->hash_link);
+}
+
+static completed_requests * find_completed_req(nw_state * s, unsigned int req_id)
+{
+    if(s->completed_reqs_table == NULL)
+        return NULL;
+
+    struct qhash_head * hash_link = qhash_search(s->completed_reqs_table, &req_id);
+    if(!hash_link)
+        return NULL;
+
+    return qhash_entry(hash_link, completed_requests, hash_link);
+}
+
+static int cmp_req_ids(const void * a, const void * b)
+{
+    unsigned int x = *(const unsigned int *)a;
+    unsigned int y = *(const unsigned int *)b;
+    return (x > y) - (x < y);
+}
+
+/* allocates a pending wait on count requests, the ids are kept sorted so that
+ * completions can be looked up in O(log count) */
+static struct pending_waits * new_pending_wait(int op_type, uint32_t * req_ids,
+        int count, tw_stime start_time)
+{
+    struct pending_waits * wait_op = (struct pending_waits*)malloc(
+            sizeof(struct pending_waits) + count * sizeof(unsigned int));
+    assert(wait_op);
+    wait_op->op_type = op_type;
+    wait_op->count = count;
+    wait_op->num_completed = 0;
+    wait_op->start_time = start_time;
+    for(int i = 0; i < count; i++)
+        wait_op->req_ids[i] = req_ids[i];
+    qsort(wait_op->req_ids, count, sizeof(unsigned int), cmp_req_ids);
+    return wait_op;
+}
+
+/* number of times req_id appears in the pending wait */
+static int pending_wait_count_req(struct pending_waits * wait_op, unsigned int req_id)
+{
+    int lo = 0, hi = wait_op->count;
+    while(lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if(wait_op->req_ids[mid] < req_id)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    int n = 0;
+    while(lo + n < wait_op->count && wait_op->req_ids[lo + n] == req_id)
+        n++;
+    return n;
+}
+
+/* removes the given requests from the completed ones, returns the number
+ * removed (saved on the matched_reqs stack for reverse computation) */
 static int clear_completed_reqs(nw_state * s,
         tw_lp * lp,
         unsigned int * reqs, int count)
 {
-    (void)s;
-    (void)lp;
-
     int i, matched = 0;
 
     for( i = 0; i < count; i++)
     {
-      struct qlist_head * ent = NULL;
-      struct completed_requests * current = NULL;
-      struct completed_requests * prev = NULL;
-
-      int index = 0;
-      qlist_for_each(ent, &s->completed_reqs)
-       {
-           if(prev)
-           {
-              rc_stack_push(lp, prev, free, s->matched_reqs);
-              prev = NULL;
-           }
-            
-           current = qlist_entry(ent, completed_requests, ql);
-           current->index = index; 
-            if(current->req_id == reqs[i])
-            {
-                ++matched;
-                qlist_del(&current->ql);
-                prev = current;
-            }
-            ++index;
-       }
-
-      if(prev)
-      {
-         rc_stack_push(lp, prev, free, s->matched_reqs);
-         prev = NULL;
-      }
+        completed_requests * current;
+        while((current = find_completed_req(s, reqs[i])) != NULL)
+        {
+            ++matched;
+            del_completed_req(current);
+            rc_stack_push(lp, current, free, s->matched_reqs);
+        }
     }
     return matched;
 }
+/* puts back the last count requests removed by clear_completed_reqs or the
+ * fused waits of codes_exec_local_ops. They go to the head of the completed
+ * queue, so reverse handlers must look requests up by id
+ * (update_completed_queue_rc) rather than rely on their position */
 static void add_completed_reqs(nw_state * s,
         tw_lp * lp,
         int count)
@@ -1014,7 +1214,7 @@ static void add_completed_reqs(nw_state * s,
     {
        struct completed_requests * req = (struct completed_requests*)rc_stack_pop(s->matched_reqs);
        // turn on only if wait-all unmatched error arises in optimistic mode.
-       qlist_add(&req->ql, &s->completed_reqs);
+       add_completed_req(s, req);
     }//end for
 }
 
@@ -1040,39 +1240,32 @@ static int notify_posted_wait(nw_state* s,
 
     int op_type = wait_elem->op_type;
 
-    if(op_type == CODES_WK_WAIT &&
-            (wait_elem->req_ids[0] == completed_req))
-    {
-            m->fwd.wait_completed = 1;
-            wait_completed = 1;
-    }
-    else if(op_type == CODES_WK_WAITALL
+    if(op_type == CODES_WK_WAIT
+            || op_type == CODES_WK_WAITALL
             || op_type == CODES_WK_WAITANY
             || op_type == CODES_WK_WAITSOME)
     {
-        int i;
-        for(i = 0; i < wait_elem->count; i++)
+        /* a request id may be waited on more than once */
+        int n = pending_wait_count_req(wait_elem, completed_req);
+        if(n > 0)
         {
-            if(wait_elem->req_ids[i] == completed_req)
+            wait_elem->num_completed += n;
+            if(wait_elem->num_completed > wait_elem->count)
+                printf("\n Num completed %d count %d LP %llu ",
+                        wait_elem->num_completed,
+                        wait_elem->count,
+                        LLU(lp->gid));
+//            if(wait_elem->num_completed > wait_elem->count)
+//                tw_lp_suspend(lp, 1, 0);
+
+            if(wait_elem->num_completed >= wait_elem->count)
             {
-                wait_elem->num_completed++;
-                if(wait_elem->num_completed > wait_elem->count)
-                    printf("\n Num completed %d count %d LP %llu ",
-                            wait_elem->num_completed,
-                            wait_elem->count,
-                            LLU(lp->gid));
-//                if(wait_elem->num_completed > wait_elem->count)
-//                    tw_lp_suspend(lp, 1, 0);
-
-                if(wait_elem->num_completed >= wait_elem->count)
-                {
-                    if(enable_debug)
-                        fprintf(workload_log, "\n(%lf) APP ID %d MPI WAITALL COMPLETED AT %llu ", tw_now(lp), s->app_id, LLU(s->nw_id));
-                    wait_completed = 1;
-                }
-
-                m->fwd.wait_completed = 1;
+                if(enable_debug && op_type != CODES_WK_WAIT)
+                    fprintf(workload_log, "\n(%lf) APP ID %d MPI WAITALL COMPLETED AT %llu ", tw_now(lp), s->app_id, LLU(s->nw_id));
+                wait_completed = 1;
             }
+
+            m->fwd.wait_completed = n;
         }
     }
     return wait_completed;
@@ -1081,27 +1274,11 @@ static int notify_posted_wait(nw_state* s,
 /* reverse handler of MPI wait operation */
 static void codes_exec_mpi_wait_rc(nw_state* s, tw_bf * bf, tw_lp* lp, nw_message * m)
 {
+   (void)m;
    if(bf->c1)
     {
         completed_requests * qi = (completed_requests*)rc_stack_pop(s->processed_ops);
-        if(m->fwd.found_match == 0)
-        {
-            qlist_add(&qi->ql, &s->completed_reqs);
-        }
-        else
-        {
-           int index = 1;
-           struct qlist_head * ent = NULL;
-           qlist_for_each(ent, &s->completed_reqs)
-           {
-                if(index == m->fwd.found_match)
-                {
-                    qlist_add(&qi->ql, ent);
-                    break;
-                }
-                index++;
-           }
-        }
+        add_completed_req(s, qi);
         codes_issue_next_event_rc(lp);
         return;
     }
@@ -1113,34 +1290,27 @@ static void codes_exec_mpi_wait_rc(nw_state* s, tw_bf * bf, tw_lp* lp, nw_messag
 /* execute MPI wait operation */
 static void codes_exec_mpi_wait(nw_state* s, tw_bf * bf, nw_message * m, tw_lp* lp, struct codes_workload_op * mpi_op)
 {
+    (void)m;
     /* check in the completed receives queue if the request ID has already been completed.*/
                 
 //    printf("\n Wait posted rank id %d ", s->nw_id);
     assert(!s->wait_op);
     unsigned int req_id = mpi_op->u.wait.req_id;
 
-    struct completed_requests* current = NULL;
+    struct completed_requests* current = find_completed_req(s, req_id);
 
-    struct qlist_head * ent = NULL;
-    int index = 0;
-    qlist_for_each(ent, &s->completed_reqs)
+    if(current)
     {
-        current = qlist_entry(ent, completed_requests, ql);
-        if(current->req_id == req_id)
+        bf->c1=1;
+        del_completed_req(current);
+        rc_stack_push(lp, current, free, s->processed_ops);
+        codes_issue_next_event(lp);
+        if(s->nw_id == (tw_lpid)TRACK_LP)
         {
-            bf->c1=1;
-            qlist_del(&current->ql);
-            rc_stack_push(lp, current, free, s->processed_ops);
-            codes_issue_next_event(lp);
-            m->fwd.found_match = index;
-            if(s->nw_id == (tw_lpid)TRACK_LP)
-            {
-                tw_output(lp, "\n wait matched at post %d ", req_id);
-                print_completed_queue(lp, &s->completed_reqs);
-            }
-            return;
+            tw_output(lp, "\n wait matched at post %d ", req_id);
+            print_completed_queue(lp, &s->completed_reqs);
         }
-        ++index;
+        return;
     }
 
     /*if(s->nw_id == (tw_lpid)TRACK_LP)
@@ -1149,13 +1319,7 @@ static void codes_exec_mpi_wait(nw_state* s, tw_bf * bf, nw_message * m, tw_lp*
         print_completed_queue(lp, &s->completed_reqs);
     }*/
     /* If not, add the wait operation in the pending 'waits' list. */
-    struct pending_waits* wait_op = (struct pending_waits*)malloc(sizeof(struct pending_waits));
-    wait_op->op_type = mpi_op->op_type;
-    wait_op->req_ids[0] = req_id;
-    wait_op->count = 1;
-    wait_op->num_completed = 0;
-    wait_op->start_time = tw_now(lp);
-    s->wait_op = wait_op;
+    s->wait_op = new_pending_wait(mpi_op->op_type, &mpi_op->u.wait.req_id, 1, tw_now(lp));
 
     return;
 }
@@ -1226,8 +1390,6 @@ static void codes_exec_mpi_wait_all(
     s->mpi_wkld_samples[indx].num_waits_sample++;
   }
   int count = mpi_op->u.waits.count;
-  /* If the count is not less than max wait reqs then stop */
-  assert(count < MAX_WAIT_REQS);
 
   int i = 0, num_matched = 0;
   m->fwd.num_matched = 0;
@@ -1241,15 +1403,8 @@ static void codes_exec_mpi_wait_all(
       /* check number of completed irecvs in the completion queue */
   for(i = 0; i < count; i++)
   {
-      unsigned int req_id = mpi_op->u.waits.req_ids[i];
-      struct qlist_head * ent = NULL;
-      struct completed_requests* current = NULL;
-      qlist_for_each(ent, &s->completed_reqs)
-       {
-            current = qlist_entry(ent, struct completed_requests, ql);
-            if(current->req_id == req_id)
-                num_matched++;
-       }
+      if(find_completed_req(s, mpi_op->u.waits.req_ids[i]))
+          num_matched++;
   }
 
   m->fwd.found_match = num_matched;
@@ -1266,16 +1421,9 @@ static void codes_exec_mpi_wait_all(
   else
   {
       /* If not, add the wait operation in the pending 'waits' list. */
-	  struct pending_waits* wait_op = (struct pending_waits*)malloc(sizeof(struct pending_waits));
-	  wait_op->count = count;
-      wait_op->op_type = mpi_op->op_type;
-      assert(count < MAX_WAIT_REQS);
-
-      for(i = 0; i < count; i++)
-          wait_op->req_ids[i] =  mpi_op->u.waits.req_ids[i];
-
+      struct pending_waits* wait_op = new_pending_wait(mpi_op->op_type,
+              mpi_op->u.waits.req_ids, count, tw_now(lp));
 	  wait_op->num_completed = num_matched;
-	  wait_op->start_time = tw_now(lp);
       s->wait_op = wait_op;
   }
   return;
@@ -1312,10 +1460,6 @@ static int rm_matching_rcv(nw_state * ns,
 
     if(matched)
     {
-        if(enable_msg_tracking && qitem->num_bytes < EAGER_THRESHOLD)
-        {
-            update_message_size(ns, lp, bf, m, qitem, 1, 1);
-        }
         if(qitem->num_bytes >= EAGER_THRESHOLD)
         {
             /* Matching receive found, need to notify the sender to transmit
@@ -1381,9 +1525,6 @@ static int rm_matching_send(nw_state * ns,
 
     if(matched)
     {
-        if(enable_msg_tracking && (qi->num_bytes < EAGER_THRESHOLD))
-            update_message_size(ns, lp, bf, m, qi, 1, 0);
-        
         m->fwd.matched_req = qitem->req_id;
         int is_rend = 0;
         if(qitem->num_bytes >= EAGER_THRESHOLD)
@@ -1812,9 +1953,12 @@ static void update_completed_queue_rc(nw_state * s, tw_bf * bf, nw_message * m,
 
     if(bf->c30)
     {
-       struct qlist_head * ent = qlist_pop(&s->completed_reqs);
-
-        completed_requests * req = qlist_entry(ent, completed_requests, ql);
+       /* the request is looked up by id: reverse handlers of waits re-add
+        * the requests they consumed at the head of the queue, so it is not
+        * necessarily the most recent entry any more */
+       completed_requests * req = find_completed_req(s, m->rc.saved_completed_req);
+       assert(req);
+       del_completed_req(req);
        free(req);
     }
     else if(bf->c31)
@@ -1827,7 +1971,7 @@ static void update_completed_queue_rc(nw_state * s, tw_bf * bf, nw_message * m,
        codes_issue_next_event_rc(lp);
     }
     if(m->fwd.wait_completed > 0)
-           s->wait_op->num_completed--;
+           s->wait_op->num_completed -= m->fwd.wait_completed;
 }
 
 static void update_completed_queue(nw_state* s,
@@ -1848,7 +1992,8 @@ static void update_completed_queue(nw_state* s,
         bf->c30 = 1;
         completed_requests * req = (completed_requests*)malloc(sizeof(completed_requests));
         req->req_id = req_id;
-        qlist_add(&req->ql, &s->completed_reqs);
+        add_completed_req(s, req);
+        m->rc.saved_completed_req = req_id;
 
         /*if(s->nw_id == (tw_lpid)TRACK_LP)
         {
@@ -1940,7 +2085,11 @@ static void update_arrival_queue_rc(nw_state* s,
     num_bytes_recvd -= m->fwd.num_bytes;
 
     if(bf->c1)
+    {
         codes_local_latency_reverse(lp);
+        record_recvd_msg(s, lp, m->fwd.src_rank, m->fwd.num_bytes,
+                m->fwd.sim_start_time, -1);
+    }
 
     if(bf->c10)
         send_ack_back_rc(s, bf, m, lp);
@@ -2015,6 +2164,9 @@ static void update_arrival_queue(nw_state* s, tw_bf * bf, nw_message * m, tw_lp
 
     if(m->fwd.num_bytes < EAGER_THRESHOLD)
     {
+        record_recvd_msg(s, lp, m->fwd.src_rank, m->fwd.num_bytes,
+                m->fwd.sim_start_time, 1);
+
         tw_stime ts = codes_local_latency(lp);
         assert(ts > 0);
         bf->c1 = 1;
@@ -2081,6 +2233,125 @@ static void update_message_time_rc(
 }
 
 /* initializes the network node LP, loads the trace file in the structs, calls the first MPI operation to be executed */
+static int ff_ckpt_ent_cmp(const void * a, const void * b)
+{
+    struct ff_ckpt_ent const * x = (struct ff_ckpt_ent const *)a;
+    struct ff_ckpt_ent const * y = (struct ff_ckpt_ent const *)b;
+    if(x->app_id != y->app_id)
+        return x->app_id < y->app_id ? -1 : 1;
+    if(x->rank != y->rank)
+        return x->rank < y->rank ? -1 : 1;
+    return 0;
+}
+
+/* skips the trace operations a warm started rank replayed before the cut */
+static void warm_start_rank(nw_state * s)
+{
+    struct ff_ckpt_ent key, * e;
+    struct codes_workload_op op;
+
+    key.app_id = s->app_id;
+    key.rank = s->local_rank;
+    e = (struct ff_ckpt_ent*)bsearch(&key, warm_ents, num_warm_ents,
+            sizeof(*e), ff_ckpt_ent_cmp);
+    if(!e)
+        tw_error(TW_LOC, "\n Rank %d of job %d is not in the warm start checkpoint %s ",
+                s->local_rank, s->app_id, warm_start);
+
+    while(!e->cut || s->ff_skipped < e->op_seq)
+    {
+        codes_workload_get_next(wrkld_id, s->app_id, s->local_rank, &op);
+        if(op.op_type == CODES_WK_END)
+        {
+            if(e->cut)
+                tw_error(TW_LOC, "\n Trace of rank %d of job %d ends before its warm start position %"PRId64" ",
+                        s->local_rank, s->app_id, e->op_seq);
+            /* the rank ended during the fast-forward, it ends right away */
+            codes_workload_get_next_rc(wrkld_id, s->app_id, s->local_rank, &op);
+            break;
+        }
+        s->ff_skipped++;
+    }
+    s->ff_time = e->time;
+
+    /* in reverse, so that the list is in the order of the cut */
+    for(int i = e->num_done - 1; i >= 0; i--)
+    {
+        completed_requests * req = (completed_requests*)malloc(sizeof(completed_requests));
+        assert(req);
+        req->req_id = warm_done[e->done_ofs + i];
+        add_completed_req(s, req);
+    }
+}
+
+static int is_collective_op(int op_type)
+{
+    switch(op_type)
+    {
+        case CODES_WK_ALLREDUCE:
+        case CODES_WK_REDUCE:
+        case CODES_WK_BCAST:
+        case CODES_WK_ALLGATHER:
+        case CODES_WK_ALLGATHERV:
+        case CODES_WK_ALLTOALL:
+        case CODES_WK_ALLTOALLV:
+        case CODES_WK_COL:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/* records where a rank of a trace job stands at the end of a fast-forward
+ * run: cut before its collective, ended, or blocked (-1) on a rank that
+ * stopped */
+static void ff_add_cut(nw_state * s)
+{
+    if(pe_ff_ents_cnt == pe_ff_ents_cap)
+    {
+        pe_ff_ents_cap = pe_ff_ents_cap ? 2 * pe_ff_ents_cap : 1024;
+        pe_ff_ents = (struct ff_ckpt_ent*)realloc(pe_ff_ents,
+                pe_ff_ents_cap * sizeof(*pe_ff_ents));
+        assert(pe_ff_ents);
+    }
+    struct ff_ckpt_ent * e = &pe_ff_ents[pe_ff_ents_cnt++];
+    memset(e, 0, sizeof(*e));
+    e->app_id = s->app_id;
+    e->rank = s->local_rank;
+    if(s->ff_cut_seq >= 0)
+    {
+        e->cut = 1;
+        e->op_seq = s->ff_cut_seq;
+        e->time = s->ff_cut_time;
+    }
+    else
+    {
+        e->cut = s->is_finished ? 0 : -1;
+        e->op_seq = -1;
+        e->time = s->ff_time + s->elapsed_time;
+    }
+    e->quiescent = s->wait_op == NULL
+        && qlist_empty(&s->pending_recvs_queue)
+        && qlist_empty(&s->arrival_queue);
+
+    /* requests completed before the cut are waited on after it */
+    struct qlist_head * ent;
+    e->done_ofs = pe_ff_done_cnt;
+    qlist_for_each(ent, &s->completed_reqs)
+    {
+        if(pe_ff_done_cnt == pe_ff_done_cap)
+        {
+            pe_ff_done_cap = pe_ff_done_cap ? 2 * pe_ff_done_cap : 1024;
+            pe_ff_done = (uint32_t*)realloc(pe_ff_done,
+                    pe_ff_done_cap * sizeof(*pe_ff_done));
+            assert(pe_ff_done);
+        }
+        pe_ff_done[pe_ff_done_cnt++] =
+            qlist_entry(ent, completed_requests, ql)->req_id;
+        e->num_done++;
+    }
+}
+
 void nw_test_init(nw_state* s, tw_lp* lp)
 {
    /* initialize the LP's and load the data */
@@ -2095,7 +2366,7 @@ void nw_test_init(nw_state* s, tw_lp* lp)
    s->num_reduce = 0;
    s->reduce_time = 0;
    s->all_reduce_time = 0;
-   s->prev_switch = 0;
+   s->col_active = 0;
    s->max_time = 0;
 
    char type_name[512];
@@ -2147,6 +2418,17 @@ void nw_test_init(nw_state* s, tw_lp* lp)
 	strcpy(params_d.cortex_gen, cortex_gen);
 #endif
    }
+   else if(strcmp(workload_type, "skeleton") == 0){
+       skeleton_params params_s;
+       strcpy(params_s.file_name, file_name_of_job[lid.job]);
+       params_s.nprocs = num_traces_of_job[lid.job];
+       params_s.num_traced_ranks = skel_traced_ranks > 0 ?
+           skel_traced_ranks : params_s.nprocs;
+       params_s.max_period = skel_max_period;
+       params_s.delay_tolerance = skel_delay_tol;
+       params = (char*)&params_s;
+       strcpy(type_name, "skeleton-workload");
+   }
    else if(strcmp(workload_type, "online") == 0){
            
        online_comm_params oc_params;
@@ -2165,6 +2447,8 @@ void nw_test_init(nw_state* s, tw_lp* lp)
        /*TODO: nprocs is different for dumpi and online workload. for
         * online, it is the number of ranks to be simulated. */
        oc_params.nprocs = num_traces_of_job[lid.job]; 
+       oc_params.batch_ops = online_batch_ops;
+       oc_params.stack_size = (size_t)online_stack_kb * 1024;
        params = (char*)&oc_params;
        strcpy(type_name, "online_comm_workload");
    }
@@ -2185,9 +2469,21 @@ void nw_test_init(nw_state* s, tw_lp* lp)
    INIT_QLIST_HEAD(&s->arrival_queue);
    INIT_QLIST_HEAD(&s->pending_recvs_queue);
    INIT_QLIST_HEAD(&s->completed_reqs);
-   INIT_QLIST_HEAD(&s->msg_sz_list);
-
-   s->msg_sz_table = NULL;
+   s->completed_reqs_table = NULL;
+   s->op_ring = NULL;
+   s->op_ring_cap = 0;
+   s->op_ring_first = 0;
+   s->op_seq = 0;
+   s->carried_delay = 0;
+   s->ff_skipped = 0;
+   s->ff_time = 0;
+   s->ff_cut_seq = -1;
+   s->ff_cut_time = 0;
+   s->bg = NULL;
+   INIT_QLIST_HEAD(&s->comm_cell_list);
+
+   memset(s->msg_sz_hist, 0, sizeof(s->msg_sz_hist));
+   s->comm_cells = NULL;
    /* Initialize the RC stack */
    rc_stack_create(&s->processed_ops);
    rc_stack_create(&s->processed_wait_op);
@@ -2211,16 +2507,8 @@ void nw_test_init(nw_state* s, tw_lp* lp)
 
    if(strncmp(file_name_of_job[lid.job], "synthetic", 9) == 0)
    {
-        sscanf(file_name_of_job[lid.job], "synthetic%d", &synthetic_pattern);
-        if(synthetic_pattern <=0 || synthetic_pattern > 5)
-        {
-            printf("\n Undefined synthetic pattern: setting to uniform random ");
-            s->synthetic_pattern = 1;
-        }
-        else
-        {
-            s->synthetic_pattern = synthetic_pattern;
-        }
+        /* configured in main */
+        s->bg = &bg_params[lid.job];
 
         tw_event * e;
         nw_message * m_new;
@@ -2235,6 +2523,8 @@ void nw_test_init(nw_state* s, tw_lp* lp)
    else 
    {
    wrkld_id = codes_workload_load(type_name, params, s->app_id, s->local_rank);
+   if(warm_ents)
+       warm_start_rank(s);
    codes_issue_next_event(lp);
    }
    if(enable_sampling && sampling_interval > 0)
@@ -2268,18 +2558,9 @@ void nw_test_event_handler(nw_state* s, tw_bf * bf, nw_message * m, tw_lp * lp)
 
         case MPI_REND_ARRIVED:
         {
-           /* update time of messages */
-            mpi_msgs_queue mpi_op;
-            mpi_op.op_type = m->op_type;
-            mpi_op.tag = m->fwd.tag;
-            mpi_op.num_bytes = m->fwd.num_bytes;
-            mpi_op.source_rank = m->fwd.src_rank;
-            mpi_op.dest_rank = m->fwd.dest_rank;
-            mpi_op.req_init_time = m->fwd.sim_start_time;
-           
-            if(enable_msg_tracking)
-                update_message_size(s, lp, bf, m, &mpi_op, 0, 1);
-        
+            record_recvd_msg(s, lp, m->fwd.src_rank, m->fwd.num_bytes,
+                    m->fwd.sim_start_time, 1);
+
             int global_src_id = m->fwd.src_rank;
             
             if(alloc_spec)
@@ -2379,21 +2660,616 @@ void nw_test_event_handler(nw_state* s, tw_bf * bf, nw_message * m, tw_lp * lp)
 	}
 }
 
-static void get_next_mpi_operation_rc(nw_state* s, tw_bf * bf, nw_message * m, tw_lp * lp)
+/* smallest power of two >= n, and its log */
+static int col_ceil_log2(int n)
 {
-    codes_workload_get_next_rc(wrkld_id, s->app_id, s->local_rank, m->mpi_op);
+    int l = 0;
+    while((1 << l) < n)
+        l++;
+    return l;
+}
 
-	if(m->op_type == CODES_WK_END)
+static int64_t col_div_up(int64_t n, int64_t d)
+{
+    int64_t q = (n + d - 1) / d;
+    return q > 0 ? q : 1;
+}
+
+static void col_set(struct col_round * r, int recv_peer, int64_t recv_bytes,
+        int send_peer, int64_t send_bytes)
+{
+    r->recv_peer = recv_peer;
+    r->recv_bytes = recv_bytes;
+    r->send_peer = send_peer;
+    r->send_bytes = send_bytes;
+}
+
+/* dissemination barrier */
+static int col_barrier_round(int nranks, int rank, int round, struct col_round * r)
+{
+    if(round >= col_ceil_log2(nranks))
+        return 0;
+
+    int dist = 1 << round;
+    col_set(r, (rank - dist + nranks) % nranks, CONTROL_MSG_SZ,
+            (rank + dist) % nranks, CONTROL_MSG_SZ);
+    return 1;
+}
+
+/* binomial tree broadcast for short messages, scatter followed by a ring
+ * allgather for long ones */
+static int col_bcast_round(int64_t nbytes, int root, int nranks, int rank,
+        int round, struct col_round * r)
+{
+    int levels = col_ceil_log2(nranks);
+    int vrank = (rank - root + nranks) % nranks;
+    int scatter = (nbytes >= COL_BCAST_SHORT_MSG && nranks >= COL_BCAST_MIN_PROCS);
+    int64_t chunk = col_div_up(nbytes, nranks);
+
+    col_set(r, -1, 0, -1, 0);
+    if(round < levels)
     {
-        s->is_finished = 0;
+        /* the tree halves at every level, subtree sizes give the scatter
+         * message sizes */
+        int mask = 1 << (levels - 1 - round);
+        if(vrank % (2 * mask) == 0 && vrank + mask < nranks)
+        {
+            int end = vrank + 2 * mask < nranks ? vrank + 2 * mask : nranks;
+            int sub = end - (vrank + mask);
+            r->send_peer = (vrank + mask + root) % nranks;
+            r->send_bytes = scatter ? chunk * sub : nbytes;
+        }
+        else if(vrank % (2 * mask) == mask)
+        {
+            int end = vrank + mask < nranks ? vrank + mask : nranks;
+            int sub = end - vrank;
+            r->recv_peer = (vrank - mask + root) % nranks;
+            r->recv_bytes = scatter ? chunk * sub : nbytes;
+        }
+        return 1;
+    }
+    if(scatter && round < levels + nranks - 1)
+    {
+        col_set(r, (rank - 1 + nranks) % nranks, chunk,
+                (rank + 1) % nranks, chunk);
+        return 1;
+    }
+    return 0;
+}
 
-        if(bf->c9)
-            return;
+/* binomial tree reduce */
+static int col_reduce_round(int64_t nbytes, int root, int nranks, int rank,
+        int round, struct col_round * r)
+{
+    if(round >= col_ceil_log2(nranks))
+        return 0;
+
+    int vrank = (rank - root + nranks) % nranks;
+    int mask = 1 << round;
+
+    col_set(r, -1, 0, -1, 0);
+    if(vrank % (2 * mask) == mask)
+    {
+        r->send_peer = (vrank - mask + root) % nranks;
+        r->send_bytes = nbytes;
+    }
+    else if(vrank % (2 * mask) == 0 && vrank + mask < nranks)
+    {
+        r->recv_peer = (vrank + mask + root) % nranks;
+        r->recv_bytes = nbytes;
+    }
+    return 1;
+}
+
+/* recursive doubling for short messages, Rabenseifner's reduce-scatter
+ * (recursive halving) followed by a recursive doubling allgather for long
+ * ones. With a non power of two number of ranks, the first 2 * rem ranks
+ * fold pairwise into rem ranks before and unfold after. */
+static int col_allreduce_round(int64_t nbytes, int nranks, int rank,
+        int round, struct col_round * r)
+{
+    int levels = col_ceil_log2(nranks);
+    int pof2 = (1 << levels) == nranks ? nranks : 1 << (levels - 1);
+    int lg_pof2 = (1 << levels) == nranks ? levels : levels - 1;
+    int rem = nranks - pof2;
+    int rabenseifner = (nbytes > COL_ALLREDUCE_SHORT_MSG && nbytes >= pof2);
+    int core_rounds = rabenseifner ? 2 * lg_pof2 : lg_pof2;
+
+    col_set(r, -1, 0, -1, 0);
+    if(rem)
+    {
+        if(round == 0)
+        {
+            if(rank < 2 * rem && rank % 2 == 0)
+                col_set(r, -1, 0, rank + 1, nbytes);
+            else if(rank < 2 * rem)
+                col_set(r, rank - 1, nbytes, -1, 0);
+            return 1;
+        }
+        if(round == core_rounds + 1)
+        {
+            if(rank < 2 * rem && rank % 2 == 1)
+                col_set(r, -1, 0, rank - 1, nbytes);
+            else if(rank < 2 * rem)
+                col_set(r, rank + 1, nbytes, -1, 0);
+            return 1;
+        }
+        if(round > core_rounds + 1)
+            return 0;
+        round--;
+    }
+    else if(round >= core_rounds)
+        return 0;
+
+    /* ranks folded away sit the core rounds out */
+    if(rank < 2 * rem && rank % 2 == 0)
+        return 1;
+
+    int newrank = rank < 2 * rem ? rank / 2 : rank - rem;
+    int mask;
+    int64_t bytes;
+    if(!rabenseifner)
+    {
+        mask = 1 << round;
+        bytes = nbytes;
+    }
+    else if(round < lg_pof2)
+    {
+        mask = 1 << round;
+        bytes = col_div_up(nbytes, (int64_t)2 << round);
+    }
+    else
+    {
+        mask = pof2 >> (round - lg_pof2 + 1);
+        bytes = col_div_up(nbytes, pof2 >> (round - lg_pof2));
+    }
+    int newpeer = newrank ^ mask;
+    int peer = newpeer < rem ? newpeer * 2 + 1 : newpeer + rem;
+    col_set(r, peer, bytes, peer, bytes);
+    return 1;
+}
+
+/* recursive doubling for power of two number of ranks and short totals,
+ * ring otherwise */
+static int col_allgather_round(int64_t nbytes, int nranks, int rank,
+        int round, struct col_round * r)
+{
+    int levels = col_ceil_log2(nranks);
+
+    if((1 << levels) == nranks && nbytes * nranks < COL_ALLGATHER_LONG_MSG)
+    {
+        if(round >= levels)
+            return 0;
+        int peer = rank ^ (1 << round);
+        col_set(r, peer, nbytes << round, peer, nbytes << round);
+        return 1;
+    }
+    if(round >= nranks - 1)
+        return 0;
+    col_set(r, (rank - 1 + nranks) % nranks, nbytes, (rank + 1) % nranks, nbytes);
+    return 1;
+}
+
+/* pairwise exchange */
+static int col_alltoall_round(int64_t nbytes, int nranks, int rank,
+        int round, struct col_round * r)
+{
+    if(round >= nranks - 1)
+        return 0;
+
+    int dist = round + 1;
+    if((nranks & (nranks - 1)) == 0)
+        col_set(r, rank ^ dist, nbytes, rank ^ dist, nbytes);
+    else
+        col_set(r, (rank - dist + nranks) % nranks, nbytes,
+                (rank + dist) % nranks, nbytes);
+    return 1;
+}
+
+/* fills in the given round of a collective for a rank, returns 0 once the
+ * collective has no rounds left */
+static int col_get_round(int col_type, int64_t nbytes, int root, int nranks,
+        int rank, int round, struct col_round * r)
+{
+    if(col_type != CODES_WK_COL && nbytes <= 0)
+        return 0;
+
+    switch(col_type)
+    {
+        case CODES_WK_BCAST:
+            return col_bcast_round(nbytes, root, nranks, rank, round, r);
+        case CODES_WK_REDUCE:
+            return col_reduce_round(nbytes, root, nranks, rank, round, r);
+        case CODES_WK_ALLREDUCE:
+            return col_allreduce_round(nbytes, nranks, rank, round, r);
+        case CODES_WK_ALLGATHER:
+        case CODES_WK_ALLGATHERV:
+            return col_allgather_round(nbytes, nranks, rank, round, r);
+        case CODES_WK_ALLTOALL:
+        case CODES_WK_ALLTOALLV:
+            return col_alltoall_round(nbytes, nranks, rank, round, r);
+        case CODES_WK_COL:
+            return col_barrier_round(nranks, rank, round, r);
+        default:
+            tw_error(TW_LOC, "\n Invalid collective type %d", col_type);
+    }
+    return 0;
+}
+
+static void codes_exec_mpi_col_rc(nw_state * s, tw_bf * bf, nw_message * m, tw_lp * lp)
+{
+    (void)bf;
+    s->col_active = 0;
+    s->col_type = m->rc.saved_col_type;
+    s->col_root = m->rc.saved_col_root;
+    s->col_bytes = m->rc.saved_num_bytes;
+    s->col_time = m->rc.saved_send_time;
+    s->col_round = m->rc.saved_col_round;
+    s->col_step = m->rc.saved_col_step;
+    codes_issue_next_event_rc(lp);
+}
+
+/* start expanding a trace collective, its point-to-point operations are
+ * issued by the following MPI_OP_GET_NEXT events */
+static void codes_exec_mpi_col(nw_state * s, tw_bf * bf, nw_message * m, tw_lp * lp,
+        struct codes_workload_op * mpi_op)
+{
+    (void)bf;
+    m->rc.col_phase = COL_PHASE_START;
+    m->rc.saved_col_type = s->col_type;
+    m->rc.saved_col_root = s->col_root;
+    m->rc.saved_num_bytes = s->col_bytes;
+    m->rc.saved_send_time = s->col_time;
+    m->rc.saved_col_round = s->col_round;
+    m->rc.saved_col_step = s->col_step;
+
+    s->col_active = 1;
+    s->col_type = mpi_op->op_type;
+    s->col_bytes = mpi_op->u.collective.num_bytes;
+    s->col_root = 0;
+    if(mpi_op->op_type == CODES_WK_BCAST || mpi_op->op_type == CODES_WK_REDUCE)
+        s->col_root = mpi_op->u.collective.root;
+    s->col_round = 0;
+    s->col_step = 0;
+    s->col_time = tw_now(lp);
+
+    if(enable_debug)
+        fprintf(workload_log, "\n (%lf) APP %d MPI COLLECTIVE %d SOURCE %llu BYTES %"PRId64,
+                tw_now(lp), s->app_id, s->col_type, LLU(s->nw_id), s->col_bytes);
+
+    codes_issue_next_event(lp);
+}
+
+static void codes_exec_mpi_col_step_rc(nw_state * s, tw_bf * bf, nw_message * m, tw_lp * lp)
+{
+    (void)bf;
+    s->col_round = m->rc.saved_col_round;
+    s->col_step = m->rc.saved_col_step;
+
+    if(m->rc.col_phase == COL_PHASE_END)
+    {
+        s->col_active = 1;
+        if(s->col_type == CODES_WK_ALLREDUCE)
+        {
+            s->num_all_reduce--;
+            s->all_reduce_time = m->rc.saved_delay;
+        }
+        codes_issue_next_event_rc(lp);
+    }
+}
+
+/* produce the next point-to-point operation of the active collective in op.
+ * Every round posts its receive, then its send, then waits for both. Returns
+ * 0 (and completes the collective) once there is nothing left to issue. */
+static int codes_exec_mpi_col_step(nw_state * s, tw_bf * bf, nw_message * m, tw_lp * lp,
+        struct codes_workload_op * op, uint32_t * req_ids)
+{
+    (void)bf;
+    struct col_round r;
+    int nranks = num_traces_of_job[s->app_id];
+
+    m->rc.col_phase = COL_PHASE_STEP;
+    m->rc.saved_col_round = s->col_round;
+    m->rc.saved_col_step = s->col_step;
+
+    while(col_get_round(s->col_type, s->col_bytes, s->col_root, nranks,
+                s->local_rank, s->col_round, &r))
+    {
+        int has_recv = (r.recv_peer >= 0);
+        int has_send = (r.send_peer >= 0);
+
+        if(!has_recv && !has_send)
+        {
+            s->col_round++;
+            continue;
+        }
+        memset(op, 0, sizeof(*op));
+        if(s->col_step == 0 && has_recv)
+        {
+            op->op_type = CODES_WK_IRECV;
+            op->u.recv.source_rank = r.recv_peer;
+            op->u.recv.dest_rank = s->local_rank;
+            op->u.recv.num_bytes = r.recv_bytes;
+            op->u.recv.tag = COL_TAG;
+            op->u.recv.req_id = COL_RECV_REQ;
+            s->col_step++;
+        }
+        else if(s->col_step == has_recv && has_send)
+        {
+            op->op_type = CODES_WK_ISEND;
+            op->u.send.source_rank = s->local_rank;
+            op->u.send.dest_rank = r.send_peer;
+            op->u.send.num_bytes = r.send_bytes;
+            op->u.send.tag = COL_TAG;
+            op->u.send.req_id = COL_SEND_REQ;
+            s->col_step++;
+        }
+        else
+        {
+            int count = 0;
+            if(has_recv)
+                req_ids[count++] = COL_RECV_REQ;
+            if(has_send)
+                req_ids[count++] = COL_SEND_REQ;
+            op->op_type = CODES_WK_WAITALL;
+            op->u.waits.count = count;
+            op->u.waits.req_ids = req_ids;
+            s->col_round++;
+            s->col_step = 0;
+        }
+        return 1;
+    }
+
+    m->rc.col_phase = COL_PHASE_END;
+    s->col_active = 0;
+    if(s->col_type == CODES_WK_ALLREDUCE)
+    {
+        m->rc.saved_delay = s->all_reduce_time;
+        s->all_reduce_time += (tw_now(lp) - s->col_time);
+        s->num_all_reduce++;
+    }
+    codes_issue_next_event(lp);
+    return 0;
+}
+
+/* returns the ring slot for the next trace operation of the rank. Slots of
+ * events older than GVT are reused, the ring grows when none is free. */
+static struct codes_workload_op * op_ring_next(nw_state * s, tw_lp * lp, int64_t * seq)
+{
+    switch(g_tw_synchronization_protocol)
+    {
+        case OPTIMISTIC:
+        case OPTIMISTIC_REALTIME:
+            while(s->op_ring_first < s->op_seq &&
+                    s->op_ring[s->op_ring_first & (s->op_ring_cap - 1)].time < lp->pe->GVT)
+                s->op_ring_first++;
+            break;
+        case OPTIMISTIC_DEBUG:
+            /* everything may be rolled back to the beginning */
+            break;
+        default:
+            s->op_ring_first = s->op_seq;
+    }
+
+    if(s->op_seq - s->op_ring_first == s->op_ring_cap)
+    {
+        int64_t cap = s->op_ring_cap ? 2 * s->op_ring_cap : OP_RING_INIT_CAP;
+        struct op_ring_entry * ring = (struct op_ring_entry*)malloc(cap * sizeof(struct op_ring_entry));
+        assert(ring);
+        for(int64_t i = s->op_ring_first; i < s->op_seq; i++)
+            ring[i & (cap - 1)] = s->op_ring[i & (s->op_ring_cap - 1)];
+        free(s->op_ring);
+        s->op_ring = ring;
+        s->op_ring_cap = cap;
+    }
+
+    struct op_ring_entry * ent = &s->op_ring[s->op_seq & (s->op_ring_cap - 1)];
+    ent->time = tw_now(lp);
+    *seq = s->op_seq++;
+    return &ent->op;
+}
+
+/* gives back the slot of the latest trace operation */
+static struct codes_workload_op * op_ring_prev(nw_state * s, int64_t seq)
+{
+    s->op_seq--;
+    assert(seq == s->op_seq && seq >= s->op_ring_first);
+    return &s->op_ring[seq & (s->op_ring_cap - 1)].op;
+}
+
+/* whether op can be replayed without waiting on the network */
+static int is_local_op(nw_state * s, struct codes_workload_op * op)
+{
+    switch(op->op_type)
+    {
+        case CODES_WK_DELAY:
+        case CODES_WK_REQ_FREE:
+            return 1;
+        case CODES_WK_WAIT:
+            return !enable_sampling && find_completed_req(s, op->u.wait.req_id) != NULL;
+        case CODES_WK_WAITALL:
+            if(enable_sampling)
+                return 0;
+            for(int i = 0; i < op->u.waits.count; i++)
+                if(!find_completed_req(s, op->u.waits.req_ids[i]))
+                    return 0;
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static void codes_exec_local_ops_rc(nw_state * s, tw_bf * bf, nw_message * m, tw_lp * lp)
+{
+    for(int i = m->rc.fused_ops - 1; i >= 0; i--)
+    {
+        struct codes_workload_op * op = op_ring_prev(s, m->op_seq + i);
+        if(op->op_type == CODES_WK_DELAY)
+            s->num_delays--;
+        else if(op->op_type == CODES_WK_WAIT)
+            s->num_wait--;
+        else if(op->op_type == CODES_WK_WAITALL)
+            s->num_waitall--;
+        codes_workload_get_next_rc(wrkld_id, s->app_id, s->local_rank, op);
+    }
+    add_completed_reqs(s, lp, m->fwd.num_matched);
+    s->compute_time = m->rc.saved_delay;
+    s->ross_sample.compute_time = m->rc.saved_delay_sample;
+    s->carried_delay = m->rc.saved_carried_delay;
+    if(bf->c28)
+        tw_rand_reverse_unif(lp->rng);
+}
+
+/* replays mpi_op and the local operations following it in the trace, then
+ * schedules the next operation once their delays have elapsed. The trace
+ * is read FUSE_BATCH operations at a time and the ones following the run
+ * are handed back to the workload. */
+static void codes_exec_local_ops(nw_state * s, tw_bf * bf, nw_message * m, tw_lp * lp,
+        struct codes_workload_op * mpi_op)
+{
+    struct codes_workload_op batch[FUSE_BATCH];
+    struct codes_workload_op * op = mpi_op;
+    int nbatch = 0, next = 0;
+    int64_t seq;
+    tw_stime delay = 0;
+
+    bf->c28 = 0;
+    m->rc.fused_ops = 1;
+    m->fwd.num_matched = 0;
+    m->rc.saved_delay = s->compute_time;
+    m->rc.saved_delay_sample = s->ross_sample.compute_time;
+    m->rc.saved_carried_delay = s->carried_delay;
+
+    while(1)
+    {
+        if(op->op_type == CODES_WK_DELAY)
+        {
+            s->num_delays++;
+            if(!disable_delay)
+                delay += op->u.delay.nsecs/compute_time_speedup;
+        }
+        else if(op->op_type == CODES_WK_WAIT)
+        {
+            s->num_wait++;
+            completed_requests * req = find_completed_req(s, op->u.wait.req_id);
+            del_completed_req(req);
+            rc_stack_push(lp, req, free, s->matched_reqs);
+            m->fwd.num_matched++;
+        }
+        else if(op->op_type == CODES_WK_WAITALL)
+        {
+            s->num_waitall++;
+            m->fwd.num_matched += clear_completed_reqs(s, lp, op->u.waits.req_ids, op->u.waits.count);
+        }
+
+        if(next == nbatch)
+        {
+            nbatch = codes_workload_get_next_batch(wrkld_id, s->app_id,
+                    s->local_rank, batch, FUSE_BATCH);
+            next = 0;
+        }
+        if(!is_local_op(s, &batch[next]))
+        {
+            codes_workload_get_next_rc_batch(wrkld_id, s->app_id,
+                    s->local_rank, batch + next, nbatch - next);
+            break;
+        }
+        op = op_ring_next(s, lp, &seq);
+        *op = batch[next++];
+        m->rc.fused_ops++;
+    }
+
+    s->compute_time += delay;
+    s->ross_sample.compute_time += delay;
+
+    tw_stime ts = delay + s->carried_delay;
+    s->carried_delay = 0;
+    if(ts < min_delay)
+        s->carried_delay = ts;
+
+    if(ts < min_delay || ts <= g_tw_lookahead)
+    {
+        bf->c28 = 1;
+        codes_issue_next_event(lp);
+    }
+    else
+    {
+        tw_event * e = tw_event_new(lp->gid, ts, lp);
+        nw_message * msg = (nw_message*)tw_event_data(e);
+        msg->msg_type = MPI_OP_GET_NEXT;
+        tw_event_send(e);
+    }
+}
+
+/* the workload of a rank is over, either at its end or at a fast-forward
+ * cut */
+static void finish_rank_wkld(nw_state * s, tw_bf * bf, nw_message * m, tw_lp * lp)
+{
+    s->elapsed_time = tw_now(lp) - s->start_time;
+    s->is_finished = 1;
+
+    if(!alloc_spec)
+    {
+        bf->c9 = 1;
+        return;
+    }
+
+    /* Notify ranks from other job that checkpoint traffic has
+     * completed */
+    printf("\n Network node %d Rank %llu finished at %lf ", s->local_rank, LLU(s->nw_id), tw_now(lp));
+    int num_jobs = codes_jobmap_get_num_jobs(jobmap_ctx);
+    if(num_jobs <= 1 || is_synthetic == 0)
+    {
+        bf->c19 = 1;
+        return;
+    }
+
+    if(num_qos_levels == 1) //notify neighbor isn't really compatible with QoS, so notify_neighbor is only called if num_qos_levels == 1 (QoS off)
+        notify_neighbor(s, lp, bf, m);
+}
+
+static void finish_rank_wkld_rc(nw_state * s, tw_bf * bf, nw_message * m, tw_lp * lp)
+{
+    s->is_finished = 0;
+
+    if(bf->c9)
+        return;
+
+    if(bf->c19)
+        return;
 
-        if(bf->c19)
+    notify_neighbor_rc(s, lp, bf, m);
+}
+
+static void get_next_mpi_operation_rc(nw_state* s, tw_bf * bf, nw_message * m, tw_lp * lp)
+{
+    if(m->rc.col_phase == COL_PHASE_STEP || m->rc.col_phase == COL_PHASE_END)
+    {
+        codes_exec_mpi_col_step_rc(s, bf, m, lp);
+        if(m->rc.col_phase == COL_PHASE_END)
             return;
+    }
+    else if(m->rc.fused_ops)
+    {
+        codes_exec_local_ops_rc(s, bf, m, lp);
+        return;
+    }
+    else
+    {
+        codes_workload_get_next_rc(wrkld_id, s->app_id, s->local_rank,
+                op_ring_prev(s, m->op_seq));
+    }
 
-        notify_neighbor_rc(s, lp, bf, m);
+    if(bf->c20)
+    {
+        s->ff_cut_seq = -1;
+        finish_rank_wkld_rc(s, bf, m, lp);
+        s->elapsed_time = m->rc.saved_delay;
+        return;
+    }
+	if(m->op_type == CODES_WK_END)
+    {
+        finish_rank_wkld_rc(s, bf, m, lp);
 		return;
     }
 	switch(m->op_type)
@@ -2431,6 +3307,12 @@ static void get_next_mpi_operation_rc(nw_state* s, tw_bf * bf, nw_message * m, t
 		break;
 		case CODES_WK_ALLREDUCE:
         {
+            s->num_cols--;
+            if(m->rc.col_phase == COL_PHASE_START)
+            {
+                codes_exec_mpi_col_rc(s, bf, m, lp);
+                break;
+            }
             if(bf->c27)
             {
                 s->num_all_reduce--;
@@ -2453,7 +3335,10 @@ static void get_next_mpi_operation_rc(nw_state* s, tw_bf * bf, nw_message * m, t
 		case CODES_WK_COL:
 		{
 			s->num_cols--;
-		    codes_issue_next_event_rc(lp);
+            if(m->rc.col_phase == COL_PHASE_START)
+                codes_exec_mpi_col_rc(s, bf, m, lp);
+            else
+		        codes_issue_next_event_rc(lp);
         }
 		break;
 
@@ -2465,6 +3350,10 @@ static void get_next_mpi_operation_rc(nw_state* s, tw_bf * bf, nw_message * m, t
         }
         break;
 
+        case CODES_WK_REQ_FREE:
+           codes_issue_next_event_rc(lp);
+        break;
+
 		case CODES_WK_WAIT:
 		{
 			s->num_wait--;
@@ -2484,43 +3373,55 @@ static void get_next_mpi_operation_rc(nw_state* s, tw_bf * bf, nw_message * m, t
 
 static void get_next_mpi_operation(nw_state* s, tw_bf * bf, nw_message * m, tw_lp * lp)
 {
-		//struct codes_workload_op * mpi_op = malloc(sizeof(struct codes_workload_op));
 //        printf("\n App id %d local rank %d ", s->app_id, s->local_rank);
-    //    struct codes_workload_op mpi_op;
-    //    codes_workload_get_next(wrkld_id, s->app_id, s->local_rank, &mpi_op);
 
-	    struct codes_workload_op * mpi_op = (struct codes_workload_op*)malloc(sizeof(struct codes_workload_op));
-        codes_workload_get_next(wrkld_id, s->app_id, s->local_rank, mpi_op);
-        m->mpi_op = mpi_op; 
-        m->op_type = mpi_op->op_type;
+        struct codes_workload_op * mpi_op;
+        struct codes_workload_op col_op;
+        uint32_t col_req_ids[2];
 
-        if(mpi_op->op_type == CODES_WK_END)
+        m->rc.col_phase = COL_PHASE_NONE;
+        m->rc.fused_ops = 0;
+        if(s->col_active)
         {
-            s->elapsed_time = tw_now(lp) - s->start_time;
-            s->is_finished = 1;
-
-            
-            if(!alloc_spec)
+            /* the next operation comes from the collective being expanded,
+             * not from the trace */
+            if(!codes_exec_mpi_col_step(s, bf, m, lp, &col_op, col_req_ids))
             {
-                bf->c9 = 1;
+                m->op_type = s->col_type;
                 return;
             }
-            
-            /* Notify ranks from other job that checkpoint traffic has
-             * completed */
-             printf("\n Network node %d Rank %llu finished at %lf ", s->local_rank, LLU(s->nw_id), tw_now(lp));
-            int num_jobs = codes_jobmap_get_num_jobs(jobmap_ctx); 
-             if(num_jobs <= 1 || is_synthetic == 0)
-             {
-                bf->c19 = 1;
+            mpi_op = &col_op;
+        }
+        else
+        {
+            mpi_op = op_ring_next(s, lp, &m->op_seq);
+            codes_workload_get_next(wrkld_id, s->app_id, s->local_rank, mpi_op);
+            if(ff_collectives > 0 && is_collective_op(mpi_op->op_type)
+                    && s->num_cols + 1 == (unsigned long)ff_collectives)
+            {
+                /* fast-forward cut: the rank stops before the collective,
+                 * which a warm start replays first */
+                bf->c20 = 1;
+                m->op_type = mpi_op->op_type;
+                m->rc.saved_delay = s->elapsed_time;
+                s->ff_cut_seq = s->ff_skipped + m->op_seq;
+                s->ff_cut_time = s->ff_time + tw_now(lp);
+                finish_rank_wkld(s, bf, m, lp);
                 return;
-             }
-
-            if(num_qos_levels == 1) //notify neighbor isn't really compatible with QoS, so notify_neighbor is only called if num_qos_levels == 1 (QoS off)
-                notify_neighbor(s, lp, bf, m);
-//             printf("Client rank %llu completed workload, local rank %d .\n", s->nw_id, s->local_rank);
+            }
+            if(fuse_local_ops && is_local_op(s, mpi_op))
+            {
+                m->op_type = mpi_op->op_type;
+                codes_exec_local_ops(s, bf, m, lp, mpi_op);
+                return;
+            }
+        }
+        m->op_type = mpi_op->op_type;
 
-             return;
+        if(mpi_op->op_type == CODES_WK_END)
+        {
+            finish_rank_wkld(s, bf, m, lp);
+            return;
         }
 		switch(mpi_op->op_type)
 		{
@@ -2562,6 +3463,10 @@ static void get_next_mpi_operation(nw_state* s, tw_bf * bf, nw_message * m, tw_l
             }
             break;
 
+            case CODES_WK_REQ_FREE:
+                codes_issue_next_event(lp);
+            break;
+
 			case CODES_WK_WAITALL:
 			  {
                 //printf("\n MPI WAITALL ");
@@ -2581,6 +3486,11 @@ static void get_next_mpi_operation(nw_state* s, tw_bf * bf, nw_message * m, tw_l
 			case CODES_WK_ALLREDUCE:
             {
 				s->num_cols++;
+                if(sim_collectives)
+                {
+                    codes_exec_mpi_col(s, bf, m, lp, mpi_op);
+                    break;
+                }
                 if(s->col_time > 0)
                 {
                     bf->c27 = 1;
@@ -2607,7 +3517,10 @@ static void get_next_mpi_operation(nw_state* s, tw_bf * bf, nw_message * m, tw_l
 			case CODES_WK_COL:
 			{
 				s->num_cols++;
-			    codes_issue_next_event(lp);
+                if(sim_collectives)
+                    codes_exec_mpi_col(s, bf, m, lp, mpi_op);
+                else
+			        codes_issue_next_event(lp);
             }
 			break;
 			default:
@@ -2639,6 +3552,8 @@ void nw_test_finalize(nw_state* s, tw_lp* lp)
             avg_msg_time = (s->send_time / s->num_recvs);
         else if(strcmp(workload_type, "online") == 0) 
         codes_workload_finalize("online_comm_workload", params, s->app_id, s->local_rank);
+        else if(strcmp(workload_type, "skeleton") == 0)
+            codes_workload_finalize("skeleton-workload", params, s->app_id, s->local_rank);
     }
     else
     {
@@ -2647,30 +3562,65 @@ void nw_test_finalize(nw_state* s, tw_lp* lp)
         
         if(strcmp(workload_type, "online") == 0) 
             codes_workload_finalize("online_comm_workload", params, s->app_id, s->local_rank);
+        else if(strcmp(workload_type, "skeleton") == 0)
+            codes_workload_finalize("skeleton-workload", params, s->app_id, s->local_rank);
     }
 
-        struct msg_size_info * tmp_msg = NULL; 
-        struct qlist_head * ent = NULL;
-
         if(s->local_rank == 0 && enable_msg_tracking)
             fprintf(msg_size_log, "\n rank_id message_size num_messages avg_latency");
-        
-        if(enable_msg_tracking)
+
+        for(int b = 0; b < MSG_SZ_BUCKETS; b++)
         {
-            qlist_for_each(ent, &s->msg_sz_list)
+            struct msg_sz_bucket * h = &s->msg_sz_hist[b];
+            if(!h->num_msgs)
+                continue;
+            pe_msg_sz_hist[b].num_msgs += h->num_msgs;
+            pe_msg_sz_hist[b].num_bytes += h->num_bytes;
+            pe_msg_sz_hist[b].latency += h->latency;
+            if(enable_msg_tracking)
             {
-                tmp_msg = qlist_entry(ent, struct msg_size_info, ql);
-                printf("\n Rank %d Msg size %"PRId64" num_msgs %d agg_latency %f avg_latency %f",
-                        s->local_rank, tmp_msg->msg_size, tmp_msg->num_msgs, tmp_msg->agg_latency, tmp_msg->avg_latency);
-                //fprintf(msg_size_log, "\n Rank %d Msg size %d num_msgs %d agg_latency %f avg_latency %f",
-                //        s->local_rank, tmp_msg->msg_size, tmp_msg->num_msgs, tmp_msg->agg_latency, tmp_msg->avg_latency);
+                /* sizes are reported as the lower bound of their bucket */
+                printf("\n Rank %d Msg size %lld num_msgs %"PRId64" avg_latency %f",
+                        s->local_rank, msg_sz_bucket_min(b), h->num_msgs,
+                        (double)h->latency / h->num_msgs);
                 if(s->local_rank == 0)
                 {
-                    fprintf(msg_size_log, "\n %llu %"PRId64" %d %f",
-                        LLU(s->nw_id), tmp_msg->msg_size, tmp_msg->num_msgs, tmp_msg->avg_latency);
+                    fprintf(msg_size_log, "\n %llu %lld %"PRId64" %f",
+                        LLU(s->nw_id), msg_sz_bucket_min(b), h->num_msgs,
+                        (double)h->latency / h->num_msgs);
                 }
             }
         }
+        if(s->comm_cells)
+        {
+            struct qlist_head * ent = NULL, * ent_next = NULL;
+            qlist_for_each_safe(ent, ent_next, &s->comm_cell_list)
+            {
+                struct comm_cell * c = qlist_entry(ent, struct comm_cell, ql);
+                if(c->num_msgs > 0)
+                {
+                    if(pe_comm_ents_cnt == pe_comm_ents_cap)
+                    {
+                        pe_comm_ents_cap = pe_comm_ents_cap ? 2 * pe_comm_ents_cap : 1024;
+                        pe_comm_ents = (struct comm_matrix_ent*)realloc(pe_comm_ents,
+                                pe_comm_ents_cap * sizeof(*pe_comm_ents));
+                        assert(pe_comm_ents);
+                    }
+                    struct comm_matrix_ent * e = &pe_comm_ents[pe_comm_ents_cnt++];
+                    e->app_id = s->app_id;
+                    e->src_rank = c->src_rank;
+                    e->dst_rank = s->local_rank;
+                    e->pad = 0;
+                    e->num_msgs = c->num_msgs;
+                    e->num_bytes = c->num_bytes;
+                }
+                free(c);
+            }
+            qhash_finalize(s->comm_cells);
+            s->comm_cells = NULL;
+        }
+        if(ff_collectives > 0 && !s->bg)
+            ff_add_cut(s);
 		int count_irecv = 0, count_isend = 0;
         count_irecv = qlist_count(&s->pending_recvs_queue);
         count_isend = qlist_count(&s->arrival_queue);
@@ -2733,6 +3683,7 @@ void nw_test_finalize(nw_state* s, tw_lp* lp)
 //	    rc_stack_destroy(s->indices);
 	    rc_stack_destroy(s->processed_ops);
 	    rc_stack_destroy(s->processed_wait_op);
+        free(s->op_ring);
 }
 
 void nw_test_event_handler_rc(nw_state* s, tw_bf * bf, nw_message * m, tw_lp * lp)
@@ -2766,6 +3717,9 @@ void nw_test_event_handler_rc(nw_state* s, tw_bf * bf, nw_message * m, tw_lp * l
         {
             codes_local_latency_reverse(lp);
 
+            record_recvd_msg(s, lp, m->fwd.src_rank, m->fwd.num_bytes,
+                    m->fwd.sim_start_time, -1);
+
             if(bf->c10)
                 codes_issue_next_event_rc(lp);
 
@@ -2813,15 +3767,29 @@ const tw_optdef app_opt [] =
 	TWOPT_ULONGLONG("max_gen_data", max_gen_data, "maximum data to be generated for synthetic traffic (Default 0 (OFF))"),
 	TWOPT_UINT("eager_threshold", EAGER_THRESHOLD, "the transition point for eager/rendezvous protocols (Default 8192)"),
     TWOPT_UINT("disable_compute", disable_delay, "disable compute simulation"),
+    TWOPT_UINT("fuse_local_ops", fuse_local_ops, "replay consecutive delays, already satisfied waits and request frees as a single timed advance (Default 0 (OFF))"),
+    TWOPT_STIME("min_delay", min_delay, "with fuse_local_ops, compute delays shorter than this (ns) are merged into the next one (Default 0)"),
+    TWOPT_UINT("skeleton_traced_ranks", skel_traced_ranks, "with workload_type=skeleton, number of ranks in the dumpi trace, the job size must be a multiple of it (Default 0: the job size)"),
+    TWOPT_UINT("skeleton_max_period", skel_max_period, "with workload_type=skeleton, longest loop body searched for in the trace, in operations (Default 256)"),
+    TWOPT_DOUBLE("skeleton_delay_tol", skel_delay_tol, "with workload_type=skeleton, relative difference of compute delays folded into one loop (Default 0.1)"),
+    TWOPT_UINT("online_batch_ops", online_batch_ops, "with workload_type=online, number of operations an SWM rank buffers before yielding to the simulation (Default 0: yield after every call)"),
+    TWOPT_UINT("online_stack_kb", online_stack_kb, "with workload_type=online, stack size in KiB of the thread running each SWM rank, recycled once the rank ends (Default 0: Argobots default)"),
+    TWOPT_UINT("preload_threads", preload_threads, "number of threads loading the workload traces of each PE before the simulation starts (Default 0 (OFF))"),
     TWOPT_UINT("payload_sz", payload_sz, "size of the payload for synthetic traffic"),
     TWOPT_UINT("syn_type", syn_type, "type of synthetic traffic"),
     TWOPT_UINT("preserve_wait_ordering", preserve_wait_ordering, "only enable when getting unmatched send/recv errors in optimistic mode (turning on slows down simulation)"),
+    TWOPT_CHAR("comm_matrix_file", comm_matrix_file, "write the number of messages and bytes exchanged by each pair of ranks to this binary file at the end of the run"),
+    TWOPT_UINT("ff_collectives", ff_collectives, "fast-forward: stop each rank of the trace jobs before its N-th collective and write the cut to ff_checkpoint (Default 0 (OFF))"),
+    TWOPT_CHAR("ff_checkpoint", ff_checkpoint, "fast-forward checkpoint file written with ff_collectives"),
+    TWOPT_CHAR("warm_start", warm_start, "resume the trace jobs from a fast-forward checkpoint, under any network configuration"),
     TWOPT_UINT("debug_cols", debug_cols, "completion time of collective operations (currently MPI_AllReduce)"),
+    TWOPT_UINT("sim_collectives", sim_collectives, "simulate collective operations as point-to-point network traffic, assumes every collective spans all ranks of the job (Default 0 (OFF))"),
     TWOPT_UINT("enable_mpi_debug", enable_debug, "enable debugging of MPI sim layer (works with sync=1 only)"),
     TWOPT_UINT("sampling_interval", sampling_interval, "sampling interval for MPI operations"),
     TWOPT_UINT("perm-thresh", perm_switch_thresh, "threshold for random permutation operations"),
 	TWOPT_UINT("enable_sampling", enable_sampling, "enable sampling (only works in sequential mode)"),
     TWOPT_STIME("mean_interval", mean_interval, "mean interval for generating background traffic"),
+    TWOPT_CHAR("bg_traffic_conf", bg_traffic_conf, "per job background traffic: lines of '<job> <generator> [key=value ...]' (see README_traces.txt)"),
     TWOPT_STIME("sampling_end_time", sampling_end_time, "sampling_end_time"),
     TWOPT_CHAR("lp-io-dir", lp_io_dir, "Where to place io output (unspecified -> no output"),
     TWOPT_UINT("lp-io-use-suffix", lp_io_use_suffix, "Whether to append uniq suffix to lp-io directory (default 0)"),
@@ -2855,6 +3823,372 @@ static void nw_add_lp_type()
   lp_type_register("nw-lp", nw_get_lp_type());
 }
 
+/* Loads the DUMPI traces of every nw-lp on this PE with a pool of
+ * preload_threads threads, so that nw_test_init finds them already loaded.
+ * Mirrors the rank and parameter selection done in nw_test_init. */
+static void nw_preload_workloads()
+{
+    struct codes_workload_load_req *reqs;
+    dumpi_trace_params params_j[5];
+    int i, count = 0;
+
+    if(preload_threads <= 0 || strcmp(workload_type, "dumpi") != 0)
+        return;
+
+    if(!num_net_traces)
+        num_net_traces = num_mpi_lps;
+
+    for(i = 0; i < 5; i++)
+    {
+        memset(&params_j[i], 0, sizeof(params_j[i]));
+        strcpy(params_j[i].file_name, file_name_of_job[i]);
+        params_j[i].num_net_traces = num_traces_of_job[i];
+        params_j[i].nprocs = nprocs;
+#ifdef ENABLE_CORTEX_PYTHON
+        strcpy(params_j[i].cortex_script, cortex_file);
+        strcpy(params_j[i].cortex_class, cortex_class);
+        strcpy(params_j[i].cortex_gen, cortex_gen);
+#endif
+    }
+
+    reqs = malloc(g_tw_nlp * sizeof(*reqs));
+    assert(reqs);
+
+    for(tw_lpid l = 0; l < g_tw_nlp; l++)
+    {
+        char const *lp_type_name;
+        struct codes_jobmap_id lid;
+        int nw_id, rep_id, offset;
+
+        codes_mapping_get_lp_info2(g_tw_lp[l]->gid, NULL, &lp_type_name,
+                NULL, &rep_id, &offset);
+        if(strcmp(lp_type_name, "nw-lp") != 0)
+            continue;
+
+        nw_id = codes_mapping_get_lp_relative_id(g_tw_lp[l]->gid, 0, 0);
+        if(alloc_spec)
+        {
+            lid = codes_jobmap_to_local_id(nw_id, jobmap_ctx);
+            if(lid.job == -1)
+                continue;
+        }
+        else
+        {
+            if(nw_id >= num_net_traces)
+                continue;
+            lid.job = 0;
+            lid.rank = nw_id;
+        }
+
+        if(strncmp(file_name_of_job[lid.job], "synthetic", 9) == 0)
+            continue;
+
+        reqs[count].app_id = lid.job;
+        reqs[count].rank = lid.rank;
+        reqs[count].params = (char*)&params_j[lid.job];
+        count++;
+    }
+
+    if(codes_workload_load_parallel("dumpi-trace-workload", reqs, count,
+                preload_threads) < 0)
+        tw_error(TW_LOC, "\n Failed to preload the workload traces ");
+
+    free(reqs);
+}
+
+/* reports the time spent loading the workloads, maximum over all PEs */
+static void nw_report_load_stats()
+{
+    struct codes_workload_load_stats stats;
+    double times[2], max_times[2];
+    long long nranks, total_ranks;
+
+    if(codes_workload_get_load_stats(wrkld_id, &stats) != 0)
+        memset(&stats, 0, sizeof(stats));
+
+    times[0] = stats.wall_time;
+    times[1] = stats.busy_time;
+    nranks = stats.nranks;
+    MPI_Reduce(times, max_times, 2, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_CODES);
+    MPI_Reduce(&nranks, &total_ranks, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_CODES);
+
+    if(!g_tw_mynode && total_ranks > 0)
+        printf("\n Workload %s: loaded %lld ranks, max load time per PE "
+                "%lf s (%lf s in load calls) \n", workload_type, total_ranks,
+                max_times[0], max_times[1]);
+}
+
+static int comm_matrix_ent_cmp(const void *a, const void *b)
+{
+    const struct comm_matrix_ent *x = (const struct comm_matrix_ent*)a;
+    const struct comm_matrix_ent *y = (const struct comm_matrix_ent*)b;
+
+    if(x->app_id != y->app_id)
+        return x->app_id < y->app_id ? -1 : 1;
+    if(x->dst_rank != y->dst_rank)
+        return x->dst_rank < y->dst_rank ? -1 : 1;
+    if(x->src_rank != y->src_rank)
+        return x->src_rank < y->src_rank ? -1 : 1;
+    return 0;
+}
+
+/* gathers the matrix cells of all PEs on the first one, which writes them
+ * with the message size histogram of the run */
+static void nw_write_comm_matrix(struct msg_sz_bucket const * hist)
+{
+    int npes, i, total = 0;
+    int cnt = pe_comm_ents_cnt * sizeof(struct comm_matrix_ent);
+    int *cnts = NULL, *displs = NULL;
+    char *all = NULL;
+
+    MPI_Comm_size(MPI_COMM_CODES, &npes);
+    if(!g_tw_mynode)
+    {
+        cnts = (int*)malloc(npes * sizeof(int));
+        displs = (int*)malloc(npes * sizeof(int));
+        assert(cnts && displs);
+    }
+    MPI_Gather(&cnt, 1, MPI_INT, cnts, 1, MPI_INT, 0, MPI_COMM_CODES);
+    if(!g_tw_mynode)
+    {
+        for(i = 0; i < npes; i++)
+        {
+            displs[i] = total;
+            total += cnts[i];
+        }
+        all = (char*)malloc(total ? total : 1);
+        assert(all);
+    }
+    MPI_Gatherv(pe_comm_ents, cnt, MPI_BYTE, all, cnts, displs, MPI_BYTE,
+            0, MPI_COMM_CODES);
+
+    if(!g_tw_mynode)
+    {
+        struct comm_matrix_hdr hdr;
+        FILE *f = fopen(comm_matrix_file, "w");
+        if(!f)
+            tw_error(TW_LOC, "\n Could not open file %s ", comm_matrix_file);
+
+        hdr.magic = COMM_MATRIX_MAGIC;
+        hdr.num_buckets = MSG_SZ_BUCKETS;
+        hdr.num_ents = total / sizeof(struct comm_matrix_ent);
+        qsort(all, hdr.num_ents, sizeof(struct comm_matrix_ent),
+                comm_matrix_ent_cmp);
+        if(fwrite(&hdr, sizeof(hdr), 1, f) != 1
+                || fwrite(hist, sizeof(*hist), MSG_SZ_BUCKETS, f) != MSG_SZ_BUCKETS
+                || fwrite(all, 1, total, f) != (size_t)total)
+            tw_error(TW_LOC, "\n Could not write file %s ", comm_matrix_file);
+        fclose(f);
+        printf("\n Communication matrix (%llu entries) written to %s \n",
+                (unsigned long long)hdr.num_ents, comm_matrix_file);
+        free(cnts);
+        free(displs);
+        free(all);
+    }
+}
+
+/* sums the received message sizes over all PEs and prints them */
+static void nw_report_comm_stats()
+{
+    long long local[3 * MSG_SZ_BUCKETS], global[3 * MSG_SZ_BUCKETS];
+    struct msg_sz_bucket hist[MSG_SZ_BUCKETS];
+    int b;
+
+    for(b = 0; b < MSG_SZ_BUCKETS; b++)
+    {
+        local[3 * b] = pe_msg_sz_hist[b].num_msgs;
+        local[3 * b + 1] = pe_msg_sz_hist[b].num_bytes;
+        local[3 * b + 2] = pe_msg_sz_hist[b].latency;
+    }
+    MPI_Reduce(local, global, 3 * MSG_SZ_BUCKETS, MPI_LONG_LONG, MPI_SUM, 0,
+            MPI_COMM_CODES);
+
+    if(!g_tw_mynode)
+    {
+        printf("\n Received messages by size: size_range num_messages num_bytes avg_latency");
+        for(b = 0; b < MSG_SZ_BUCKETS; b++)
+        {
+            hist[b].num_msgs = global[3 * b];
+            hist[b].num_bytes = global[3 * b + 1];
+            hist[b].latency = global[3 * b + 2];
+            if(hist[b].num_msgs)
+                printf("\n [%lld, %lld) %"PRId64" %"PRId64" %lf", msg_sz_bucket_min(b),
+                        b ? 2 * msg_sz_bucket_min(b) : 1, hist[b].num_msgs,
+                        hist[b].num_bytes,
+                        (double)hist[b].latency / hist[b].num_msgs);
+        }
+        printf("\n");
+    }
+
+    if(comm_matrix_file[0])
+        nw_write_comm_matrix(hist);
+
+    free(pe_comm_ents);
+    pe_comm_ents = NULL;
+    pe_comm_ents_cnt = pe_comm_ents_cap = 0;
+}
+
+/* gathers the fast-forward cuts of all PEs on the first one, which writes
+ * the checkpoint */
+static void nw_write_ff_checkpoint()
+{
+    int npes, i, total = 0, total_done = 0;
+    int cnt = pe_ff_ents_cnt * sizeof(struct ff_ckpt_ent);
+    int cnt_done = pe_ff_done_cnt * sizeof(uint32_t);
+    int *cnts = NULL, *displs = NULL, *cnts_done = NULL, *displs_done = NULL;
+    char *all = NULL, *all_done = NULL;
+
+    MPI_Comm_size(MPI_COMM_CODES, &npes);
+    if(!g_tw_mynode)
+    {
+        cnts = (int*)malloc(npes * sizeof(int));
+        displs = (int*)malloc(npes * sizeof(int));
+        cnts_done = (int*)malloc(npes * sizeof(int));
+        displs_done = (int*)malloc(npes * sizeof(int));
+        assert(cnts && displs && cnts_done && displs_done);
+    }
+    MPI_Gather(&cnt, 1, MPI_INT, cnts, 1, MPI_INT, 0, MPI_COMM_CODES);
+    MPI_Gather(&cnt_done, 1, MPI_INT, cnts_done, 1, MPI_INT, 0, MPI_COMM_CODES);
+    if(!g_tw_mynode)
+    {
+        for(i = 0; i < npes; i++)
+        {
+            displs[i] = total;
+            total += cnts[i];
+            displs_done[i] = total_done;
+            total_done += cnts_done[i];
+        }
+        all = (char*)malloc(total ? total : 1);
+        all_done = (char*)malloc(total_done ? total_done : 1);
+        assert(all && all_done);
+    }
+    MPI_Gatherv(pe_ff_ents, cnt, MPI_BYTE, all, cnts, displs, MPI_BYTE,
+            0, MPI_COMM_CODES);
+    MPI_Gatherv(pe_ff_done, cnt_done, MPI_BYTE, all_done, cnts_done,
+            displs_done, MPI_BYTE, 0, MPI_COMM_CODES);
+
+    if(!g_tw_mynode)
+    {
+        struct ff_ckpt_hdr hdr;
+        struct ff_ckpt_ent * ents = (struct ff_ckpt_ent*)all;
+        uint32_t * done = (uint32_t*)all_done;
+        uint32_t * out_done = (uint32_t*)malloc(total_done ? total_done : 1);
+        int64_t num_done = 0;
+        int num_cut = 0, num_ended = 0, num_blocked = 0, num_pending = 0;
+        double cut_time = 0;
+        assert(out_done);
+
+        /* the request offsets of each PE start at its part of all_done */
+        for(i = 0; i < npes; i++)
+            for(int e = displs[i] / (int)sizeof(*ents);
+                    e < (displs[i] + cnts[i]) / (int)sizeof(*ents); e++)
+                ents[e].done_ofs += displs_done[i] / sizeof(*done);
+
+        hdr.magic = FF_CKPT_MAGIC;
+        hdr.ff_collectives = ff_collectives;
+        hdr.num_ents = total / sizeof(struct ff_ckpt_ent);
+        qsort(all, hdr.num_ents, sizeof(struct ff_ckpt_ent), ff_ckpt_ent_cmp);
+        for(uint64_t e = 0; e < hdr.num_ents; e++)
+        {
+            memcpy(out_done + num_done, done + ents[e].done_ofs,
+                    ents[e].num_done * sizeof(*done));
+            ents[e].done_ofs = num_done;
+            num_done += ents[e].num_done;
+        }
+
+        FILE *f = fopen(ff_checkpoint, "w");
+        if(!f)
+            tw_error(TW_LOC, "\n Could not open file %s ", ff_checkpoint);
+        if(fwrite(&hdr, sizeof(hdr), 1, f) != 1
+                || fwrite(all, 1, total, f) != (size_t)total
+                || fwrite(out_done, 1, total_done, f) != (size_t)total_done)
+            tw_error(TW_LOC, "\n Could not write file %s ", ff_checkpoint);
+        fclose(f);
+
+        for(uint64_t e = 0; e < hdr.num_ents; e++)
+        {
+            if(ents[e].cut > 0)
+                num_cut++;
+            else if(ents[e].cut == 0)
+                num_ended++;
+            else
+                num_blocked++;
+            if(!ents[e].quiescent)
+                num_pending++;
+            if(ents[e].time > cut_time)
+                cut_time = ents[e].time;
+        }
+        printf("\n Fast-forward checkpoint written to %s: %d ranks cut before collective %d, %d ended, %d blocked, cut time %lf ns, %"PRId64" completed requests not waited on ",
+                ff_checkpoint, num_cut, ff_collectives, num_ended, num_blocked, cut_time, num_done);
+        if(num_blocked || num_pending)
+            printf("\n Warning: %d ranks blocked and %d ranks with pending messages at the cut, the checkpoint is not consistent ",
+                    num_blocked, num_pending);
+        printf("\n");
+        free(cnts);
+        free(displs);
+        free(cnts_done);
+        free(displs_done);
+        free(all);
+        free(all_done);
+        free(out_done);
+    }
+    free(pe_ff_ents);
+    pe_ff_ents = NULL;
+    pe_ff_ents_cnt = pe_ff_ents_cap = 0;
+    free(pe_ff_done);
+    pe_ff_done = NULL;
+    pe_ff_done_cnt = pe_ff_done_cap = 0;
+}
+
+/* reads the checkpoint of a warm start, on every PE */
+static void nw_read_warm_start()
+{
+    struct ff_ckpt_hdr hdr;
+    FILE *f = fopen(warm_start, "r");
+    if(!f)
+        tw_error(TW_LOC, "\n Could not open file %s ", warm_start);
+    if(fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != FF_CKPT_MAGIC)
+        tw_error(TW_LOC, "\n %s is not a fast-forward checkpoint ", warm_start);
+
+    num_warm_ents = hdr.num_ents;
+    warm_ents = (struct ff_ckpt_ent*)malloc((num_warm_ents ? num_warm_ents : 1)
+            * sizeof(*warm_ents));
+    assert(warm_ents);
+    if(fread(warm_ents, sizeof(*warm_ents), num_warm_ents, f) != num_warm_ents)
+        tw_error(TW_LOC, "\n Could not read file %s ", warm_start);
+
+    num_warm_done = 0;
+    for(uint64_t e = 0; e < num_warm_ents; e++)
+    {
+        if(warm_ents[e].num_done < 0
+                || warm_ents[e].done_ofs != (int64_t)num_warm_done)
+            tw_error(TW_LOC, "\n Corrupt completed requests of rank %d of job %d in %s ",
+                    warm_ents[e].rank, warm_ents[e].app_id, warm_start);
+        num_warm_done += warm_ents[e].num_done;
+    }
+    warm_done = (uint32_t*)malloc((num_warm_done ? num_warm_done : 1)
+            * sizeof(*warm_done));
+    assert(warm_done);
+    if(fread(warm_done, sizeof(*warm_done), num_warm_done, f) != num_warm_done)
+        tw_error(TW_LOC, "\n Could not read file %s ", warm_start);
+    fclose(f);
+
+    for(uint64_t e = 0; e < num_warm_ents; e++)
+    {
+        if(warm_ents[e].cut < 0)
+            tw_error(TW_LOC, "\n Rank %d of job %d was blocked at the cut of %s, it can't be warm started ",
+                    warm_ents[e].rank, warm_ents[e].app_id, warm_start);
+        /* messages in flight at the cut are not in the checkpoint */
+        if(!warm_ents[e].quiescent)
+            tw_error(TW_LOC, "\n Rank %d of job %d had pending messages at the cut of %s, it can't be warm started ",
+                    warm_ents[e].rank, warm_ents[e].app_id, warm_start);
+    }
+    if(!g_tw_mynode)
+        printf("\n Warm start of %llu ranks from %s (cut before collective %u, %llu completed requests not waited on) \n",
+                (unsigned long long)num_warm_ents, warm_start, hdr.ff_collectives,
+                (unsigned long long)num_warm_done);
+}
+
 /* setup for the ROSS event tracing
  */
 void nw_lp_event_collect(nw_message *m, tw_lp *lp, char *buffer, int *collect_flag)
@@ -2928,19 +4262,6 @@ void nw_lp_register_model()
 }
 /* end of ROSS event tracing setup */
 
-static int msg_size_hash_compare(
-            void *key, struct qhash_head *link)
-{
-   int64_t *in_size = (int64_t *)key;
-   struct msg_size_info *tmp;
-
-    tmp = qhash_entry(link, struct msg_size_info, hash_link);
-    if (tmp->msg_size == *in_size)
-      return 1;
-
-    return 0;
-}
-
 /* Method to organize all mpi_replay specific configuration parameters
 to be specified in the loaded .conf file*/
 void modelnet_mpi_replay_read_config()
@@ -2974,11 +4295,12 @@ int modelnet_mpi_replay(MPI_Comm comm, int* argc, char*** argv )
 #endif
   codes_comm_update();
 
-  if(strcmp(workload_type, "dumpi") != 0 && strcmp(workload_type, "online") != 0)
+  if(strcmp(workload_type, "dumpi") != 0 && strcmp(workload_type, "online") != 0
+          && strcmp(workload_type, "skeleton") != 0)
     {
 	if(tw_ismaster())
 		printf("Usage: mpirun -np n ./modelnet-mpi-replay --sync=1/3"
-                " --workload_type=dumpi/online"
+                " --workload_type=dumpi/online/skeleton"
 		" --workload_conf_file=prefix-workload-file-name"
                 " --alloc_file=alloc-file-name"
 #ifdef ENABLE_CORTEX_PYTHON
@@ -2994,6 +4316,8 @@ int modelnet_mpi_replay(MPI_Comm comm, int* argc, char*** argv )
     }
 
 	jobmap_ctx = NULL; // make sure it's NULL if it's not used
+    if((ff_collectives > 0) != (strlen(ff_checkpoint) > 0))
+        tw_error(TW_LOC, "\n ff_collectives and ff_checkpoint must be given together ");
 
     sprintf(sampling_dir, "sampling-dir");
     mkdir(sampling_dir, S_IRUSR | S_IWUSR | S_IXUSR);
@@ -3017,6 +4341,17 @@ int modelnet_mpi_replay(MPI_Comm comm, int* argc, char*** argv )
               num_syn_clients = num_traces_of_job[i];
               num_net_traces += num_traces_of_job[i];
               is_synthetic = 1;
+
+              int pattern = 1;
+              sscanf(file_name_of_job[i], "synthetic%d", &pattern);
+              if(pattern <= 0 || pattern > NUM_SYN_GENS)
+              {
+                  printf("\n Undefined synthetic pattern: setting to uniform random ");
+                  pattern = 1;
+              }
+              bg_traffic_params_init(&bg_params[i], syn_gen_names[pattern],
+                      payload_sz, mean_interval);
+              bg_params[i].perm_bytes = perm_switch_thresh;
             }
             else if(ref!=EOF)
             {
@@ -3030,6 +4365,29 @@ int modelnet_mpi_replay(MPI_Comm comm, int* argc, char*** argv )
         }
         printf("\n num_net_traces %d ", num_net_traces);
         fclose(name_file);
+
+        /* per job generators, rates and QoS levels override the synthetic<N>
+         * names */
+        int has_bg_conf[5] = {0};
+        if(strlen(bg_traffic_conf) > 0
+                && bg_traffic_read_conf(bg_traffic_conf, bg_params, has_bg_conf, i) < 0)
+            tw_error(TW_LOC, "\n Could not read background traffic file %s ", bg_traffic_conf);
+        for(int j = 0; j < i; j++)
+        {
+            if(strncmp(file_name_of_job[j], "synthetic", 9) != 0)
+            {
+                if(has_bg_conf[j])
+                    tw_error(TW_LOC, "\n Job %d has background traffic but is not a synthetic job ", j);
+                continue;
+            }
+            if(bg_traffic_setup(&bg_params[j], num_traces_of_job[j]) < 0)
+                tw_error(TW_LOC, "\n Invalid background traffic for job %d ", j);
+            if(!g_tw_mynode)
+                printf("\n Background job %d: %s, %d ranks per LP, interval %lf ns, payload %d, qos %d ",
+                        j, bg_params[j].gen_name, bg_params[j].ranks_per_lp,
+                        bg_params[j].interval, bg_params[j].payload_sz,
+                        bg_params[j].qos_level);
+        }
         assert(strlen(alloc_file) != 0);
         alloc_spec = 1;
         jobmap_p.alloc_file = alloc_file;
@@ -3039,7 +4397,7 @@ int modelnet_mpi_replay(MPI_Comm comm, int* argc, char*** argv )
     {
         assert(num_net_traces);
         num_traces_of_job[0] = num_net_traces;
-        if(strcmp(workload_type, "dumpi") == 0)
+        if(strcmp(workload_type, "dumpi") == 0 || strcmp(workload_type, "skeleton") == 0)
         {
             assert(strlen(workload_file) > 0);
             strcpy(file_name_of_job[0], workload_file);
@@ -3148,6 +4506,9 @@ int modelnet_mpi_replay(MPI_Comm comm, int* argc, char*** argv )
         int ret = lp_io_prepare(lp_io_dir, flags, &io_handle, MPI_COMM_CODES);
         assert(ret == 0 || !"lp_io_prepare failure");
     }
+   if(strlen(warm_start) > 0)
+       nw_read_warm_start();
+   nw_preload_workloads();
    tw_run();
 
     if(enable_debug)
@@ -3195,8 +4556,6 @@ int modelnet_mpi_replay(MPI_Comm comm, int* argc, char*** argv )
 			total_max_recv_time, total_avg_recv_time/num_net_traces,
 			total_max_wait_time, total_avg_wait_time/num_net_traces);
     
-    if(synthetic_pattern == PERMUTATION)
-        printf("\n Threshold for random permutation %ld ", perm_switch_thresh);
    }
     if (do_lp_io){
         int ret = lp_io_flush(io_handle, MPI_COMM_CODES);
@@ -3206,6 +4565,14 @@ int modelnet_mpi_replay(MPI_Comm comm, int* argc, char*** argv )
         printf("\n PE%d: Synthetic traffic stats: data received per proc %lf bytes \n",rank, g_total_syn_data/num_syn_clients);
 
    model_net_report_stats(net_id);
+   nw_report_load_stats();
+   nw_report_comm_stats();
+   if(ff_collectives > 0)
+       nw_write_ff_checkpoint();
+   free(warm_ents);
+   warm_ents = NULL;
+   free(warm_done);
+   warm_done = NULL;
    
    if(unmatched && g_tw_mynode == 0) 
        fprintf(stderr, "\n Warning: unmatched send and receive operations found.\n");
@@ -3213,6 +4580,9 @@ int modelnet_mpi_replay(MPI_Comm comm, int* argc, char*** argv )
    
    if(alloc_spec)
        codes_jobmap_destroy(jobmap_ctx);
+   for(int j = 0; j < 5; j++)
+       bg_traffic_finalize(&bg_params[j]);
+   free(bg_dests);
 
 #ifdef USE_RDAMARIS
     } // end if(g_st_ross_rank)
@@ -0,0 +1,349 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#include <ross.h>
+
+#include "codes/codes.h"
+#include "codes/configuration.h"
+#include "codes/rc-stack.h"
+#include "codes/model-net-sample-sink.h"
+#include "codes/model-net-link-summary.h"
+
+struct mn_link_summary
+{
+    int nports;
+    int64_t samples;
+    tw_stime time;
+    long fwd_events;
+    long rev_events;
+    tw_stime * busy_time;
+    int64_t * traffic;
+    double * util_min;
+    double * util_max;
+    uint32_t * hist; /* nports x MN_LINK_HIST_BUCKETS */
+    struct rc_stack * rc;
+};
+
+/* what an add needs to be undone: its inputs and the old extremes */
+struct link_summary_rc
+{
+    long fwd_events;
+    long rev_events;
+    tw_stime interval;
+    tw_stime * busy_time;
+    int64_t * traffic;
+    double * util_min;
+    double * util_max;
+};
+
+/* the most utilized links seen on this PE */
+struct link_summary_top
+{
+    double util;
+    double router_id;
+    double port;
+    double traffic;
+};
+
+static struct link_summary_top * top = NULL;
+static int top_k = -1;
+static int top_count = 0;
+
+static int link_hist_bucket(double util)
+{
+    double scaled = util * (1 << MN_LINK_HIST_BITS);
+    uint32_t x, msb = 0;
+
+    if (scaled <= 0)
+        return 0;
+    if (scaled >= (1 << MN_LINK_HIST_BITS))
+        x = (1 << MN_LINK_HIST_BITS) - 1;
+    else
+        x = (uint32_t)scaled;
+    if (x == 0)
+        return 0;
+    while ((x >> (msb + 1)) != 0)
+        msb++;
+    if (msb < 2)
+        return 1 + msb * MN_LINK_HIST_SUB + (x - (1u << msb));
+    return 1 + msb * MN_LINK_HIST_SUB + ((x >> (msb - 2)) & 3);
+}
+
+double model_net_link_summary_bucket_lower(int b)
+{
+    int msb, sub;
+    uint32_t x;
+
+    if (b <= 0)
+        return 0.0;
+    msb = (b - 1) / MN_LINK_HIST_SUB;
+    sub = (b - 1) % MN_LINK_HIST_SUB;
+    x = (1u << msb) + ((uint32_t)sub << (msb < 2 ? 0 : msb - 2));
+    return (double)x / (1 << MN_LINK_HIST_BITS);
+}
+
+mn_link_summary * model_net_link_summary_new(int nports)
+{
+    mn_link_summary * ls = calloc(1, sizeof(*ls));
+
+    assert(ls && nports > 0);
+    ls->nports = nports;
+    ls->busy_time = calloc(nports, sizeof(*ls->busy_time));
+    ls->traffic = calloc(nports, sizeof(*ls->traffic));
+    ls->util_min = calloc(nports, sizeof(*ls->util_min));
+    ls->util_max = calloc(nports, sizeof(*ls->util_max));
+    ls->hist = calloc((size_t)nports * MN_LINK_HIST_BUCKETS, sizeof(*ls->hist));
+    assert(ls->busy_time && ls->traffic && ls->util_min && ls->util_max &&
+            ls->hist);
+    rc_stack_create(&ls->rc);
+    return ls;
+}
+
+void model_net_link_summary_free(mn_link_summary * ls)
+{
+    if (!ls)
+        return;
+    rc_stack_destroy(ls->rc);
+    free(ls->hist);
+    free(ls->util_max);
+    free(ls->util_min);
+    free(ls->traffic);
+    free(ls->busy_time);
+    free(ls);
+}
+
+static void link_summary_rc_free(void * data)
+{
+    free(data);
+}
+
+void model_net_link_summary_add(
+        mn_link_summary * ls,
+        tw_lp * lp,
+        tw_stime const * busy_time,
+        int64_t const * traffic,
+        long fwd_events,
+        long rev_events,
+        tw_stime interval)
+{
+    int n = ls->nports, i;
+    struct link_summary_rc * r;
+    char * p;
+
+    rc_stack_gc(lp, ls->rc);
+
+    /* one allocation per sample holds the record and its arrays */
+    r = malloc(sizeof(*r) + n * (3 * sizeof(double) + sizeof(int64_t)));
+    assert(r);
+    p = (char*)(r + 1);
+    r->busy_time = (tw_stime*)p;
+    r->util_min = r->busy_time + n;
+    r->util_max = r->util_min + n;
+    r->traffic = (int64_t*)(r->util_max + n);
+    r->fwd_events = fwd_events;
+    r->rev_events = rev_events;
+    r->interval = interval;
+    memcpy(r->busy_time, busy_time, n * sizeof(*busy_time));
+    memcpy(r->traffic, traffic, n * sizeof(*traffic));
+    memcpy(r->util_min, ls->util_min, n * sizeof(*ls->util_min));
+    memcpy(r->util_max, ls->util_max, n * sizeof(*ls->util_max));
+
+    for (i = 0; i < n; i++)
+    {
+        double util = interval > 0 ? busy_time[i] / interval : 0;
+
+        ls->busy_time[i] += busy_time[i];
+        ls->traffic[i] += traffic[i];
+        if (ls->samples == 0 || util < ls->util_min[i])
+            ls->util_min[i] = util;
+        if (ls->samples == 0 || util > ls->util_max[i])
+            ls->util_max[i] = util;
+        ls->hist[(size_t)i * MN_LINK_HIST_BUCKETS + link_hist_bucket(util)]++;
+    }
+    ls->samples++;
+    ls->time += interval;
+    ls->fwd_events += fwd_events;
+    ls->rev_events += rev_events;
+
+    rc_stack_push(lp, r, link_summary_rc_free, ls->rc);
+}
+
+void model_net_link_summary_add_rc(
+        mn_link_summary * ls,
+        tw_stime * busy_time,
+        int64_t * traffic,
+        long * fwd_events,
+        long * rev_events)
+{
+    struct link_summary_rc * r = rc_stack_pop(ls->rc);
+    int n = ls->nports, i;
+
+    for (i = 0; i < n; i++)
+    {
+        double util = r->interval > 0 ? r->busy_time[i] / r->interval : 0;
+
+        ls->busy_time[i] -= r->busy_time[i];
+        ls->traffic[i] -= r->traffic[i];
+        ls->hist[(size_t)i * MN_LINK_HIST_BUCKETS + link_hist_bucket(util)]--;
+    }
+    memcpy(ls->util_min, r->util_min, n * sizeof(*ls->util_min));
+    memcpy(ls->util_max, r->util_max, n * sizeof(*ls->util_max));
+    ls->samples--;
+    ls->time -= r->interval;
+    ls->fwd_events -= r->fwd_events;
+    ls->rev_events -= r->rev_events;
+
+    memcpy(busy_time, r->busy_time, n * sizeof(*busy_time));
+    memcpy(traffic, r->traffic, n * sizeof(*traffic));
+    *fwd_events = r->fwd_events;
+    *rev_events = r->rev_events;
+    free(r);
+}
+
+/* order by decreasing utilization, ties by router and port */
+static int link_top_cmp(void const * a, void const * b)
+{
+    struct link_summary_top const * x = a, * y = b;
+
+    if (x->util != y->util)
+        return x->util > y->util ? -1 : 1;
+    if (x->router_id != y->router_id)
+        return x->router_id < y->router_id ? -1 : 1;
+    if (x->port != y->port)
+        return x->port < y->port ? -1 : 1;
+    return 0;
+}
+
+static void link_top_offer(struct link_summary_top const * t)
+{
+    int i;
+
+    if (top_k == -1)
+    {
+        if (configuration_get_value_int(&config, "PARAMS", "rt_sample_topk",
+                    NULL, &top_k) || top_k < 0)
+            top_k = 10;
+        top = calloc(top_k > 0 ? top_k : 1, sizeof(*top));
+        assert(top);
+    }
+    if (top_k == 0)
+        return;
+    if (top_count == top_k && link_top_cmp(t, &top[top_k-1]) >= 0)
+        return;
+
+    /* insertion into the sorted list, k is small */
+    i = top_count < top_k ? top_count++ : top_k - 1;
+    while (i > 0 && link_top_cmp(t, &top[i-1]) < 0)
+    {
+        top[i] = top[i-1];
+        i--;
+    }
+    top[i] = *t;
+}
+
+void model_net_link_summary_write(
+        mn_link_summary const * ls,
+        tw_lpid router_id,
+        char const * path)
+{
+    struct mn_sample_column cols[] = {
+        { "router_id",  MN_SAMPLE_UINT64, 1 },
+        { "port",       MN_SAMPLE_INT64,  1 },
+        { "samples",    MN_SAMPLE_INT64,  1 },
+        { "busy_time",  MN_SAMPLE_DOUBLE, 1 },
+        { "traffic",    MN_SAMPLE_INT64,  1 },
+        { "util_min",   MN_SAMPLE_DOUBLE, 1 },
+        { "util_max",   MN_SAMPLE_DOUBLE, 1 },
+        { "util_mean",  MN_SAMPLE_DOUBLE, 1 },
+        { "util_hist",  MN_SAMPLE_UINT64, MN_LINK_HIST_BUCKETS },
+    };
+    mn_sample_sink * sink = model_net_sample_sink_get(path, cols,
+            sizeof(cols) / sizeof(cols[0]),
+            "router link utilization summaries, one row per port. util_hist "
+            "bucket 0 counts idle samples; bucket b > 0 covers utilizations "
+            "from 2^m (1 + s/4) / 2^16 with m = (b-1)/4 and s = (b-1)%4");
+    uint64_t hist[MN_LINK_HIST_BUCKETS];
+    uint64_t id = router_id;
+    int64_t samples = ls->samples;
+    int i, b;
+
+    for (i = 0; i < ls->nports; i++)
+    {
+        int64_t port = i;
+        double mean = ls->time > 0 ? ls->busy_time[i] / ls->time : 0;
+        void const * fields[] = { &id, &port, &samples, &ls->busy_time[i],
+            &ls->traffic[i], &ls->util_min[i], &ls->util_max[i], &mean,
+            hist };
+        struct link_summary_top t;
+
+        for (b = 0; b < MN_LINK_HIST_BUCKETS; b++)
+            hist[b] = ls->hist[(size_t)i * MN_LINK_HIST_BUCKETS + b];
+        model_net_sample_sink_append(sink, fields);
+
+        t.util = mean;
+        t.router_id = (double)router_id;
+        t.port = i;
+        t.traffic = (double)ls->traffic[i];
+        link_top_offer(&t);
+    }
+}
+
+void model_net_link_summary_report(void)
+{
+    struct link_summary_top * all = NULL;
+    int rank, nranks, k, i, any = top_count;
+
+    MPI_Allreduce(MPI_IN_PLACE, &any, 1, MPI_INT, MPI_MAX, MPI_COMM_CODES);
+    if (!any)
+        return;
+
+    MPI_Comm_rank(MPI_COMM_CODES, &rank);
+    MPI_Comm_size(MPI_COMM_CODES, &nranks);
+
+    /* a PE without summaries still has to agree on k */
+    k = top_k;
+    MPI_Allreduce(MPI_IN_PLACE, &k, 1, MPI_INT, MPI_MAX, MPI_COMM_CODES);
+    if (top_k < k)
+    {
+        top = realloc(top, k * sizeof(*top));
+        assert(top);
+    }
+    for (i = top_count; i < k; i++)
+        top[i].util = -1;
+
+    if (rank == 0)
+    {
+        all = malloc((size_t)nranks * k * sizeof(*all));
+        assert(all);
+    }
+    MPI_Gather(top, 4 * k, MPI_DOUBLE, all, 4 * k, MPI_DOUBLE, 0,
+            MPI_COMM_CODES);
+
+    if (rank == 0)
+    {
+        qsort(all, (size_t)nranks * k, sizeof(*all), link_top_cmp);
+        printf("\nmost utilized router links (mean utilization):\n");
+        for (i = 0; i < k && all[i].util >= 0; i++)
+            printf("  router %llu port %d: %.4f (%.0f bytes)\n",
+                    (unsigned long long)all[i].router_id, (int)all[i].port,
+                    all[i].util, all[i].traffic);
+        free(all);
+    }
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
@@ -221,6 +221,11 @@ int model_net_sampling_enabled(void)
     return mn_sample_enabled;
 }
 
+tw_stime model_net_sampling_interval(void)
+{
+    return mn_sample_interval;
+}
+
 // schedule sample event - want to be precise, so no noise here
 static void issue_sample_event(tw_lp *lp)
 {
@@ -338,11 +343,55 @@ static void base_read_config(const char * anno, model_net_base_params *p){
                 tw_error(TW_LOC, "Unknown value for "
                         "PARAMS:prio-sched-sub-sched %s", sched);
             }
-            else if (i == MN_SCHED_PRIO){
-                tw_error(TW_LOC, "priority scheduler cannot be used as a "
+            else if (i == MN_SCHED_PRIO || i == MN_SCHED_DRR ||
+                    i == MN_SCHED_WFQ){
+                tw_error(TW_LOC, "%s scheduler cannot be used as a "
                         "priority scheduler's sub sched "
-                        "(PARAMS:prio-sched-sub-sched)");
+                        "(PARAMS:prio-sched-sub-sched)", sched_names[i]);
+            }
+        }
+    }
+    else if (p->sched_params.type == MN_SCHED_DRR ||
+            p->sched_params.type == MN_SCHED_WFQ){
+        mn_flow_params *flow = &p->sched_params.u.flow;
+        char **weights;
+        size_t num_weights;
+
+        ret = configuration_get_value(&config, "PARAMS", "flow-sched-key",
+                anno, sched, MAX_NAME_LENGTH);
+        if (ret <= 0 || strcmp(sched, "dest") == 0)
+            flow->key = MN_FLOW_KEY_DEST;
+        else if (strcmp(sched, "src") == 0)
+            flow->key = MN_FLOW_KEY_SRC;
+        else if (strcmp(sched, "pair") == 0)
+            flow->key = MN_FLOW_KEY_PAIR;
+        else
+            tw_error(TW_LOC, "Unknown value for PARAMS:flow-sched-key %s "
+                    "(expected dest, src or pair)", sched);
+
+        // quantum defaults to the packet size, set below
+        flow->quantum = 0;
+        long int quantum_l = 0;
+        ret = configuration_get_value_longint(&config, "PARAMS",
+                "flow-sched-quantum", anno, &quantum_l);
+        if (ret == 0)
+            flow->quantum = quantum_l;
+
+        flow->num_weights = 0;
+        flow->weights = NULL;
+        ret = configuration_get_multivalue(&config, "PARAMS",
+                "flow-sched-weights", anno, &weights, &num_weights);
+        if (ret == 1 && num_weights > 0){
+            flow->num_weights = num_weights;
+            flow->weights = malloc(num_weights * sizeof(*flow->weights));
+            assert(flow->weights);
+            for (size_t i = 0; i < num_weights; i++){
+                flow->weights[i] = atoi(weights[i]);
+                if (flow->weights[i] < 1)
+                    tw_error(TW_LOC, "PARAMS:flow-sched-weights must be "
+                            "positive integers (got %s)", weights[i]);
             }
+            free(weights);
         }
     }
 
@@ -363,6 +412,16 @@ static void base_read_config(const char * anno, model_net_base_params *p){
     }
 
 
+    if (p->sched_params.type == MN_SCHED_DRR){
+        mn_flow_params *flow = &p->sched_params.u.flow;
+        if (flow->quantum == 0)
+            flow->quantum = packet_size;
+        else if (flow->quantum < packet_size)
+            tw_error(TW_LOC, "PARAMS:flow-sched-quantum (%llu) must be at "
+                    "least the packet size (%llu)", LLU(flow->quantum),
+                    LLU(packet_size));
+    }
+
     p->packet_size = packet_size;
 }
 
@@ -622,7 +681,8 @@ void model_net_base_finalize(
         model_net_base_state * ns,
         tw_lp * lp){
     final_f sfini = method_array[ns->net_id]->mn_sample_fini_fn;
-    if (sfini != NULL)
+    // samplers only run (and have something to write) when enabled
+    if (sfini != NULL && model_net_sampling_enabled())
         sfini(ns->sub_state, lp);
     ns->sub_type->final(ns->sub_state, lp);
     free(ns->sub_state);
@@ -0,0 +1,658 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+/* Buffered, asynchronous sample output shared by the model-net models. See
+ * codes/model-net-sample-sink.h for the file format. */
+
+#include "codes_config.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <mpi.h>
+#include <ross.h>
+
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+#include <zlib.h>
+#define MN_SAMPLE_HAVE_ZLIB 1
+#endif
+
+#include "codes/codes.h"
+#include "codes/configuration.h"
+#include "codes/model-net-sample-sink.h"
+
+/* target size of the uncompressed payload of a block */
+#define SINK_BLOCK_BYTES (1 << 20)
+/* chunk size when merging spill files */
+#define SINK_COPY_BYTES  (8 << 20)
+
+#define SINK_ROUND_UP(_x) \
+    (((_x) + MN_SAMPLE_ALIGN - 1) / MN_SAMPLE_ALIGN * MN_SAMPLE_ALIGN)
+
+struct sink_block
+{
+    int nrows;
+    char * data; /* rows_per_block rows of each column in turn */
+    struct sink_block * next;
+};
+
+struct mn_sample_sink
+{
+    char * path;
+    int ncols;
+    struct mn_sample_file_column * cols;
+    size_t * col_bytes; /* bytes per row of each column */
+    size_t row_bytes;
+    char * desc;
+    int rows_per_block;
+    int64_t rows;
+
+    struct sink_block * cur;
+
+    /* writer thread state, protected by lock */
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct sink_block * queue_head;
+    struct sink_block * queue_tail;
+    struct sink_block * free_blocks;
+    int done;
+
+    /* owned by the writer thread until it is joined */
+    int spill_fd;
+    char * spill_path;
+    uint64_t spill_bytes;
+    char * scratch;
+    size_t scratch_size;
+    int write_error;
+
+    struct mn_sample_sink * next;
+};
+
+static struct mn_sample_sink * sinks = NULL;
+static int sink_compress = -1;
+
+static int sink_compress_enabled(void)
+{
+    if (sink_compress == -1)
+    {
+        int rc = configuration_get_value_int(&config, "PARAMS",
+                "sample_compress", NULL, &sink_compress);
+        if (rc)
+            sink_compress = 0;
+#ifndef MN_SAMPLE_HAVE_ZLIB
+        if (sink_compress && !g_tw_mynode)
+            fprintf(stderr, "WARNING: PARAMS:sample_compress requires zlib, "
+                    "writing uncompressed samples\n");
+        sink_compress = 0;
+#endif
+    }
+    return sink_compress;
+}
+
+static void write_full(int fd, void const * buf, size_t len, int * err)
+{
+    char const * p = buf;
+
+    while (len > 0 && !*err)
+    {
+        ssize_t n = write(fd, p, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            *err = errno;
+            break;
+        }
+        p += n;
+        len -= n;
+    }
+}
+
+/* write a full or final block to the spill file (writer thread) */
+static void sink_write_block(struct mn_sample_sink * s, struct sink_block * b)
+{
+    struct mn_sample_block_header bh;
+    size_t raw = 0, stored, total;
+    char * out;
+    int c;
+
+    for (c = 0; c < s->ncols; c++)
+        raw += s->col_bytes[c] * b->nrows;
+
+    /* worst case size of the block, so the scratch buffer never needs to
+     * grow for a given sink */
+    total = SINK_ROUND_UP(sizeof(bh) + s->row_bytes * s->rows_per_block +
+            s->row_bytes * s->rows_per_block / 1000 + 64);
+    if (total > s->scratch_size)
+    {
+        free(s->scratch);
+        s->scratch = malloc(total);
+        assert(s->scratch);
+        s->scratch_size = total;
+    }
+    out = s->scratch + sizeof(bh);
+
+    memset(&bh, 0, sizeof(bh));
+    memcpy(bh.magic, MN_SAMPLE_BLK_MAGIC, sizeof(bh.magic));
+    bh.pe = (int32_t)g_tw_mynode;
+    bh.nrows = b->nrows;
+    bh.raw_bytes = raw;
+
+    /* pack the used part of each column */
+    char * packed = out;
+#ifdef MN_SAMPLE_HAVE_ZLIB
+    char * zbuf = NULL;
+    if (sink_compress)
+    {
+        zbuf = malloc(raw > 0 ? raw : 1);
+        assert(zbuf);
+        packed = zbuf;
+    }
+#endif
+    size_t off = 0, col_off = 0;
+    for (c = 0; c < s->ncols; c++)
+    {
+        memcpy(packed + off, b->data + col_off, s->col_bytes[c] * b->nrows);
+        off += s->col_bytes[c] * b->nrows;
+        col_off += s->col_bytes[c] * s->rows_per_block;
+    }
+    stored = raw;
+#ifdef MN_SAMPLE_HAVE_ZLIB
+    if (sink_compress)
+    {
+        uLongf zlen = s->scratch_size - sizeof(bh);
+        if (compress2((Bytef*)out, &zlen, (Bytef*)zbuf, raw, 1) == Z_OK &&
+                zlen < raw)
+        {
+            stored = zlen;
+            bh.flags |= MN_SAMPLE_COMPRESSED;
+        }
+        else
+            memcpy(out, zbuf, raw);
+        free(zbuf);
+    }
+#endif
+    bh.stored_bytes = stored;
+    bh.block_bytes = SINK_ROUND_UP(sizeof(bh) + stored);
+    memcpy(s->scratch, &bh, sizeof(bh));
+    memset(s->scratch + sizeof(bh) + stored, 0,
+            bh.block_bytes - sizeof(bh) - stored);
+
+    write_full(s->spill_fd, s->scratch, bh.block_bytes, &s->write_error);
+    s->spill_bytes += bh.block_bytes;
+}
+
+static void * sink_writer(void * arg)
+{
+    struct mn_sample_sink * s = arg;
+    struct sink_block * b;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&s->lock);
+        while (!s->queue_head && !s->done)
+            pthread_cond_wait(&s->cond, &s->lock);
+        b = s->queue_head;
+        if (!b)
+        {
+            pthread_mutex_unlock(&s->lock);
+            break;
+        }
+        s->queue_head = b->next;
+        if (!s->queue_head)
+            s->queue_tail = NULL;
+        pthread_mutex_unlock(&s->lock);
+
+        sink_write_block(s, b);
+
+        pthread_mutex_lock(&s->lock);
+        b->nrows = 0;
+        b->next = s->free_blocks;
+        s->free_blocks = b;
+        pthread_mutex_unlock(&s->lock);
+    }
+    return NULL;
+}
+
+static struct sink_block * sink_new_block(struct mn_sample_sink * s)
+{
+    struct sink_block * b;
+
+    pthread_mutex_lock(&s->lock);
+    b = s->free_blocks;
+    if (b)
+        s->free_blocks = b->next;
+    pthread_mutex_unlock(&s->lock);
+
+    if (!b)
+    {
+        b = malloc(sizeof(*b));
+        assert(b);
+        b->data = malloc(s->row_bytes * s->rows_per_block);
+        assert(b->data);
+    }
+    b->nrows = 0;
+    b->next = NULL;
+    return b;
+}
+
+/* hand the current block to the writer thread */
+static void sink_queue_block(struct mn_sample_sink * s)
+{
+    struct sink_block * b = s->cur;
+
+    s->cur = NULL;
+    if (!b || b->nrows == 0)
+    {
+        if (b)
+        {
+            free(b->data);
+            free(b);
+        }
+        return;
+    }
+    pthread_mutex_lock(&s->lock);
+    if (s->queue_tail)
+        s->queue_tail->next = b;
+    else
+        s->queue_head = b;
+    s->queue_tail = b;
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+}
+
+static struct mn_sample_sink * sink_find(char const * path)
+{
+    struct mn_sample_sink * s;
+
+    for (s = sinks; s; s = s->next)
+    {
+        if (strcmp(s->path, path) == 0)
+            return s;
+    }
+    return NULL;
+}
+
+mn_sample_sink * model_net_sample_sink_get(
+        char const * path,
+        struct mn_sample_column const * cols,
+        int ncols,
+        char const * description)
+{
+    struct mn_sample_sink * s = sink_find(path);
+    int c;
+
+    if (s)
+    {
+        int same = s->ncols == ncols;
+        for (c = 0; same && c < ncols; c++)
+            same = s->cols[c].type == (uint32_t)cols[c].type &&
+                s->cols[c].count == (uint32_t)cols[c].count &&
+                strncmp(s->cols[c].name, cols[c].name,
+                        MN_SAMPLE_NAME_MAX-1) == 0;
+        if (!same)
+            tw_error(TW_LOC, "sample file %s: requested with two different "
+                    "sets of columns", path);
+        return s;
+    }
+
+    s = calloc(1, sizeof(*s));
+    assert(s);
+    s->path = strdup(path);
+    s->ncols = ncols;
+    s->cols = calloc(ncols, sizeof(*s->cols));
+    s->col_bytes = malloc(ncols * sizeof(*s->col_bytes));
+    assert(s->path && s->cols && s->col_bytes);
+    for (c = 0; c < ncols; c++)
+    {
+        assert(cols[c].count > 0);
+        s->cols[c].type = cols[c].type;
+        s->cols[c].count = cols[c].count;
+        strncpy(s->cols[c].name, cols[c].name, MN_SAMPLE_NAME_MAX-1);
+        s->col_bytes[c] = 8 * (size_t)cols[c].count;
+        s->row_bytes += s->col_bytes[c];
+    }
+    s->desc = strdup(description ? description : "");
+    s->rows_per_block = SINK_BLOCK_BYTES / s->row_bytes;
+    if (s->rows_per_block < 1)
+        s->rows_per_block = 1;
+
+    sink_compress_enabled();
+
+    int len = snprintf(NULL, 0, "%s.spill-%ld", path, (long)g_tw_mynode);
+    s->spill_path = malloc(len + 1);
+    assert(s->spill_path);
+    snprintf(s->spill_path, len + 1, "%s.spill-%ld", path, (long)g_tw_mynode);
+    s->spill_fd = open(s->spill_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (s->spill_fd < 0)
+        tw_error(TW_LOC, "unable to open sample spill file %s: %s",
+                s->spill_path, strerror(errno));
+
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->cond, NULL);
+    if (pthread_create(&s->writer, NULL, sink_writer, s) != 0)
+        tw_error(TW_LOC, "unable to start sample writer thread for %s", path);
+
+    s->next = sinks;
+    sinks = s;
+    return s;
+}
+
+void model_net_sample_sink_append(
+        mn_sample_sink * s,
+        void const * const * fields)
+{
+    size_t col_off = 0;
+    int c;
+
+    if (!s->cur)
+        s->cur = sink_new_block(s);
+
+    for (c = 0; c < s->ncols; c++)
+    {
+        memcpy(s->cur->data + col_off + s->col_bytes[c] * s->cur->nrows,
+                fields[c], s->col_bytes[c]);
+        col_off += s->col_bytes[c] * s->rows_per_block;
+    }
+    s->rows++;
+    if (++s->cur->nrows == s->rows_per_block)
+        sink_queue_block(s);
+}
+
+/* flush the sink and stop its writer thread */
+static void sink_finish(struct mn_sample_sink * s)
+{
+    sink_queue_block(s);
+    pthread_mutex_lock(&s->lock);
+    s->done = 1;
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+    pthread_join(s->writer, NULL);
+    close(s->spill_fd);
+    if (s->write_error)
+        tw_error(TW_LOC, "error writing sample spill file %s: %s",
+                s->spill_path, strerror(s->write_error));
+}
+
+static void sink_free(struct mn_sample_sink * s)
+{
+    while (s->free_blocks)
+    {
+        struct sink_block * b = s->free_blocks;
+        s->free_blocks = b->next;
+        free(b->data);
+        free(b);
+    }
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->cond);
+    free(s->scratch);
+    free(s->spill_path);
+    free(s->desc);
+    free(s->col_bytes);
+    free(s->cols);
+    free(s->path);
+    free(s);
+}
+
+/* file header, columns and description, padded to the first block */
+static char * sink_header(struct mn_sample_sink const * s, uint64_t * bytes)
+{
+    struct mn_sample_file_header fh;
+    size_t desc_len = strlen(s->desc);
+    size_t len = sizeof(fh) + s->ncols * sizeof(*s->cols) + desc_len;
+    char * buf;
+
+    *bytes = SINK_ROUND_UP(len);
+    buf = calloc(1, *bytes);
+    assert(buf);
+    memset(&fh, 0, sizeof(fh));
+    memcpy(fh.magic, MN_SAMPLE_MAGIC, sizeof(fh.magic));
+    fh.version = MN_SAMPLE_VERSION;
+    fh.ncols = s->ncols;
+    fh.flags = sink_compress ? MN_SAMPLE_COMPRESSED : 0;
+    fh.desc_len = desc_len;
+    fh.header_bytes = *bytes;
+    memcpy(buf, &fh, sizeof(fh));
+    memcpy(buf + sizeof(fh), s->cols, s->ncols * sizeof(*s->cols));
+    memcpy(buf + sizeof(fh) + s->ncols * sizeof(*s->cols), s->desc, desc_len);
+    return buf;
+}
+
+/* merge the spill files of one sink (which may not exist on every PE) */
+static void sink_merge(char const * path, struct mn_sample_sink * s)
+{
+    int rank, nranks, writer, has = s ? 1 : 0;
+    uint64_t header_bytes = 0, spill_bytes, offset = 0;
+    int64_t rows, total_rows = 0;
+    char * header = NULL;
+    MPI_File fh;
+    int rc;
+
+    MPI_Comm_rank(MPI_COMM_CODES, &rank);
+    MPI_Comm_size(MPI_COMM_CODES, &nranks);
+
+    /* the lowest rank that used the sink describes it */
+    int mine = has ? rank : nranks;
+    MPI_Allreduce(&mine, &writer, 1, MPI_INT, MPI_MIN, MPI_COMM_CODES);
+    if (rank == writer)
+        header = sink_header(s, &header_bytes);
+    MPI_Bcast(&header_bytes, 1, MPI_UINT64_T, writer, MPI_COMM_CODES);
+
+    spill_bytes = has ? s->spill_bytes : 0;
+    rows = has ? s->rows : 0;
+    MPI_Exscan(&spill_bytes, &offset, 1, MPI_UINT64_T, MPI_SUM,
+            MPI_COMM_CODES);
+    if (rank == 0)
+        offset = 0;
+    MPI_Reduce(&rows, &total_rows, 1, MPI_INT64_T, MPI_SUM, 0,
+            MPI_COMM_CODES);
+
+    rc = MPI_File_open(MPI_COMM_CODES, (char*)path,
+            MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh);
+    if (rc != MPI_SUCCESS)
+        tw_error(TW_LOC, "unable to open sample file %s", path);
+    MPI_File_set_size(fh, 0);
+
+    if (header)
+    {
+        MPI_File_write_at(fh, 0, header, header_bytes, MPI_BYTE,
+                MPI_STATUS_IGNORE);
+        free(header);
+    }
+
+    if (spill_bytes > 0)
+    {
+        int fd = open(s->spill_path, O_RDONLY);
+        char * buf = malloc(SINK_COPY_BYTES);
+        uint64_t done = 0;
+
+        if (fd < 0)
+            tw_error(TW_LOC, "unable to reopen sample spill file %s",
+                    s->spill_path);
+        assert(buf);
+        while (done < spill_bytes)
+        {
+            ssize_t n = read(fd, buf, SINK_COPY_BYTES);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                tw_error(TW_LOC, "short read of sample spill file %s",
+                        s->spill_path);
+            MPI_File_write_at(fh, header_bytes + offset + done, buf, n,
+                    MPI_BYTE, MPI_STATUS_IGNORE);
+            done += n;
+        }
+        free(buf);
+        close(fd);
+    }
+    MPI_File_close(&fh);
+
+    if (has)
+        unlink(s->spill_path);
+    if (rank == 0)
+        printf("model-net sampling: wrote %lld samples to %s\n",
+                (long long)total_rows, path);
+}
+
+static int sink_name_cmp(void const * a, void const * b)
+{
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+void model_net_sample_sinks_close(void)
+{
+    struct mn_sample_sink * s;
+    int nranks, i, len = 0, total = 0, nnames = 0;
+    int * lens, * displs;
+    char * local, * all, ** names;
+
+    MPI_Comm_size(MPI_COMM_CODES, &nranks);
+
+    /* every PE has to take part in merging every sink, so agree on the
+     * union of the sink paths first */
+    for (s = sinks; s; s = s->next)
+    {
+        sink_finish(s);
+        len += strlen(s->path) + 1;
+    }
+    local = malloc(len + 1);
+    assert(local);
+    len = 0;
+    for (s = sinks; s; s = s->next)
+    {
+        strcpy(local + len, s->path);
+        len += strlen(s->path) + 1;
+    }
+
+    lens = malloc(nranks * sizeof(*lens));
+    displs = malloc(nranks * sizeof(*displs));
+    assert(lens && displs);
+    MPI_Allgather(&len, 1, MPI_INT, lens, 1, MPI_INT, MPI_COMM_CODES);
+    for (i = 0; i < nranks; i++)
+    {
+        displs[i] = total;
+        total += lens[i];
+    }
+    all = malloc(total + 1);
+    assert(all);
+    MPI_Allgatherv(local, len, MPI_CHAR, all, lens, displs, MPI_CHAR,
+            MPI_COMM_CODES);
+
+    names = malloc((total + 1) * sizeof(*names));
+    assert(names);
+    for (i = 0; i < total; i += strlen(all + i) + 1)
+        names[nnames++] = all + i;
+    qsort(names, nnames, sizeof(*names), sink_name_cmp);
+
+    for (i = 0; i < nnames; i++)
+    {
+        if (i > 0 && strcmp(names[i], names[i-1]) == 0)
+            continue;
+        sink_merge(names[i], sink_find(names[i]));
+    }
+
+    while (sinks)
+    {
+        s = sinks;
+        sinks = s->next;
+        sink_free(s);
+    }
+    free(names);
+    free(all);
+    free(displs);
+    free(lens);
+    free(local);
+}
+
+mn_sample_sink * model_net_sample_router_sink(
+        char const * path,
+        int radix,
+        char const * description)
+{
+    struct mn_sample_column cols[] = {
+        { "router_id",    MN_SAMPLE_UINT64, 1 },
+        { "busy_time",    MN_SAMPLE_DOUBLE, radix },
+        { "link_traffic", MN_SAMPLE_INT64,  radix },
+        { "end_time",     MN_SAMPLE_DOUBLE, 1 },
+        { "fwd_events",   MN_SAMPLE_INT64,  1 },
+        { "rev_events",   MN_SAMPLE_INT64,  1 },
+    };
+    return model_net_sample_sink_get(path, cols,
+            sizeof(cols) / sizeof(cols[0]), description);
+}
+
+void model_net_sample_router_append(
+        mn_sample_sink * sink,
+        tw_lpid router_id,
+        tw_stime const * busy_time,
+        int64_t const * link_traffic,
+        tw_stime end_time,
+        long fwd_events,
+        long rev_events)
+{
+    uint64_t id = router_id;
+    double end = end_time;
+    int64_t fwd = fwd_events, rev = rev_events;
+    void const * fields[] = { &id, busy_time, link_traffic, &end, &fwd, &rev };
+
+    assert(sizeof(*busy_time) == 8);
+    model_net_sample_sink_append(sink, fields);
+}
+
+mn_sample_sink * model_net_sample_terminal_sink(char const * path)
+{
+    struct mn_sample_column cols[] = {
+        { "terminal_id",     MN_SAMPLE_UINT64, 1 },
+        { "fin_chunks",      MN_SAMPLE_INT64,  1 },
+        { "data_size",       MN_SAMPLE_INT64,  1 },
+        { "fin_hops",        MN_SAMPLE_DOUBLE, 1 },
+        { "fin_chunks_time", MN_SAMPLE_DOUBLE, 1 },
+        { "busy_time",       MN_SAMPLE_DOUBLE, 1 },
+        { "end_time",        MN_SAMPLE_DOUBLE, 1 },
+        { "fwd_events",      MN_SAMPLE_INT64,  1 },
+        { "rev_events",      MN_SAMPLE_INT64,  1 },
+    };
+    return model_net_sample_sink_get(path, cols,
+            sizeof(cols) / sizeof(cols[0]), "compute node samples");
+}
+
+void model_net_sample_terminal_append(
+        mn_sample_sink * sink,
+        tw_lpid terminal_id,
+        long fin_chunks,
+        long data_size,
+        double fin_hops,
+        tw_stime fin_chunks_time,
+        tw_stime busy_time,
+        tw_stime end_time,
+        long fwd_events,
+        long rev_events)
+{
+    uint64_t id = terminal_id;
+    int64_t chunks = fin_chunks, size = data_size;
+    double hops = fin_hops, chunks_time = fin_chunks_time, busy = busy_time,
+           end = end_time;
+    int64_t fwd = fwd_events, rev = rev_events;
+    void const * fields[] = { &id, &chunks, &size, &hops, &chunks_time, &busy,
+        &end, &fwd, &rev };
+
+    model_net_sample_sink_append(sink, fields);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
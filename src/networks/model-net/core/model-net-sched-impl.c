@@ -11,6 +11,7 @@
 #include <codes/model-net-sched.h>
 #include <codes/model-net-method.h>
 #include <codes/quicklist.h>
+#include <codes/quickhash.h>
 #include <codes/codes.h>
 
 #define MN_SCHED_DEBUG_VERBOSE 0
@@ -49,8 +50,65 @@ typedef struct mn_sched_prio {
     mn_prio_params params;
     const model_net_sched_interface *sub_sched_iface;
     mn_sched_queue ** sub_scheds; // one for each params.num_prios
+    // number of requests queued at each priority, and a bitmap of the
+    // priorities with queued requests (bit i%64 of word i/64)
+    int * queue_lens;
+    int num_words;
+    uint64_t * nonempty;
 } mn_sched_prio;
 
+// cost of the priority scheduler's next on this PE (see mn_sched_cost)
+static mn_sched_cost prio_cost;
+
+// a flow of the drr/wfq schedulers. Requests within a flow are served in
+// order through the embedded fcfs queue. Flows are created on first use and
+// kept for the lifetime of the scheduler, so their ids stay valid for rc
+typedef struct mn_sched_flow {
+    mn_sched_queue q;
+    int id;
+    // flow key: see mn_flow_key (unused fields are 0)
+    tw_lpid src;
+    tw_lpid dest;
+    int prio;
+    int weight;
+    // drr: link in the list of backlogged flows, deficit counter and whether
+    // the flow has received its quantum for the current visit
+    struct qlist_head active;
+    int64_t deficit;
+    int credited;
+    // wfq: finish tags of the head packet and of the last packet sent, and
+    // position in the heap of backlogged flows (-1 if idle)
+    double head_finish;
+    double last_finish;
+    int heap_idx;
+    struct qhash_head hash_link;
+} mn_sched_flow;
+
+// drr and wfq share the flow bookkeeping
+typedef struct mn_sched_flows {
+    mn_flow_params params;
+    const struct model_net_method *method;
+    int is_recv_queue;
+    struct qhash_table *flow_tbl;
+    int num_flows;
+    int flows_cap;
+    mn_sched_flow **flows; // indexed by flow id
+    // drr: backlogged flows in round-robin order
+    struct qlist_head active;
+    // wfq: binary min-heap of backlogged flows by head finish tag, and the
+    // system virtual time (finish tag of the last packet sent)
+    int heap_len;
+    mn_sched_flow **heap;
+    double vtime;
+} mn_sched_flows;
+
+#define FLOW_HASH_SIZE 1021
+
+// drr next flags, see drr_next
+#define DRR_ROTATED  1
+#define DRR_CREDITED 2
+#define DRR_IDLE     4
+
 /// scheduler-specific function decls and tables
 
 /// FCFS
@@ -142,6 +200,60 @@ static void prio_next_rc (
         const model_net_sched_rc * rc,
         tw_lp                    * lp);
 
+// DEFICIT ROUND-ROBIN
+static void flows_init (
+        const struct model_net_method     * method, 
+        const model_net_sched_cfg_params  * params,
+        int                                 is_recv_queue,
+        void                             ** sched);
+static void flows_destroy (void *sched);
+static void drr_add (
+        const model_net_request * req,
+        const mn_sched_params   * sched_params,
+        int                       remote_event_size,
+        void                    * remote_event,
+        int                       local_event_size,
+        void                    * local_event,
+        void                    * sched,
+        model_net_sched_rc      * rc,
+        tw_lp                   * lp);
+static void drr_add_rc(void *sched, const model_net_sched_rc *rc, tw_lp *lp);
+static int  drr_next(
+        tw_stime              * poffset,
+        void                  * sched,
+        void                  * rc_event_save,
+        model_net_sched_rc    * rc,
+        tw_lp                 * lp);
+static void drr_next_rc (
+        void                     * sched,
+        const void               * rc_event_save,
+        const model_net_sched_rc * rc,
+        tw_lp                    * lp);
+
+// WEIGHTED FAIR QUEUING
+static void wfq_add (
+        const model_net_request * req,
+        const mn_sched_params   * sched_params,
+        int                       remote_event_size,
+        void                    * remote_event,
+        int                       local_event_size,
+        void                    * local_event,
+        void                    * sched,
+        model_net_sched_rc      * rc,
+        tw_lp                   * lp);
+static void wfq_add_rc(void *sched, const model_net_sched_rc *rc, tw_lp *lp);
+static int  wfq_next(
+        tw_stime              * poffset,
+        void                  * sched,
+        void                  * rc_event_save,
+        model_net_sched_rc    * rc,
+        tw_lp                 * lp);
+static void wfq_next_rc (
+        void                     * sched,
+        const void               * rc_event_save,
+        const model_net_sched_rc * rc,
+        tw_lp                    * lp);
+
 /// function tables (names defined by X macro in model-net-sched.h)
 static const model_net_sched_interface fcfs_tab = 
 { &fcfs_init, &fcfs_destroy, &fcfs_add, &fcfs_add_rc, &fcfs_next, &fcfs_next_rc};
@@ -149,6 +261,10 @@ static const model_net_sched_interface rr_tab =
 { &rr_init, &rr_destroy, &rr_add, &rr_add_rc, &rr_next, &rr_next_rc};
 static const model_net_sched_interface prio_tab =
 { &prio_init, &prio_destroy, &prio_add, &prio_add_rc, &prio_next, &prio_next_rc};
+static const model_net_sched_interface drr_tab =
+{ &flows_init, &flows_destroy, &drr_add, &drr_add_rc, &drr_next, &drr_next_rc};
+static const model_net_sched_interface wfq_tab =
+{ &flows_init, &flows_destroy, &wfq_add, &wfq_add_rc, &wfq_next, &wfq_next_rc};
 
 #define X(a,b,c) c,
 const model_net_sched_interface * sched_interfaces[] = {
@@ -426,6 +542,33 @@ void rr_next_rc (
     fcfs_next_rc(sched, rc_event_save, rc, lp);
 }
 
+// index of the lowest set bit of a non-zero word
+static inline int prio_lowest_bit(uint64_t w){
+#if defined(__GNUC__)
+    return __builtin_ctzll(w);
+#else
+    int b = 0;
+    if (!(w & 0xffffffffull)) { w >>= 32; b += 32; }
+    if (!(w & 0xffffull))     { w >>= 16; b += 16; }
+    if (!(w & 0xffull))       { w >>= 8;  b += 8; }
+    if (!(w & 0xfull))        { w >>= 4;  b += 4; }
+    if (!(w & 0x3ull))        { w >>= 2;  b += 2; }
+    if (!(w & 0x1ull))        { b += 1; }
+    return b;
+#endif
+}
+
+static inline void prio_inc(mn_sched_prio *ss, int prio){
+    if (ss->queue_lens[prio]++ == 0)
+        ss->nonempty[prio/64] |= 1ull << (prio%64);
+}
+
+static inline void prio_dec(mn_sched_prio *ss, int prio){
+    assert(ss->queue_lens[prio] > 0);
+    if (--ss->queue_lens[prio] == 0)
+        ss->nonempty[prio/64] &= ~(1ull << (prio%64));
+}
+
 void prio_init (
         const struct model_net_method     * method, 
         const model_net_sched_cfg_params  * params,
@@ -435,6 +578,10 @@ void prio_init (
     mn_sched_prio *ss = *sched;
     ss->params = params->u.prio;
     ss->sub_scheds = malloc(ss->params.num_prios*sizeof(mn_sched_queue*));
+    ss->queue_lens = calloc(ss->params.num_prios, sizeof(*ss->queue_lens));
+    ss->num_words = (ss->params.num_prios + 63) / 64;
+    ss->nonempty = calloc(ss->num_words, sizeof(*ss->nonempty));
+    assert(ss->sub_scheds && ss->queue_lens && ss->nonempty);
     ss->sub_sched_iface = sched_interfaces[ss->params.sub_stype];
     for (int i = 0; i < ss->params.num_prios; i++){
         ss->sub_sched_iface->init(method, params, is_recv_queue,
@@ -444,11 +591,12 @@ void prio_init (
 
 void prio_destroy (void *sched){
     mn_sched_prio *ss = sched;
-    for (int i = 0; i < ss->params.num_prios; i++){
+    for (int i = 0; i < ss->params.num_prios; i++)
         ss->sub_sched_iface->destroy(ss->sub_scheds[i]);
-        free(ss->sub_scheds);
-        free(ss);
-    }
+    free(ss->sub_scheds);
+    free(ss->queue_lens);
+    free(ss->nonempty);
+    free(ss);
 }
 
 void prio_add (
@@ -477,6 +625,7 @@ void prio_add (
             remote_event, local_event_size, local_event, ss->sub_scheds[prio],
             rc, lp);
     rc->prio = prio;
+    prio_inc(ss, prio);
 }
 
 void prio_add_rc(void * sched, const model_net_sched_rc *rc, tw_lp *lp){
@@ -484,6 +633,7 @@ void prio_add_rc(void * sched, const model_net_sched_rc *rc, tw_lp *lp){
     mn_sched_prio *ss = sched;
     dprintf("%llu (mn): rc adding with prio %d\n", LLU(lp->gid), rc->prio);
     ss->sub_sched_iface->add_rc(ss->sub_scheds[rc->prio], rc, lp);
+    prio_dec(ss, rc->prio);
 }
 
 int prio_next(
@@ -492,15 +642,21 @@ int prio_next(
         void                  * rc_event_save,
         model_net_sched_rc    * rc,
         tw_lp                 * lp){
-    // check each priority, first one that's non-empty gets the next
+    // the lowest non-empty priority gets the next packet
     mn_sched_prio *ss = sched;
-    for (int i = 0; i < ss->params.num_prios; i++){
-        // TODO: this works for now while the other schedulers have the same
-        // internal representation
-        if (!qlist_empty(&ss->sub_scheds[i]->reqs)){
+    prio_cost.next_calls++;
+    for (int w = 0; w < ss->num_words; w++){
+        prio_cost.words_scanned++;
+        if (ss->nonempty[w]){
+            int i = w*64 + prio_lowest_bit(ss->nonempty[w]);
             rc->prio = i;
-            return ss->sub_sched_iface->next(
+            int ret = ss->sub_sched_iface->next(
                     poffset, ss->sub_scheds[i], rc_event_save, rc, lp);
+            assert(ret != -1);
+            // request finished
+            if (ret == 1)
+                prio_dec(ss, i);
+            return ret;
         }
     }
     rc->prio = -1;
@@ -517,10 +673,363 @@ void prio_next_rc (
         mn_sched_prio *ss = sched;
         ss->sub_sched_iface->next_rc(ss->sub_scheds[rc->prio], rc_event_save,
                 rc, lp);
+        if (rc->rtn == 1)
+            prio_inc(ss, rc->prio);
     }
     // else, no-op
 }
 
+void model_net_sched_get_prio_cost(mn_sched_cost *cost){
+    *cost = prio_cost;
+}
+
+/// flow bookkeeping shared by drr and wfq
+
+struct flow_key {
+    tw_lpid src;
+    tw_lpid dest;
+    int prio;
+};
+
+static int flow_compare(void *key, struct qhash_head *link){
+    struct flow_key *k = key;
+    mn_sched_flow *f = qhash_entry(link, mn_sched_flow, hash_link);
+    return f->src == k->src && f->dest == k->dest && f->prio == k->prio;
+}
+
+static int flow_hash(void *key, int table_size){
+    struct flow_key *k = key;
+    uint64_t h = k->src * 0x9E3779B97F4A7C15ull;
+    h = (h ^ k->dest) * 0x9E3779B97F4A7C15ull;
+    h = (h ^ (uint64_t)k->prio) * 0x9E3779B97F4A7C15ull;
+    return (int)((h >> 32) % (uint64_t)table_size);
+}
+
+void flows_init (
+        const struct model_net_method     * method, 
+        const model_net_sched_cfg_params  * params,
+        int                                 is_recv_queue,
+        void                             ** sched){
+    *sched = calloc(1, sizeof(mn_sched_flows));
+    mn_sched_flows *ss = *sched;
+    assert(ss);
+    ss->params = params->u.flow;
+    ss->method = method;
+    ss->is_recv_queue = is_recv_queue;
+    ss->flow_tbl = qhash_init(flow_compare, flow_hash, FLOW_HASH_SIZE);
+    assert(ss->flow_tbl);
+    INIT_QLIST_HEAD(&ss->active);
+}
+
+void flows_destroy (void *sched){
+    mn_sched_flows *ss = sched;
+    for (int i = 0; i < ss->num_flows; i++)
+        free(ss->flows[i]);
+    free(ss->flows);
+    free(ss->heap);
+    qhash_finalize(ss->flow_tbl);
+    free(ss);
+}
+
+// find the flow a request belongs to, creating it on first use
+static mn_sched_flow * flows_get(
+        mn_sched_flows          * ss,
+        const model_net_request * req,
+        const mn_sched_params   * sched_params){
+    struct flow_key k;
+    k.src  = ss->params.key == MN_FLOW_KEY_DEST ? 0 : req->src_lp;
+    k.dest = ss->params.key == MN_FLOW_KEY_SRC  ? 0 : req->final_dest_lp;
+    k.prio = sched_params->prio < 0 ? 0 : sched_params->prio;
+
+    struct qhash_head *link = qhash_search(ss->flow_tbl, &k);
+    if (link)
+        return qhash_entry(link, mn_sched_flow, hash_link);
+
+    if (ss->num_flows == ss->flows_cap){
+        ss->flows_cap = ss->flows_cap ? 2 * ss->flows_cap : 16;
+        ss->flows = realloc(ss->flows, ss->flows_cap * sizeof(*ss->flows));
+        ss->heap = realloc(ss->heap, ss->flows_cap * sizeof(*ss->heap));
+        assert(ss->flows && ss->heap);
+    }
+    mn_sched_flow *f = calloc(1, sizeof(*f));
+    assert(f);
+    f->q.method = ss->method;
+    f->q.is_recv_queue = ss->is_recv_queue;
+    INIT_QLIST_HEAD(&f->q.reqs);
+    f->id = ss->num_flows;
+    f->src = k.src;
+    f->dest = k.dest;
+    f->prio = k.prio;
+    if (ss->params.num_weights == 0)
+        f->weight = 1;
+    else if (k.prio < ss->params.num_weights)
+        f->weight = ss->params.weights[k.prio];
+    else
+        f->weight = ss->params.weights[ss->params.num_weights-1];
+    INIT_QLIST_HEAD(&f->active);
+    f->heap_idx = -1;
+    qhash_add(ss->flow_tbl, &k, &f->hash_link);
+    ss->flows[ss->num_flows++] = f;
+    return f;
+}
+
+// size of the next packet of a backlogged flow
+static uint64_t flow_head_psize(const mn_sched_flow *f){
+    mn_sched_qitem *q = qlist_entry(f->q.reqs.next, mn_sched_qitem, ql);
+    return q->req.packet_size >= q->rem ? q->rem : q->req.packet_size;
+}
+
+/// DRR implementation
+/// backlogged flows are kept in a list in round order. The head flow is
+/// credited quantum*weight bytes when it reaches the head and sends packets
+/// until its deficit no longer covers the next one, at which point it moves
+/// to the tail. Since the quantum covers a full packet, a next call looks at
+/// no more than two flows
+
+void drr_add (
+        const model_net_request * req,
+        const mn_sched_params   * sched_params,
+        int                       remote_event_size,
+        void                    * remote_event,
+        int                       local_event_size,
+        void                    * local_event,
+        void                    * sched,
+        model_net_sched_rc      * rc,
+        tw_lp                   * lp){
+    mn_sched_flows *ss = sched;
+    mn_sched_flow *f = flows_get(ss, req, sched_params);
+    if (f->q.queue_len == 0)
+        qlist_add_tail(&f->active, &ss->active);
+    fcfs_add(req, sched_params, remote_event_size, remote_event,
+            local_event_size, local_event, &f->q, rc, lp);
+    rc->flow = f->id;
+}
+
+void drr_add_rc(void *sched, const model_net_sched_rc *rc, tw_lp *lp){
+    mn_sched_flows *ss = sched;
+    mn_sched_flow *f = ss->flows[rc->flow];
+    fcfs_add_rc(&f->q, rc, lp);
+    // an idle flow has not been credited yet, so only the list changes
+    if (f->q.queue_len == 0)
+        qlist_del(&f->active);
+}
+
+int drr_next(
+        tw_stime              * poffset,
+        void                  * sched,
+        void                  * rc_event_save,
+        model_net_sched_rc    * rc,
+        tw_lp                 * lp){
+    mn_sched_flows *ss = sched;
+    rc->flow_flags = 0;
+    if (qlist_empty(&ss->active)){
+        rc->flow = -1;
+        rc->rtn = -1;
+        return -1;
+    }
+
+    mn_sched_flow *f = qlist_entry(ss->active.next, mn_sched_flow, active);
+    uint64_t psize = flow_head_psize(f);
+    if (f->credited && f->deficit < (int64_t)psize){
+        // round over for this flow
+        f->credited = 0;
+        qlist_del(&f->active);
+        qlist_add_tail(&f->active, &ss->active);
+        rc->flow_flags |= DRR_ROTATED;
+        f = qlist_entry(ss->active.next, mn_sched_flow, active);
+        psize = flow_head_psize(f);
+    }
+    if (!f->credited){
+        f->deficit += (int64_t)(ss->params.quantum * f->weight);
+        f->credited = 1;
+        rc->flow_flags |= DRR_CREDITED;
+    }
+    assert(f->deficit >= (int64_t)psize);
+    f->deficit -= psize;
+    rc->flow = f->id;
+
+    int ret = fcfs_next(poffset, &f->q, rc_event_save, rc, lp);
+    if (f->q.queue_len == 0){
+        // idle flows don't carry their deficit over
+        rc->flow_saved.deficit = f->deficit;
+        f->deficit = 0;
+        f->credited = 0;
+        qlist_del(&f->active);
+        rc->flow_flags |= DRR_IDLE;
+    }
+    return ret;
+}
+
+void drr_next_rc (
+        void                     * sched,
+        const void               * rc_event_save,
+        const model_net_sched_rc * rc,
+        tw_lp                    * lp){
+    mn_sched_flows *ss = sched;
+    if (rc->rtn == -1)
+        return;
+
+    mn_sched_flow *f = ss->flows[rc->flow];
+    if (rc->flow_flags & DRR_IDLE){
+        qlist_add(&f->active, &ss->active);
+        f->deficit = rc->flow_saved.deficit;
+        f->credited = 1;
+    }
+    fcfs_next_rc(&f->q, rc_event_save, rc, lp);
+    f->deficit += flow_head_psize(f);
+    if (rc->flow_flags & DRR_CREDITED){
+        f->deficit -= (int64_t)(ss->params.quantum * f->weight);
+        f->credited = 0;
+    }
+    if (rc->flow_flags & DRR_ROTATED){
+        // the rotated flow is now at the tail
+        mn_sched_flow *r = qlist_entry(ss->active.prev, mn_sched_flow, active);
+        qlist_del(&r->active);
+        qlist_add(&r->active, &ss->active);
+        r->credited = 1;
+    }
+}
+
+/// WFQ implementation
+/// self-clocked fair queuing: the head packet of each backlogged flow gets a
+/// finish tag of max(vtime, flow's last tag) + size/weight, and the flow with
+/// the smallest tag is served next. Ties are broken by flow key (not by id or
+/// heap layout) so that the order is the same after a rollback
+
+static int wfq_less(const mn_sched_flow *a, const mn_sched_flow *b){
+    if (a->head_finish != b->head_finish)
+        return a->head_finish < b->head_finish;
+    if (a->prio != b->prio)
+        return a->prio < b->prio;
+    if (a->src != b->src)
+        return a->src < b->src;
+    return a->dest < b->dest;
+}
+
+static void wfq_heap_set(mn_sched_flows *ss, int i, mn_sched_flow *f){
+    ss->heap[i] = f;
+    f->heap_idx = i;
+}
+
+static void wfq_heap_fix(mn_sched_flows *ss, int i){
+    mn_sched_flow *f = ss->heap[i];
+    // sift up
+    while (i > 0 && wfq_less(f, ss->heap[(i-1)/2])){
+        wfq_heap_set(ss, i, ss->heap[(i-1)/2]);
+        i = (i-1)/2;
+    }
+    // sift down
+    for (;;){
+        int c = 2*i + 1;
+        if (c >= ss->heap_len)
+            break;
+        if (c+1 < ss->heap_len && wfq_less(ss->heap[c+1], ss->heap[c]))
+            c++;
+        if (!wfq_less(ss->heap[c], f))
+            break;
+        wfq_heap_set(ss, i, ss->heap[c]);
+        i = c;
+    }
+    wfq_heap_set(ss, i, f);
+}
+
+static void wfq_heap_push(mn_sched_flows *ss, mn_sched_flow *f){
+    wfq_heap_set(ss, ss->heap_len++, f);
+    wfq_heap_fix(ss, ss->heap_len-1);
+}
+
+static void wfq_heap_remove(mn_sched_flows *ss, mn_sched_flow *f){
+    int i = f->heap_idx;
+    assert(i >= 0 && ss->heap[i] == f);
+    f->heap_idx = -1;
+    ss->heap_len--;
+    if (i < ss->heap_len){
+        wfq_heap_set(ss, i, ss->heap[ss->heap_len]);
+        wfq_heap_fix(ss, i);
+    }
+}
+
+void wfq_add (
+        const model_net_request * req,
+        const mn_sched_params   * sched_params,
+        int                       remote_event_size,
+        void                    * remote_event,
+        int                       local_event_size,
+        void                    * local_event,
+        void                    * sched,
+        model_net_sched_rc      * rc,
+        tw_lp                   * lp){
+    mn_sched_flows *ss = sched;
+    mn_sched_flow *f = flows_get(ss, req, sched_params);
+    int was_idle = f->q.queue_len == 0;
+    fcfs_add(req, sched_params, remote_event_size, remote_event,
+            local_event_size, local_event, &f->q, rc, lp);
+    if (was_idle){
+        double start = ss->vtime > f->last_finish ? ss->vtime : f->last_finish;
+        f->head_finish = start + (double)flow_head_psize(f) / f->weight;
+        wfq_heap_push(ss, f);
+    }
+    rc->flow = f->id;
+}
+
+void wfq_add_rc(void *sched, const model_net_sched_rc *rc, tw_lp *lp){
+    mn_sched_flows *ss = sched;
+    mn_sched_flow *f = ss->flows[rc->flow];
+    fcfs_add_rc(&f->q, rc, lp);
+    if (f->q.queue_len == 0)
+        wfq_heap_remove(ss, f);
+}
+
+int wfq_next(
+        tw_stime              * poffset,
+        void                  * sched,
+        void                  * rc_event_save,
+        model_net_sched_rc    * rc,
+        tw_lp                 * lp){
+    mn_sched_flows *ss = sched;
+    rc->flow_flags = 0;
+    if (ss->heap_len == 0){
+        rc->flow = -1;
+        rc->rtn = -1;
+        return -1;
+    }
+
+    mn_sched_flow *f = ss->heap[0];
+    rc->flow = f->id;
+    rc->flow_saved.wfq.vtime = ss->vtime;
+    rc->flow_saved.wfq.finish = f->last_finish;
+    ss->vtime = f->head_finish;
+    f->last_finish = f->head_finish;
+
+    int ret = fcfs_next(poffset, &f->q, rc_event_save, rc, lp);
+    if (f->q.queue_len == 0)
+        wfq_heap_remove(ss, f);
+    else {
+        f->head_finish = f->last_finish + (double)flow_head_psize(f) / f->weight;
+        wfq_heap_fix(ss, f->heap_idx);
+    }
+    return ret;
+}
+
+void wfq_next_rc (
+        void                     * sched,
+        const void               * rc_event_save,
+        const model_net_sched_rc * rc,
+        tw_lp                    * lp){
+    mn_sched_flows *ss = sched;
+    if (rc->rtn == -1)
+        return;
+
+    mn_sched_flow *f = ss->flows[rc->flow];
+    if (f->heap_idx >= 0)
+        wfq_heap_remove(ss, f);
+    fcfs_next_rc(&f->q, rc_event_save, rc, lp);
+    f->head_finish = f->last_finish;
+    f->last_finish = rc->flow_saved.wfq.finish;
+    ss->vtime = rc->flow_saved.wfq.vtime;
+    wfq_heap_push(ss, f);
+}
+
 /*
  * Local variables:
  *  c-indent-level: 4
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <ross.h>
+
+#include "codes/configuration.h"
+#include "codes/jenkins-hash.h"
+#include "codes/model-net-sample-sink.h"
+#include "codes/model-net-trace.h"
+
+#define TRACE_FILE_MAX 256
+
+static int trace_rate = 0;
+static char trace_file[TRACE_FILE_MAX] = "model-net-packet-trace";
+static mn_sample_sink * trace_sink = NULL;
+
+void model_net_trace_configure(void)
+{
+    int rc;
+
+    rc = configuration_get_value_int(&config, "PARAMS", "packet_trace_rate",
+            NULL, &trace_rate);
+    if (rc || trace_rate < 0)
+        trace_rate = 0;
+    if (!trace_rate)
+        return;
+
+    configuration_get_value(&config, "PARAMS", "packet_trace_file", NULL,
+            trace_file, TRACE_FILE_MAX - 4);
+    if (!g_tw_mynode)
+        printf("model-net: tracing 1 in %d messages to %s.bin\n", trace_rate,
+                trace_file);
+}
+
+int model_net_trace_select(
+        tw_lpid sender,
+        tw_lpid final_dest_lp,
+        tw_stime now)
+{
+    struct { uint64_t sender, dest; tw_stime now; } key;
+    uint32_t h1 = 0, h2 = 0;
+
+    if (!trace_rate)
+        return 0;
+    if (trace_rate == 1)
+        return 1;
+
+    memset(&key, 0, sizeof(key));
+    key.sender = sender;
+    key.dest = final_dest_lp;
+    key.now = now;
+    bj_hashlittle2(&key, sizeof(key), &h1, &h2);
+    return h1 % trace_rate == 0;
+}
+
+void model_net_trace_record(struct mn_trace_record const * rec)
+{
+    void const * fields[] = { &rec->packet_id, &rec->chunk_id,
+        &rec->src_terminal, &rec->dest_terminal, &rec->kind, &rec->location,
+        &rec->port, &rec->vc, &rec->start_time, &rec->arrive_time,
+        &rec->depart_time };
+
+    if (!trace_sink)
+    {
+        struct mn_sample_column cols[] = {
+            { "packet_id",     MN_SAMPLE_UINT64, 1 },
+            { "chunk_id",      MN_SAMPLE_INT64,  1 },
+            { "src_terminal",  MN_SAMPLE_INT64,  1 },
+            { "dest_terminal", MN_SAMPLE_INT64,  1 },
+            { "kind",          MN_SAMPLE_INT64,  1 },
+            { "location",      MN_SAMPLE_INT64,  1 },
+            { "port",          MN_SAMPLE_INT64,  1 },
+            { "vc",            MN_SAMPLE_INT64,  1 },
+            { "start_time",    MN_SAMPLE_DOUBLE, 1 },
+            { "arrive_time",   MN_SAMPLE_DOUBLE, 1 },
+            { "depart_time",   MN_SAMPLE_DOUBLE, 1 },
+        };
+        char path[TRACE_FILE_MAX];
+
+        snprintf(path, sizeof(path), "%s.bin", trace_file);
+        trace_sink = model_net_sample_sink_get(path, cols,
+                sizeof(cols) / sizeof(cols[0]),
+                "sampled packet trace. kind: 0 injected at the source "
+                "terminal, 1 left a router, 2 delivered to the destination "
+                "terminal. Packets are identified by (src_terminal, "
+                "packet_id)");
+    }
+    model_net_sample_sink_append(trace_sink, fields);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
@@ -11,7 +11,11 @@
 #include "codes/model-net-method.h"
 #include "codes/model-net-lp.h"
 #include "codes/model-net-sched.h"
+#include "codes/model-net-sample-sink.h"
+#include "codes/model-net-link-summary.h"
+#include "codes/model-net-trace.h"
 #include "codes/codes.h"
+#include "codes/codes-category.h"
 #include <codes/codes_mapping.h>
 
 
@@ -71,6 +75,11 @@ static int codes_node_eager_limit = 16000;
 // - needs to be held between the register and configure calls
 static int do_config_nets[MAX_NETS];
 
+// per-category statistics of all finalized LPs on this PE, reduced across
+// PEs by model_net_report_stats
+static mn_stats_table pe_stats;
+static int pe_stats_reported = 0;
+
 void model_net_register(){
     // first set up which networks need to be registered, then pass off to base
     // LP to do its thing
@@ -165,6 +174,8 @@ int* model_net_configure(int *id_count){
                 "setting to %d\n", codes_node_eager_limit);
     }
 
+    model_net_trace_configure();
+
     return ids;
 }
 
@@ -178,86 +189,149 @@ int model_net_get_id(char *name){
     return -1;
 }
 
-void model_net_write_stats(tw_lpid lpid, struct mn_stats* stat)
+static void mn_stats_add(struct mn_stats *to, struct mn_stats const *from)
 {
-    int ret;
-    char id[19+CATEGORY_NAME_MAX+1];
-    char data[1024];
-
-    sprintf(id, "model-net-category-%s", stat->category);
-    sprintf(data, "lp:%ld\tsend_count:%ld\tsend_bytes:%ld\tsend_time:%f\t"
-        "recv_count:%ld\trecv_bytes:%ld\trecv_time:%f\tmax_event_size:%ld\n",
-        (long)lpid,
-        stat->send_count,
-        stat->send_bytes,
-        stat->send_time,
-        stat->recv_count,
-        stat->recv_bytes,
-        stat->recv_time,
-        stat->max_event_size);
-
-    ret = lp_io_write(lpid, id, strlen(data), data);
-    assert(ret == 0);
-
-    return;
+    to->send_count += from->send_count;
+    to->send_bytes += from->send_bytes;
+    to->send_time += from->send_time;
+    to->recv_count += from->recv_count;
+    to->recv_bytes += from->recv_bytes;
+    to->recv_time += from->recv_time;
+    if(from->max_event_size > to->max_event_size)
+        to->max_event_size = from->max_event_size;
 }
 
-void model_net_print_stats(tw_lpid lpid, mn_stats mn_stats_array[])
+void model_net_print_stats(tw_lpid lpid, mn_stats_table *table)
 {
-
+    (void)lpid;
     int i;
-    struct mn_stats all;
 
-    memset(&all, 0, sizeof(all));
-    sprintf(all.category, "all");
+    for(i=0; i<table->count; i++)
+    {
+        if(table->stats[i].category[0] != '\0')
+            mn_stats_add(model_net_find_stats(table->stats[i].category,
+                        &pe_stats), &table->stats[i]);
+    }
+    free(table->stats);
+    table->stats = NULL;
+    table->count = 0;
+}
+
+struct mn_stats* model_net_find_stats(char const * category, mn_stats_table *table)
+{
+    int id = codes_category_id(category);
+    struct mn_stats *stat;
 
-    for(i=0; i<CATEGORY_MAX; i++)
+    if(id >= table->count)
     {
-        if(strlen(mn_stats_array[i].category) > 0)
-        {
-            all.send_count += mn_stats_array[i].send_count;
-            all.send_bytes += mn_stats_array[i].send_bytes;
-            all.send_time += mn_stats_array[i].send_time;
-            all.recv_count += mn_stats_array[i].recv_count;
-            all.recv_bytes += mn_stats_array[i].recv_bytes;
-            all.recv_time += mn_stats_array[i].recv_time;
-            if(mn_stats_array[i].max_event_size > all.max_event_size)
-                all.max_event_size = mn_stats_array[i].max_event_size;
-
-            model_net_write_stats(lpid, &mn_stats_array[i]);
-        }
+        int cnt = codes_category_count();
+        table->stats = realloc(table->stats, cnt * sizeof(*table->stats));
+        assert(table->stats);
+        memset(table->stats + table->count, 0,
+                (cnt - table->count) * sizeof(*table->stats));
+        table->count = cnt;
+    }
+
+    stat = &table->stats[id];
+    if(stat->category[0] == '\0')
+    {
+        strncpy(stat->category, category, CATEGORY_NAME_MAX-1);
+        stat->category[CATEGORY_NAME_MAX-1] = '\0';
     }
-    model_net_write_stats(lpid, &all);
+    return(stat);
 }
 
-struct mn_stats* model_net_find_stats(char const * category, mn_stats mn_stats_array[])
+/* gather the per-category totals of every PE on rank 0 (matched up by
+ * name, since category ids are PE-local) and print them */
+static void model_net_reduce_category_stats(void)
 {
-    int i;
-    int new_flag = 0;
-    int found_flag = 0;
+    struct mn_stats *local, *all_stats = NULL;
+    int *counts = NULL, *displs = NULL;
+    int i, n = 0, total = 0, nranks, rank;
+    mn_stats_table merged;
+    struct mn_stats all;
+
+    MPI_Comm_rank(MPI_COMM_CODES, &rank);
+    MPI_Comm_size(MPI_COMM_CODES, &nranks);
 
-    for(i=0; i<CATEGORY_MAX; i++)
+    local = malloc((pe_stats.count + 1) * sizeof(*local));
+    assert(local);
+    for(i = 0; i < pe_stats.count; i++)
     {
-        if(strlen(mn_stats_array[i].category) == 0)
-        {
-            found_flag = 1;
-            new_flag = 1;
-            break;
-        }
-        if(strcmp(category, mn_stats_array[i].category) == 0)
+        if(pe_stats.stats[i].category[0] != '\0')
+            local[n++] = pe_stats.stats[i];
+    }
+    n *= sizeof(*local);
+
+    if(rank == 0)
+    {
+        counts = malloc(nranks * sizeof(*counts));
+        displs = malloc(nranks * sizeof(*displs));
+        assert(counts && displs);
+    }
+    MPI_Gather(&n, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_CODES);
+    if(rank == 0)
+    {
+        for(i = 0; i < nranks; i++)
         {
-            found_flag = 1;
-            new_flag = 0;
-            break;
+            displs[i] = total;
+            total += counts[i];
         }
+        all_stats = malloc(total > 0 ? total : 1);
+        assert(all_stats);
     }
-    assert(found_flag);
+    MPI_Gatherv(local, n, MPI_BYTE, all_stats, counts, displs, MPI_BYTE, 0,
+            MPI_COMM_CODES);
+    free(local);
 
-    if(new_flag)
+    if(rank == 0)
     {
-        strcpy(mn_stats_array[i].category, category);
+        memset(&merged, 0, sizeof(merged));
+        memset(&all, 0, sizeof(all));
+        for(i = 0; i < total / (int)sizeof(*all_stats); i++)
+            mn_stats_add(model_net_find_stats(all_stats[i].category, &merged),
+                    &all_stats[i]);
+        for(i = 0; i < merged.count; i++)
+        {
+            struct mn_stats *s = &merged.stats[i];
+            if(s->category[0] == '\0')
+                continue;
+            printf("model-net category %s: send_count %ld send_bytes %ld "
+                    "send_time %f recv_count %ld recv_bytes %ld recv_time %f "
+                    "max_event_size %ld\n", s->category, s->send_count,
+                    s->send_bytes, s->send_time, s->recv_count,
+                    s->recv_bytes, s->recv_time, s->max_event_size);
+            mn_stats_add(&all, s);
+        }
+        if(merged.count > 0)
+            printf("model-net category all: send_count %ld send_bytes %ld "
+                    "send_time %f recv_count %ld recv_bytes %ld recv_time %f "
+                    "max_event_size %ld\n", all.send_count, all.send_bytes,
+                    all.send_time, all.recv_count, all.recv_bytes,
+                    all.recv_time, all.max_event_size);
+        free(merged.stats);
+        free(all_stats);
+        free(counts);
+        free(displs);
     }
-    return(&mn_stats_array[i]);
+}
+
+// report the per-packet cost of the priority schedulers, if any were used
+static void model_net_reduce_sched_cost(void)
+{
+    mn_sched_cost local;
+    uint64_t in[2], out[2];
+    int rank;
+
+    MPI_Comm_rank(MPI_COMM_CODES, &rank);
+    model_net_sched_get_prio_cost(&local);
+    in[0] = local.next_calls;
+    in[1] = local.words_scanned;
+    MPI_Reduce(in, out, 2, MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_CODES);
+    if(rank == 0 && out[0] > 0)
+        printf("model-net priority scheduler: %llu next calls, "
+                "%.3f bitmap words scanned per call\n", LLU(out[0]),
+                (double)out[1] / out[0]);
 }
 
 static model_net_event_return model_net_noop_event(
@@ -364,6 +438,8 @@ static model_net_event_return model_net_event_impl_base(
         r->pull_size = 0;
     }
     r->net_id = net_id;
+    r->trace = model_net_trace_select(sender->gid, final_dest_lp,
+            tw_now(sender));
     r->remote_event_size = remote_event_size;
     r->self_event_size = self_event_size;
     strncpy(r->category, category, CATEGORY_NAME_MAX-1);
@@ -651,6 +727,17 @@ void model_net_report_stats(int net_id)
      // TODO: ADd checks by network names
      //    // Add dragonfly and torus network models
    method_array[net_id]->mn_report_stats();
+
+   // category stats and sample files cover every network, so only reduce
+   // them once
+   if(!pe_stats_reported)
+   {
+       pe_stats_reported = 1;
+       model_net_reduce_category_stats();
+       model_net_reduce_sched_cost();
+       model_net_link_summary_report();
+       model_net_sample_sinks_close();
+   }
    return;
 }
 
@@ -209,7 +209,7 @@ struct terminal_state
 // Terminal generate, sends and arrival T_SEND, T_ARRIVAL, T_GENERATE
 // Router-Router Intra-group sends and receives RR_LSEND, RR_LARRIVE
 // Router-Router Inter-group sends and receives RR_GSEND, RR_GARRIVE
-   struct mn_stats dragonfly_stats_array[CATEGORY_MAX];
+   mn_stats_table dragonfly_stats_array;
   /* collective init time */
   tw_stime collective_init_time;
 
@@ -1271,7 +1271,7 @@ static void packet_generate_rc(terminal_state * s, tw_bf * bf, terminal_message
         }
       }
      struct mn_stats* stat;
-     stat = model_net_find_stats(msg->category, s->dragonfly_stats_array);
+     stat = model_net_find_stats(msg->category, &s->dragonfly_stats_array);
      stat->send_count--;
      stat->send_bytes -= msg->packet_size;
      stat->send_time -= (1/s->params->cn_bandwidth) * msg->packet_size;
@@ -1369,7 +1369,7 @@ static void packet_generate(terminal_state * s, tw_bf * bf, terminal_message * m
   total_event_size = model_net_get_msg_sz(DRAGONFLY) + 
       msg->remote_event_size_bytes + msg->local_event_size_bytes;
   mn_stats* stat;
-  stat = model_net_find_stats(msg->category, s->dragonfly_stats_array);
+  stat = model_net_find_stats(msg->category, &s->dragonfly_stats_array);
   stat->send_count++;
   stat->send_bytes += msg->packet_size;
   stat->send_time += (1/p->cn_bandwidth) * msg->packet_size;
@@ -1592,7 +1592,7 @@ static void packet_arrive_rc(terminal_state * s, tw_bf * bf, terminal_message *
       tmp = qhash_entry(hash_link, struct dfly_qhash_entry, hash_link);
       
       mn_stats* stat;
-      stat = model_net_find_stats(msg->category, s->dragonfly_stats_array);
+      stat = model_net_find_stats(msg->category, &s->dragonfly_stats_array);
       stat->recv_time = msg->saved_rcv_time;
 
       if(bf->c1)
@@ -1786,7 +1786,7 @@ static void packet_arrive(terminal_state * s, tw_bf * bf, terminal_message * msg
     s->ross_sample.fin_hops_sample += msg->my_N_hop;
     s->fin_hops_ross_sample += msg->my_N_hop;
 
-    mn_stats* stat = model_net_find_stats(msg->category, s->dragonfly_stats_array);
+    mn_stats* stat = model_net_find_stats(msg->category, &s->dragonfly_stats_array);
     msg->saved_rcv_time = stat->recv_time;
     stat->recv_time += (tw_now(lp) - msg->travel_start_time);
 
@@ -2626,7 +2626,7 @@ static void
 dragonfly_terminal_final( terminal_state * s, 
       tw_lp * lp )
 {
-	model_net_print_stats(lp->gid, s->dragonfly_stats_array);
+	model_net_print_stats(lp->gid, &s->dragonfly_stats_array);
   
     if(s->terminal_id == 0)
     {
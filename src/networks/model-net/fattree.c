@@ -199,7 +199,7 @@ struct ft_terminal_state
   int *vc_occupancy; // NUM_VC
   tw_stime* terminal_available_time;
 
-  struct mn_stats fattree_stats_array[CATEGORY_MAX];
+  mn_stats_table fattree_stats_array;
 
   fattree_message_list **terminal_msgs;
   fattree_message_list **terminal_msgs_tail;
@@ -1625,7 +1625,7 @@ void ft_packet_generate_rc(ft_terminal_state * s, tw_bf * bf, fattree_message *
     }
 
     struct mn_stats* stat;
-    stat = model_net_find_stats(msg->category, s->fattree_stats_array);
+    stat = model_net_find_stats(msg->category, &s->fattree_stats_array);
     stat->send_count--;
     stat->send_bytes -= msg->packet_size;
     stat->send_time -= (1/s->params->link_bandwidth) * msg->packet_size;
@@ -1725,7 +1725,7 @@ void ft_packet_generate(ft_terminal_state * s, tw_bf * bf, fattree_message * msg
   total_event_size = model_net_get_msg_sz(FATTREE) +
     msg->remote_event_size_bytes+ msg->local_event_size_bytes;
   mn_stats* stat;
-  stat = model_net_find_stats(msg->category, s->fattree_stats_array);
+  stat = model_net_find_stats(msg->category, &s->fattree_stats_array);
   stat->send_count++;
   stat->send_bytes += msg->packet_size;
   stat->send_time += (1/p->link_bandwidth) * msg->packet_size;
@@ -2420,7 +2420,7 @@ void ft_packet_arrive_rc(ft_terminal_state * s, tw_bf * bf, fattree_message * ms
     tmp = qhash_entry(hash_link, struct ftree_qhash_entry, hash_link);
 
     mn_stats* stat;
-    stat = model_net_find_stats(msg->category, s->fattree_stats_array);
+    stat = model_net_find_stats(msg->category, &s->fattree_stats_array);
     stat->recv_time = msg->saved_rcv_time;
 
     if(bf->c1)
@@ -2552,7 +2552,7 @@ void ft_packet_arrive(ft_terminal_state * s, tw_bf * bf, fattree_message * msg,
     s->total_hops += msg->my_N_hop;
     s->fin_hops_sample += msg->my_N_hop;
 
-    mn_stats* stat = model_net_find_stats(msg->category, s->fattree_stats_array);
+    mn_stats* stat = model_net_find_stats(msg->category, &s->fattree_stats_array);
     msg->saved_rcv_time = stat->recv_time;
     stat->recv_time += (tw_now(lp) - msg->travel_start_time);
 
@@ -2787,7 +2787,7 @@ void ft_terminal_event( ft_terminal_state * s, tw_bf * bf, fattree_message * msg
 void fattree_terminal_final( ft_terminal_state * s, tw_lp * lp )
 {
     if(dump_topo) return;
-    model_net_print_stats(lp->gid, s->fattree_stats_array);
+    model_net_print_stats(lp->gid, &s->fattree_stats_array);
 
     int written = 0;
     if(!s->terminal_id && !s->rail_id)
@@ -17,10 +17,10 @@
 #include "codes/model-net-sched.h"
 #include "codes/codes_mapping.h"
 #include "codes/codes.h"
+#include "codes/codes-size-index.h"
 #include "codes/net/loggp.h"
 
 #define CATEGORY_NAME_MAX 16
-#define CATEGORY_MAX 12
 
 #define LP_CONFIG_NM (model_net_lp_config_names[LOGGP])
 #define LP_METHOD_NM (model_net_method_names[LOGGP])
@@ -63,7 +63,20 @@ typedef struct loggp_param loggp_param;
 struct loggp_param
 {
     int table_size;
-    param_table_entry table[100];
+    param_table_entry *table;
+    /* direct index over the table sizes, built once at configure time */
+    struct codes_size_index size_idx;
+    /* interpolate between the two nearest measured sizes instead of using
+     * the parameters of the next larger one */
+    int interpolate;
+};
+
+/* the parameters used to model a message of a particular size */
+struct loggp_msg_params
+{
+    double L;
+    double g;
+    double G;
 };
 
 
@@ -74,7 +87,7 @@ struct loggp_state
     tw_stime net_recv_next_idle;
     const char * anno;
     const loggp_param *params;
-    struct mn_stats loggp_stats_array[CATEGORY_MAX];
+    mn_stats_table loggp_stats_array;
 };
 
 /* annotation-specific parameters (unannotated entry occurs at the
@@ -139,9 +152,10 @@ void loggp_recv_msg_event_rc(tw_lp *sender);
 
 static void loggp_report_stats();
 
-static const struct param_table_entry* find_params(
+static void find_params(
         uint64_t msg_size,
-        const loggp_param *params);
+        const loggp_param *params,
+        struct loggp_msg_params *out);
 
 /* data structure for model-net statistics */
 struct model_net_method loggp_method =
@@ -322,7 +336,7 @@ static void loggp_finalize(
     loggp_state * ns,
     tw_lp * lp)
 {
-    model_net_print_stats(lp->gid, &ns->loggp_stats_array[0]);
+    model_net_print_stats(lp->gid, &ns->loggp_stats_array);
     return;
 }
 
@@ -348,7 +362,7 @@ static void handle_msg_ready_rev_event(
 
     ns->net_recv_next_idle = m->net_recv_next_idle_saved;
 
-    stat = model_net_find_stats(m->category, ns->loggp_stats_array);
+    stat = model_net_find_stats(m->category, &ns->loggp_stats_array);
     stat->recv_count--;
     stat->recv_bytes -= m->net_msg_size_bytes;
     stat->recv_time -= m->recv_time_saved;
@@ -377,18 +391,18 @@ static void handle_msg_ready_event(
     loggp_message *m_new;
     struct mn_stats* stat;
     double recv_time;
-    const struct param_table_entry *param;
+    struct loggp_msg_params param;
 
-    param = find_params(m->net_msg_size_bytes, ns->params);
+    find_params(m->net_msg_size_bytes, ns->params, &param);
 
-    recv_time = ((double)(m->net_msg_size_bytes-1)*param->G);
+    recv_time = ((double)(m->net_msg_size_bytes-1)*param.G);
     /* scale to nanoseconds */
     recv_time *= 1000.0;
     m->recv_time_saved = recv_time;
 
     //printf("handle_msg_ready_event(), lp %llu.\n", (unsigned long long)lp->gid);
     /* add statistics */
-    stat = model_net_find_stats(m->category, ns->loggp_stats_array);
+    stat = model_net_find_stats(m->category, &ns->loggp_stats_array);
     stat->recv_count++;
     stat->recv_bytes += m->net_msg_size_bytes;
     stat->recv_time += recv_time;
@@ -403,7 +417,7 @@ static void handle_msg_ready_event(
 
     /* bump up input queue idle time accordingly, include gap (g) parameter */
     m->net_recv_next_idle_saved = ns->net_recv_next_idle;
-    ns->net_recv_next_idle = recv_queue_time + tw_now(lp) + param->g*1000.0;
+    ns->net_recv_next_idle = recv_queue_time + tw_now(lp) + param.g*1000.0;
 
     dprintf("%lu (mn): ready msg    %lu->%lu, size %lu (%3s last)\n"
             "          now:%0.3le, idle[prev:%0.3le, next:%0.3le], "
@@ -478,7 +492,7 @@ static void handle_msg_start_rev_event(
     }
 
     mn_stats* stat;
-    stat = model_net_find_stats(m->category, ns->loggp_stats_array);
+    stat = model_net_find_stats(m->category, &ns->loggp_stats_array);
     stat->send_count--;
     stat->send_bytes -= m->net_msg_size_bytes;
     stat->send_time -= m->xmit_time_saved;
@@ -500,9 +514,9 @@ static void handle_msg_start_event(
     mn_stats* stat;
     int total_event_size;
     double xmit_time;
-    const struct param_table_entry *param;
+    struct loggp_msg_params param;
 
-    param = find_params(m->net_msg_size_bytes, ns->params);
+    find_params(m->net_msg_size_bytes, ns->params, &param);
 
     total_event_size = model_net_get_msg_sz(LOGGP) + m->event_size_bytes +
         m->local_event_size_bytes;
@@ -512,14 +526,14 @@ static void handle_msg_start_event(
      * msg xfer as well) and therefore are more important for overlapping
      * computation rather than simulating communication time.
      */
-    xmit_time = ((double)(m->net_msg_size_bytes-1)*param->G);
+    xmit_time = ((double)(m->net_msg_size_bytes-1)*param.G);
     /* scale to nanoseconds */
     xmit_time *= 1000.0;
     m->xmit_time_saved = xmit_time;
 
     //printf("handle_msg_start_event(), lp %llu.\n", (unsigned long long)lp->gid);
     /* add statistics */
-    stat = model_net_find_stats(m->category, ns->loggp_stats_array);
+    stat = model_net_find_stats(m->category, &ns->loggp_stats_array);
     stat->send_count++;
     stat->send_bytes += m->net_msg_size_bytes;
     stat->send_time += xmit_time;
@@ -527,7 +541,7 @@ static void handle_msg_start_event(
         stat->max_event_size = total_event_size;
 
     /* calculate send time stamp */
-    send_queue_time = (param->L)*1000.0;
+    send_queue_time = (param.L)*1000.0;
     /* bump up time if the NIC send queue isn't idle right now */
     if(ns->net_send_next_idle > tw_now(lp))
         send_queue_time += ns->net_send_next_idle - tw_now(lp);
@@ -539,7 +553,7 @@ static void handle_msg_start_event(
     m->net_send_next_idle_saved = ns->net_send_next_idle;
     if(ns->net_send_next_idle < tw_now(lp))
         ns->net_send_next_idle = tw_now(lp);
-    ns->net_send_next_idle += xmit_time + param->g*1000.0;
+    ns->net_send_next_idle += xmit_time + param.g*1000.0;
 
     dprintf("%lu (mn): start msg    %lu->%lu, size %lu (%3s last)\n"
             "          now:%0.3le, idle[prev:%0.3le, next:%0.3le], "
@@ -714,31 +728,47 @@ void loggp_recv_msg_event_rc(tw_lp *sender){
 }
 
 static void loggp_configure(){
-    char config_file[MAX_NAME_LENGTH];
+    char (*config_files)[MAX_NAME_LENGTH];
 
     anno_map = codes_mapping_get_lp_anno_map(LP_CONFIG_NM);
     assert(anno_map);
     num_params = anno_map->num_annos + (anno_map->has_unanno_lp > 0);
     all_params = malloc(num_params * sizeof(*all_params));
+    config_files = malloc(num_params * sizeof(*config_files));
+    assert(all_params && config_files);
 
-    for (int i = 0; i < anno_map->num_annos; i++){
-        const char * anno = anno_map->annotations[i].ptr;
+    for (uint64_t i = 0; i < num_params; i++){
+        /* the unannotated entry (if any) is last */
+        const char * anno = (int)i < anno_map->num_annos ?
+            anno_map->annotations[i].ptr : NULL;
         int rc = configuration_get_value_relpath(&config, "PARAMS",
-                "net_config_file", anno, config_file, MAX_NAME_LENGTH);
+                "net_config_file", anno, config_files[i], MAX_NAME_LENGTH);
         if (rc <= 0){
-            tw_error(TW_LOC, "unable to read PARAMS:net_config_file@%s",
-                    anno);
+            if (anno)
+                tw_error(TW_LOC, "unable to read PARAMS:net_config_file@%s",
+                        anno);
+            else
+                tw_error(TW_LOC, "unable to read PARAMS:net_config_file");
         }
-        loggp_set_params(config_file, &all_params[i]);
-    }
-    if (anno_map->has_unanno_lp > 0){
-        int rc = configuration_get_value_relpath(&config, "PARAMS",
-                "net_config_file", NULL, config_file, MAX_NAME_LENGTH);
-        if (rc <= 0){
-            tw_error(TW_LOC, "unable to read PARAMS:net_config_file");
+
+        /* annotations commonly share a netgauge file; parse and index
+         * each file only once and share the (read-only) table */
+        uint64_t j;
+        for (j = 0; j < i; j++){
+            if (strcmp(config_files[i], config_files[j]) == 0)
+                break;
         }
-        loggp_set_params(config_file, &all_params[anno_map->num_annos]);
+        if (j < i)
+            all_params[i] = all_params[j];
+        else
+            loggp_set_params(config_files[i], &all_params[i]);
+
+        rc = configuration_get_value_int(&config, "PARAMS",
+                "loggp_interpolate", anno, &all_params[i].interpolate);
+        if (rc)
+            all_params[i].interpolate = 0;
     }
+    free(config_files);
 }
 
 void loggp_set_params(const char * config_file, loggp_param * params){
@@ -755,12 +785,21 @@ void loggp_set_params(const char * config_file, loggp_param * params){
         assert(0);
     }
 
+    int table_cap = 0;
     params->table_size = 0;
+    params->table = NULL;
     while(fgets(buffer, 512, conf))
     {
         line_nr++;
         if(buffer[0] == '#')
             continue;
+        if(params->table_size == table_cap)
+        {
+            table_cap = table_cap ? 2 * table_cap : 64;
+            params->table = realloc(params->table,
+                    table_cap * sizeof(*params->table));
+            assert(params->table);
+        }
         ret = sscanf(buffer, "%"PRIu64" %d %lf %lf %lf %lf %lf %lf %lf %lf %lf",
             &params->table[params->table_size].size,
             &params->table[params->table_size].n,
@@ -786,6 +825,18 @@ void loggp_set_params(const char * config_file, loggp_param * params){
 
     fclose(conf);
 
+    if(params->table_size == 0)
+        tw_error(TW_LOC, "no loggp table entries found in %s", config_file);
+
+    uint64_t *sizes = malloc(params->table_size * sizeof(*sizes));
+    assert(sizes);
+    for(int i = 0; i < params->table_size; i++)
+        sizes[i] = params->table[i].size;
+    if(codes_size_index_init(&params->size_idx, sizes, params->table_size))
+        tw_error(TW_LOC, "loggp table sizes in %s are not sorted",
+                config_file);
+    free(sizes);
+
     return;
 }
 
@@ -797,26 +848,37 @@ static void loggp_packet_event_rc(tw_lp *sender)
 
 /* find the parameters corresponding to the message size we are transmitting
  */
-static const struct param_table_entry* find_params(
+static void find_params(
         uint64_t msg_size,
-        const loggp_param *params) {
+        const loggp_param *params,
+        struct loggp_msg_params *out) {
+    const struct param_table_entry *lo, *hi;
+    double w;
     int i;
 
-    /* pick parameters based on the next smallest size in the table, but
-     * default to beginning or end of table if we are out of range
-     */
-
-    for(i=0; i < params->table_size; i++)
+    if(params->interpolate)
     {
-        if(params->table[i].size > msg_size)
-        {
-            break;
-        }
+        /* interpolate between the measured sizes around msg_size,
+         * clamping to the ends of the table */
+        w = codes_size_index_interp(&params->size_idx, msg_size, &i);
+        lo = &params->table[i];
+        hi = w > 0.0 ? &params->table[i+1] : lo;
+        out->L = lo->L + w * (hi->L - lo->L);
+        out->g = lo->g + w * (hi->g - lo->g);
+        out->G = lo->G + w * (hi->G - lo->G);
+        return;
     }
+
+    /* pick parameters based on the next largest size in the table, but
+     * default to the end of table if we are out of range
+     */
+    i = codes_size_index_upper(&params->size_idx, msg_size);
     if(i>=params->table_size)
         i = params->table_size-1;
 
-    return(&params->table[i]);
+    out->L = params->table[i].L;
+    out->g = params->table[i].g;
+    out->G = params->table[i].G;
 }
 
 /*
@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+/* print a sample file written by the model-net sample sinks as text, one row
+ * per line */
+
+#include "codes_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+#include <zlib.h>
+#endif
+
+#include "codes/model-net-sample-sink.h"
+
+static void print_elem(uint32_t type, char const * p)
+{
+    int64_t i;
+    uint64_t u;
+    double d;
+
+    switch (type)
+    {
+        case MN_SAMPLE_INT64:
+            memcpy(&i, p, 8);
+            printf("%" PRId64, i);
+            break;
+        case MN_SAMPLE_UINT64:
+            memcpy(&u, p, 8);
+            printf("%" PRIu64, u);
+            break;
+        case MN_SAMPLE_DOUBLE:
+            memcpy(&d, p, 8);
+            printf("%.9g", d);
+            break;
+        default:
+            printf("?");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    struct mn_sample_file_header fh;
+    struct mn_sample_file_column * cols;
+    struct mn_sample_block_header bh;
+    char * desc, * stored, * raw;
+    size_t * col_off;
+    uint32_t c, k, r;
+    FILE * f;
+
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s <sample file>\n", argv[0]);
+        return 1;
+    }
+    f = fopen(argv[1], "rb");
+    if (!f)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    if (fread(&fh, sizeof(fh), 1, f) != 1 ||
+            memcmp(fh.magic, MN_SAMPLE_MAGIC, sizeof(fh.magic)) != 0)
+    {
+        fprintf(stderr, "%s: not a model-net sample file\n", argv[1]);
+        return 1;
+    }
+    if (fh.version != MN_SAMPLE_VERSION)
+    {
+        fprintf(stderr, "%s: unsupported version %u\n", argv[1], fh.version);
+        return 1;
+    }
+
+    cols = malloc(fh.ncols * sizeof(*cols));
+    col_off = malloc(fh.ncols * sizeof(*col_off));
+    desc = calloc(1, fh.desc_len + 1);
+    if (!cols || !col_off || !desc ||
+            fread(cols, sizeof(*cols), fh.ncols, f) != fh.ncols ||
+            fread(desc, 1, fh.desc_len, f) != fh.desc_len)
+    {
+        fprintf(stderr, "%s: truncated header\n", argv[1]);
+        return 1;
+    }
+
+    printf("# %s\n#", desc);
+    for (c = 0; c < fh.ncols; c++)
+    {
+        if (cols[c].count == 1)
+            printf(" %s", cols[c].name);
+        else
+            printf(" %s[%u]", cols[c].name, cols[c].count);
+    }
+    printf("\n");
+
+    fseek(f, fh.header_bytes, SEEK_SET);
+    while (fread(&bh, sizeof(bh), 1, f) == 1)
+    {
+        if (memcmp(bh.magic, MN_SAMPLE_BLK_MAGIC, sizeof(bh.magic)) != 0)
+        {
+            fprintf(stderr, "%s: corrupt block header\n", argv[1]);
+            return 1;
+        }
+        stored = malloc(bh.stored_bytes + 1);
+        raw = malloc(bh.raw_bytes + 1);
+        if (!stored || !raw ||
+                fread(stored, 1, bh.stored_bytes, f) != bh.stored_bytes)
+        {
+            fprintf(stderr, "%s: truncated block\n", argv[1]);
+            return 1;
+        }
+        if (bh.flags & MN_SAMPLE_COMPRESSED)
+        {
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+            uLongf len = bh.raw_bytes;
+            if (uncompress((Bytef*)raw, &len, (Bytef*)stored,
+                        bh.stored_bytes) != Z_OK || len != bh.raw_bytes)
+            {
+                fprintf(stderr, "%s: unable to decompress block\n", argv[1]);
+                return 1;
+            }
+#else
+            fprintf(stderr, "%s: compressed blocks require zlib\n", argv[1]);
+            return 1;
+#endif
+        }
+        else
+            memcpy(raw, stored, bh.raw_bytes);
+
+        col_off[0] = 0;
+        for (c = 1; c < fh.ncols; c++)
+            col_off[c] = col_off[c-1] + 8 * (size_t)cols[c-1].count * bh.nrows;
+
+        for (r = 0; r < bh.nrows; r++)
+        {
+            for (c = 0; c < fh.ncols; c++)
+            {
+                char const * p = raw + col_off[c] + 8 * (size_t)cols[c].count * r;
+                for (k = 0; k < cols[c].count; k++)
+                {
+                    if (c + k > 0)
+                        printf(" ");
+                    print_elem(cols[c].type, p + 8 * k);
+                }
+            }
+            printf("\n");
+        }
+        free(stored);
+        free(raw);
+        fseek(f, bh.block_bytes - sizeof(bh) - bh.stored_bytes, SEEK_CUR);
+    }
+
+    free(desc);
+    free(col_off);
+    free(cols);
+    fclose(f);
+    return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
@@ -18,7 +18,6 @@
 #include "codes/net/simplenet-upd.h"
 
 #define CATEGORY_NAME_MAX 16
-#define CATEGORY_MAX 12
 
 #define LP_CONFIG_NM (model_net_lp_config_names[SIMPLENET])
 #define LP_METHOD_NM (model_net_method_names[SIMPLENET])
@@ -41,7 +40,7 @@ struct sn_state
     tw_stime net_recv_next_idle;
     const char * anno;
     simplenet_param params;
-    struct mn_stats sn_stats_array[CATEGORY_MAX];
+    mn_stats_table sn_stats_array;
 };
 
 /* annotation-specific parameters (unannotated entry occurs at the
@@ -287,7 +286,7 @@ static void sn_finalize(
     sn_state * ns,
     tw_lp * lp)
 {
-    model_net_print_stats(lp->gid, &ns->sn_stats_array[0]);
+    model_net_print_stats(lp->gid, &ns->sn_stats_array);
     return;
 }
 
@@ -321,7 +320,7 @@ static void handle_msg_ready_rev_event(
 
     ns->net_recv_next_idle = m->net_recv_next_idle_saved;
 
-    stat = model_net_find_stats(m->category, ns->sn_stats_array);
+    stat = model_net_find_stats(m->category, &ns->sn_stats_array);
     stat->recv_count--;
     stat->recv_bytes -= m->net_msg_size_bytes;
     stat->recv_time = m->recv_time_saved;
@@ -346,7 +345,7 @@ static void handle_msg_ready_event(
 
     //printf("handle_msg_ready_event(), lp %llu.\n", (unsigned long long)lp->gid);
     /* add statistics */
-    stat = model_net_find_stats(m->category, ns->sn_stats_array);
+    stat = model_net_find_stats(m->category, &ns->sn_stats_array);
     stat->recv_count++;
     stat->recv_bytes += m->net_msg_size_bytes;
     m->recv_time_saved = stat->recv_time;
@@ -413,7 +412,7 @@ static void handle_msg_start_rev_event(
     }
 
     mn_stats* stat;
-    stat = model_net_find_stats(m->category, ns->sn_stats_array);
+    stat = model_net_find_stats(m->category, &ns->sn_stats_array);
     stat->send_count--;
     stat->send_bytes -= m->net_msg_size_bytes;
     stat->send_time = m->send_time_saved;
@@ -440,7 +439,7 @@ static void handle_msg_start_event(
 
     //printf("handle_msg_start_event(), lp %llu.\n", (unsigned long long)lp->gid);
     /* add statistics */
-    stat = model_net_find_stats(m->category, ns->sn_stats_array);
+    stat = model_net_find_stats(m->category, &ns->sn_stats_array);
     stat->send_count++;
     stat->send_bytes += m->net_msg_size_bytes;
     m->send_time_saved = stat->send_time;
@@ -6,6 +6,10 @@
 
 #include <string.h>
 #include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <ross.h>
 
 #include "codes/lp-io.h"
@@ -15,27 +19,67 @@
 #include "codes/model-net-lp.h"
 #include "codes/codes_mapping.h"
 #include "codes/codes.h"
+#include "codes/codes-category.h"
 #include "codes/net/simplep2p.h"
 
 #define CATEGORY_NAME_MAX 16
-#define CATEGORY_MAX 12
 
 #define SIMPLEP2P_DEBUG 0
 
 #define LP_CONFIG_NM (model_net_lp_config_names[SIMPLEP2P])
 #define LP_METHOD_NM (model_net_method_names[SIMPLEP2P])
 
+/* binary latency/bandwidth matrix files start with this header, followed by
+ * dim*dim (egress, ingress) pairs of doubles in row-major order. They are
+ * mapped rather than parsed */
+#define SP_BIN_MAGIC "SP2PMAT"
+#define SP_BIN_VERSION 1
+struct sp_bin_hdr
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t dim;
+};
+
 // parameters for simplep2p configuration
 struct simplep2p_param
 {
+    /* the tables are indexed by link class rather than by LP: LPs are
+     * assigned to classes (racks, pods, sites, ...) and all LPs of a class
+     * share the same row/column. Without a class mapping each LP is its own
+     * class */
     double * net_latency_ns_table;
     double * net_bw_mbps_table;
+    /* non-zero if the table points into a mapped file */
+    size_t latency_map_len;
+    size_t bw_map_len;
 
     int mat_len;
     int num_lps;
+    int num_classes;
+    /* explicit class of each LP (NULL: derived from class_block_size) */
+    int * lp_class;
+    /* LPs i*class_block_size .. (i+1)*class_block_size-1 form class i
+     * (1: each LP is its own class) */
+    int class_block_size;
 };
 typedef struct simplep2p_param simplep2p_param;
 
+/* next idle times of the links to the peers an LP has actually talked to,
+ * kept in a small open-addressed table keyed by the peer's relative id.
+ * Peers that are absent are idle since time 0. */
+struct sp_idle_ent
+{
+    int peer;
+    tw_stime next_idle;
+};
+struct sp_idle_map
+{
+    int count;
+    int cap;
+    struct sp_idle_ent *ents;
+};
+
 /*Define simplep2p data types and structs*/
 typedef struct sp_state sp_state;
 
@@ -48,14 +92,13 @@ struct category_idles_s{
     tw_stime send_prev_idle_all;
     tw_stime recv_next_idle_all;
     tw_stime recv_prev_idle_all;
-    char category[CATEGORY_NAME_MAX];
 };
 
 struct sp_state
 {
     /* next idle times for network card, both inbound and outbound */
-    tw_stime *send_next_idle;
-    tw_stime *recv_next_idle;
+    struct sp_idle_map send_next_idle;
+    struct sp_idle_map recv_next_idle;
 
     const char * anno;
     const simplep2p_param * params;
@@ -65,10 +108,11 @@ struct sp_state
     /* Each simplep2p "NIC" actually has N connections, so we need to track
      * idle times across all of them to correctly do stats.
      * Additionally need to track different idle times across different
-     * categories */
-    category_idles idle_times_cat[CATEGORY_MAX];
+     * categories, indexed by category id (same indexing as sp_stats_array) */
+    category_idles *idle_times_cat;
+    int num_idle_times_cat;
 
-    struct mn_stats sp_stats_array[CATEGORY_MAX];
+    mn_stats_table sp_stats_array;
 };
 
 /* annotation-specific parameters (unannotated entry occurs at the
@@ -106,15 +150,19 @@ static int sp_get_magic();
 /* given two simplep2p logical ids, do matrix lookups to get the point-to-point
  * latency/bandwidth */
 static double sp_get_table_ent(
+        const simplep2p_param * params,
         int      from_id,
         int      to_id,
 	int	 is_outgoing,
-        int      num_lps,
         double * table);
 
+/* returns the next idle time slot for a peer, adding the peer if needed.
+ * The pointer is only valid until the next insertion into the map */
+static tw_stime * sp_idle_get(struct sp_idle_map *map, int peer);
+
 /* category lookup */
 static category_idles* sp_get_category_idles(
-        char * category, category_idles *idles);
+        char const * category, sp_state *ns);
 
 /* collective network calls */
 static void simple_wan_collective();
@@ -301,6 +349,40 @@ static void fill_tri_mat(int N, double *mat, double *tri){
     }
 }
 
+/* map a binary matrix file. Returns the table, or NULL if the file is not in
+ * the binary format */
+static double * sp_map_bin_mat(const char * fname, int * dim, size_t * len){
+    struct sp_bin_hdr hdr;
+    struct stat st;
+    void *map;
+    int fd;
+
+    fd = open(fname, O_RDONLY);
+    if (fd < 0)
+        tw_error(TW_LOC, "simplep2p: unable to open %s", fname);
+    if (read(fd, &hdr, sizeof(hdr)) != (ssize_t)sizeof(hdr) ||
+            memcmp(hdr.magic, SP_BIN_MAGIC, sizeof(SP_BIN_MAGIC)) != 0){
+        close(fd);
+        return NULL;
+    }
+    if (hdr.version != SP_BIN_VERSION)
+        tw_error(TW_LOC, "simplep2p: %s: unsupported binary matrix version %u",
+                fname, hdr.version);
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size !=
+            sizeof(hdr) + 2 * (size_t)hdr.dim * hdr.dim * sizeof(double))
+        tw_error(TW_LOC, "simplep2p: %s: size doesn't match a %u x %u matrix",
+                fname, hdr.dim, hdr.dim);
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        tw_error(TW_LOC, "simplep2p: unable to map %s", fname);
+
+    *dim = hdr.dim;
+    *len = st.st_size;
+    return (double *)((char *)map + sizeof(hdr));
+}
+
 /* lets caller specify model parameters to use */
 static void sp_set_params(
         const char      * latency_fname,
@@ -309,6 +391,22 @@ static void sp_set_params(
     long int fsize_s, fsize_b;
     /* TODO: make this a run-time option */
     int is_tri_mat = 0;
+    int dim_s, dim_b;
+
+    params->net_latency_ns_table = sp_map_bin_mat(latency_fname, &dim_s,
+            &params->latency_map_len);
+    params->net_bw_mbps_table = sp_map_bin_mat(bw_fname, &dim_b,
+            &params->bw_map_len);
+    if (params->net_latency_ns_table && params->net_bw_mbps_table){
+        if (dim_s != dim_b)
+            tw_error(TW_LOC, "simplep2p: latency and bandwidth matrices "
+                    "differ in size (%d vs. %d)", dim_s, dim_b);
+        params->mat_len = 2 * dim_s;
+        return;
+    }
+    if (params->net_latency_ns_table || params->net_bw_mbps_table)
+        tw_error(TW_LOC, "simplep2p: latency and bandwidth matrices must "
+                "both be text or both be binary");
 
     /* slurp the files */
     FILE *sf = fopen(latency_fname, "r");
@@ -391,25 +489,14 @@ static void sp_init(
     /* inititalize global logical ID w.r.t. annotation */
     ns->id = codes_mapping_get_lp_relative_id(lp->gid, 0, 1);
 
-    /* all devices are idle to begin with */
-    ns->send_next_idle = malloc(ns->params->num_lps *
-            sizeof(ns->send_next_idle));
-    ns->recv_next_idle = malloc(ns->params->num_lps *
-            sizeof(ns->recv_next_idle));
-    tw_stime st = tw_now(lp);
-    int i;
-    for (i = 0; i < ns->params->num_lps; i++){
-        ns->send_next_idle[i] = st;
-        ns->recv_next_idle[i] = st;
-    }
+    /* all devices are idle to begin with; links are added to the idle maps
+     * as peers are contacted */
+    memset(&ns->send_next_idle, 0, sizeof(ns->send_next_idle));
+    memset(&ns->recv_next_idle, 0, sizeof(ns->recv_next_idle));
 
-    for (i = 0; i < CATEGORY_MAX; i++){
-        ns->idle_times_cat[i].send_next_idle_all = 0.0;
-        ns->idle_times_cat[i].send_prev_idle_all = 0.0;
-        ns->idle_times_cat[i].recv_next_idle_all = 0.0;
-        ns->idle_times_cat[i].recv_prev_idle_all = 0.0;
-        ns->idle_times_cat[i].category[0] = '\0';
-    }
+    /* per-category idle times are added as categories are seen */
+    ns->idle_times_cat = NULL;
+    ns->num_idle_times_cat = 0;
 
     return;
 }
@@ -470,15 +557,22 @@ static void sp_finalize(
      * until afterwards) */
     int i;
     for (i = 0;
-            i < CATEGORY_MAX && strlen(ns->idle_times_cat[i].category) > 0;
+            i < ns->num_idle_times_cat && i < ns->sp_stats_array.count;
             i++){
         category_idles *id = ns->idle_times_cat + i;
-        mn_stats       *st = ns->sp_stats_array + i;
+        mn_stats       *st = ns->sp_stats_array.stats + i;
+        if (st->category[0] == '\0')
+            continue;
         st->send_time += id->send_next_idle_all - id->send_prev_idle_all;
         st->recv_time += id->recv_next_idle_all - id->recv_prev_idle_all;
     }
 
-    model_net_print_stats(lp->gid, &ns->sp_stats_array[0]);
+    model_net_print_stats(lp->gid, &ns->sp_stats_array);
+    free(ns->send_next_idle.ents);
+    free(ns->recv_next_idle.ents);
+    free(ns->idle_times_cat);
+    ns->idle_times_cat = NULL;
+    ns->num_idle_times_cat = 0;
     return;
 }
 
@@ -511,13 +605,14 @@ static void handle_msg_ready_rev_event(
     struct mn_stats* stat;
     category_idles * idles;
 
-    stat = model_net_find_stats(m->category, ns->sp_stats_array);
+    stat = model_net_find_stats(m->category, &ns->sp_stats_array);
     stat->recv_count--;
     stat->recv_bytes -= m->net_msg_size_bytes;
     stat->recv_time = m->recv_time_saved;
 
-    ns->recv_next_idle[m->src_mn_rel_id] = m->recv_next_idle_saved;
-    idles = sp_get_category_idles(m->category, ns->idle_times_cat);
+    *sp_idle_get(&ns->recv_next_idle, m->src_mn_rel_id) =
+        m->recv_next_idle_saved;
+    idles = sp_get_category_idles(m->category, ns);
     idles->recv_next_idle_all = m->recv_next_idle_all_saved;
     idles->recv_prev_idle_all = m->recv_prev_idle_all_saved;
 
@@ -541,10 +636,12 @@ static void handle_msg_ready_event(
     struct mn_stats* stat;
 
     /* get source->me network stats */
-    double bw = sp_get_table_ent(m->src_mn_rel_id, ns->id,
-            1, ns->params->num_lps, ns->params->net_bw_mbps_table);
-    double latency = sp_get_table_ent(m->src_mn_rel_id, ns->id,
-            1, ns->params->num_lps, ns->params->net_latency_ns_table);
+    double bw = sp_get_table_ent(ns->params, m->src_mn_rel_id, ns->id,
+            1, ns->params->net_bw_mbps_table);
+    double latency = sp_get_table_ent(ns->params, m->src_mn_rel_id, ns->id,
+            1, ns->params->net_latency_ns_table);
+    tw_stime *recv_next_idle =
+        sp_idle_get(&ns->recv_next_idle, m->src_mn_rel_id);
 
    // printf("\n LP %d outgoing bandwidth with LP %d is %f ", ns->id, m->src_mn_rel_id, bw);
     if (bw <= 0.0 || latency < 0.0){
@@ -556,21 +653,21 @@ static void handle_msg_ready_event(
 
     /* are we available to recv the msg? */
     /* were we available when the transmission was started? */
-    if(ns->recv_next_idle[m->src_mn_rel_id] > tw_now(lp))
+    if(*recv_next_idle > tw_now(lp))
         recv_queue_time +=
-            ns->recv_next_idle[m->src_mn_rel_id] - tw_now(lp);
+            *recv_next_idle - tw_now(lp);
 
     /* calculate transfer time based on msg size and bandwidth */
     recv_queue_time += rate_to_ns(m->net_msg_size_bytes, bw);
 
     /* bump up input queue idle time accordingly */
-    m->recv_next_idle_saved = ns->recv_next_idle[m->src_mn_rel_id];
-    ns->recv_next_idle[m->src_mn_rel_id] = recv_queue_time + tw_now(lp);
+    m->recv_next_idle_saved = *recv_next_idle;
+    *recv_next_idle = recv_queue_time + tw_now(lp);
 
     /* get stats, save state (TODO: smarter save state than param dump?)  */
-    stat = model_net_find_stats(m->category, ns->sp_stats_array);
+    stat = model_net_find_stats(m->category, &ns->sp_stats_array);
     category_idles *idles =
-        sp_get_category_idles(m->category, ns->idle_times_cat);
+        sp_get_category_idles(m->category, ns);
     stat->recv_count++;
     stat->recv_bytes += m->net_msg_size_bytes;
     m->recv_time_saved = stat->recv_time;
@@ -580,7 +677,7 @@ static void handle_msg_ready_event(
 #if SIMPLEP2P_DEBUG
     printf("%d: from_id:%d now: %8.3lf next_idle_recv: %8.3lf\n",
             ns->id, m->src_mn_rel_id,
-            tw_now(lp), ns->recv_next_idle[m->src_mn_rel_id]);
+            tw_now(lp), *recv_next_idle);
     printf("%d: BEFORE all_idles_recv %8.3lf %8.3lf\n",
             ns->id,
             idles->recv_prev_idle_all, idles->recv_next_idle_all);
@@ -593,9 +690,9 @@ static void handle_msg_ready_event(
             idles->recv_next_idle_all - idles->recv_prev_idle_all;
         idles->recv_prev_idle_all = tw_now(lp);
     }
-    if (ns->recv_next_idle[m->src_mn_rel_id] > idles->recv_next_idle_all){
+    if (*recv_next_idle > idles->recv_next_idle_all){
         /* extend the active period (active until at least this request) */
-        idles->recv_next_idle_all = ns->recv_next_idle[m->src_mn_rel_id];
+        idles->recv_next_idle_all = *recv_next_idle;
     }
 
 #if SIMPLEP2P_DEBUG
@@ -649,14 +746,15 @@ static void handle_msg_start_rev_event(
     }
 
     mn_stats* stat;
-    stat = model_net_find_stats(m->category, ns->sp_stats_array);
+    stat = model_net_find_stats(m->category, &ns->sp_stats_array);
     stat->send_count--;
     stat->send_bytes -= m->net_msg_size_bytes;
     stat->send_time = m->send_time_saved;
 
     category_idles *idles =
-        sp_get_category_idles(m->category, ns->idle_times_cat);
-    ns->send_next_idle[m->dest_mn_rel_id] = m->send_next_idle_saved;
+        sp_get_category_idles(m->category, ns);
+    *sp_idle_get(&ns->send_next_idle, m->dest_mn_rel_id) =
+        m->send_next_idle_saved;
     idles->send_next_idle_all = m->send_next_idle_all_saved;
     idles->send_prev_idle_all = m->send_prev_idle_all_saved;
 
@@ -678,6 +776,7 @@ static void handle_msg_start_event(
     int total_event_size;
     int dest_rel_id;
     double bw, latency;
+    tw_stime *send_next_idle;
 
     total_event_size = model_net_get_msg_sz(SIMPLEP2P) + m->event_size_bytes +
         m->local_event_size_bytes;
@@ -686,10 +785,11 @@ static void handle_msg_start_event(
     m->dest_mn_rel_id = dest_rel_id;
 
     /* grab the link params */
-    bw = sp_get_table_ent(ns->id, dest_rel_id,
-            0, ns->params->num_lps, ns->params->net_bw_mbps_table);
-    latency = sp_get_table_ent(ns->id, dest_rel_id,
-            0, ns->params->num_lps, ns->params->net_latency_ns_table);
+    bw = sp_get_table_ent(ns->params, ns->id, dest_rel_id,
+            0, ns->params->net_bw_mbps_table);
+    latency = sp_get_table_ent(ns->params, ns->id, dest_rel_id,
+            0, ns->params->net_latency_ns_table);
+    send_next_idle = sp_idle_get(&ns->send_next_idle, dest_rel_id);
 
     //printf("\n LP %d incoming bandwidth with LP %d is %f ", ns->id, dest_rel_id, bw);
     if (bw <= 0.0 || latency < 0.0){
@@ -702,20 +802,20 @@ static void handle_msg_start_event(
     /* calculate send time stamp */
     send_queue_time = 0.0; /* net msg latency cost (negligible for this model) */
     /* bump up time if the NIC send queue isn't idle right now */
-    if(ns->send_next_idle[dest_rel_id] > tw_now(lp))
-        send_queue_time += ns->send_next_idle[dest_rel_id] - tw_now(lp);
+    if(*send_next_idle > tw_now(lp))
+        send_queue_time += *send_next_idle - tw_now(lp);
 
     /* move the next idle time ahead to after this transmission is
      * _complete_ from the sender's perspective
      */
-    m->send_next_idle_saved = ns->send_next_idle[dest_rel_id];
-    ns->send_next_idle[dest_rel_id] = send_queue_time + tw_now(lp) +
+    m->send_next_idle_saved = *send_next_idle;
+    *send_next_idle = send_queue_time + tw_now(lp) +
         rate_to_ns(m->net_msg_size_bytes, bw);
 
     /* get stats, save state (TODO: smarter save state than param dump?)  */
-    stat = model_net_find_stats(m->category, ns->sp_stats_array);
+    stat = model_net_find_stats(m->category, &ns->sp_stats_array);
     category_idles *idles =
-        sp_get_category_idles(m->category, ns->idle_times_cat);
+        sp_get_category_idles(m->category, ns);
     stat->send_count++;
     stat->send_bytes += m->net_msg_size_bytes;
     m->send_time_saved = stat->send_time;
@@ -727,7 +827,7 @@ static void handle_msg_start_event(
 #if SIMPLEP2P_DEBUG
     printf("%d: to_id:%d now: %8.3lf next_idle_send: %8.3lf\n",
             ns->id, dest_rel_id,
-            tw_now(lp), ns->send_next_idle[dest_rel_id]);
+            tw_now(lp), *send_next_idle);
     printf("%d: BEFORE all_idles_send %8.3lf %8.3lf\n",
             ns->id, idles->send_prev_idle_all, idles->send_next_idle_all);
 #endif
@@ -738,9 +838,9 @@ static void handle_msg_start_event(
         stat->send_time += idles->send_next_idle_all - idles->send_prev_idle_all;
         idles->send_prev_idle_all = tw_now(lp);
     }
-    if (ns->send_next_idle[dest_rel_id] > idles->send_next_idle_all){
+    if (*send_next_idle > idles->send_next_idle_all){
         /* extend the active period (active until at least this request) */
-        idles->send_next_idle_all = ns->send_next_idle[dest_rel_id];
+        idles->send_next_idle_all = *send_next_idle;
     }
 
 #if SIMPLEP2P_DEBUG
@@ -862,9 +962,31 @@ static tw_stime simplep2p_packet_event(
      return xfer_to_nic_time;
 }
 
+/* reads the class of each LP, given as whitespace separated integers in LP
+ * order. Returns the number of classes */
+static int sp_read_class_file(const char * fname, simplep2p_param *p){
+    FILE *f = fopen(fname, "r");
+    int i, max_cls = -1;
+
+    if (!f)
+        tw_error(TW_LOC, "simplep2p: unable to open %s", fname);
+    p->lp_class = malloc(p->num_lps * sizeof(*p->lp_class));
+    assert(p->lp_class);
+    for (i = 0; i < p->num_lps; i++){
+        if (fscanf(f, "%d", &p->lp_class[i]) != 1 || p->lp_class[i] < 0)
+            tw_error(TW_LOC, "simplep2p: %s: expected a class for each of "
+                    "the %d LPs", fname, p->num_lps);
+        if (p->lp_class[i] > max_cls)
+            max_cls = p->lp_class[i];
+    }
+    fclose(f);
+    return max_cls + 1;
+}
+
 static void sp_read_config(const char * anno, simplep2p_param *p){
     char latency_file[MAX_NAME_LENGTH];
     char bw_file[MAX_NAME_LENGTH];
+    char class_file[MAX_NAME_LENGTH];
     int rc;
     rc = configuration_get_value_relpath(&config, "PARAMS",
             "net_latency_ns_file", anno, latency_file, MAX_NAME_LENGTH);
@@ -890,11 +1012,29 @@ static void sp_read_config(const char * anno, simplep2p_param *p){
     }
     p->num_lps = codes_mapping_get_lp_count(NULL, 0,
             LP_CONFIG_NM, anno, 0);
+
+    /* optional link classes: either an explicit per-LP class file or
+     * contiguous blocks of LPs */
+    p->lp_class = NULL;
+    p->class_block_size = 1;
+    rc = configuration_get_value_relpath(&config, "PARAMS", "net_class_file",
+            anno, class_file, MAX_NAME_LENGTH);
+    if (rc > 0)
+        p->num_classes = sp_read_class_file(class_file, p);
+    else{
+        rc = configuration_get_value_int(&config, "PARAMS",
+                "net_class_block_size", anno, &p->class_block_size);
+        if (rc || p->class_block_size < 1)
+            p->class_block_size = 1;
+        p->num_classes = (p->num_lps + p->class_block_size - 1) /
+            p->class_block_size;
+    }
+
     sp_set_params(latency_file, bw_file, p);
-    if (p->mat_len != (2 * p->num_lps)){
+    if (p->mat_len != (2 * p->num_classes)){
         tw_error(TW_LOC, "simplep2p config matrix doesn't match the "
-                "number of simplep2p LPs (%d vs. %d)\n",
-                p->mat_len, p->num_lps);
+                "number of simplep2p link classes (%d vs. %d, %d LPs)\n",
+                p->mat_len, p->num_classes, p->num_lps);
     }
 }
 
@@ -917,41 +1057,83 @@ static void simplep2p_packet_event_rc(tw_lp *sender)
     return;
 }
 
+static inline int sp_get_class(const simplep2p_param * params, int id){
+    if (params->lp_class)
+        return params->lp_class[id];
+    return id / params->class_block_size;
+}
+
 static double sp_get_table_ent(
+        const simplep2p_param * params,
         int      from_id,
         int      to_id,
 	int 	 is_incoming, /* chooses between incoming and outgoing bandwidths */
-        int      num_lps,
         double * table){
     // TODO: if a tri-matrix, then change the addressing
-    return table[2 * from_id * num_lps + 2 * to_id + is_incoming];
+    int from_cls = sp_get_class(params, from_id);
+    int to_cls = sp_get_class(params, to_id);
+    return table[2 * (size_t)from_cls * params->num_classes + 2 * to_cls
+        + is_incoming];
 }
 
-/* category lookup (more or less copied from model_net_find_stats) */
-static category_idles* sp_get_category_idles(
-        char * category, category_idles *idles){
-    int i;
-    int new_flag = 0;
-    int found_flag = 0;
+/* multiplicative hash; relative ids are dense so this spreads them well */
+static inline uint32_t sp_idle_hash(int peer){
+    return (uint32_t)peer * 2654435761u;
+}
 
-    for(i=0; i<CATEGORY_MAX; i++) {
-        if(strlen(idles[i].category) == 0) {
-            found_flag = 1;
-            new_flag = 1;
-            break;
-        }
-        if(strcmp(category, idles[i].category) == 0) {
-            found_flag = 1;
-            new_flag = 0;
-            break;
+static tw_stime * sp_idle_get(struct sp_idle_map *map, int peer){
+    uint32_t mask, i;
+
+    /* keep the load factor under 1/2 */
+    if (2 * (map->count + 1) > map->cap){
+        struct sp_idle_ent *old = map->ents;
+        int old_cap = map->cap, j;
+
+        map->cap = map->cap ? 2 * map->cap : 8;
+        map->ents = malloc(map->cap * sizeof(*map->ents));
+        assert(map->ents);
+        for (j = 0; j < map->cap; j++)
+            map->ents[j].peer = -1;
+        mask = map->cap - 1;
+        for (j = 0; j < old_cap; j++){
+            if (old[j].peer < 0)
+                continue;
+            i = sp_idle_hash(old[j].peer) & mask;
+            while (map->ents[i].peer >= 0)
+                i = (i + 1) & mask;
+            map->ents[i] = old[j];
         }
+        free(old);
     }
-    assert(found_flag);
 
-    if(new_flag) {
-        strcpy(idles[i].category, category);
+    mask = map->cap - 1;
+    i = sp_idle_hash(peer) & mask;
+    while (map->ents[i].peer >= 0){
+        if (map->ents[i].peer == peer)
+            return &map->ents[i].next_idle;
+        i = (i + 1) & mask;
+    }
+    map->ents[i].peer = peer;
+    map->ents[i].next_idle = 0.0;
+    map->count++;
+    return &map->ents[i].next_idle;
+}
+
+/* category lookup, indexed by interned category id */
+static category_idles* sp_get_category_idles(
+        char const * category, sp_state *ns){
+    int id = codes_category_id(category);
+
+    if (id >= ns->num_idle_times_cat) {
+        int cnt = codes_category_count();
+        ns->idle_times_cat = realloc(ns->idle_times_cat,
+                cnt * sizeof(*ns->idle_times_cat));
+        assert(ns->idle_times_cat);
+        memset(ns->idle_times_cat + ns->num_idle_times_cat, 0,
+                (cnt - ns->num_idle_times_cat) * sizeof(*ns->idle_times_cat));
+        ns->num_idle_times_cat = cnt;
     }
-    return &idles[i];
+    return &ns->idle_times_cat[id];
 }
 
 /*
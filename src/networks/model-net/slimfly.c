@@ -206,7 +206,7 @@ struct terminal_state
     // Terminal generate, sends and arrival T_SEND, T_ARRIVAL, T_GENERATE
     // Router-Router Intra-group sends and receives RR_LSEND, RR_LARRIVE
     // Router-Router Inter-group sends and receives RR_GSEND, RR_GARRIVE
-    struct mn_stats slimfly_stats_array[CATEGORY_MAX];
+    mn_stats_table slimfly_stats_array;
 
     struct rc_stack * st;
     int *issueIdle;
@@ -1330,7 +1330,7 @@ void slim_packet_generate_rc(terminal_state * s, tw_bf * bf, slim_terminal_messa
     buff_time_storage_delete(bts);
 
     struct mn_stats* stat;
-    stat = model_net_find_stats(msg->category, s->slimfly_stats_array);
+    stat = model_net_find_stats(msg->category, &s->slimfly_stats_array);
     stat->send_count--;
     stat->send_bytes -= msg->packet_size;
     stat->send_time -= (1/s->params->cn_bandwidth) * msg->packet_size;
@@ -1526,7 +1526,7 @@ void slim_packet_generate(terminal_state * s, tw_bf * bf, slim_terminal_message
     total_event_size = model_net_get_msg_sz(SLIMFLY) +
         msg->remote_event_size_bytes + msg->local_event_size_bytes;
     mn_stats* stat;
-    stat = model_net_find_stats(msg->category, s->slimfly_stats_array);
+    stat = model_net_find_stats(msg->category, &s->slimfly_stats_array);
     stat->send_count++;
     stat->send_bytes += msg->packet_size;
     stat->send_time += (1/p->cn_bandwidth) * msg->packet_size;
@@ -1798,7 +1798,7 @@ void slim_packet_arrive_rc(terminal_state * s, tw_bf * bf, slim_terminal_message
     tmp = qhash_entry(hash_link, struct sfly_qhash_entry, hash_link);
 
     mn_stats* stat;
-    stat = model_net_find_stats(msg->category, s->slimfly_stats_array);
+    stat = model_net_find_stats(msg->category, &s->slimfly_stats_array);
     stat->recv_time -= (tw_now(lp) - msg->travel_start_time);
 
     if(bf->c1)
@@ -1944,7 +1944,7 @@ void slim_packet_arrive(terminal_state * s, tw_bf * bf, slim_terminal_message *
     total_hops += msg->my_N_hop;
     s->total_hops += msg->my_N_hop;
 
-    mn_stats* stat = model_net_find_stats(msg->category, s->slimfly_stats_array);
+    mn_stats* stat = model_net_find_stats(msg->category, &s->slimfly_stats_array);
     stat->recv_time += (tw_now(lp) - msg->travel_start_time);
 
 #if DEBUG
@@ -2132,7 +2132,7 @@ void slimfly_terminal_final( terminal_state * s,
 {
     // printf("slim terminal final\n");
 
-    model_net_print_stats(lp->gid, s->slimfly_stats_array);
+    model_net_print_stats(lp->gid, &s->slimfly_stats_array);
 
     int written = 0;
     if(!s->terminal_id)
@@ -161,7 +161,7 @@ struct nodes_state
   int* neighbour_plus_lpID;
 
   /* records torus statistics for this LP having different communication categories */
-  struct mn_stats torus_stats_array[CATEGORY_MAX];
+  mn_stats_table torus_stats_array;
    /* for collective operations */
 
   /* collective init time */
@@ -1150,7 +1150,7 @@ static void packet_generate( nodes_state * ns,
    /* record the statistics of the generated packets */
    total_event_size = model_net_get_msg_sz(TORUS) + msg->remote_event_size_bytes + msg->local_event_size_bytes;
    mn_stats* stat;
-   stat = model_net_find_stats(msg->category, ns->torus_stats_array);
+   stat = model_net_find_stats(msg->category, &ns->torus_stats_array);
    stat->send_count++;
    stat->send_bytes += msg->packet_size;
    stat->send_time += (1/ns->params->link_bandwidth) * msg->packet_size;
@@ -1190,7 +1190,7 @@ static void packet_generate_rc( nodes_state * s,
         s->in_send_loop[queue] = 0;
      }
      mn_stats* stat;
-     stat = model_net_find_stats(msg->category, s->torus_stats_array);
+     stat = model_net_find_stats(msg->category, &s->torus_stats_array);
      stat->send_count--;
      stat->send_bytes -= msg->packet_size;
      stat->send_time -= (1/s->params->link_bandwidth) * msg->packet_size;
@@ -1436,7 +1436,7 @@ static void packet_arrive_rc(nodes_state * s,
         if(bf->c2)
         {
             struct mn_stats* stat;
-            stat = model_net_find_stats(msg->category, s->torus_stats_array);
+            stat = model_net_find_stats(msg->category, &s->torus_stats_array);
             stat->recv_count--;
             stat->recv_bytes -= msg->packet_size;
             stat->recv_time = msg->saved_recv_time;
@@ -1544,7 +1544,7 @@ static void packet_arrive( nodes_state * s,
         if( msg->chunk_id == num_chunks - 1 )
         {
 	    bf->c2 = 1;
-	    stat = model_net_find_stats(msg->category, s->torus_stats_array);
+	    stat = model_net_find_stats(msg->category, &s->torus_stats_array);
 	    stat->recv_count++;
 	    stat->recv_bytes += msg->packet_size;
 	    msg->saved_recv_time = s->total_time;
@@ -1734,7 +1734,7 @@ final( nodes_state * s, tw_lp * lp )
   }
   rc_stack_destroy(s->st);
 
-  model_net_print_stats(lp->gid, s->torus_stats_array);
+  model_net_print_stats(lp->gid, &s->torus_stats_array);
   free(s->next_link_available_time);
   free(s->next_credit_available_time);
   free(s->next_flit_generate_time);
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2013 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <codes/codes-category.h>
+#include <codes/quickhash.h>
+
+#define CATEGORY_HASH_SIZE 64
+
+struct category_entry
+{
+    int id;
+    char *name;
+    struct qhash_head hash_link;
+};
+
+static struct qhash_table *category_tbl = NULL;
+static char **category_names = NULL;
+static int category_count = 0;
+static int category_cap = 0;
+
+/* one-entry cache: most models only ever see a single category */
+static struct category_entry *category_last = NULL;
+
+static int category_compare(void *key, struct qhash_head *link)
+{
+    struct category_entry *e =
+        qhash_entry(link, struct category_entry, hash_link);
+
+    return strcmp((char const *)key, e->name) == 0;
+}
+
+int codes_category_id(char const * category)
+{
+    struct qhash_head *link;
+    struct category_entry *e;
+
+    if (category_last && strcmp(category, category_last->name) == 0)
+        return category_last->id;
+
+    if (!category_tbl) {
+        category_tbl = qhash_init(category_compare, quickhash_string_hash,
+                CATEGORY_HASH_SIZE);
+        assert(category_tbl);
+    }
+
+    link = qhash_search(category_tbl, (void*)category);
+    if (link) {
+        category_last = qhash_entry(link, struct category_entry, hash_link);
+        return category_last->id;
+    }
+
+    if (category_count == category_cap) {
+        category_cap = category_cap ? 2 * category_cap : 16;
+        category_names = realloc(category_names,
+                category_cap * sizeof(*category_names));
+        assert(category_names);
+    }
+
+    e = malloc(sizeof(*e));
+    assert(e);
+    e->id = category_count++;
+    e->name = strdup(category);
+    assert(e->name);
+    category_names[e->id] = e->name;
+    qhash_add(category_tbl, e->name, &e->hash_link);
+
+    category_last = e;
+    return e->id;
+}
+
+char const * codes_category_name(int id)
+{
+    assert(id >= 0 && id < category_count);
+    return category_names[id];
+}
+
+int codes_category_count(void)
+{
+    return category_count;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2013 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <codes/codes-size-index.h>
+
+/* bucket of size: 0 for 0, otherwise floor(log2(size)) + 1 */
+static inline int size_bucket(uint64_t size)
+{
+    int b = 0;
+
+    if (size >= (UINT64_C(1) << 32)) { size >>= 32; b += 32; }
+    if (size >= (UINT64_C(1) << 16)) { size >>= 16; b += 16; }
+    if (size >= (UINT64_C(1) << 8))  { size >>= 8;  b += 8; }
+    if (size >= (UINT64_C(1) << 4))  { size >>= 4;  b += 4; }
+    if (size >= (UINT64_C(1) << 2))  { size >>= 2;  b += 2; }
+    if (size >= (UINT64_C(1) << 1))  { size >>= 1;  b += 1; }
+    return b + (int)size;
+}
+
+int codes_size_index_init(
+        struct codes_size_index * idx,
+        uint64_t const * sizes,
+        int n)
+{
+    int i, b;
+
+    memset(idx, 0, sizeof(*idx));
+    for (i = 1; i < n; i++)
+    {
+        if (sizes[i] < sizes[i-1])
+            return -1;
+    }
+
+    idx->n = n;
+    if (n > 0)
+    {
+        idx->sizes = malloc(n * sizeof(*idx->sizes));
+        assert(idx->sizes);
+        memcpy(idx->sizes, sizes, n * sizeof(*idx->sizes));
+    }
+
+    /* entries are sorted, so the starts are filled in a single pass */
+    i = 0;
+    for (b = 0; b < CODES_SIZE_INDEX_BUCKETS; b++)
+    {
+        uint64_t lo = b == 0 ? 0 : UINT64_C(1) << (b - 1);
+        while (i < n && idx->sizes[i] < lo)
+            i++;
+        idx->start[b] = i;
+    }
+    return 0;
+}
+
+void codes_size_index_destroy(struct codes_size_index * idx)
+{
+    free(idx->sizes);
+    memset(idx, 0, sizeof(*idx));
+}
+
+int codes_size_index_upper(
+        struct codes_size_index const * idx,
+        uint64_t size)
+{
+    int i = idx->start[size_bucket(size)];
+
+    /* only entries within size's own bucket can be skipped here */
+    while (i < idx->n && idx->sizes[i] <= size)
+        i++;
+    return i;
+}
+
+double codes_size_index_interp(
+        struct codes_size_index const * idx,
+        uint64_t size,
+        int * lo)
+{
+    int i = codes_size_index_upper(idx, size);
+
+    if (i == 0 || i >= idx->n)
+    {
+        *lo = i == 0 ? 0 : idx->n - 1;
+        return 0.0;
+    }
+
+    *lo = i - 1;
+    return (double)(size - idx->sizes[i-1]) /
+        (double)(idx->sizes[i] - idx->sizes[i-1]);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
@@ -10,13 +10,14 @@
 #include <codes/jenkins-hash.h>
 #include <codes/codes.h>
 #include <codes/codes_mapping.h>
+#include <codes/codes-category.h>
+#include <codes/codes-size-index.h>
 #include <codes/lp-type-lookup.h>
 #include <codes/local-storage-model.h>
 #include <codes/quicklist.h>
 #include <codes/rc-stack.h>
 
 #define CATEGORY_NAME_MAX 16
-#define CATEGORY_MAX 12
 
 int lsm_in_sequence = 0;
 tw_stime lsm_msg_offset = 0.0;
@@ -48,6 +49,8 @@ typedef struct disk_model_s
     double *write_seeks;
     double *read_seeks;
     unsigned int bins;
+    // direct index over request_sizes
+    struct codes_size_index size_idx;
     // sched params
     //   0  - no scheduling
     //  >0  - make scheduler with use_sched priority lanes
@@ -108,7 +111,9 @@ typedef struct lsm_state_s
     disk_model_t *model;
     int64_t  current_offset;
     uint64_t current_object;
-    lsm_stats_t lsm_stats_array[CATEGORY_MAX];
+    /* indexed by interned category id, grown as categories are seen */
+    lsm_stats_t *lsm_stats_array;
+    int lsm_stats_count;
     /* scheduling state */
     int use_sched;
     lsm_sched_t sched;
@@ -196,13 +201,7 @@ static tw_stime transfer_time_table (lsm_state_t *ns,
     unsigned int i;
 
     /* find nearest size rounded down. */
-    for (i = 0; i < ns->model->bins; i++)
-    {
-        if (ns->model->request_sizes[i] > size)
-        {
-            break;
-        }
-    }
+    i = codes_size_index_upper(&ns->model->size_idx, size);
     if (i > 0) i--;
 
     if (rw)
@@ -485,7 +484,7 @@ static void lsm_finalize(lsm_state_t *ns,
     memset(&all, 0, sizeof(all));
     sprintf(all.category, "all");
 
-    for(i=0; i<CATEGORY_MAX; i++)
+    for(i=0; i<ns->lsm_stats_count; i++)
     {
         if(strlen(ns->lsm_stats_array[i].category) > 0)
         {
@@ -504,6 +503,10 @@ static void lsm_finalize(lsm_state_t *ns,
 
     write_stats(lp, &all);
 
+    free(ns->lsm_stats_array);
+    ns->lsm_stats_array = NULL;
+    ns->lsm_stats_count = 0;
+
     return;
 }
 
@@ -734,32 +737,22 @@ static void handle_rev_io_completion (lsm_state_t *ns,
 
 static lsm_stats_t *find_stats(const char* category, lsm_state_t *ns)
 {
-    int i;
-    int new_flag = 0;
-    int found_flag = 0;
+    int id = codes_category_id(category);
 
-    for(i=0; i<CATEGORY_MAX; i++)
+    if(id >= ns->lsm_stats_count)
     {
-        if(strlen(ns->lsm_stats_array[i].category) == 0)
-        {
-            found_flag = 1;
-            new_flag = 1;
-            break;
-        }
-        if(strcmp(category, ns->lsm_stats_array[i].category) == 0)
-        {
-            found_flag = 1;
-            new_flag = 0;
-            break;
-        }
+        int cnt = codes_category_count();
+        ns->lsm_stats_array = realloc(ns->lsm_stats_array,
+                cnt * sizeof(*ns->lsm_stats_array));
+        assert(ns->lsm_stats_array);
+        memset(ns->lsm_stats_array + ns->lsm_stats_count, 0,
+                (cnt - ns->lsm_stats_count) * sizeof(*ns->lsm_stats_array));
+        ns->lsm_stats_count = cnt;
     }
-    assert(found_flag);
 
-    if(new_flag)
-    {
-        strcpy(ns->lsm_stats_array[i].category, category);
-    }
-    return(&ns->lsm_stats_array[i]);
+    if(ns->lsm_stats_array[id].category[0] == '\0')
+        strcpy(ns->lsm_stats_array[id].category, category);
+    return(&ns->lsm_stats_array[id]);
 
 }
 
@@ -799,6 +792,35 @@ void lsm_register(void)
     lp_type_register(LSM_NAME, &lsm_lp);
 }
 
+static void swap_double(double *v, unsigned int i, unsigned int j)
+{
+    double tmp = v[i];
+    v[i] = v[j];
+    v[j] = tmp;
+}
+
+// request_sizes may be listed in any order: sort the bins by size, moving the
+// rates, overheads and seeks of each bin along with it
+static void sort_bins(disk_model_t *model)
+{
+    for (unsigned int i = 1; i < model->bins; i++)
+    {
+        for (unsigned int j = i; j > 0 &&
+                model->request_sizes[j-1] > model->request_sizes[j]; j--)
+        {
+            unsigned int tmp = model->request_sizes[j];
+            model->request_sizes[j] = model->request_sizes[j-1];
+            model->request_sizes[j-1] = tmp;
+            swap_double(model->write_rates, j, j-1);
+            swap_double(model->read_rates, j, j-1);
+            swap_double(model->write_overheads, j, j-1);
+            swap_double(model->read_overheads, j, j-1);
+            swap_double(model->write_seeks, j, j-1);
+            swap_double(model->read_seeks, j, j-1);
+        }
+    }
+}
+
 // read the configuration file for a given annotation
 static void read_config(ConfigHandle *ch, char const * anno, disk_model_t *model)
 {
@@ -900,6 +922,17 @@ static void read_config(ConfigHandle *ch, char const * anno, disk_model_t *model
     configuration_get_value_int(ch, LSM_NAME, "enable_scheduler", anno,
             &model->use_sched);
     assert(model->use_sched >= 0);
+
+    sort_bins(model);
+    uint64_t *sizes = (uint64_t*)malloc(sizeof(*sizes)*model->bins);
+    assert(sizes);
+    for (unsigned int i = 0; i < model->bins; i++)
+    {
+        sizes[i] = model->request_sizes[i];
+    }
+    rc = codes_size_index_init(&model->size_idx, sizes, model->bins);
+    assert(rc == 0);
+    free(sizes);
 }
 
 void lsm_configure(void)
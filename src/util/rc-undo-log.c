@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <ross.h>
+#include "codes/rc-undo-log.h"
+
+#define RC_UNDO_LOG_INIT_CAP 256
+
+enum rc_undo_log_mode {
+    RC_UNDO_NONOPT, // not in optimistic mode, nothing is recorded
+    RC_UNDO_OPT, // optimistic mode
+    RC_UNDO_OPT_DBG // optimistic *debug* mode, never collected
+};
+
+/* a saved word, or a group marker (size == 0) holding the event time */
+typedef struct rc_undo_entry_s {
+    void * addr;
+    union {
+        uint64_t bits;
+        tw_stime time;
+    } v;
+    size_t size;
+} rc_undo_entry;
+
+/* entries live in a circular array: groups are collected from the front and
+ * rolled back from the back */
+struct rc_undo_log {
+    enum rc_undo_log_mode mode;
+    rc_undo_entry * ents;
+    size_t cap; // power of two
+    size_t first;
+    size_t len;
+    int count; // saved words
+};
+
+#define ENT(l, i) (&(l)->ents[((l)->first + (i)) & ((l)->cap - 1)])
+
+void rc_undo_log_create(struct rc_undo_log **l){
+    struct rc_undo_log *ll = (struct rc_undo_log*)calloc(1, sizeof(*ll));
+    assert(ll);
+    switch (g_tw_synchronization_protocol) {
+        case OPTIMISTIC:
+        case OPTIMISTIC_REALTIME:
+            ll->mode = RC_UNDO_OPT;
+            break;
+        case OPTIMISTIC_DEBUG:
+            ll->mode = RC_UNDO_OPT_DBG;
+            break;
+        default:
+            ll->mode = RC_UNDO_NONOPT;
+    }
+    *l = ll;
+}
+
+void rc_undo_log_destroy(struct rc_undo_log *l) {
+    free(l->ents);
+    free(l);
+}
+
+static rc_undo_entry * rc_undo_log_push(struct rc_undo_log *l) {
+    if (l->len == l->cap) {
+        size_t cap = l->cap ? 2 * l->cap : RC_UNDO_LOG_INIT_CAP;
+        rc_undo_entry *ents = (rc_undo_entry*)malloc(cap * sizeof(*ents));
+        assert(ents);
+        /* unwrap into the new array */
+        for (size_t i = 0; i < l->len; i++)
+            ents[i] = *ENT(l, i);
+        free(l->ents);
+        l->ents = ents;
+        l->cap = cap;
+        l->first = 0;
+    }
+    l->len++;
+    return ENT(l, l->len - 1);
+}
+
+void rc_undo_log_begin(tw_lp const *lp, struct rc_undo_log *l) {
+    if (l->mode == RC_UNDO_NONOPT)
+        return;
+    rc_undo_entry *e = rc_undo_log_push(l);
+    e->addr = NULL;
+    e->v.time = tw_now(lp);
+    e->size = 0;
+}
+
+void rc_undo_log_save(struct rc_undo_log *l, void *addr, size_t size) {
+    assert(size > 0 && size <= sizeof(uint64_t));
+    if (l->mode == RC_UNDO_NONOPT)
+        return;
+    if (l->len == 0)
+        tw_error(TW_LOC, "rc undo log: save outside of an event group\n");
+    rc_undo_entry *e = rc_undo_log_push(l);
+    e->addr = addr;
+    e->v.bits = 0;
+    memcpy(&e->v.bits, addr, size);
+    e->size = size;
+    l->count++;
+}
+
+void rc_undo_log_rollback(struct rc_undo_log *l) {
+    while (l->len > 0) {
+        rc_undo_entry *e = ENT(l, l->len - 1);
+        l->len--;
+        if (e->size == 0)
+            return;
+        memcpy(e->addr, &e->v.bits, e->size);
+        l->count--;
+    }
+    tw_error(TW_LOC,
+            "could not roll back rc undo log (no open event group)\n");
+}
+
+int rc_undo_log_count(struct rc_undo_log const *l) { return l->count; }
+
+void rc_undo_log_gc(tw_lp const *lp, struct rc_undo_log *l) {
+    // in optimistic debug mode, we can't gc anything, because we'll be rolling
+    // back to the beginning
+    if (l->mode == RC_UNDO_OPT_DBG && lp != NULL)
+        return;
+
+    /* the front entry is always a group marker */
+    while (l->len > 0) {
+        rc_undo_entry *e = ENT(l, 0);
+        assert(e->size == 0);
+        if (lp != NULL && e->v.time >= lp->pe->GVT)
+            break;
+        do {
+            if (e->size != 0)
+                l->count--;
+            l->first = (l->first + 1) & (l->cap - 1);
+            l->len--;
+            e = ENT(l, 0);
+        } while (l->len > 0 && e->size != 0);
+    }
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
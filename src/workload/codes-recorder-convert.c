@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+/* one-time converter from a Recorder trace directory to the binary trace
+ * cache consumed by the recorder_io_workload generator */
+
+#include <assert.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <codes/codes-workload.h>
+
+static char trace_dir[MAX_NAME_LENGTH_WKLD] = {'\0'};
+static char out_file[MAX_NAME_LENGTH_WKLD] = {'\0'};
+static int64_t nprocs = 0;
+
+static struct option long_opts[] =
+{
+    {"r-trace-dir", required_argument, NULL, 'd'},
+    {"r-nprocs", required_argument, NULL, 'x'},
+    {"output", required_argument, NULL, 'o'},
+    {NULL, 0, NULL, 0}
+};
+
+void usage(){
+    fputs(
+            "Usage: codes-recorder-convert --r-trace-dir DIR --r-nprocs N [OPTION...]\n"
+            "--r-trace-dir: directory containing recorder trace files\n"
+            "--r-nprocs: number of ranks in original recorder workload\n"
+            "--output: cache file to write (default: DIR/" RECORDER_CACHE_FILE ")\n",
+            stderr
+            );
+}
+
+int main(int argc, char *argv[])
+{
+    int ch;
+    while ((ch = getopt_long(argc, argv, "d:x:o:", long_opts, NULL)) != -1){
+        switch (ch){
+            case 'd':
+                strncpy(trace_dir, optarg, MAX_NAME_LENGTH_WKLD - 1);
+                break;
+            case 'x':
+                nprocs = atol(optarg);
+                break;
+            case 'o':
+                strncpy(out_file, optarg, MAX_NAME_LENGTH_WKLD - 1);
+                break;
+            default:
+                usage();
+                return 1;
+        }
+    }
+
+    if (trace_dir[0] == '\0' || nprocs <= 0){
+        usage();
+        return 1;
+    }
+
+    if (recorder_io_workload_convert(trace_dir, nprocs,
+                out_file[0] == '\0' ? NULL : out_file) != 0){
+        fprintf(stderr, "Error: unable to convert recorder traces in %s\n",
+                trace_dir);
+        return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
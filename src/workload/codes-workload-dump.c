@@ -10,14 +10,15 @@
 #include <codes/codes-workload.h>
 #include <codes/codes.h>
 #include <inttypes.h>
+#include <time.h>
 
 static char type[128] = {'\0'};
 static darshan_params d_params = {"", 0}; 
 static iolang_params i_params = {0, 0, "", ""};
 static recorder_params r_params = {"", 0};
 static dumpi_trace_params du_params = {"", 0, 0};
-static online_comm_params oc_params = {"", "", 0};
-static checkpoint_wrkld_params c_params = {0, 0, 0, 0, 0};
+static online_comm_params oc_params = {"", "", 0, 0, 0};
+static checkpoint_wrkld_params c_params = {0, 0, 0, 0, 0, 0};
 static iomock_params im_params = {0, 0, 1, 0, 0, 0};
 static int n = -1;
 static int start_rank = 0;
@@ -38,6 +39,7 @@ static struct option long_opts[] =
     {"chkpoint-bw", required_argument, NULL, 'B'},
     {"chkpoint-iters", required_argument, NULL, 'i'},
     {"chkpoint-mtti", required_argument, NULL, 'M'},
+    {"chkpoint-coll", no_argument, NULL, 'C'},
     {"iomock-request-type", required_argument, NULL, 'Q'},
     {"iomock-num-requests", required_argument, NULL, 'N'},
     {"iomock-request-size", required_argument, NULL, 'z'},
@@ -69,6 +71,7 @@ void usage(){
             "--chkpoint-bw: checkpointing bandwidth\n"
             "--chkpoint-iters: iteration count for checkpoint workload\n"
             "--chkpoint-mtti: mean time to interrupt\n"
+            "--chkpoint-coll: write each checkpoint as a single collective op\n"
             "MOCK IO OPTIONS (iomock_workload)\n"
             "--iomock-request-type: whether to write or read\n"
             "--iomock-num-requests: number of writes/reads\n"
@@ -123,9 +126,12 @@ int main(int argc, char *argv[])
     int64_t num_waitsomes = 0;
     int64_t num_waitanys = 0;
     int64_t num_testalls = 0;
+    int64_t num_ops = 0;
+    double gen_time = 0.0;
+    struct timespec gen_start, gen_end;
 
     char ch;
-    while ((ch = getopt_long(argc, argv, "t:n:l:b:a:m:sp:wr:S:B:R:M:Q:N:z:f:u",
+    while ((ch = getopt_long(argc, argv, "t:n:l:b:a:m:sp:wr:S:B:R:M:CQ:N:z:f:u",
                     long_opts, NULL)) != -1){
         switch (ch){
             case 't':
@@ -175,6 +181,9 @@ int main(int argc, char *argv[])
             case 'M':
                 c_params.mtti = atof(optarg);
                 break;
+            case 'C':
+                c_params.collective = 1;
+                break;
             case 'Q':
                 im_params.is_write = (strcmp("write", optarg) == 0);
                 break;
@@ -327,7 +336,12 @@ int main(int argc, char *argv[])
         printf("total_read_time = %f, total_write_time = %f\n", total_read_time, total_write_time);
         assert(id != -1);
         do {
+            clock_gettime(CLOCK_MONOTONIC, &gen_start);
             codes_workload_get_next(id, 0, i, &op);
+            clock_gettime(CLOCK_MONOTONIC, &gen_end);
+            gen_time += (gen_end.tv_sec - gen_start.tv_sec) +
+                (gen_end.tv_nsec - gen_start.tv_nsec) * 1e-9;
+            num_ops++;
 //            codes_workload_print_op(stdout, &op, 0, i);
 
             switch(op.op_type)
@@ -495,6 +509,9 @@ int main(int argc, char *argv[])
         fprintf(stderr, "NUM_WAITSOMES:   %"PRId64"\n", num_waitsomes);
         fprintf(stderr, "NUM_WAITANYS:    %"PRId64"\n", num_waitanys);
         fprintf(stderr, "NUM_TESTALLS:    %"PRId64"\n", num_testalls);
+        fprintf(stderr, "NUM_OPS:         %"PRId64"\n", num_ops);
+        fprintf(stderr, "OPS_PER_SEC:     %.4e\n",
+                gen_time > 0.0 ? num_ops / gen_time : 0.0);
     }
 
 #ifdef USE_ONLINE
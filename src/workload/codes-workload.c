@@ -5,6 +5,8 @@
  */
 
 #include <assert.h>
+#include <pthread.h>
+#include <time.h>
 
 #include <ross.h>
 #include <codes/codes-workload.h>
@@ -21,6 +23,7 @@ extern struct codes_workload_method test_workload_method;
 extern struct codes_workload_method iolang_workload_method;
 #ifdef USE_DUMPI
 extern struct codes_workload_method dumpi_trace_workload_method;
+extern struct codes_workload_method skeleton_workload_method;
 #endif
 
 #ifdef USE_DARSHAN
@@ -46,6 +49,7 @@ static struct codes_workload_method const * method_array_default[] =
     &iolang_workload_method,
 #ifdef USE_DUMPI
     &dumpi_trace_workload_method,
+    &skeleton_workload_method,
 #endif
 
 #ifdef USE_DARSHAN
@@ -80,28 +84,52 @@ static struct codes_workload_method const ** method_array = NULL;
  *
  * NOTE: we could make this faster with a smarter data structure.  For now
  * we just have a linked list of rank_queue structs, one per rank that has
- * opened the workload.  We then have a linked list off of each of those
- * to hold a lifo queue of operations that have been reversed for that rank.
+ * opened the workload.  Each of those holds an array used as a lifo queue
+ * of operations that have been reversed for that rank, so that reversing
+ * and re-issuing operations does not allocate.
  */
 
-/* holds an operation that has been reversed */
-struct rc_op
-{
-    struct codes_workload_op op;
-    struct rc_op* next;
-};
-
 /* tracks lifo queue of reversed operations for a given rank */
 struct rank_queue
 {
     int app;
     int rank;
-    struct rc_op *lifo;
+    /* set by codes_workload_load_parallel; the next codes_workload_load
+     * for this rank does not need to call into the method again */
+    int preloaded;
+    /* reversed operations, the next one to re-issue is the last one */
+    struct codes_workload_op *lifo;
+    int lifo_cnt;
+    int lifo_cap;
     struct rank_queue *next;
 };
 
 static struct rank_queue *ranks = NULL;
 
+/* per-method load statistics, indexed by workload id */
+static int num_methods = 0;
+static struct codes_workload_load_stats *load_stats = NULL;
+
+static double load_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1.0e-9;
+}
+
+static struct rank_queue * find_rank_queue(int app_id, int rank)
+{
+    struct rank_queue *tmp = ranks;
+
+    while(tmp)
+    {
+        if(tmp->rank == rank && tmp->app == app_id)
+            break;
+        tmp = tmp->next;
+    }
+    return tmp;
+}
+
 // only call this once
 static void init_workload_methods(void)
 {
@@ -120,9 +148,58 @@ static void init_workload_methods(void)
         memcpy(method_array+num_user_methods, method_array_default,
                 num_default_methods * sizeof(*method_array_default));
     }
+    while (method_array[num_methods] != NULL)
+        num_methods++;
+    load_stats = calloc(num_methods, sizeof(*load_stats));
+    assert(load_stats);
     is_workloads_init = 1;
 }
 
+static int find_method(const char *type)
+{
+    int i;
+
+    for(i=0; method_array[i] != NULL; i++)
+    {
+        if(strcmp(method_array[i]->method_name, type) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static void push_rc_op(struct rank_queue *q, const struct codes_workload_op *op)
+{
+    if(q->lifo_cnt == q->lifo_cap)
+    {
+        q->lifo_cap = q->lifo_cap ? 2 * q->lifo_cap : 16;
+        q->lifo = realloc(q->lifo, q->lifo_cap * sizeof(*q->lifo));
+        assert(q->lifo);
+    }
+    q->lifo[q->lifo_cnt++] = *op;
+}
+
+static struct rank_queue * add_rank_queue(int app_id, int rank)
+{
+    struct rank_queue *tmp;
+
+    /* are we tracking information for this rank yet? */
+    tmp = find_rank_queue(app_id, rank);
+    if(tmp == NULL)
+    {
+        tmp = (struct rank_queue*)malloc(sizeof(*tmp));
+        assert(tmp);
+        tmp->app  = app_id;
+        tmp->rank = rank;
+        tmp->preloaded = 0;
+        tmp->lifo = NULL;
+        tmp->lifo_cnt = 0;
+        tmp->lifo_cap = 0;
+        tmp->next = ranks;
+        ranks = tmp;
+    }
+    return tmp;
+}
+
 codes_workload_config_return codes_workload_read_config(
         ConfigHandle * handle,
         char const * section_name,
@@ -173,44 +250,170 @@ int codes_workload_load(
 
     int i;
     int ret;
+    double start;
     struct rank_queue *tmp;
 
-    for(i=0; method_array[i] != NULL; i++)
+    i = find_method(type);
+    if(i < 0)
     {
-        if(strcmp(method_array[i]->method_name, type) == 0)
-        {
-            /* load appropriate workload generator */
-            ret = method_array[i]->codes_workload_load(params, app_id, rank);
-            if(ret < 0)
-            {
-                return(-1);
-            }
+        fprintf(stderr, "Error: failed to find workload generator %s\n", type);
+        return(-1);
+    }
 
-            /* are we tracking information for this rank yet? */
-            tmp = ranks;
-            while(tmp)
-            {
-                if(tmp->rank == rank && tmp->app == app_id)
-                    break;
-                tmp = tmp->next;
-            }
-            if(tmp == NULL)
+    tmp = find_rank_queue(app_id, rank);
+    if(tmp && tmp->preloaded)
+    {
+        tmp->preloaded = 0;
+        return(i);
+    }
+
+    /* load appropriate workload generator */
+    start = load_now();
+    ret = method_array[i]->codes_workload_load(params, app_id, rank);
+    if(ret < 0)
+    {
+        return(-1);
+    }
+    start = load_now() - start;
+    load_stats[i].nranks++;
+    load_stats[i].busy_time += start;
+    load_stats[i].wall_time += start;
+
+    add_rank_queue(app_id, rank);
+
+    return(i);
+}
+
+struct load_pool
+{
+    struct codes_workload_method const *method;
+    struct codes_workload_load_req const *reqs;
+    int count;
+    int *ret;
+    double *busy;
+    /* next request to hand out, protected by lock */
+    int next;
+    pthread_mutex_t lock;
+};
+
+static void * load_pool_worker(void *arg)
+{
+    struct load_pool *pool = arg;
+    double start, busy = 0;
+    int ndx;
+
+    for(;;)
+    {
+        pthread_mutex_lock(&pool->lock);
+        ndx = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+        if(ndx >= pool->count)
+            break;
+
+        start = load_now();
+        pool->ret[ndx] = pool->method->codes_workload_load(
+                pool->reqs[ndx].params, pool->reqs[ndx].app_id,
+                pool->reqs[ndx].rank);
+        busy += load_now() - start;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    *pool->busy += busy;
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+int codes_workload_load_parallel(
+        const char* type,
+        struct codes_workload_load_req const *reqs,
+        int count,
+        int nthreads)
+{
+    init_workload_methods();
+
+    struct load_pool pool;
+    pthread_t *threads;
+    double start, busy = 0;
+    int i, t, id, err = 0;
+
+    id = find_method(type);
+    if(id < 0)
+    {
+        fprintf(stderr, "Error: failed to find workload generator %s\n", type);
+        return(-1);
+    }
+
+    /* methods that keep unprotected global state are loaded on the
+     * calling thread only */
+    if(!method_array[id]->thread_safe_load || nthreads < 1)
+        nthreads = 1;
+    if(nthreads > count)
+        nthreads = count;
+
+    pool.method = method_array[id];
+    pool.reqs = reqs;
+    pool.count = count;
+    pool.ret = calloc(count > 0 ? count : 1, sizeof(*pool.ret));
+    assert(pool.ret);
+    pool.busy = &busy;
+    pool.next = 0;
+    pthread_mutex_init(&pool.lock, NULL);
+
+    start = load_now();
+    if(nthreads <= 1)
+        load_pool_worker(&pool);
+    else
+    {
+        threads = malloc(nthreads * sizeof(*threads));
+        assert(threads);
+        for(t = 0; t < nthreads; t++)
+        {
+            if(pthread_create(&threads[t], NULL, load_pool_worker, &pool))
             {
-                tmp = (struct rank_queue*)malloc(sizeof(*tmp));
-                assert(tmp);
-                tmp->app  = app_id;
-                tmp->rank = rank;
-                tmp->lifo = NULL;
-                tmp->next = ranks;
-                ranks = tmp;
+                fprintf(stderr, "Error: failed to create workload load "
+                        "thread %d\n", t);
+                break;
             }
+        }
+        /* threads that were started drain the whole pool */
+        if(t == 0)
+            load_pool_worker(&pool);
+        while(t-- > 0)
+            pthread_join(threads[t], NULL);
+        free(threads);
+    }
+    load_stats[id].wall_time += load_now() - start;
+    load_stats[id].busy_time += busy;
+    pthread_mutex_destroy(&pool.lock);
 
-            return(i);
+    /* the shim's own bookkeeping is done serially */
+    for(i = 0; i < count; i++)
+    {
+        if(pool.ret[i] < 0)
+        {
+            fprintf(stderr, "Error: failed to load workload for app %d "
+                    "rank %d\n", reqs[i].app_id, reqs[i].rank);
+            err = 1;
+            continue;
         }
+        load_stats[id].nranks++;
+        add_rank_queue(reqs[i].app_id, reqs[i].rank)->preloaded = 1;
     }
+    free(pool.ret);
 
-    fprintf(stderr, "Error: failed to find workload generator %s\n", type);
-    return(-1);
+    return(err ? -1 : id);
+}
+
+int codes_workload_get_load_stats(
+        int wkld_id,
+        struct codes_workload_load_stats *stats)
+{
+    init_workload_methods();
+
+    if(wkld_id < 0 || wkld_id >= num_methods)
+        return(-1);
+    *stats = load_stats[wkld_id];
+    return(0);
 }
 
 void codes_workload_get_next(
@@ -220,28 +423,17 @@ void codes_workload_get_next(
         struct codes_workload_op *op)
 {
     struct rank_queue *tmp;
-    struct rc_op *tmp_op;
 
     /* first look to see if we have a reversed operation that we can
      * re-issue
      */
-    tmp = ranks;
-    while(tmp)
-    {
-        if(tmp->rank == rank && tmp->app == app_id)
-            break;
-        tmp = tmp->next;
-    }
+    tmp = find_rank_queue(app_id, rank);
     if(tmp==NULL)
         printf("tmp is NULL, rank=%d, app_id = %d", rank, app_id);
     assert(tmp);
-    if(tmp->lifo)
+    if(tmp->lifo_cnt)
     {
-        tmp_op = tmp->lifo;
-        tmp->lifo = tmp_op->next;
-
-        *op = tmp_op->op;
-        free(tmp_op);
+        *op = tmp->lifo[--tmp->lifo_cnt];
         return;
     }
 
@@ -259,22 +451,11 @@ void codes_workload_get_next_rc(
 {
     (void)wkld_id; // currently unused
     struct rank_queue *tmp;
-    struct rc_op *tmp_op;
 
-    tmp = ranks;
-    while(tmp)
-    {
-        if(tmp->rank == rank && tmp->app == app_id)
-            break;
-        tmp = tmp->next;
-    }
+    tmp = find_rank_queue(app_id, rank);
     assert(tmp);
 
-    tmp_op = (struct rc_op*)malloc(sizeof(struct rc_op));
-    assert(tmp_op);
-    tmp_op->op = *op;
-    tmp_op->next = tmp->lifo;
-    tmp->lifo = tmp_op;
+    push_rc_op(tmp, op);
 
     return;
 }
@@ -288,6 +469,86 @@ void codes_workload_get_next_rc2(
     method_array[wkld_id]->codes_workload_get_next_rc2(app_id, rank);
 }
 
+int codes_workload_get_next_batch(
+        int wkld_id,
+        int app_id,
+        int rank,
+        struct codes_workload_op *ops,
+        int max_ops)
+{
+    struct rank_queue *tmp;
+    int n = 0;
+
+    tmp = find_rank_queue(app_id, rank);
+    assert(tmp);
+
+    /* re-issue reversed operations first */
+    while(n < max_ops && tmp->lifo_cnt)
+    {
+        ops[n] = tmp->lifo[--tmp->lifo_cnt];
+        if(ops[n++].op_type == CODES_WK_END)
+            return n;
+    }
+
+    if(n == max_ops)
+        return n;
+
+    if(method_array[wkld_id]->codes_workload_get_next_batch)
+    {
+        n += method_array[wkld_id]->codes_workload_get_next_batch(app_id,
+                rank, ops + n, max_ops - n);
+        return n;
+    }
+
+    while(n < max_ops)
+    {
+        method_array[wkld_id]->codes_workload_get_next(app_id, rank, &ops[n]);
+        assert(ops[n].op_type);
+        if(ops[n++].op_type == CODES_WK_END)
+            break;
+    }
+    return n;
+}
+
+void codes_workload_get_next_rc_batch(
+        int wkld_id,
+        int app_id,
+        int rank,
+        const struct codes_workload_op *ops,
+        int count)
+{
+    (void)wkld_id; // currently unused
+    struct rank_queue *tmp;
+    int i;
+
+    tmp = find_rank_queue(app_id, rank);
+    assert(tmp);
+
+    /* push in reverse so the ops are re-issued in their original order */
+    for(i = count - 1; i >= 0; i--)
+        push_rc_op(tmp, &ops[i]);
+}
+
+void codes_workload_get_next_rc2_batch(
+        int wkld_id,
+        int app_id,
+        int rank,
+        int count)
+{
+    int i;
+
+    if(method_array[wkld_id]->codes_workload_get_next_rc2_batch)
+    {
+        method_array[wkld_id]->codes_workload_get_next_rc2_batch(app_id, rank,
+                count);
+        return;
+    }
+
+    assert(method_array[wkld_id]->codes_workload_get_next_rc2);
+    for(i = 0; i < count; i++)
+        method_array[wkld_id]->codes_workload_get_next_rc2(app_id, rank);
+}
+
 /* Finalize the workload */
 int codes_workload_finalize(
         const char* type,
@@ -6,24 +6,22 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <assert.h>
 
-#include "codes/quickhash.h"
-
 #include "codes/codes-workload.h"
 
-#define CHECKPOINT_HASH_TABLE_SIZE 251
-
 #define DEFAULT_WR_BUF_SIZE (16 * 1024 * 1024)   /* 16 MiB default */
 
+/* position of an operation within a single compute/checkpoint iteration.
+ * Writes occupy the positions between CHECKPOINT_OPEN_FILE and the close,
+ * which is always the last position of the iteration */
 enum checkpoint_status
 {
-    CHECKPOINT_COMPUTE,
-    CHECKPOINT_OPEN_FILE,
-    CHECKPOINT_WRITE,
-    CHECKPOINT_CLOSE_FILE,
-    CHECKPOINT_INACTIVE,
+    CHECKPOINT_COMPUTE = 0,
+    CHECKPOINT_OPEN_FILE = 1,
+    CHECKPOINT_WRITE = 2,
 };
 
 static void * checkpoint_workload_read_config(
@@ -34,50 +32,50 @@ static void * checkpoint_workload_read_config(
 static int checkpoint_workload_load(const char* params, int app_id, int rank);
 static void checkpoint_workload_get_next(int app_id, int rank, struct codes_workload_op *op);
 static void checkpoint_workload_get_next_rc2(int app_id, int rank);
-
-static int checkpoint_state_compare(void *key, struct qhash_head *link);
+static int checkpoint_workload_get_next_batch(int app_id, int rank,
+        struct codes_workload_op *ops, int max_ops);
+static void checkpoint_workload_get_next_rc2_batch(int app_id, int rank,
+        int count);
 
 /* TODO: fpp or shared file, or option? affects offsets and file ids */
 
-/* state for each process participating in this checkpoint */
-struct checkpoint_state
+/* job-level state shared by every rank of a checkpointing application. The
+ * schedule is identical across ranks, so it is computed once at load time
+ * and each rank only tracks its position in the op stream */
+struct checkpoint_app
 {
-    int rank;
     int app_id;
-    enum checkpoint_status status;
+    int nprocs;
+    /* emit each checkpoint phase as a single collective write */
+    int collective;
     /* optimal interval to checkpoint (s) */
     double checkpoint_interval;
-    /* how much this rank contributes to checkpoint (bytes) */
+    /* how much each rank contributes to checkpoint (bytes) */
     long long io_per_checkpoint;
-    /* which checkpointing iteration are we on */
-    int cur_checkpoint;
-    /* how much we have checkpointed to file in current iteration (bytes) */
-    long long cur_checkpoint_sz;
-    /* for reverse computation */
-    long long saved_cur_checkpoint_sz;
-    long long saved_prev_checkpoint_sz;
-    /* the total number of checkpointing iterations (compute+checkpoint) to run */
-    int total_checkpoints;
-    struct qhash_head hash_link;
+    /* number of write ops each rank issues per checkpoint */
+    long long writes_per_checkpoint;
+    /* ops per compute+checkpoint iteration (delay, open, writes, close) */
+    long long ops_per_iter;
+    /* total ops per rank, excluding the terminating CODES_WK_END */
+    long long total_ops;
+    /* per-rank index of the next op to issue, indexed by rank */
+    long long *next_op;
 };
 
-struct checkpoint_id
-{
-    int rank;
-    int app_id;
-};
-
-static struct qhash_table *chkpoint_state_tbl = NULL;
-static int chkpoint_tbl_pop = 0;
+/* dense table of applications, indexed by app id */
+static struct checkpoint_app **chkpoint_apps = NULL;
+static int chkpoint_apps_cnt = 0;
 
 /* function pointers for this method */
-struct codes_workload_method checkpoint_workload_method = 
+struct codes_workload_method checkpoint_workload_method =
 {
     .method_name = "checkpoint_io_workload",
     .codes_workload_read_config = &checkpoint_workload_read_config,
     .codes_workload_load = &checkpoint_workload_load,
     .codes_workload_get_next = &checkpoint_workload_get_next,
     .codes_workload_get_next_rc2 = &checkpoint_workload_get_next_rc2,
+    .codes_workload_get_next_batch = &checkpoint_workload_get_next_batch,
+    .codes_workload_get_next_rc2_batch = &checkpoint_workload_get_next_rc2_batch,
 };
 
 static void * checkpoint_workload_read_config(
@@ -107,41 +105,30 @@ static void * checkpoint_workload_read_config(
             annotation, &p->mtti);
     assert(!rc);
 
+    /* optional */
+    rc = configuration_get_value_int(handle, section_name,
+            "checkpoint_collective", annotation, &p->collective);
+    if (rc)
+        p->collective = 0;
+
     p->nprocs = num_ranks;
 
     return p;
 }
 
-static int checkpoint_workload_load(const char* params, int app_id, int rank)
+static struct checkpoint_app * checkpoint_app_init(
+        checkpoint_wrkld_params const * c_params,
+        int app_id)
 {
-    checkpoint_wrkld_params *c_params = (checkpoint_wrkld_params *)params;
-    struct checkpoint_state* new_state;
+    struct checkpoint_app *app;
     double checkpoint_wr_time;
-    struct checkpoint_id this_chkpoint_id;
-
-    if (!c_params)
-        return(-1);
-
-    /* TODO: app_id unsupported? */
-    APP_ID_UNSUPPORTED(app_id, "checkpoint_workload")
-
-    if (!chkpoint_state_tbl)
-    {
-        chkpoint_state_tbl = qhash_init(checkpoint_state_compare,
-            quickhash_64bit_hash, CHECKPOINT_HASH_TABLE_SIZE);
-        if(!chkpoint_state_tbl)
-            return(-1);
-    }
 
-    new_state = (struct checkpoint_state*)malloc(sizeof(*new_state));
-    if (!new_state)
-        return(-1);
+    app = malloc(sizeof(*app));
+    assert(app);
 
-    new_state->rank = rank;
-    new_state->app_id = app_id;
-    new_state->status = CHECKPOINT_COMPUTE;
-    new_state->cur_checkpoint = 1;
-    new_state->total_checkpoints = c_params->total_checkpoints;
+    app->app_id = app_id;
+    app->nprocs = c_params->nprocs;
+    app->collective = c_params->collective;
 
     /* calculate the time (in seconds) taken to write the checkpoint to file */
     checkpoint_wr_time = (c_params->checkpoint_sz * 1024) /* checkpoint size (GiB) */
@@ -151,214 +138,212 @@ static int checkpoint_workload_load(const char* params, int app_id, int rank)
      * equation given in the conclusion of Daly's "A higher order estimate
      * of the optimum checkpoint interval for restart dumps"
      */
-    new_state->checkpoint_interval =
+    app->checkpoint_interval =
         sqrt(2 * checkpoint_wr_time * (c_params->mtti * 60 * 60))
             - checkpoint_wr_time;
 
     /* calculate how many bytes each rank contributes to total checkpoint */
-    new_state->io_per_checkpoint = (c_params->checkpoint_sz * pow(1024, 4))
+    app->io_per_checkpoint = (c_params->checkpoint_sz * pow(1024, 4))
         / c_params->nprocs;
 
-    /* add state for this checkpoint to hash table */
-    this_chkpoint_id.rank = rank;
-    this_chkpoint_id.app_id = app_id;
-    qhash_add(chkpoint_state_tbl, &this_chkpoint_id, &(new_state->hash_link));
-    chkpoint_tbl_pop++;
+    /* a zero-sized checkpoint still issues a single (empty) write */
+    if (app->collective || app->io_per_checkpoint == 0)
+        app->writes_per_checkpoint = 1;
+    else
+        app->writes_per_checkpoint =
+            (app->io_per_checkpoint + DEFAULT_WR_BUF_SIZE - 1)
+            / DEFAULT_WR_BUF_SIZE;
+
+    app->ops_per_iter = app->writes_per_checkpoint + 3;
+    app->total_ops = app->ops_per_iter * c_params->total_checkpoints;
+
+    app->next_op = calloc(app->nprocs, sizeof(*app->next_op));
+    assert(app->next_op);
+
+    return app;
+}
+
+static int checkpoint_workload_load(const char* params, int app_id, int rank)
+{
+    checkpoint_wrkld_params *c_params = (checkpoint_wrkld_params *)params;
+    struct checkpoint_app *app;
+
+    if (!c_params || app_id < 0)
+        return(-1);
+
+    if (app_id >= chkpoint_apps_cnt)
+    {
+        chkpoint_apps = realloc(chkpoint_apps,
+                (app_id + 1) * sizeof(*chkpoint_apps));
+        assert(chkpoint_apps);
+        memset(chkpoint_apps + chkpoint_apps_cnt, 0,
+                (app_id + 1 - chkpoint_apps_cnt) * sizeof(*chkpoint_apps));
+        chkpoint_apps_cnt = app_id + 1;
+    }
+
+    app = chkpoint_apps[app_id];
+    if (!app)
+    {
+        app = checkpoint_app_init(c_params, app_id);
+        chkpoint_apps[app_id] = app;
+    }
+    else if (app->nprocs != c_params->nprocs)
+        tw_error(TW_LOC, "checkpoint workload: app %d rank %d passed in a "
+                "different rank count (%d vs. %d)", app_id, rank,
+                c_params->nprocs, app->nprocs);
+
+    if (rank < 0 || rank >= app->nprocs)
+        return(-1);
+
+    app->next_op[rank] = 0;
 
     return(0);
 }
 
-static void checkpoint_workload_get_next_rc2(int app_id, int rank)
+static struct checkpoint_app * checkpoint_app_get(int app_id, int rank)
 {
-    struct qhash_head *hash_link = NULL;
-    struct checkpoint_state *this_state = NULL;
-    struct checkpoint_id tmp;
-
-    /* find the checkpoint state for this rank/app_id combo */
-    tmp.rank = rank;
-    tmp.app_id = app_id;
-    
-    hash_link = qhash_search(chkpoint_state_tbl, &tmp);
-    if (!hash_link)
+    if (app_id < 0 || app_id >= chkpoint_apps_cnt || !chkpoint_apps[app_id]
+            || rank < 0 || rank >= chkpoint_apps[app_id]->nprocs)
     {
         fprintf(stderr, "No checkpoint context found for rank %d (app_id = %d)\n",
             rank, app_id);
-        return;
+        return NULL;
     }
-    this_state = qhash_entry(hash_link, struct checkpoint_state, hash_link);
-    assert(this_state);
+    return chkpoint_apps[app_id];
+}
 
-    switch(this_state->status)
-    {
-        case CHECKPOINT_COMPUTE:
-            /* rollback the status back to compute*/
-            this_state->status = CHECKPOINT_COMPUTE;
-            break;
+static void checkpoint_workload_get_next_rc2(int app_id, int rank)
+{
+    struct checkpoint_app *app = checkpoint_app_get(app_id, rank);
 
-        case CHECKPOINT_OPEN_FILE:
-            /* rollback the status to checkpoint open file */
-            this_state->status = CHECKPOINT_OPEN_FILE;
-            this_state->cur_checkpoint_sz = this_state->saved_prev_checkpoint_sz;
-            break;
+    if (!app)
+        return;
 
-        case CHECKPOINT_WRITE:
-            this_state->status = CHECKPOINT_WRITE;
-            this_state->cur_checkpoint_sz = this_state->saved_cur_checkpoint_sz;
-            break;
+    assert(app->next_op[rank] > 0);
+    app->next_op[rank]--;
+}
 
-        case CHECKPOINT_CLOSE_FILE:
-            this_state->cur_checkpoint--;
-            this_state->status = CHECKPOINT_CLOSE_FILE;
-            break;
+static void checkpoint_workload_get_next_rc2_batch(int app_id, int rank,
+        int count)
+{
+    struct checkpoint_app *app = checkpoint_app_get(app_id, rank);
 
-        case CHECKPOINT_INACTIVE:
-            this_state->status = CHECKPOINT_INACTIVE;
-            break;
-        
-        default:
-            fprintf(stderr, "Invalid checkpoint workload status for "
-                "rank %d (app_id = %d)\n", rank, app_id);
-            return;
-    }
+    if (!app)
+        return;
+
+    assert(app->next_op[rank] >= count);
+    app->next_op[rank] -= count;
 }
 
-/* find the next workload operation to issue for this rank */
-static void checkpoint_workload_get_next(int app_id, int rank, struct codes_workload_op *op)
+/* derive the op at position op_ndx of the rank's op stream */
+static void checkpoint_fill_op(struct checkpoint_app const *app, int rank,
+        long long op_ndx, struct codes_workload_op *op)
 {
-    struct qhash_head *hash_link = NULL;
-    struct checkpoint_state *this_state = NULL;
-    struct checkpoint_id tmp;
-    long long remaining;
-
-    /* find the checkpoint state for this rank/app_id combo */
-    tmp.rank = rank;
-    tmp.app_id = app_id;
-    hash_link = qhash_search(chkpoint_state_tbl, &tmp);
-    if (!hash_link)
+    long long iter, pos, write_ndx, remaining;
+
+    if (op_ndx >= app->total_ops)
     {
-        fprintf(stderr, "No checkpoint context found for rank %d (app_id = %d)\n",
-            rank, app_id);
+        /* all compute checkpoint iterations complete, so just end
+         * the workload
+         */
         op->op_type = CODES_WK_END;
         return;
     }
-    this_state = qhash_entry(hash_link, struct checkpoint_state, hash_link);
-    assert(this_state);
 
-    switch (this_state->status)
+    /* checkpoint files are numbered from 1 */
+    iter = op_ndx / app->ops_per_iter;
+    pos = op_ndx % app->ops_per_iter;
+
+    if (pos == CHECKPOINT_COMPUTE)
     {
-        case CHECKPOINT_COMPUTE:
-            /* the workload is just starting or the previous checkpoint
-             * file was just closed, so we start the next computation
-             * cycle, with duration == checkpoint_interval time
-             */
-
-            /* set delay operation parameters */
-            op->op_type = CODES_WK_DELAY;
-            op->u.delay.seconds = this_state->checkpoint_interval;
-
-            /* set the next status */
-            this_state->status = CHECKPOINT_OPEN_FILE;
-            break;
-        case CHECKPOINT_OPEN_FILE:
-            /* we just finished a computation phase, so we need to
-             * open the next checkpoint file to start a dump */
-            /* TODO: do we synchronize before opening? */
-            /* TODO: how do we get unique file_ids for different ranks, apps, and checkpoint iterations */
-
-            /* set open parameters */
-            op->op_type = CODES_WK_OPEN;
-            op->u.open.file_id = this_state->cur_checkpoint;
-            op->u.open.create_flag = 1;
-
-            /* set the next status */
-            this_state->saved_prev_checkpoint_sz = this_state->cur_checkpoint_sz;
-            this_state->cur_checkpoint_sz = 0;
-            this_state->status = CHECKPOINT_WRITE;
-            break;
-        case CHECKPOINT_WRITE:
-            /* we just opened the checkpoint file, so we being looping
-             * over the write operations we need to perform
-             */
-            remaining = this_state->io_per_checkpoint
-                - this_state->cur_checkpoint_sz;
-
-            /* set write parameters */
-            op->op_type = CODES_WK_WRITE;
-            op->u.write.file_id = this_state->cur_checkpoint;
-            op->u.write.offset = this_state->cur_checkpoint_sz;
-            if (remaining >= DEFAULT_WR_BUF_SIZE)
-                op->u.write.size = DEFAULT_WR_BUF_SIZE;
-            else
-                op->u.write.size = remaining;
-
-            /* set the next status -- only advance to checkpoint
-             * file close if we have completed the checkpoint
-             * writing phase
-             */
-            this_state->saved_cur_checkpoint_sz = this_state->cur_checkpoint_sz;
-            this_state->cur_checkpoint_sz += op->u.write.size;
-            if (this_state->cur_checkpoint_sz == this_state->io_per_checkpoint)
-                this_state->status = CHECKPOINT_CLOSE_FILE;
-            break;
-        case CHECKPOINT_CLOSE_FILE:
-            /* we just completed a checkpoint writing phase, so we need to
-             * close the current checkpoint file
-             */
-
-            /* set close parameters */
-            op->op_type = CODES_WK_CLOSE;
-            op->u.close.file_id = this_state->cur_checkpoint;
-
-            /* set the next status -- if there are more iterations to
-             * be completed, start the next compute/checkpoint phase;
-             * otherwise, end the workload
-             */
-            this_state->cur_checkpoint++;
-            if (this_state->cur_checkpoint > this_state->total_checkpoints)
-            {
-                this_state->status = CHECKPOINT_INACTIVE;
-            }
-            else
-            {
-                this_state->status = CHECKPOINT_COMPUTE;
-            }
-            break;
-        case CHECKPOINT_INACTIVE:
-            /* all compute checkpoint iterations complete, so just end
-             * the workload
-             */
-            op->op_type = CODES_WK_END;
-
-            /* remove hash entry */
-            /*qhash_del(hash_link);
-            free(this_state);
-            chkpoint_tbl_pop--;
-            if (!chkpoint_tbl_pop)
-            {
-                qhash_finalize(chkpoint_state_tbl);
-                chkpoint_state_tbl = NULL;
-            }*/
-            break; 
-        default:
-            fprintf(stderr, "Invalid checkpoint workload status for "
-                "rank %d (app_id = %d)\n", rank, app_id);
-            op->op_type = CODES_WK_END;
-            return;
+        /* the workload is just starting or the previous checkpoint
+         * file was just closed, so we start the next computation
+         * cycle, with duration == checkpoint_interval time
+         */
+        op->op_type = CODES_WK_DELAY;
+        op->u.delay.seconds = app->checkpoint_interval;
+    }
+    else if (pos == CHECKPOINT_OPEN_FILE)
+    {
+        /* we just finished a computation phase, so we need to
+         * open the next checkpoint file to start a dump */
+        /* TODO: how do we get unique file_ids for different ranks, apps, and checkpoint iterations */
+        op->op_type = app->collective ? CODES_WK_MPI_COLL_OPEN : CODES_WK_OPEN;
+        op->u.open.file_id = iter + 1;
+        op->u.open.create_flag = 1;
+    }
+    else if (pos == app->ops_per_iter - 1)
+    {
+        /* we just completed a checkpoint writing phase, so we need to
+         * close the current checkpoint file
+         */
+        op->op_type = app->collective ? CODES_WK_MPI_CLOSE : CODES_WK_CLOSE;
+        op->u.close.file_id = iter + 1;
+    }
+    else if (app->collective)
+    {
+        /* the whole job writes its checkpoint as a single collective
+         * operation into a shared file, ordered by rank */
+        op->op_type = CODES_WK_MPI_COLL_WRITE;
+        op->u.write.file_id = iter + 1;
+        op->u.write.offset = (off_t)rank * app->io_per_checkpoint;
+        op->u.write.size = app->io_per_checkpoint;
+    }
+    else
+    {
+        /* loop over the write operations we need to perform */
+        write_ndx = pos - CHECKPOINT_WRITE;
+        remaining = app->io_per_checkpoint - write_ndx * DEFAULT_WR_BUF_SIZE;
+
+        op->op_type = CODES_WK_WRITE;
+        op->u.write.file_id = iter + 1;
+        op->u.write.offset = write_ndx * DEFAULT_WR_BUF_SIZE;
+        if (remaining >= DEFAULT_WR_BUF_SIZE)
+            op->u.write.size = DEFAULT_WR_BUF_SIZE;
+        else
+            op->u.write.size = remaining;
     }
 
     return;
 }
 
-static int checkpoint_state_compare(void *key, struct qhash_head *link)
+/* find the next workload operation to issue for this rank */
+static void checkpoint_workload_get_next(int app_id, int rank, struct codes_workload_op *op)
+{
+    struct checkpoint_app *app = checkpoint_app_get(app_id, rank);
+
+    if (!app)
+    {
+        op->op_type = CODES_WK_END;
+        return;
+    }
+
+    /* the cursor always advances (including past the end) so that the
+     * reverse handler is an unconditional decrement */
+    checkpoint_fill_op(app, rank, app->next_op[rank]++, op);
+}
+
+static int checkpoint_workload_get_next_batch(int app_id, int rank,
+        struct codes_workload_op *ops, int max_ops)
 {
-    struct checkpoint_id *in = (struct checkpoint_id *)key;
-    struct checkpoint_state *tmp = NULL;
+    struct checkpoint_app *app = checkpoint_app_get(app_id, rank);
+    int n = 0;
 
-    tmp = qhash_entry(link, struct checkpoint_state, hash_link);
-    if ((tmp->rank == in->rank) && (tmp->app_id == in->app_id))
-        return(1);
+    if (!app)
+    {
+        if (max_ops < 1)
+            return 0;
+        ops[0].op_type = CODES_WK_END;
+        return 1;
+    }
 
-    return(0);
+    while (n < max_ops)
+    {
+        checkpoint_fill_op(app, rank, app->next_op[rank]++, &ops[n]);
+        if (ops[n++].op_type == CODES_WK_END)
+            break;
+    }
+    return n;
 }
 
 /*
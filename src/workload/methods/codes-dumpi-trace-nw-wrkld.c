@@ -10,6 +10,7 @@
 #include <mpi.h>
 #include <ross.h>
 #include <assert.h>
+#include <pthread.h>
 #include "dumpi/libundumpi/bindings.h"
 #include "dumpi/libundumpi/libundumpi.h"
 #include "codes/codes-workload.h"
@@ -45,6 +46,8 @@ extern struct codes_jobmap_ctx *jobmap_ctx;
 
 static struct qhash_table *rank_tbl = NULL;
 static int rank_tbl_pop = 0;
+/* protects rank_tbl when ranks are loaded concurrently */
+static pthread_mutex_t rank_tbl_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static unsigned int max_threshold = INT_MAX;
 /* context of the MPI workload */
@@ -226,6 +229,41 @@ static void dumpi_remove_next_op(void *mpi_op_array, struct codes_workload_op *m
 	}*/
 }
 
+/* removes up to max_ops operations from the array in one go, stopping after
+ * the terminating CODES_WK_END. Returns the number of operations copied */
+static int dumpi_remove_next_ops(void *mpi_op_array, struct codes_workload_op *mpi_ops,
+                                      int max_ops)
+{
+    dumpi_op_data_array *array = (dumpi_op_data_array*)mpi_op_array;
+    int64_t i, avail;
+    int n = 0;
+
+    if (max_ops <= 0)
+        return 0;
+
+    avail = array->op_arr_cnt - array->op_arr_ndx;
+    if (avail > 0)
+    {
+        if (avail > max_ops)
+            avail = max_ops;
+        memcpy(mpi_ops, &array->op_array[array->op_arr_ndx],
+                avail * sizeof(*mpi_ops));
+        for (i = 0; i < avail; i++)
+            mpi_ops[i].sequence_id = array->op_arr_ndx + i;
+        array->op_arr_ndx += avail;
+        n = avail;
+    }
+
+    if (n < max_ops)
+    {
+        mpi_ops[n].op_type = CODES_WK_END;
+        mpi_ops[n].sequence_id = array->op_arr_ndx;
+        array->op_arr_ndx++;
+        n++;
+    }
+    return n;
+}
+
 /* check for initialization and normalize reported time */
 static inline void check_set_init_time(const dumpi_time *t, rank_mpi_context * my_ctx)
 {
@@ -595,6 +633,7 @@ int handleDUMPIBcast(const dumpi_bcast *prm, uint16_t thread,
 
         wrkld_per_rank.op_type = CODES_WK_BCAST;
         wrkld_per_rank.u.collective.num_bytes = prm->count * get_num_bytes(myctx,prm->datatype);
+        wrkld_per_rank.u.collective.root = prm->root;
 	    assert(wrkld_per_rank.u.collective.num_bytes >= 0);
 
         update_times_and_insert(&wrkld_per_rank, wall, myctx);
@@ -697,6 +736,7 @@ int handleDUMPIReduce(const dumpi_reduce *prm, uint16_t thread,
 
         wrkld_per_rank.op_type = CODES_WK_REDUCE;
         wrkld_per_rank.u.collective.num_bytes = prm->count * get_num_bytes(myctx,prm->datatype);
+        wrkld_per_rank.u.collective.root = prm->root;
 	    assert(wrkld_per_rank.u.collective.num_bytes > 0);
 
         update_times_and_insert(&wrkld_per_rank, wall, myctx);
@@ -788,12 +828,17 @@ int dumpi_trace_nw_workload_load(const char* params, int app_id, int rank)
     if(dumpi_params->nprocs > 0)
         hash_size = (dumpi_params->num_net_traces / dumpi_params->nprocs) + 1;
 	
+    pthread_mutex_lock(&rank_tbl_lock);
     if(!rank_tbl)
     	{
             rank_tbl = qhash_init(hash_rank_compare, quickhash_64bit_hash, hash_size);
             if(!rank_tbl)
+            {
+                  pthread_mutex_unlock(&rank_tbl_lock);
                   return -1;
+            }
     	}
+    pthread_mutex_unlock(&rank_tbl_lock);
 	
 	rank_mpi_context *my_ctx;
 	my_ctx = malloc(sizeof(rank_mpi_context));
@@ -975,8 +1020,10 @@ int dumpi_trace_nw_workload_load(const char* params, int app_id, int rank)
         rank_mpi_compare cmp;
         cmp.app = my_ctx->my_app_id;
         cmp.rank = my_ctx->my_rank;
+    pthread_mutex_lock(&rank_tbl_lock);
 	qhash_add(rank_tbl, &cmp, &(my_ctx->hash_link));
 	rank_tbl_pop++;
+    pthread_mutex_unlock(&rank_tbl_lock);
 
 	return 0;
 }
@@ -1123,6 +1170,86 @@ void dumpi_trace_nw_workload_get_next(int app_id, int rank, struct codes_workloa
   return;
 }
 
+static rank_mpi_context * dumpi_find_rank_ctx(int app_id, int rank)
+{
+    struct qhash_head *hash_link = NULL;
+    rank_mpi_compare cmp;
+    cmp.rank = rank;
+    cmp.app = app_id;
+
+    hash_link = qhash_search(rank_tbl, &cmp);
+    if(!hash_link)
+        return NULL;
+    return qhash_entry(hash_link, rank_mpi_context, hash_link);
+}
+
+int dumpi_trace_nw_workload_get_next_batch(int app_id, int rank,
+        struct codes_workload_op *ops, int max_ops)
+{
+    rank_mpi_context* temp_data = dumpi_find_rank_ctx(app_id, rank);
+
+    if(!temp_data)
+    {
+        printf("\n not found for rank id %d , %d", rank, app_id);
+        if(max_ops < 1)
+            return 0;
+        ops[0].op_type = CODES_WK_END;
+        return 1;
+    }
+    return dumpi_remove_next_ops(temp_data->dumpi_mpi_array, ops, max_ops);
+}
+
+void dumpi_trace_nw_workload_get_next_rc2_batch(int app_id, int rank, int count)
+{
+    rank_mpi_context* temp_data = dumpi_find_rank_ctx(app_id, rank);
+    dumpi_op_data_array *array;
+
+    assert(temp_data);
+    array = (dumpi_op_data_array*)temp_data->dumpi_mpi_array;
+    array->op_arr_ndx -= count;
+    assert(array->op_arr_ndx >= 0);
+}
+
+/* drops the parsed operations of a rank, which must not be replayed (or
+ * reversed) any further */
+int dumpi_trace_nw_workload_finalize(const char* params, int app_id, int rank)
+{
+    (void)params;
+    rank_mpi_context* temp_data;
+    dumpi_op_data_array *array;
+    int64_t i;
+
+    pthread_mutex_lock(&rank_tbl_lock);
+    temp_data = rank_tbl ? dumpi_find_rank_ctx(app_id, rank) : NULL;
+    if(!temp_data)
+    {
+        pthread_mutex_unlock(&rank_tbl_lock);
+        return -1;
+    }
+    qhash_del(&temp_data->hash_link);
+    rank_tbl_pop--;
+    pthread_mutex_unlock(&rank_tbl_lock);
+
+    array = (dumpi_op_data_array*)temp_data->dumpi_mpi_array;
+    for(i = 0; i < array->op_arr_cnt; i++)
+    {
+        switch(array->op_array[i].op_type)
+        {
+            case CODES_WK_WAITALL:
+            case CODES_WK_WAITSOME:
+            case CODES_WK_WAITANY:
+                free(array->op_array[i].u.waits.req_ids);
+                break;
+            default:
+                break;
+        }
+    }
+    free(array->op_array);
+    free(array);
+    free(temp_data);
+    return 0;
+}
+
 /* implements the codes workload method */
 struct codes_workload_method dumpi_trace_workload_method =
 {
@@ -1131,6 +1258,14 @@ struct codes_workload_method dumpi_trace_workload_method =
     .codes_workload_load = dumpi_trace_nw_workload_load,
     .codes_workload_get_next = dumpi_trace_nw_workload_get_next,
     .codes_workload_get_next_rc2 = dumpi_trace_nw_workload_get_next_rc2,
+    .codes_workload_get_next_batch = dumpi_trace_nw_workload_get_next_batch,
+    .codes_workload_get_next_rc2_batch = dumpi_trace_nw_workload_get_next_rc2_batch,
+    .codes_workload_finalize = dumpi_trace_nw_workload_finalize,
+#ifndef ENABLE_CORTEX
+    /* each rank parses its own trace file; only rank_tbl is shared. CoRtEx
+     * translation (and its python interpreter) is not reentrant */
+    .thread_safe_load = 1,
+#endif
 };
 
 /*
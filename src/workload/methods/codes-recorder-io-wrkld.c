@@ -12,8 +12,11 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <unistd.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <dirent.h>
+#include <pthread.h>
 
 #include "ross.h"
 #include "codes/codes-workload.h"
@@ -24,11 +27,32 @@
 
 #define RANK_HASH_TABLE_SIZE 397
 
+/* binary trace cache produced by recorder_io_workload_convert. Layout:
+ * header, (nprocs + 1) uint64_t record indices (rank r owns records
+ * [index[r], index[r+1])), then the packed recorder_io_op records */
+#define RECORDER_CACHE_MAGIC "CODESREC"
+#define RECORDER_CACHE_VERSION 1
+
+struct recorder_cache_hdr
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t op_size;
+    int64_t nprocs;
+};
+
+/* a single trace op, in the form stored in the binary cache. Fields are
+ * interpreted according to op_type when the op is handed out */
 struct recorder_io_op
 {
     double start_time;
     double end_time;
-    struct codes_workload_op codes_op;
+    uint64_t file_id;
+    int64_t offset;
+    uint64_t size;
+    int32_t op_type;
+    /* barrier count or open create flag */
+    int32_t arg;
 };
 
 struct file_entry
@@ -44,9 +68,11 @@ struct rank_traces_context
     int rank;
     double last_op_time;
 
-    struct recorder_io_op trace_ops[2048]; /* TODO: this should be extendable */
-    int trace_list_ndx;
-    int trace_list_max;
+    /* points either into the mmapped cache or at trace_ops_buf */
+    const struct recorder_io_op *trace_ops;
+    struct recorder_io_op *trace_ops_buf;
+    int64_t trace_list_ndx;
+    int64_t trace_list_max;
 
     /* hash table link to next rank (if any) */
     struct qhash_head hash_link;
@@ -67,46 +93,50 @@ struct codes_workload_method recorder_io_workload_method =
     .codes_workload_read_config = NULL,
     .codes_workload_load = recorder_io_workload_load,
     .codes_workload_get_next = recorder_io_workload_get_next,
+    .thread_safe_load = 1,
 };
 
 static struct qhash_table *rank_tbl = NULL;
 static int rank_tbl_pop = 0;
+/* protects rank_tbl and the trace caches during concurrent loads */
+static pthread_mutex_t load_lock = PTHREAD_MUTEX_INITIALIZER;
 
-/* load the workload generator for this rank, given input params */
-static int recorder_io_workload_load(const char *params, int app_id, int rank)
+/* the trace cache of a trace directory, mapped once per PE. Loaded ranks
+ * point into the mapping, so it is kept until the generator shuts down. A
+ * directory without a usable cache is remembered with map == NULL */
+struct recorder_cache
 {
-    recorder_params *r_params = (recorder_params *) params;
-    struct rank_traces_context *newv = NULL;
-    struct qhash_table *file_id_tbl = NULL;
-    struct qhash_head *link = NULL;
-    struct file_entry *file;
-
-    APP_ID_UNSUPPORTED(app_id, "recorder")
-
-    int64_t nprocs = r_params->nprocs;
-    char *trace_dir = r_params->trace_dir_path;
-    if(!trace_dir)
-        return -1;
-
-    /* allocate a new trace context for this rank */
-    newv = (struct rank_traces_context*)malloc(sizeof(*newv));
-    if(!newv)
-        return -1;
+    char trace_dir[MAX_NAME_LENGTH_WKLD];
+    int64_t nprocs;
+    void *map;
+    size_t len;
+    struct recorder_cache *next;
+};
 
-    newv->rank = rank;
-    newv->trace_list_ndx = 0;
-    newv->trace_list_max = 0;
+static struct recorder_cache *caches = NULL;
 
-#if 0
-    DIR *dirp;
-    struct dirent *entry;
-    dirp = opendir(trace_dir);
-    while((entry = readdir(dirp)) != NULL) {
-        if(entry->d_type == DT_REG)
-            nprocs++;
+static void recorder_push_op(struct recorder_io_op **ops, int64_t *cnt,
+        int64_t *cap, struct recorder_io_op const *r_op)
+{
+    if (*cnt == *cap)
+    {
+        *cap = *cap ? 2 * *cap : 2048;
+        *ops = realloc(*ops, *cap * sizeof(**ops));
+        assert(*ops);
     }
-    closedir(dirp);
-#endif
+    (*ops)[(*cnt)++] = *r_op;
+}
+
+/* parse the text log of the given rank into a newly allocated op array.
+ * Returns the op count, or -1 on failure */
+static int64_t recorder_parse_rank_log(const char *trace_dir, int64_t nprocs,
+        int rank, struct recorder_io_op **ops_out)
+{
+    struct qhash_table *file_id_tbl = NULL;
+    struct qhash_head *link = NULL;
+    struct file_entry *file;
+    struct recorder_io_op *ops = NULL;
+    int64_t ops_cnt = 0, ops_cap = 0;
 
     char trace_file_name[1024] = {'\0'};
     sprintf(trace_file_name, "%s/log.%d", trace_dir, rank);
@@ -116,6 +146,7 @@ static int recorder_io_workload_load(const char *params, int app_id, int rank)
         return -1;
 
     char *line = NULL;
+    char *save_ptr = NULL;
     size_t len;
     ssize_t ret_value;
     char function_name[128] = {'\0'};
@@ -123,16 +154,17 @@ static int recorder_io_workload_load(const char *params, int app_id, int rank)
     double io_start_time = 0.0;
     while((ret_value = getline(&line, &len, trace_file)) != -1) {
         struct recorder_io_op r_op;
-        char *token = strtok(line, ", \n");
+        char *token = strtok_r(line, ", \n", &save_ptr);
         int fd;
 
+        memset(&r_op, 0, sizeof(r_op));
         if (strcmp(token, "BARRIER") && strcmp(token, "0"))
         {
             if (wkld_start_time == 0.0)
                 wkld_start_time = atof(token);
 
             r_op.start_time = atof(token) - wkld_start_time;
-            token = strtok(NULL, ", ");
+            token = strtok_r(NULL, ", ", &save_ptr);
         }
         strcpy(function_name, token);
 
@@ -140,132 +172,84 @@ static int recorder_io_workload_load(const char *params, int app_id, int rank)
             char *filename = NULL;
             char *open_flags = NULL;
 
-            filename = strtok(NULL, ", (");
-            open_flags = strtok(NULL, ", )");
+            filename = strtok_r(NULL, ", (", &save_ptr);
+            open_flags = strtok_r(NULL, ", )", &save_ptr);
 
             if (!(atoi(open_flags) & O_CREAT))
             {
-                r_op.codes_op.op_type = CODES_WK_BARRIER;
+                r_op.op_type = CODES_WK_BARRIER;
                 r_op.end_time = r_op.start_time;
+                r_op.arg = nprocs;
 
-                r_op.codes_op.u.barrier.count = nprocs;
-                r_op.codes_op.u.barrier.root = 0;
-
-                newv->trace_ops[newv->trace_list_ndx++] = r_op;
-                if (newv->trace_list_ndx == 2048) break;
+                recorder_push_op(&ops, &ops_cnt, &ops_cap, &r_op);
             }
 
-            token = strtok(NULL, ", )");
-            token = strtok(NULL, ", ");
+            token = strtok_r(NULL, ", )", &save_ptr);
+            token = strtok_r(NULL, ", ", &save_ptr);
             fd = atoi(token);
 
-            token = strtok(NULL, ", \n");
+            token = strtok_r(NULL, ", \n", &save_ptr);
             r_op.end_time = r_op.start_time + atof(token);
 
             if (!file_id_tbl)
             {
                 file_id_tbl = qhash_init(hash_file_compare, quickhash_32bit_hash, 11);
                 if (!file_id_tbl)
-                {
-                    free(newv);
-                    return -1;
-                }
+                    goto fail;
             }
 
             file = (struct file_entry*)malloc(sizeof(struct file_entry));
             if (!file)
-            {
-                free(newv);
-                return -1;
-            }
-            
+                goto fail;
+
             uint32_t h1 = 0x00000000, h2 = 0xFFFFFFFF;
             bj_hashlittle2(filename, strlen(filename), &h1, &h2);
             file->file_id = h1 + (((uint64_t)h2)<<32);
             file->fd = fd;
-            r_op.codes_op.op_type = CODES_WK_OPEN;
-            r_op.codes_op.u.open.file_id = file->file_id;
-            r_op.codes_op.u.open.create_flag = atoi(open_flags) & O_CREAT;
+            r_op.op_type = CODES_WK_OPEN;
+            r_op.file_id = file->file_id;
+            r_op.arg = atoi(open_flags) & O_CREAT;
 
             qhash_add(file_id_tbl, &fd, &(file->hash_link));
         }
         else if(!strcmp(function_name, "close")) {
-            r_op.codes_op.op_type = CODES_WK_CLOSE;
+            r_op.op_type = CODES_WK_CLOSE;
 
-            token = strtok(NULL, ", ()");
+            token = strtok_r(NULL, ", ()", &save_ptr);
             fd = atoi(token);
 
-            token = strtok(NULL, ", ");
-            token = strtok(NULL, ", \n");
+            token = strtok_r(NULL, ", ", &save_ptr);
+            token = strtok_r(NULL, ", \n", &save_ptr);
             r_op.end_time = r_op.start_time + atof(token);
 
-            link = qhash_search(file_id_tbl, &fd);
+            link = file_id_tbl ? qhash_search(file_id_tbl, &fd) : NULL;
             if (!link)
-            {
-                free(newv);
-                return -1;
-            }
+                goto fail;
 
             file = qhash_entry(link, struct file_entry, hash_link);
-            r_op.codes_op.u.close.file_id = file->file_id;
+            r_op.file_id = file->file_id;
 
             qhash_del(link);
             free(file);
         }
-        else if(!strcmp(function_name, "read") || !strcmp(function_name, "read64")) {
-            r_op.codes_op.op_type = CODES_WK_READ;
-
-            token = strtok(NULL, ", (");
-            fd = atoi(token);
-
-            // Throw out the buffer
-            token = strtok(NULL, ", ");
-
-            token = strtok(NULL, ", )");
-            r_op.codes_op.u.read.size = atol(token);
-
-            token = strtok(NULL, ", )");
-            r_op.codes_op.u.read.offset = atol(token);
-
-            token = strtok(NULL, ", ");
-            token = strtok(NULL, ", \n");
-
-            if (io_start_time == 0.0)
-            {
-                r_op.end_time = r_op.start_time + atof(token);
-            }
-            else
-            {
-                r_op.start_time = r_op.end_time = io_start_time;
-            }
-
-            link = qhash_search(file_id_tbl, &fd);
-            if (!link)
-            {
-                free(newv);
-                return -1;
-            }
-
-            file = qhash_entry(link, struct file_entry, hash_link);
-            r_op.codes_op.u.read.file_id = file->file_id;
-        }
-        else if(!strcmp(function_name, "write") || !strcmp(function_name, "write64")) {
-            r_op.codes_op.op_type = CODES_WK_WRITE;
+        else if(!strcmp(function_name, "read") || !strcmp(function_name, "read64") ||
+                !strcmp(function_name, "write") || !strcmp(function_name, "write64")) {
+            r_op.op_type = (function_name[0] == 'r') ? CODES_WK_READ : CODES_WK_WRITE;
 
-            token = strtok(NULL, ", (");
+            token = strtok_r(NULL, ", (", &save_ptr);
             fd = atoi(token);
 
             // Throw out the buffer
-            token = strtok(NULL, ", ");
+            token = strtok_r(NULL, ", ", &save_ptr);
 
-            token = strtok(NULL, ", )");
-            r_op.codes_op.u.write.size = atol(token);
+            token = strtok_r(NULL, ", )", &save_ptr);
+            r_op.size = atol(token);
 
-            token = strtok(NULL, ", )");
-            r_op.codes_op.u.write.offset = atol(token);
+            token = strtok_r(NULL, ", )", &save_ptr);
+            r_op.offset = atol(token);
 
-            token = strtok(NULL, ", ");
-            token = strtok(NULL, ", \n");
+            token = strtok_r(NULL, ", ", &save_ptr);
+            token = strtok_r(NULL, ", \n", &save_ptr);
 
             if (io_start_time == 0.0)
             {
@@ -276,26 +260,23 @@ static int recorder_io_workload_load(const char *params, int app_id, int rank)
                 r_op.start_time = r_op.end_time = io_start_time;
             }
 
-            link = qhash_search(file_id_tbl, &fd);
+            link = file_id_tbl ? qhash_search(file_id_tbl, &fd) : NULL;
             if (!link)
-            {
-                free(newv);
-                return -1;
-            }
+                goto fail;
 
             file = qhash_entry(link, struct file_entry, hash_link);
-            r_op.codes_op.u.write.file_id = file->file_id;
+            r_op.file_id = file->file_id;
         }
         else if(!strcmp(function_name, "BARRIER")) {
             r_op.start_time = r_op.end_time = io_start_time;
-            
-            r_op.codes_op.op_type = CODES_WK_BARRIER;
-            r_op.codes_op.u.barrier.count = nprocs;
-            r_op.codes_op.u.barrier.root = 0;
+
+            r_op.op_type = CODES_WK_BARRIER;
+            r_op.arg = nprocs;
         }
         else if(!strcmp(function_name, "0")) {
-            token = strtok (NULL, ", \n");
-            newv->trace_ops[newv->trace_list_ndx-1].end_time += atof(token);
+            token = strtok_r(NULL, ", \n", &save_ptr);
+            if (ops_cnt > 0)
+                ops[ops_cnt-1].end_time += atof(token);
 
             io_start_time = 0.0;
             continue;
@@ -308,24 +289,280 @@ static int recorder_io_workload_load(const char *params, int app_id, int rank)
             continue;
         }
 
-        newv->trace_ops[newv->trace_list_ndx++] = r_op;
-        if (newv->trace_list_ndx == 2048) break;
+        recorder_push_op(&ops, &ops_cnt, &ops_cap, &r_op);
     }
 
+    free(line);
     fclose(trace_file);
-    qhash_finalize(file_id_tbl);
+    if (file_id_tbl)
+        qhash_destroy_and_finalize(file_id_tbl, struct file_entry, hash_link, free);
 
-    /* reset ndx to 0 and set max to event count */
-    /* now we can read all events by counting through array from 0 - max */
-    newv->trace_list_max = newv->trace_list_ndx;
+    *ops_out = ops;
+    return ops_cnt;
+
+fail:
+    free(line);
+    free(ops);
+    fclose(trace_file);
+    if (file_id_tbl)
+        qhash_destroy_and_finalize(file_id_tbl, struct file_entry, hash_link, free);
+    return -1;
+}
+
+/* map the binary cache of trace_dir into c, leaving c->map NULL if there
+ * is none or it is unusable */
+static void recorder_cache_open(struct recorder_cache *c)
+{
+    char cache_file_name[1024] = {'\0'};
+    char log_file_name[1024] = {'\0'};
+    struct recorder_cache_hdr const *hdr;
+    struct stat st, log_st;
+    int64_t r;
+    int fd;
+
+    sprintf(cache_file_name, "%s/%s", c->trace_dir, RECORDER_CACHE_FILE);
+    fd = open(cache_file_name, O_RDONLY);
+    if (fd < 0)
+        return;
+
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(*hdr))
+    {
+        close(fd);
+        return;
+    }
+
+    c->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (c->map == MAP_FAILED)
+    {
+        c->map = NULL;
+        return;
+    }
+    c->len = st.st_size;
+
+    hdr = c->map;
+    if (memcmp(hdr->magic, RECORDER_CACHE_MAGIC, sizeof(hdr->magic)) ||
+        hdr->version != RECORDER_CACHE_VERSION ||
+        hdr->op_size != sizeof(struct recorder_io_op) ||
+        hdr->nprocs != c->nprocs ||
+        c->len < sizeof(*hdr) + (c->nprocs + 1) * sizeof(uint64_t))
+    {
+        fprintf(stderr, "recorder: ignoring incompatible trace cache %s\n",
+                cache_file_name);
+        goto fail;
+    }
+
+    /* a log rewritten after the conversion makes the cache stale */
+    for (r = 0; r < c->nprocs; r++)
+    {
+        sprintf(log_file_name, "%s/log.%"PRId64, c->trace_dir, r);
+        if (stat(log_file_name, &log_st) == 0 && log_st.st_mtime > st.st_mtime)
+        {
+            fprintf(stderr, "recorder: ignoring trace cache %s, older than "
+                    "%s\n", cache_file_name, log_file_name);
+            goto fail;
+        }
+    }
+    return;
+
+fail:
+    munmap(c->map, c->len);
+    c->map = NULL;
+    c->len = 0;
+}
+
+/* the cache of trace_dir, mapped on first use. Called with load_lock held */
+static struct recorder_cache *recorder_cache_get(const char *trace_dir,
+        int64_t nprocs)
+{
+    struct recorder_cache *c;
+
+    for (c = caches; c; c = c->next)
+        if (c->nprocs == nprocs && !strcmp(c->trace_dir, trace_dir))
+            return c;
+
+    c = calloc(1, sizeof(*c));
+    assert(c);
+    strncpy(c->trace_dir, trace_dir, MAX_NAME_LENGTH_WKLD - 1);
+    c->nprocs = nprocs;
+    recorder_cache_open(c);
+    c->next = caches;
+    caches = c;
+    return c;
+}
+
+/* points *ops_out at the records of rank in the cache. Returns their count,
+ * or -1 if the index of the rank does not fit the file */
+static int64_t recorder_cache_slice(struct recorder_cache const *c, int rank,
+        struct recorder_io_op const **ops_out)
+{
+    uint64_t const *index = (uint64_t const *)
+        ((char const *)c->map + sizeof(struct recorder_cache_hdr));
+    struct recorder_io_op const *ops = (struct recorder_io_op const *)
+        (index + c->nprocs + 1);
+    uint64_t max_ops = (c->len - ((char const *)ops - (char const *)c->map)) /
+        sizeof(*ops);
+
+    if (index[rank] > index[rank+1] || index[rank+1] > max_ops)
+        return -1;
+
+    *ops_out = ops + index[rank];
+    return index[rank+1] - index[rank];
+}
+
+/* unmap all trace caches once no loaded rank points into them */
+static void recorder_cache_finalize(void)
+{
+    while (caches)
+    {
+        struct recorder_cache *c = caches;
+
+        caches = c->next;
+        if (c->map)
+            munmap(c->map, c->len);
+        free(c);
+    }
+}
+
+int recorder_io_workload_convert(const char *trace_dir, int64_t nprocs,
+        const char *out_file)
+{
+    char cache_file_name[1024] = {'\0'};
+    struct recorder_cache_hdr hdr;
+    uint64_t *index;
+    FILE *f;
+    int64_t r;
+
+    if (!out_file)
+    {
+        sprintf(cache_file_name, "%s/%s", trace_dir, RECORDER_CACHE_FILE);
+        out_file = cache_file_name;
+    }
+
+    f = fopen(out_file, "w");
+    if (!f)
+        return -1;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, RECORDER_CACHE_MAGIC, sizeof(hdr.magic));
+    hdr.version = RECORDER_CACHE_VERSION;
+    hdr.op_size = sizeof(struct recorder_io_op);
+    hdr.nprocs = nprocs;
+
+    index = calloc(nprocs + 1, sizeof(*index));
+    assert(index);
+
+    /* the index is rewritten once all ranks have been appended */
+    if (fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+        fwrite(index, sizeof(*index), nprocs + 1, f) != (size_t)nprocs + 1)
+        goto fail;
+
+    for (r = 0; r < nprocs; r++)
+    {
+        struct recorder_io_op *ops = NULL;
+        int64_t cnt = recorder_parse_rank_log(trace_dir, nprocs, r, &ops);
+
+        if (cnt < 0)
+        {
+            fprintf(stderr, "recorder: unable to parse trace of rank %"PRId64
+                    " in %s\n", r, trace_dir);
+            goto fail;
+        }
+
+        if (fwrite(ops, sizeof(*ops), cnt, f) != (size_t)cnt)
+        {
+            free(ops);
+            goto fail;
+        }
+        free(ops);
+        index[r+1] = index[r] + cnt;
+    }
+
+    if (fseek(f, sizeof(hdr), SEEK_SET) ||
+        fwrite(index, sizeof(*index), nprocs + 1, f) != (size_t)nprocs + 1)
+        goto fail;
+
+    free(index);
+    return fclose(f) ? -1 : 0;
+
+fail:
+    free(index);
+    fclose(f);
+    remove(out_file);
+    return -1;
+}
+
+/* load the workload generator for this rank, given input params */
+static int recorder_io_workload_load(const char *params, int app_id, int rank)
+{
+    recorder_params *r_params = (recorder_params *) params;
+    struct rank_traces_context *newv = NULL;
+    struct recorder_cache *cache;
+
+    APP_ID_UNSUPPORTED(app_id, "recorder")
+
+    int64_t nprocs = r_params->nprocs;
+    char *trace_dir = r_params->trace_dir_path;
+    if(!trace_dir)
+        return -1;
+
+    /* allocate a new trace context for this rank */
+    newv = (struct rank_traces_context*)malloc(sizeof(*newv));
+    if(!newv)
+        return -1;
+
+    newv->rank = rank;
     newv->trace_list_ndx = 0;
+    newv->trace_ops_buf = NULL;
+
+#if 0
+    DIR *dirp;
+    struct dirent *entry;
+    dirp = opendir(trace_dir);
+    while((entry = readdir(dirp)) != NULL) {
+        if(entry->d_type == DT_REG)
+            nprocs++;
+    }
+    closedir(dirp);
+#endif
+
+    pthread_mutex_lock(&load_lock);
+    cache = recorder_cache_get(trace_dir, nprocs);
+    newv->trace_list_max = -1;
+    if (cache->map && rank >= 0 && rank < nprocs)
+    {
+        /* ops are read straight out of the mapped cache */
+        newv->trace_list_max = recorder_cache_slice(cache, rank,
+                &newv->trace_ops);
+        if (newv->trace_list_max < 0)
+            fprintf(stderr, "recorder: corrupt index for rank %d in the "
+                    "trace cache of %s, parsing its log\n", rank, trace_dir);
+    }
+    pthread_mutex_unlock(&load_lock);
+
+    if (newv->trace_list_max < 0)
+    {
+        newv->trace_list_max = recorder_parse_rank_log(trace_dir, nprocs,
+                rank, &newv->trace_ops_buf);
+        if (newv->trace_list_max < 0)
+        {
+            free(newv);
+            return -1;
+        }
+        newv->trace_ops = newv->trace_ops_buf;
+    }
+
+    /* now we can read all events by counting through array from 0 - max */
     newv->last_op_time = 0.0;
 
+    pthread_mutex_lock(&load_lock);
     /* initialize the hash table of rank contexts, if it has not been initialized */
     if (!rank_tbl) {
         rank_tbl = qhash_init(hash_rank_compare, quickhash_32bit_hash, RANK_HASH_TABLE_SIZE);
 
         if (!rank_tbl) {
+            pthread_mutex_unlock(&load_lock);
+            free(newv->trace_ops_buf);
             free(newv);
             return -1;
         }
@@ -334,10 +571,44 @@ static int recorder_io_workload_load(const char *params, int app_id, int rank)
     /* add this rank context to the hash table */
     qhash_add(rank_tbl, &(newv->rank), &(newv->hash_link));
     rank_tbl_pop++;
+    pthread_mutex_unlock(&load_lock);
 
     return 0;
 }
 
+/* expand a stored trace op into the workload op handed to the simulator */
+static void recorder_decode_op(struct recorder_io_op const *r_op,
+        struct codes_workload_op *op)
+{
+    op->op_type = r_op->op_type;
+    switch (r_op->op_type)
+    {
+        case CODES_WK_OPEN:
+            op->u.open.file_id = r_op->file_id;
+            op->u.open.create_flag = r_op->arg;
+            break;
+        case CODES_WK_CLOSE:
+            op->u.close.file_id = r_op->file_id;
+            break;
+        case CODES_WK_READ:
+            op->u.read.file_id = r_op->file_id;
+            op->u.read.offset = r_op->offset;
+            op->u.read.size = r_op->size;
+            break;
+        case CODES_WK_WRITE:
+            op->u.write.file_id = r_op->file_id;
+            op->u.write.offset = r_op->offset;
+            op->u.write.size = r_op->size;
+            break;
+        case CODES_WK_BARRIER:
+            op->u.barrier.count = r_op->arg;
+            op->u.barrier.root = 0;
+            break;
+        default:
+            assert(0);
+    }
+}
+
 /* pull the next trace (independent or collective) for this rank from its trace context */
 static void recorder_io_workload_get_next(int app_id, int rank, struct codes_workload_op *op)
 {
@@ -362,6 +633,7 @@ static void recorder_io_workload_get_next(int app_id, int rank, struct codes_wor
         /* no more events -- just end the workload */
         op->op_type = CODES_WK_END;
         qhash_del(hash_link);
+        free(tmp->trace_ops_buf);
         free(tmp);
 
         rank_tbl_pop--;
@@ -369,13 +641,14 @@ static void recorder_io_workload_get_next(int app_id, int rank, struct codes_wor
         {
             qhash_finalize(rank_tbl);
             rank_tbl = NULL;
+            recorder_cache_finalize();
         }
     }
     else {
-        struct recorder_io_op *next_r_op = &(tmp->trace_ops[tmp->trace_list_ndx]);
+        struct recorder_io_op const *next_r_op = &(tmp->trace_ops[tmp->trace_list_ndx]);
 
         if ((next_r_op->start_time - tmp->last_op_time) <= RECORDER_NEGLIGIBLE_DELAY) {
-            *op = next_r_op->codes_op;
+            recorder_decode_op(next_r_op, op);
 
             tmp->trace_list_ndx++;
             tmp->last_op_time = next_r_op->end_time;
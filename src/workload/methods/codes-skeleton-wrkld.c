@@ -0,0 +1,764 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+/* Skeleton workload: reads a dumpi trace through the dumpi workload method,
+ * reduces the operations of each traced rank to a compact program of
+ * (loop body, repeat count) blocks and generates operations from that program
+ * at any multiple of the traced rank count.
+ *
+ * - point-to-point peers are kept as offsets from the own rank, so ranks
+ *   with the same neighbour pattern (typically the interior ranks of a
+ *   decomposition) share one program
+ * - rank r of the generated job runs the program of traced rank
+ *   r % num_traced_ranks and talks to the ranks of its own copy of the traced
+ *   job, so every send still meets its receive. Collectives span the whole
+ *   generated job
+ * - compute delays that repeat within delay_tolerance are folded into one
+ *   loop and replaced by their mean
+ * - a request id is the position of the posting op in the program. A loop
+ *   body is only accepted if the requests it posts are waited on within the
+ *   same iteration, so ids are never reused while outstanding
+ *
+ * The programs are shared by all the ranks of a PE, the state of a rank is
+ * its position in the program.
+ */
+
+#include <assert.h>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include <ross.h>
+#include <codes/codes-workload.h>
+#include <codes/quickhash.h>
+#include <codes/quicklist.h>
+#include <codes/codes.h>
+
+#define DEFAULT_HASH_TBL_SIZE 1024
+#define SKEL_DEFAULT_MAX_PERIOD 256
+#define SKEL_DEFAULT_DELAY_TOL 0.1
+/* peer offset of a receive from any source */
+#define SKEL_ANY_PEER INT_MIN
+/* the traces are loaded under app ids that do not collide with the jobs
+ * replayed through the dumpi workload */
+#define SKEL_TRACE_APP_BASE (1 << 20)
+/* outstanding requests of the trace being read, power of two */
+#define SKEL_REQ_TBL_SIZE 1024
+
+extern struct codes_workload_method dumpi_trace_workload_method;
+
+/* an operation of a skeleton program */
+struct skel_op
+{
+    enum codes_workload_op_type op_type;
+    int peer; /* offset of the peer from the own rank */
+    int tag;
+    int root;
+    int64_t num_bytes;
+    double nsecs;
+    uint32_t req_id; /* request posted (isend/irecv) or waited on (wait) */
+    int count; /* waitall/waitsome/waitany */
+    uint32_t *req_ids;
+};
+
+/* ops [first, first + len) of a program, run repeat times */
+struct skel_block
+{
+    int first;
+    int len;
+    int64_t repeat;
+};
+
+struct skel_prog
+{
+    struct skel_op *ops;
+    int num_ops;
+    struct skel_block *blocks;
+    int num_blocks;
+    struct qlist_head ql;
+};
+
+struct app_params
+{
+    skeleton_params params;
+    int app_id;
+    /* program of each traced rank, extracted on first use */
+    struct skel_prog **progs;
+    /* distinct programs */
+    struct qlist_head prog_list;
+    struct qlist_head ql;
+};
+
+struct rank_state
+{
+    int rank;
+    int app_id;
+    struct skel_prog const *prog;
+    /* position of the next op */
+    int block;
+    int pos;
+    int64_t iter;
+    int64_t seq;
+    /* CODES_WK_END ops handed out */
+    int64_t ended;
+    struct qhash_head hash_link;
+};
+
+/* an op of the trace being read, with its waits resolved to the ops that
+ * posted the requests */
+struct flat_op
+{
+    struct skel_op op;
+    int64_t *posted_by; /* waits: trace index of the op posting each request */
+    int64_t last_wait; /* isend/irecv: trace index of the last wait on the
+                          request, -1 if none */
+};
+
+struct flat_trace
+{
+    struct flat_op *ops;
+    int64_t num_ops;
+    int64_t cap;
+};
+
+/* outstanding request of the trace being read */
+struct req_ent
+{
+    uint32_t req_id;
+    int64_t idx;
+    struct qhash_head hash_link;
+};
+
+// globals
+// hold all of the ranks using this workload
+static struct qhash_table *rank_tbl = NULL;
+static int num_qhash_entries = 0;
+
+// hold application configurations
+static struct qlist_head app_params_list = QLIST_HEAD_INIT(app_params_list);
+
+static int params_eq(skeleton_params const * a, skeleton_params const * b)
+{
+    return (strcmp(a->file_name, b->file_name) == 0 &&
+            a->num_traced_ranks == b->num_traced_ranks &&
+            a->nprocs == b->nprocs &&
+            a->max_period == b->max_period &&
+            a->delay_tolerance == b->delay_tolerance);
+}
+
+static int rank_tbl_compare(void * key, struct qhash_head * link)
+{
+    struct rank_state *a = key;
+    struct rank_state *b = qhash_entry(link, struct rank_state, hash_link);
+    if (a->rank == b->rank && a->app_id == b->app_id)
+        return 1;
+    else
+        return 0;
+}
+
+static int req_tbl_compare(void * key, struct qhash_head * link)
+{
+    uint32_t *req_id = key;
+    struct req_ent *e = qhash_entry(link, struct req_ent, hash_link);
+    return e->req_id == *req_id;
+}
+
+static struct flat_op * flat_push(struct flat_trace *ft)
+{
+    if (ft->num_ops == ft->cap) {
+        ft->cap = ft->cap ? 2 * ft->cap : 1024;
+        ft->ops = realloc(ft->ops, ft->cap * sizeof(*ft->ops));
+        assert(ft->ops);
+    }
+    return &ft->ops[ft->num_ops++];
+}
+
+/* records that op idx posted req_id */
+static void skel_post_req(struct qhash_table *reqs, uint32_t req_id,
+        int64_t idx)
+{
+    struct qhash_head *link = qhash_search(reqs, &req_id);
+    struct req_ent *e;
+
+    if (link) {
+        e = qhash_entry(link, struct req_ent, hash_link);
+    }
+    else {
+        e = malloc(sizeof(*e));
+        assert(e);
+        e->req_id = req_id;
+        qhash_add(reqs, &req_id, &e->hash_link);
+    }
+    e->idx = idx;
+}
+
+/* resolves the requests waited on by the op that will be appended to ft,
+ * dropping the ones the trace never posted (e.g. MPI_REQUEST_NULL). Returns
+ * the number of resolved requests */
+static int skel_wait_reqs(struct flat_trace *ft, struct qhash_table *reqs,
+        uint32_t const *req_ids, int count, int completes,
+        int64_t **posted_by)
+{
+    int i, n = 0;
+
+    *posted_by = malloc(count * sizeof(**posted_by));
+    assert(*posted_by);
+    for (i = 0; i < count; i++) {
+        uint32_t req_id = req_ids[i];
+        struct qhash_head *link = qhash_search(reqs, &req_id);
+        if (!link)
+            continue;
+        struct req_ent *e = qhash_entry(link, struct req_ent, hash_link);
+        (*posted_by)[n++] = e->idx;
+        ft->ops[e->idx].last_wait = ft->num_ops;
+        if (completes) {
+            qhash_del(link);
+            free(e);
+        }
+    }
+    if (n == 0) {
+        free(*posted_by);
+        *posted_by = NULL;
+    }
+    return n;
+}
+
+static void skel_add_op(struct flat_trace *ft, struct qhash_table *reqs,
+        int trace_rank, struct codes_workload_op const *op)
+{
+    struct skel_op so;
+    int64_t *posted_by = NULL;
+
+    memset(&so, 0, sizeof(so));
+    so.op_type = op->op_type;
+    so.req_id = UINT32_MAX;
+    switch (op->op_type) {
+        case CODES_WK_DELAY:
+            so.nsecs = op->u.delay.nsecs;
+            break;
+        case CODES_WK_SEND:
+        case CODES_WK_ISEND:
+            so.peer = op->u.send.dest_rank - trace_rank;
+            so.tag = op->u.send.tag;
+            so.num_bytes = op->u.send.num_bytes;
+            break;
+        case CODES_WK_RECV:
+        case CODES_WK_IRECV:
+            so.peer = op->u.recv.source_rank < 0 ?
+                SKEL_ANY_PEER : op->u.recv.source_rank - trace_rank;
+            so.tag = op->u.recv.tag;
+            so.num_bytes = op->u.recv.num_bytes;
+            break;
+        case CODES_WK_BCAST:
+        case CODES_WK_REDUCE:
+            so.root = op->u.collective.root;
+            /* fall through */
+        case CODES_WK_ALLGATHER:
+        case CODES_WK_ALLGATHERV:
+        case CODES_WK_ALLTOALL:
+        case CODES_WK_ALLTOALLV:
+        case CODES_WK_ALLREDUCE:
+        case CODES_WK_COL:
+            so.num_bytes = op->u.collective.num_bytes;
+            break;
+        case CODES_WK_WAIT:
+            so.count = skel_wait_reqs(ft, reqs, &op->u.wait.req_id, 1, 1,
+                    &posted_by);
+            if (so.count == 0)
+                return;
+            break;
+        case CODES_WK_WAITALL:
+        case CODES_WK_WAITSOME:
+        case CODES_WK_WAITANY:
+            so.count = skel_wait_reqs(ft, reqs, op->u.waits.req_ids,
+                    op->u.waits.count, op->op_type == CODES_WK_WAITALL,
+                    &posted_by);
+            if (so.count == 0)
+                return;
+            break;
+        default:
+            /* request frees are no-ops in the replay */
+            return;
+    }
+
+    if (op->op_type == CODES_WK_ISEND)
+        skel_post_req(reqs, op->u.send.req_id, ft->num_ops);
+    else if (op->op_type == CODES_WK_IRECV)
+        skel_post_req(reqs, op->u.recv.req_id, ft->num_ops);
+
+    struct flat_op *f = flat_push(ft);
+    f->op = so;
+    f->posted_by = posted_by;
+    f->last_wait = -1;
+}
+
+/* reads the trace of a rank through the dumpi workload */
+static void skel_read_trace(struct app_params const *ap, int trace_rank,
+        struct flat_trace *ft)
+{
+    dumpi_trace_params dp;
+    struct codes_workload_op op;
+    struct qhash_table *reqs;
+    int app = SKEL_TRACE_APP_BASE + ap->app_id;
+
+    memset(&dp, 0, sizeof(dp));
+    strcpy(dp.file_name, ap->params.file_name);
+    dp.num_net_traces = ap->params.num_traced_ranks;
+    dp.nprocs = ap->params.num_traced_ranks;
+    if (dumpi_trace_workload_method.codes_workload_load((char*)&dp, app,
+                trace_rank) != 0)
+        tw_error(TW_LOC, "skeleton workload: unable to load rank %d of "
+                "trace %s\n", trace_rank, dp.file_name);
+
+    reqs = qhash_init(req_tbl_compare, quickhash_32bit_hash, SKEL_REQ_TBL_SIZE);
+    assert(reqs);
+    for (;;) {
+        dumpi_trace_workload_method.codes_workload_get_next(app, trace_rank,
+                &op);
+        if (op.op_type == CODES_WK_END)
+            break;
+        skel_add_op(ft, reqs, trace_rank, &op);
+    }
+    qhash_destroy_and_finalize(reqs, struct req_ent, hash_link, free);
+    dumpi_trace_workload_method.codes_workload_finalize((char*)&dp, app,
+            trace_rank);
+}
+
+static int flat_op_eq(struct flat_trace const *ft, int64_t a, int64_t b,
+        double tol)
+{
+    struct skel_op const *x = &ft->ops[a].op;
+    struct skel_op const *y = &ft->ops[b].op;
+    int i;
+
+    if (x->op_type != y->op_type || x->peer != y->peer || x->tag != y->tag ||
+            x->root != y->root || x->num_bytes != y->num_bytes ||
+            x->count != y->count)
+        return 0;
+    if (x->op_type == CODES_WK_DELAY)
+        return fabs(x->nsecs - y->nsecs) <=
+            tol * (x->nsecs > y->nsecs ? x->nsecs : y->nsecs);
+    /* waits match if they wait on the ops at the same distance */
+    for (i = 0; i < x->count; i++)
+        if (a - ft->ops[a].posted_by[i] != b - ft->ops[b].posted_by[i])
+            return 0;
+    return 1;
+}
+
+/* whether no request crosses the boundaries of trace ops [first, first+len) */
+static int skel_self_contained(struct flat_trace const *ft, int64_t first,
+        int64_t len)
+{
+    int64_t i;
+    int j;
+
+    for (i = first; i < first + len; i++) {
+        struct flat_op const *f = &ft->ops[i];
+        if (f->last_wait >= first + len)
+            return 0;
+        for (j = 0; j < f->op.count; j++)
+            if (f->posted_by[j] < first)
+                return 0;
+    }
+    return 1;
+}
+
+/* number of back to back copies of trace ops [first, first + len), 0 if
+ * they can not be a loop body */
+static int64_t skel_count_repeats(struct flat_trace const *ft, int64_t first,
+        int64_t len, double tol)
+{
+    int64_t r, k;
+
+    if (!skel_self_contained(ft, first, len))
+        return 0;
+    for (r = 1; first + (r + 1) * len <= ft->num_ops; r++) {
+        int64_t s = first + r * len;
+        for (k = 0; k < len; k++)
+            if (!flat_op_eq(ft, first + k, s + k, tol))
+                break;
+        if (k < len || !skel_self_contained(ft, s, len))
+            break;
+    }
+    return r;
+}
+
+/* greedily folds the trace into loops: at each position, the loop body of
+ * at most max_period ops covering the most ops wins. Ops that do not start a
+ * loop are gathered in blocks run once */
+static struct skel_prog * skel_compress(struct flat_trace const *ft,
+        int max_period, double tol)
+{
+    struct skel_prog *p = calloc(1, sizeof(*p));
+    int64_t *prog_idx = malloc((ft->num_ops + 1) * sizeof(*prog_idx));
+    int64_t i = 0, len, r, k;
+    int lit = -1;
+
+    assert(p && prog_idx);
+    p->ops = calloc(ft->num_ops + 1, sizeof(*p->ops));
+    p->blocks = calloc(ft->num_ops + 1, sizeof(*p->blocks));
+    assert(p->ops && p->blocks);
+
+    while (i < ft->num_ops) {
+        int64_t best_len = 0, best_rep = 0;
+        for (len = 1; len <= max_period && i + 2 * len <= ft->num_ops; len++) {
+            if (!flat_op_eq(ft, i, i + len, tol))
+                continue;
+            r = skel_count_repeats(ft, i, len, tol);
+            if (r >= 2 && r * len > best_rep * best_len) {
+                best_len = len;
+                best_rep = r;
+            }
+        }
+
+        if (best_len) {
+            struct skel_block *b = &p->blocks[p->num_blocks++];
+            b->first = p->num_ops;
+            b->len = best_len;
+            b->repeat = best_rep;
+            for (k = 0; k < best_len; k++) {
+                struct skel_op *so = &p->ops[p->num_ops + k];
+                *so = ft->ops[i + k].op;
+                if (so->op_type == CODES_WK_DELAY) {
+                    so->nsecs = 0;
+                    for (r = 0; r < best_rep; r++)
+                        so->nsecs += ft->ops[i + r * best_len + k].op.nsecs;
+                    so->nsecs /= best_rep;
+                }
+            }
+            for (r = 0; r < best_rep; r++)
+                for (k = 0; k < best_len; k++)
+                    prog_idx[i + r * best_len + k] = p->num_ops + k;
+            p->num_ops += best_len;
+            i += best_rep * best_len;
+            lit = -1;
+        }
+        else {
+            if (lit < 0) {
+                lit = p->num_blocks++;
+                p->blocks[lit].first = p->num_ops;
+                p->blocks[lit].len = 0;
+                p->blocks[lit].repeat = 1;
+            }
+            p->ops[p->num_ops] = ft->ops[i].op;
+            prog_idx[i] = p->num_ops;
+            p->blocks[lit].len++;
+            p->num_ops++;
+            i++;
+        }
+    }
+
+    /* loop bodies are self contained, so all the copies of an op resolve to
+     * the same requests */
+    for (i = 0; i < ft->num_ops; i++) {
+        struct flat_op const *f = &ft->ops[i];
+        struct skel_op *so = &p->ops[prog_idx[i]];
+        switch (so->op_type) {
+            case CODES_WK_ISEND:
+            case CODES_WK_IRECV:
+                so->req_id = prog_idx[i];
+                break;
+            case CODES_WK_WAIT:
+                so->req_id = prog_idx[f->posted_by[0]];
+                break;
+            case CODES_WK_WAITALL:
+            case CODES_WK_WAITSOME:
+            case CODES_WK_WAITANY:
+                if (so->req_ids)
+                    break;
+                so->req_ids = malloc(so->count * sizeof(*so->req_ids));
+                assert(so->req_ids);
+                for (k = 0; k < so->count; k++)
+                    so->req_ids[k] = prog_idx[f->posted_by[k]];
+                break;
+            default:
+                break;
+        }
+    }
+    free(prog_idx);
+
+    if (p->num_ops) {
+        p->ops = realloc(p->ops, p->num_ops * sizeof(*p->ops));
+        p->blocks = realloc(p->blocks, p->num_blocks * sizeof(*p->blocks));
+        assert(p->ops && p->blocks);
+    }
+    return p;
+}
+
+static int skel_prog_eq(struct skel_prog const *a, struct skel_prog const *b)
+{
+    int i;
+
+    if (a->num_ops != b->num_ops || a->num_blocks != b->num_blocks ||
+            memcmp(a->blocks, b->blocks,
+                a->num_blocks * sizeof(*a->blocks)) != 0)
+        return 0;
+    for (i = 0; i < a->num_ops; i++) {
+        struct skel_op const *x = &a->ops[i];
+        struct skel_op const *y = &b->ops[i];
+        if (x->op_type != y->op_type || x->peer != y->peer ||
+                x->tag != y->tag || x->root != y->root ||
+                x->num_bytes != y->num_bytes || x->nsecs != y->nsecs ||
+                x->req_id != y->req_id || x->count != y->count)
+            return 0;
+        if (x->req_ids && memcmp(x->req_ids, y->req_ids,
+                    x->count * sizeof(*x->req_ids)) != 0)
+            return 0;
+    }
+    return 1;
+}
+
+static void skel_prog_free(struct skel_prog *p)
+{
+    int i;
+
+    for (i = 0; i < p->num_ops; i++)
+        free(p->ops[i].req_ids);
+    free(p->ops);
+    free(p->blocks);
+    free(p);
+}
+
+/* extracts the program of a traced rank, sharing it with the ranks that
+ * already have the same one */
+static struct skel_prog * skel_extract(struct app_params *ap, int trace_rank)
+{
+    struct flat_trace ft = { NULL, 0, 0 };
+    struct skel_prog *p, *q;
+    struct qlist_head *ent;
+    int64_t i;
+    int max_period = ap->params.max_period > 0 ?
+        ap->params.max_period : SKEL_DEFAULT_MAX_PERIOD;
+    double tol = ap->params.delay_tolerance >= 0 ?
+        ap->params.delay_tolerance : SKEL_DEFAULT_DELAY_TOL;
+
+    skel_read_trace(ap, trace_rank, &ft);
+    p = skel_compress(&ft, max_period, tol);
+
+    if (trace_rank == 0 && g_tw_mynode == 0)
+        printf("skeleton workload: app %d rank 0 reduced from %lld to %d ops "
+                "in %d blocks\n", ap->app_id, (long long)ft.num_ops,
+                p->num_ops, p->num_blocks);
+
+    for (i = 0; i < ft.num_ops; i++)
+        free(ft.ops[i].posted_by);
+    free(ft.ops);
+
+    qlist_for_each(ent, &ap->prog_list) {
+        q = qlist_entry(ent, struct skel_prog, ql);
+        if (skel_prog_eq(p, q)) {
+            skel_prog_free(p);
+            return q;
+        }
+    }
+    qlist_add_tail(&p->ql, &ap->prog_list);
+    return p;
+}
+
+static int skeleton_workload_load(const char* params, int app_id, int rank)
+{
+    skeleton_params const * p = (skeleton_params const *) params;
+
+    if (p->num_traced_ranks <= 0 || p->nprocs < p->num_traced_ranks ||
+            p->nprocs % p->num_traced_ranks != 0)
+        tw_error(TW_LOC, "skeleton workload: the number of ranks (%d) must be "
+                "a multiple of the number of traced ranks (%d)\n",
+                p->nprocs, p->num_traced_ranks);
+    if (rank >= p->nprocs)
+        return -1;
+
+    // search for and append if needed into the global params table
+    struct qlist_head *ent;
+    struct app_params *ap;
+    qlist_for_each(ent, &app_params_list) {
+        ap = qlist_entry(ent, struct app_params, ql);
+        if (app_id == ap->app_id) {
+            if (params_eq(&ap->params, p))
+                break;
+            else
+                tw_error(TW_LOC, "app %d: rank %d passed in a different config",
+                        app_id, rank);
+        }
+    }
+    if (ent == &app_params_list) {
+        ap = malloc(sizeof(*ap));
+        assert(ap);
+        ap->params = *p;
+        ap->app_id = app_id;
+        ap->progs = calloc(p->num_traced_ranks, sizeof(*ap->progs));
+        assert(ap->progs);
+        INIT_QLIST_HEAD(&ap->prog_list);
+        qlist_add_tail(&ap->ql, &app_params_list);
+    }
+
+    int trace_rank = rank % p->num_traced_ranks;
+    if (ap->progs[trace_rank] == NULL)
+        ap->progs[trace_rank] = skel_extract(ap, trace_rank);
+
+    if (rank_tbl == NULL) {
+        rank_tbl = qhash_init(rank_tbl_compare, quickhash_64bit_hash,
+                DEFAULT_HASH_TBL_SIZE);
+        assert(rank_tbl);
+    }
+
+    struct rank_state *rs = calloc(1, sizeof(*rs));
+    assert(rs);
+    rs->rank = rank;
+    rs->app_id = app_id;
+    rs->prog = ap->progs[trace_rank];
+
+    qhash_add(rank_tbl, rs, &rs->hash_link);
+    num_qhash_entries++;
+
+    return 0;
+}
+
+static struct rank_state * skel_find_rank(int app_id, int rank)
+{
+    struct rank_state cmp = { .rank = rank, .app_id = app_id };
+
+    struct qhash_head *hash_link =
+        rank_tbl ? qhash_search(rank_tbl, &cmp) : NULL;
+    if (hash_link == NULL)
+        tw_error(TW_LOC, "skeleton workload: unable to find app-rank context "
+                "for app %d, rank %d", app_id, rank);
+    return qhash_entry(hash_link, struct rank_state, hash_link);
+}
+
+static void skel_fill_op(int rank, struct skel_op const *so,
+        struct codes_workload_op *op)
+{
+    op->op_type = so->op_type;
+    switch (so->op_type) {
+        case CODES_WK_DELAY:
+            op->u.delay.nsecs = so->nsecs;
+            op->u.delay.seconds = so->nsecs / 1e9;
+            break;
+        case CODES_WK_SEND:
+        case CODES_WK_ISEND:
+            op->u.send.source_rank = rank;
+            op->u.send.dest_rank = rank + so->peer;
+            op->u.send.num_bytes = so->num_bytes;
+            op->u.send.count = so->num_bytes;
+            op->u.send.tag = so->tag;
+            op->u.send.req_id = so->req_id;
+            break;
+        case CODES_WK_RECV:
+        case CODES_WK_IRECV:
+            op->u.recv.source_rank =
+                so->peer == SKEL_ANY_PEER ? -1 : rank + so->peer;
+            op->u.recv.dest_rank = -1;
+            op->u.recv.num_bytes = so->num_bytes;
+            op->u.recv.count = so->num_bytes;
+            op->u.recv.tag = so->tag;
+            op->u.recv.req_id = so->req_id;
+            break;
+        case CODES_WK_WAIT:
+            op->u.wait.req_id = so->req_id;
+            break;
+        case CODES_WK_WAITALL:
+        case CODES_WK_WAITSOME:
+        case CODES_WK_WAITANY:
+            op->u.waits.count = so->count;
+            op->u.waits.req_ids = so->req_ids;
+            break;
+        default:
+            /* collectives */
+            op->u.collective.num_bytes = so->num_bytes;
+            op->u.collective.root = so->root;
+            break;
+    }
+}
+
+static void skeleton_workload_get_next(
+        int app_id,
+        int rank,
+        struct codes_workload_op *op)
+{
+    struct rank_state *rs = skel_find_rank(app_id, rank);
+    struct skel_prog const *p = rs->prog;
+
+    memset(op, 0, sizeof(*op));
+    op->sequence_id = rs->seq++;
+    if (rs->block == p->num_blocks) {
+        op->op_type = CODES_WK_END;
+        rs->ended++;
+        return;
+    }
+
+    struct skel_block const *b = &p->blocks[rs->block];
+    skel_fill_op(rank, &p->ops[b->first + rs->pos], op);
+    if (++rs->pos == b->len) {
+        rs->pos = 0;
+        if (++rs->iter == b->repeat) {
+            rs->iter = 0;
+            rs->block++;
+        }
+    }
+}
+
+static void skeleton_workload_get_next_rc2(int app_id, int rank)
+{
+    struct rank_state *rs = skel_find_rank(app_id, rank);
+    struct skel_prog const *p = rs->prog;
+
+    rs->seq--;
+    if (rs->ended) {
+        rs->ended--;
+        return;
+    }
+    if (rs->pos == 0) {
+        if (rs->iter == 0) {
+            assert(rs->block > 0);
+            rs->block--;
+            rs->iter = p->blocks[rs->block].repeat;
+        }
+        rs->iter--;
+        rs->pos = p->blocks[rs->block].len;
+    }
+    rs->pos--;
+}
+
+static int skeleton_workload_get_rank_cnt(const char* params, int app_id)
+{
+    (void)app_id;
+    return ((skeleton_params const *) params)->nprocs;
+}
+
+static int skeleton_workload_finalize(const char* params, int app_id, int rank)
+{
+    (void)params;
+    struct rank_state *rs = skel_find_rank(app_id, rank);
+
+    qhash_del(&rs->hash_link);
+    free(rs);
+    num_qhash_entries--;
+    if (num_qhash_entries == 0) {
+        qhash_finalize(rank_tbl);
+        rank_tbl = NULL;
+    }
+    return 0;
+}
+
+struct codes_workload_method skeleton_workload_method =
+{
+    .method_name = "skeleton-workload",
+    .codes_workload_read_config = NULL,
+    .codes_workload_load = skeleton_workload_load,
+    .codes_workload_get_next = skeleton_workload_get_next,
+    .codes_workload_get_next_rc2 = skeleton_workload_get_next_rc2,
+    .codes_workload_get_rank_cnt = skeleton_workload_get_rank_cnt,
+    .codes_workload_finalize = skeleton_workload_finalize,
+};
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
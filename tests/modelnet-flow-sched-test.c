@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2013 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+/* each server queues NUM_MSGS messages of priority 0 and then NUM_MSGS of
+ * priority 1 to the next server, all at once. The receiver prints the
+ * priorities in the order the messages arrived, so the test script can tell
+ * how the scheduler shared the link between the two flows. Servers in a ring
+ * over two PEs generate stragglers at the senders, so optimistic runs also
+ * roll back the schedulers' decisions */
+
+#include <string.h>
+#include <assert.h>
+#include <ross.h>
+
+#include "codes/model-net.h"
+#include "codes/codes.h"
+#include "codes/codes_mapping.h"
+#include "codes/configuration.h"
+#include "codes/lp-type-lookup.h"
+#include "codes/lp-msg.h"
+#include "codes/model-net-sched.h"
+
+#define PAYLOAD_SZ 4096 /* size of simulated data payload, bytes  */
+#define NUM_MSGS 6      /* messages per priority */
+#define NUM_PRIOS 2
+
+static int net_id = 0;
+static int num_servers = 0;
+
+typedef struct svr_msg svr_msg;
+typedef struct svr_state svr_state;
+
+enum svr_event
+{
+    KICKOFF,    /* initial event */
+    RECV,       /* message received at sink */
+};
+
+struct svr_state
+{
+    int server_idx;
+    int num_recv;
+    // priorities in receive order
+    int recv_order[NUM_PRIOS*NUM_MSGS];
+};
+
+struct svr_msg
+{
+    msg_header h;
+    model_net_event_return ret[NUM_PRIOS*NUM_MSGS];
+    int msg_prio;
+};
+
+static void svr_init(
+    svr_state * ns,
+    tw_lp * lp);
+static void svr_event(
+    svr_state * ns,
+    tw_bf * b,
+    svr_msg * m,
+    tw_lp * lp);
+static void svr_rev_event(
+    svr_state * ns,
+    tw_bf * b,
+    svr_msg * m,
+    tw_lp * lp);
+static void svr_finalize(
+    svr_state * ns,
+    tw_lp * lp);
+
+tw_lptype svr_lp = {
+    (init_f) svr_init,
+    (pre_run_f) NULL,
+    (event_f) svr_event,
+    (revent_f) svr_rev_event,
+    (commit_f) NULL,
+    (final_f)  svr_finalize,
+    (map_f) codes_mapping,
+    sizeof(svr_state),
+};
+
+static void svr_add_lp_type();
+static tw_stime s_to_ns(tw_stime ns);
+static void handle_kickoff_event(
+    svr_state * ns,
+    svr_msg * m,
+    tw_lp * lp);
+static void handle_kickoff_rev_event(
+    svr_state * ns,
+    svr_msg * m,
+    tw_lp * lp);
+
+const tw_optdef app_opt [] =
+{
+	TWOPT_GROUP("Model net flow scheduler test case" ),
+	TWOPT_END()
+};
+
+int main(
+    int argc,
+    char **argv)
+{
+    int num_nets;
+    int *net_ids;
+    g_tw_ts_end = s_to_ns(60*60*24*365); /* one year, in nsecs */
+
+    tw_opt_add(app_opt);
+    tw_init(&argc, &argv);
+
+    if(argc < 2)
+    {
+	    printf("\n Usage: mpirun <args> --sync=[1,3] -- mapping_file_name.conf (optional --nkp) ");
+	    MPI_Finalize();
+	    return 0;
+    }
+
+    configuration_load(argv[2], MPI_COMM_WORLD, &config);
+
+    model_net_register();
+    svr_add_lp_type();
+
+    codes_mapping_setup();
+
+    net_ids = model_net_configure(&num_nets);
+    assert(num_nets==1);
+    net_id = *net_ids;
+    free(net_ids);
+
+    num_servers = codes_mapping_get_lp_count("MODELNET_GRP", 0, "nw-lp",
+            NULL, 1);
+    assert(num_servers > 1);
+
+    tw_run();
+
+    tw_end();
+    return 0;
+}
+
+static void svr_add_lp_type()
+{
+  lp_type_register("nw-lp", &svr_lp);
+}
+
+static void svr_init(
+    svr_state * ns,
+    tw_lp * lp)
+{
+    memset(ns, 0, sizeof(*ns));
+    ns->server_idx = codes_mapping_get_lp_relative_id(lp->gid, 0, 0);
+
+    tw_event *e = tw_event_new(lp->gid, codes_local_latency(lp), lp);
+    svr_msg * m = tw_event_data(e);
+    msg_set_header(666, KICKOFF, lp->gid, &m->h);
+    tw_event_send(e);
+}
+
+static void svr_event(
+    svr_state * ns,
+    tw_bf * b,
+    svr_msg * m,
+    tw_lp * lp)
+{
+    (void)b;
+    switch (m->h.event_type)
+    {
+        case KICKOFF:
+            handle_kickoff_event(ns, m, lp);
+            break;
+        case RECV:
+            assert(ns->num_recv < NUM_PRIOS*NUM_MSGS);
+            ns->recv_order[ns->num_recv++] = m->msg_prio;
+            break;
+        default:
+	    printf("\n Invalid message type %d ", m->h.event_type);
+            assert(0);
+        break;
+    }
+}
+
+static void svr_rev_event(
+    svr_state * ns,
+    tw_bf * b,
+    svr_msg * m,
+    tw_lp * lp)
+{
+    (void)b;
+    switch (m->h.event_type)
+    {
+        case KICKOFF:
+            handle_kickoff_rev_event(ns, m, lp);
+            break;
+        case RECV:
+            ns->num_recv--;
+            break;
+        default:
+            assert(0);
+            break;
+    }
+}
+
+static void svr_finalize(
+    svr_state * ns,
+    tw_lp * lp)
+{
+    (void)lp;
+    char buf[32 + 2*NUM_PRIOS*NUM_MSGS];
+    int written = sprintf(buf, "server %d recv order:", ns->server_idx);
+
+    for (int i = 0; i < ns->num_recv; i++)
+        written += sprintf(buf + written, " %d", ns->recv_order[i]);
+    printf("%s\n", buf);
+}
+
+/* convert seconds to ns */
+static tw_stime s_to_ns(tw_stime ns)
+{
+    return(ns * (1000.0 * 1000.0 * 1000.0));
+}
+
+/* queue both flows to the next server in one go */
+static void handle_kickoff_event(
+    svr_state * ns,
+    svr_msg * m,
+    tw_lp * lp)
+{
+    svr_msg m_remote;
+    msg_set_header(666, RECV, lp->gid, &m_remote.h);
+
+    tw_lpid dest = codes_mapping_get_lpid_from_relative(
+            (ns->server_idx + 1) % num_servers, NULL, "nw-lp", NULL, 0);
+
+    MN_START_SEQ();
+    for (int i = 0; i < NUM_PRIOS*NUM_MSGS; i++){
+        m_remote.msg_prio = i / NUM_MSGS;
+        model_net_set_msg_param(MN_MSG_PARAM_SCHED, MN_SCHED_PARAM_PRIO,
+                (void*) &m_remote.msg_prio);
+        m->ret[i] = model_net_event(net_id, "test", dest, PAYLOAD_SZ, 0.0,
+                sizeof(svr_msg), &m_remote, 0, NULL, lp);
+    }
+    MN_END_SEQ();
+}
+
+static void handle_kickoff_rev_event(
+        svr_state *ns,
+        svr_msg *m,
+        tw_lp *lp){
+    (void)ns;
+    for (int i = 0; i < NUM_PRIOS*NUM_MSGS; i++){
+        model_net_event_rc2(lp, &m->ret[i]);
+    }
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
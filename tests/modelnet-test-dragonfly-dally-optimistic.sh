@@ -0,0 +1,32 @@
+#!/bin/bash
+
+# the dragonfly-dally synthetic, sequential and optimistic: the router link
+# stats (traffic, busy time and stalled chunks per port) have to match, so
+# every rollback of the router handlers restores their state exactly
+
+tmpdir=$(mktemp -d)
+trap "rm -rf $tmpdir" EXIT
+
+bin=src/network-workloads/model-net-synthetic-dally-dfly
+conf=src/network-workloads/conf/dragonfly-dally/modelnet-test-dragonfly-dally.conf
+
+$bin --sync=1 --num_messages=10 --lp-io-dir=$tmpdir/seq -- $conf \
+    > $tmpdir/seq.out || exit 1
+mpirun -np 2 $bin --sync=3 --num_messages=10 --lp-io-dir=$tmpdir/opt \
+    -- $conf > $tmpdir/opt.out || exit 1
+
+for mode in seq opt; do
+    if grep -q "leftover\|lefover" $tmpdir/$mode.out; then
+        echo "$mode run left messages queued"
+        exit 1
+    fi
+    awk '$2 == "R"' $tmpdir/$mode/dragonfly-link-stats | sort \
+        > $tmpdir/$mode.rtr
+done
+
+[ -s $tmpdir/seq.rtr ] || exit 1
+if ! cmp -s $tmpdir/seq.rtr $tmpdir/opt.rtr; then
+    echo "router stats differ between the sequential and optimistic runs"
+    diff $tmpdir/seq.rtr $tmpdir/opt.rtr | head -20
+    exit 1
+fi
@@ -0,0 +1,72 @@
+#!/bin/bash
+
+# packet tracing (packet_trace_rate=1) of dragonfly-dally, sequential and
+# optimistic: every traced packet has to be injected once, each of its
+# chunks delivered once after at least one router hop, hops have to carry
+# the output port and vc, and both runs have to emit the same records
+
+set -o pipefail
+
+tmpdir=$(mktemp -d)
+trap "rm -rf $tmpdir" EXIT
+
+bin=src/network-workloads/model-net-synthetic-dally-dfly
+conf=src/network-workloads/conf/dragonfly-dally/modelnet-test-dragonfly-dally.conf
+dump=src/networks/model-net/model-net-sample-dump
+
+# kind: 0 inject, 1 hop, 2 deliver. Columns: packet_id chunk_id
+# src_terminal dest_terminal kind location port vc start arrive depart
+check() {
+    awk '
+        $5 == 0 { if ($7 != -1 || $8 != -1) bad = "inject with a port";
+                  inj[$3 " " $1]++; n++ }
+        $5 == 1 { if ($7 < 0 || $8 < 0) bad = "hop without a port or vc";
+                  if ($7 > 0) ports = 1;
+                  hop[$3 " " $1 " " $2]++ }
+        $5 == 2 { if ($7 != -1 || $8 != -1) bad = "delivery with a port";
+                  del[$3 " " $1 " " $2]++; pkt[$3 " " $1]++ }
+        END {
+            if (bad != "") { print bad; exit 1 }
+            if (!n) { print "no traced packets"; exit 1 }
+            if (!ports) { print "every hop left through port 0"; exit 1 }
+            for (p in inj) {
+                if (inj[p] != 1) { print "packet " p " injected " inj[p] " times"; exit 1 }
+                if (!(p in pkt)) { print "packet " p " never delivered"; exit 1 }
+            }
+            for (c in del) {
+                split(c, k, " ");
+                if (!((k[1] " " k[2]) in inj)) { print "chunk " c " never injected"; exit 1 }
+                if (del[c] != 1) { print "chunk " c " delivered " del[c] " times"; exit 1 }
+                if (!(c in hop)) { print "chunk " c " delivered without a hop"; exit 1 }
+            }
+            for (c in hop)
+                if (!(c in del)) { print "chunk " c " hopped but not delivered"; exit 1 }
+        }' $1
+}
+
+for mode in seq opt; do
+    awk -v f="$tmpdir/$mode" '{ print }
+        /^PARAMS/ { p = 1 }
+        p && /^\{/ { print "   packet_trace_rate=\"1\";";
+                     print "   packet_trace_file=\"" f "\";"; p = 0 }' \
+        $conf > $tmpdir/$mode.conf
+
+    if [ $mode = seq ]; then
+        $bin --sync=1 --num_messages=10 -- $tmpdir/$mode.conf \
+            > $tmpdir/$mode.out || exit 1
+    else
+        mpirun -np 2 $bin --sync=3 --num_messages=10 -- $tmpdir/$mode.conf \
+            > $tmpdir/$mode.out || exit 1
+    fi
+
+    $dump $tmpdir/$mode.bin | grep -v '^#' > $tmpdir/$mode.rows || exit 1
+    check $tmpdir/$mode.rows || exit 1
+done
+
+# records are only written at commit, so rolled back events leave no trace
+seq=$(wc -l < $tmpdir/seq.rows)
+opt=$(wc -l < $tmpdir/opt.rows)
+if [ "$seq" -ne "$opt" ]; then
+    echo "$seq records sequentially, $opt optimistically"
+    exit 1
+fi
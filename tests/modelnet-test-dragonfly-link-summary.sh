@@ -0,0 +1,33 @@
+#!/bin/bash
+
+# router link summaries (rt_sample_mode="summary") of dragonfly-dally and
+# dragonfly-plus: each run has to write summary rows and print the most
+# utilized links
+
+tmpdir=$(mktemp -d)
+trap "rm -rf $tmpdir" EXIT
+
+for net in dally plus; do
+    if [ $net = dally ]; then
+        bin=src/network-workloads/model-net-synthetic-dally-dfly
+        conf=src/network-workloads/conf/dragonfly-dally/modelnet-test-dragonfly-dally.conf
+    else
+        bin=src/network-workloads/model-net-synthetic-dfly-plus
+        conf=src/network-workloads/conf/dragonfly-plus/modelnet-test-dragonfly-plus.conf
+    fi
+
+    awk -v f="$tmpdir/$net" '{ print }
+        /^PARAMS/ { p = 1 }
+        p && /^\{/ { print "   rt_sample_mode=\"summary\";";
+                     print "   rt_sample_file=\"" f "\";"; p = 0 }' \
+        $conf > $tmpdir/$net.conf
+
+    $bin --sync=1 --num_messages=10 --sampling-interval=10000 \
+        --sampling-end-time=200000 -- $tmpdir/$net.conf > $tmpdir/$net.out
+    [ $? -eq 0 ] || exit 1
+
+    grep -q "^  router [0-9]* port [0-9]*:" $tmpdir/$net.out || exit 1
+    rows=$(src/networks/model-net/model-net-sample-dump \
+        $tmpdir/$net-summary.bin | grep -vc '^#')
+    [ "$rows" -gt 0 ] || exit 1
+done
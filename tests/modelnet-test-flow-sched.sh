@@ -0,0 +1,53 @@
+#!/bin/bash
+
+# two flows per sender (priorities 0 and 1, weights 1:2), queued priority 0
+# first. fcfs has to deliver them in queue order, drr and wfq have to
+# deliver about two priority 1 messages per priority 0 one while both flows
+# are backlogged. Optimistic runs have to deliver in the same order as the
+# sequential ones
+
+tmpdir=$(mktemp -d)
+trap "rm -rf $tmpdir" EXIT
+
+bin=tests/modelnet-flow-sched-test
+nmsgs=6
+
+# the drr setup with the default scheduler
+sed 's/modelnet_scheduler="drr"/modelnet_scheduler="fcfs"/' \
+    tests/conf/modelnet-test-drr.conf > $tmpdir/fcfs.conf
+
+for sched in fcfs drr wfq; do
+    conf=tests/conf/modelnet-test-$sched.conf
+    [ $sched = fcfs ] && conf=$tmpdir/fcfs.conf
+
+    $bin --sync=1 -- $conf > $tmpdir/$sched-seq.out || exit 1
+    mpirun -np 2 $bin --sync=3 -- $conf \
+        > $tmpdir/$sched-opt.out || exit 1
+
+    for mode in seq opt; do
+        grep "recv order:" $tmpdir/$sched-$mode.out | sort \
+            > $tmpdir/$sched-$mode.order
+    done
+    [ $(wc -l < $tmpdir/$sched-seq.order) -eq 16 ] || exit 1
+    if ! cmp -s $tmpdir/$sched-seq.order $tmpdir/$sched-opt.order; then
+        echo "$sched: optimistic receive order differs"
+        diff $tmpdir/$sched-seq.order $tmpdir/$sched-opt.order
+        exit 1
+    fi
+
+    # priority 1 messages among the first 3/2 nmsgs received
+    awk -v s=$sched -v n=$nmsgs '{
+        ones = 0; all = 0;
+        for (i = 5; i <= NF; i++) {
+            all += $i;
+            if (i - 4 <= n * 3 / 2)
+                ones += $i;
+        }
+        if (NF - 4 != 2 * n || all != n) {
+            print s ": " $0; exit 1
+        }
+        if (s == "fcfs" ? ones != n / 2 : ones < n - 1 || ones > n + 1) {
+            print s ": " ones " priority 1 messages early: " $0; exit 1
+        }
+    }' $tmpdir/$sched-seq.order || exit 1
+done
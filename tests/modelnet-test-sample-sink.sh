@@ -0,0 +1,76 @@
+#!/bin/bash
+
+# full mode terminal and router samples of dragonfly-dally through the sample
+# sink, sequential and merged from the spills of two PEs (also compressed,
+# when configure found zlib): every LP has to contribute one row per sample
+# interval, both runs the same rows, and no spill file may be left behind
+
+tmpdir=$(mktemp -d)
+trap "rm -rf $tmpdir" EXIT
+
+bin=src/network-workloads/model-net-synthetic-dally-dfly
+conf=src/network-workloads/conf/dragonfly-dally/modelnet-test-dragonfly-dally.conf
+dump=src/networks/model-net/model-net-sample-dump
+
+# 20 samples of 10us per LP
+nsamples=20
+sampling="--sampling-interval=10000 --sampling-end-time=200000"
+
+run() {
+    mode=$1
+    shift
+    awk -v f="$tmpdir/$mode" -v z=$compress '{ print }
+        /^PARAMS/ { p = 1 }
+        p && /^\{/ { print "   cn_sample_file=\"" f "-cn\";";
+                     print "   rt_sample_file=\"" f "-rt\";";
+                     if (z) print "   sample_compress=\"1\";"; p = 0 }' \
+        $conf > $tmpdir/$mode.conf
+    "$@" --num_messages=10 $sampling -- $tmpdir/$mode.conf \
+        > $tmpdir/$mode.out 2>&1 || return 1
+
+    for s in cn rt; do
+        $dump $tmpdir/$mode-$s.bin | grep -v '^#' > $tmpdir/$mode-$s.rows \
+            || return 1
+        # one row per LP and sample
+        awk -v n=$nsamples '{ c[$1]++ }
+            END {
+                for (id in c) {
+                    if (c[id] != n) { print "LP " id ": " c[id] " samples"; exit 1 }
+                    ids++
+                }
+                if (!ids) { print "no samples"; exit 1 }
+            }' $tmpdir/$mode-$s.rows || return 1
+    done
+    if ls $tmpdir/*.spill-* > /dev/null 2>&1; then
+        echo "$mode run left spill files"
+        return 1
+    fi
+}
+
+same_rows() {
+    for s in cn rt; do
+        a=$(wc -l < $tmpdir/$1-$s.rows)
+        b=$(wc -l < $tmpdir/$2-$s.rows)
+        if [ "$a" -ne "$b" ]; then
+            echo "$s samples: $a rows in $1, $b in $2"
+            return 1
+        fi
+    done
+}
+
+compress=0
+run seq $bin --sync=1 || exit 1
+run opt mpirun -np 2 $bin --sync=3 || exit 1
+same_rows seq opt || exit 1
+
+compress=1
+run optz mpirun -np 2 $bin --sync=3 || exit 1
+if grep -q "sample_compress requires zlib" $tmpdir/optz.out; then
+    exit 0
+fi
+# MN_SAMPLE_COMPRESSED in the file header flags
+for s in cn rt; do
+    flags=$(od -A n -t u4 -j 16 -N 4 $tmpdir/optz-$s.bin)
+    [ $((flags & 1)) -eq 1 ] || exit 1
+done
+same_rows opt optz || exit 1
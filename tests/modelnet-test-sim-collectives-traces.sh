@@ -0,0 +1,32 @@
+#!/bin/bash
+
+# --sim_collectives=1 on the AMG trace: the collectives become point-to-point
+# rounds, so they add traffic, every byte sent is received, and an
+# optimistic run moves the same bytes as a sequential one
+
+if [ -z $srcdir ]; then
+         echo srcdir variable not set.
+              exit 1
+ fi
+
+source $srcdir/tests/download-traces.sh
+
+set -o pipefail
+
+replay="src/network-workloads/model-net-mpi-replay --disable_compute=1 --num_net_traces=27 --workload_file=/tmp/df_AMG_n27_dumpi/dumpi-2014.03.03.14.55.00- --workload_type=dumpi"
+conf=$srcdir/src/network-workloads/conf/modelnet-mpi-test-dfly-amg-216.conf
+
+# prints "<bytes sent> <bytes received>" of a run
+bytes() {
+    "$@" | sed -n 's/.*Total bytes sent \([0-9]*\) recvd \([0-9]*\).*/\1 \2/p'
+}
+
+off=$(bytes $replay --sync=1 -- $conf) || exit 1
+seq=$(bytes $replay --sync=1 --sim_collectives=1 -- $conf) || exit 1
+opt=$(bytes mpirun -np 2 $replay --sync=3 --sim_collectives=1 -- $conf) || exit 1
+
+[ -n "$off" ] && [ -n "$seq" ] || exit 1
+set -- $seq
+[ $1 -eq $2 ] || exit 1
+[ $1 -gt ${off%% *} ] || exit 1
+[ "$seq" = "$opt" ] || exit 1
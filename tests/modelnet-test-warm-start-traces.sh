@@ -0,0 +1,91 @@
+#!/bin/bash
+
+# fast-forward checkpoint and warm start round trip on the AMG trace:
+# - the bytes sent before and after a cut add up to the ones of a full run,
+#   also for a cut between requests completing and the wait on them
+# - the cut positions do not depend on the synchronization
+# - a warm started run fast-forwarding one more collective cuts every rank
+#   at the position of a direct fast-forward
+
+if [ -z $srcdir ]; then
+         echo srcdir variable not set.
+              exit 1
+ fi
+
+source $srcdir/tests/download-traces.sh
+
+set -o pipefail
+
+tmpdir=$(mktemp -d)
+trap "rm -rf $tmpdir" EXIT
+
+replay="src/network-workloads/model-net-mpi-replay --disable_compute=1 --num_net_traces=27 --workload_file=/tmp/df_AMG_n27_dumpi/dumpi-2014.03.03.14.55.00- --workload_type=dumpi"
+conf=$srcdir/src/network-workloads/conf/modelnet-mpi-test-dfly-amg-216.conf
+
+# prints "<bytes sent> <bytes received>" of a run
+bytes() {
+    "$@" | sed -n 's/.*Total bytes sent \([0-9]*\) recvd \([0-9]*\).*/\1 \2/p'
+}
+
+# prints "<job> <rank> <position> <cut> <quiescent> <completed requests>"
+# for each rank of a checkpoint: a 16 byte header, 48 byte entries, then
+# the ids of the completed requests
+cuts() {
+    local n=$(od -A n -t u8 -j 8 -N 8 $1)
+    od -A n -t d4 -v -j 16 -N $((n * 48)) -w48 $1 | \
+        awk '{ print $1, $2, $3, $7, $8, $11 }'
+}
+
+full=$(bytes $replay --sync=1 -- $conf) || exit 1
+[ -n "$full" ] || exit 1
+read full_sent full_recvd <<< "$full"
+
+# fast-forwards to collective $1 into checkpoint $2, warm starts from it and
+# checks that the two runs move the bytes of the full one
+round_trip() {
+    local ff warm ff_sent ff_recvd warm_sent warm_recvd
+
+    ff=$(bytes $replay --sync=1 --ff_collectives=$1 \
+        --ff_checkpoint=$2 -- $conf) || return 1
+    warm=$(bytes $replay --sync=1 --warm_start=$2 -- $conf) || return 1
+    [ -n "$ff" ] && [ -n "$warm" ] || return 1
+    read ff_sent ff_recvd <<< "$ff"
+    read warm_sent warm_recvd <<< "$warm"
+    [ $full_sent -eq $((ff_sent + warm_sent)) ] || return 1
+    [ $full_recvd -eq $((ff_recvd + warm_recvd)) ] || return 1
+}
+
+round_trip 2 $tmpdir/ff2 || exit 1
+
+# the cut is consistent: some ranks were cut and none had pending messages
+[ $(cuts $tmpdir/ff2 | awk '$4 == 1' | wc -l) -gt 0 ] || exit 1
+[ $(cuts $tmpdir/ff2 | awk '$5 != 1' | wc -l) -eq 0 ] || exit 1
+
+$replay --sync=1 --ff_collectives=3 --ff_checkpoint=$tmpdir/ff3 \
+    -- $conf > /dev/null || exit 1
+mpirun -np 2 $replay --sync=3 --ff_collectives=3 \
+    --ff_checkpoint=$tmpdir/ff3-opt -- $conf > /dev/null || exit 1
+$replay --sync=1 --warm_start=$tmpdir/ff2 --ff_collectives=2 \
+    --ff_checkpoint=$tmpdir/ff2-1 -- $conf > /dev/null || exit 1
+
+[ "$(cuts $tmpdir/ff3)" = "$(cuts $tmpdir/ff3-opt)" ] || exit 1
+[ "$(cuts $tmpdir/ff3)" = "$(cuts $tmpdir/ff2-1)" ] || exit 1
+
+# ranks cut at both collectives resume further in their trace
+paste -d ' ' <(cuts $tmpdir/ff2) <(cuts $tmpdir/ff3) | \
+    awk '$4 == 1 && $10 == 1 && $9 <= $3 { bad = 1 } END { exit bad }' || exit 1
+
+# a cut where ranks completed requests they wait on after it (an isend or
+# irecv, the collective, then the wait): the warm start has to restore them
+# or those ranks never get past their wait
+for n in 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16; do
+    $replay --sync=1 --ff_collectives=$n --ff_checkpoint=$tmpdir/done \
+        -- $conf > /dev/null || exit 1
+    if [ $(cuts $tmpdir/done | awk '$4 == 1 && $6 > 0' | wc -l) -gt 0 ] &&
+            [ $(cuts $tmpdir/done | awk '$5 != 1' | wc -l) -eq 0 ]; then
+        round_trip $n $tmpdir/done || exit 1
+        exit 0
+    fi
+done
+echo "no consistent cut with completed requests in the first 16 collectives"
+exit 1
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <assert.h>
+#include <ross.h>
+#include "codes/rc-undo-log.h"
+
+int main()
+{
+    /* mock up a dummy lp for testing */
+    tw_lp lp;
+    tw_kp kp;
+    tw_pe pe;
+    memset(&lp, 0, sizeof(lp));
+    memset(&kp, 0, sizeof(kp));
+    memset(&pe, 0, sizeof(pe));
+
+    lp.pe = &pe;
+    lp.kp = &kp;
+
+    g_tw_synchronization_protocol = OPTIMISTIC;
+
+    struct rc_undo_log *l;
+    rc_undo_log_create(&l);
+    assert(l != NULL);
+
+    int a = 1;
+    double b = 2.0;
+    char c = 'c';
+    long arr[1000];
+    int i;
+
+#define RUN_ALL() \
+    do { \
+        kp.last_time = 1.0; \
+        rc_undo_log_begin(&lp, l); \
+        RC_UNDO_ADD(l, a, 10); \
+        RC_UNDO_SET(l, b, 4.0); \
+        kp.last_time = 2.0; \
+        rc_undo_log_begin(&lp, l); \
+        kp.last_time = 3.0; \
+        rc_undo_log_begin(&lp, l); \
+        RC_UNDO_SET(l, c, 'd'); \
+        RC_UNDO_ADD(l, a, 100); \
+        RC_UNDO_SET(l, a, 7); \
+    } while (0)
+
+    RUN_ALL();
+    assert(5 == rc_undo_log_count(l));
+    assert(a == 7 && b == 4.0 && c == 'd');
+
+    /* the last event restores in reverse order */
+    rc_undo_log_rollback(l);
+    assert(a == 11 && b == 4.0 && c == 'c');
+    assert(2 == rc_undo_log_count(l));
+    /* the event that saved nothing */
+    rc_undo_log_rollback(l);
+    assert(2 == rc_undo_log_count(l));
+    rc_undo_log_rollback(l);
+    assert(a == 1 && b == 2.0 && c == 'c');
+    assert(0 == rc_undo_log_count(l));
+
+    /* collect the first two groups, the third can still be rolled back */
+    RUN_ALL();
+    pe.GVT = 2.5;
+    rc_undo_log_gc(&lp, l);
+    assert(3 == rc_undo_log_count(l));
+    rc_undo_log_rollback(l);
+    assert(a == 11 && b == 4.0 && c == 'c');
+    assert(0 == rc_undo_log_count(l));
+
+    /* grow past the initial capacity while the array wraps around */
+    a = 1;
+    b = 2.0;
+    pe.GVT = 0.0;
+    for (i = 0; i < 1000; i++)
+        arr[i] = i;
+    for (i = 0; i < 1000; i++) {
+        kp.last_time = i;
+        rc_undo_log_begin(&lp, l);
+        RC_UNDO_SET(l, arr[i], -i);
+        RC_UNDO_ADD(l, a, 1);
+        if (i % 100 == 99) {
+            pe.GVT = i - 10;
+            rc_undo_log_gc(&lp, l);
+        }
+    }
+    assert(a == 1001);
+    for (i = 999; i >= 989; i--)
+        rc_undo_log_rollback(l);
+    assert(a == 990);
+    for (i = 0; i < 1000; i++)
+        assert(arr[i] == (i >= 989 ? i : -i));
+
+    rc_undo_log_gc(NULL, l);
+    assert(0 == rc_undo_log_count(l));
+    rc_undo_log_destroy(l);
+
+    return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+/* checks codes_workload_get_next_batch and its reverse handlers against
+ * the single op calls, both for a generator with batch hooks (checkpoint)
+ * and for one without them (iomock) */
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <codes/codes-workload.h>
+
+#define MAX_OPS 256
+#define BATCH 5
+
+static int same_op(struct codes_workload_op const *a,
+        struct codes_workload_op const *b)
+{
+    if (a->op_type != b->op_type)
+        return 0;
+    switch (a->op_type)
+    {
+        case CODES_WK_DELAY:
+            return a->u.delay.seconds == b->u.delay.seconds;
+        case CODES_WK_OPEN:
+            return a->u.open.file_id == b->u.open.file_id;
+        case CODES_WK_CLOSE:
+            return a->u.close.file_id == b->u.close.file_id;
+        case CODES_WK_READ:
+            return a->u.read.file_id == b->u.read.file_id &&
+                a->u.read.offset == b->u.read.offset &&
+                a->u.read.size == b->u.read.size;
+        case CODES_WK_WRITE:
+            return a->u.write.file_id == b->u.write.file_id &&
+                a->u.write.offset == b->u.write.offset &&
+                a->u.write.size == b->u.write.size;
+        default:
+            return 1;
+    }
+}
+
+/* drains a rank one op at a time */
+static int drain(int wkld_id, int app_id, int rank,
+        struct codes_workload_op *ops)
+{
+    int n = 0;
+
+    do
+    {
+        assert(n < MAX_OPS);
+        codes_workload_get_next(wkld_id, app_id, rank, &ops[n]);
+    } while (ops[n++].op_type != CODES_WK_END);
+    return n;
+}
+
+/* drains a rank in batches. Every other batch is handed back in part
+ * (rc_batch) or rolled back in part (rc2_batch, when use_rc2 is set) and
+ * then fetched again */
+static int drain_batch(int wkld_id, int app_id, int rank,
+        struct codes_workload_op *ops, int use_rc2)
+{
+    struct codes_workload_op batch[BATCH];
+    int n = 0, nb, keep, i, round = 0;
+
+    for (;;)
+    {
+        nb = codes_workload_get_next_batch(wkld_id, app_id, rank, batch,
+                BATCH);
+        assert(nb >= 1 && nb <= BATCH);
+        for (i = 0; i < nb - 1; i++)
+            assert(batch[i].op_type != CODES_WK_END);
+
+        if (round++ % 2 == 0 && nb > 1)
+        {
+            keep = nb / 2;
+            if (use_rc2)
+                codes_workload_get_next_rc2_batch(wkld_id, app_id, rank,
+                        nb - keep);
+            else
+                codes_workload_get_next_rc_batch(wkld_id, app_id, rank,
+                        batch + keep, nb - keep);
+            nb = keep;
+        }
+        for (i = 0; i < nb; i++)
+        {
+            assert(n < MAX_OPS);
+            ops[n++] = batch[i];
+            if (batch[i].op_type == CODES_WK_END)
+                return n;
+        }
+    }
+}
+
+static void check(char const *type, char const *params, int app_id,
+        int ref_rank, int rank, int use_rc2)
+{
+    struct codes_workload_op ref[MAX_OPS], ops[MAX_OPS];
+    int wkld_id, nref, n, i;
+
+    wkld_id = codes_workload_load(type, params, app_id, ref_rank);
+    assert(wkld_id >= 0);
+    wkld_id = codes_workload_load(type, params, app_id, rank);
+    assert(wkld_id >= 0);
+
+    nref = drain(wkld_id, app_id, ref_rank, ref);
+    n = drain_batch(wkld_id, app_id, rank, ops, use_rc2);
+    if (n != nref)
+    {
+        fprintf(stderr, "%s: %d ops in batches, %d one at a time\n", type,
+                n, nref);
+        assert(0);
+    }
+    for (i = 0; i < n; i++)
+        assert(same_op(&ops[i], &ref[i]));
+}
+
+int main()
+{
+    checkpoint_wrkld_params c_params;
+    iomock_params i_params;
+
+    /* 2 checkpoints of 32 16 MiB writes per rank */
+    memset(&c_params, 0, sizeof(c_params));
+    c_params.nprocs = 2;
+    c_params.checkpoint_sz = 1.0 / 1024;
+    c_params.checkpoint_wr_bw = 1.0;
+    c_params.total_checkpoints = 2;
+    c_params.mtti = 1.0;
+
+    memset(&i_params, 0, sizeof(i_params));
+    i_params.file_id = 1;
+    i_params.is_write = 1;
+    i_params.num_requests = 11;
+    i_params.request_size = 4096;
+
+    /* batch hooks, handed back through the shim and rolled back in the
+     * generator */
+    check("checkpoint_io_workload", (char *)&c_params, 0, 0, 1, 0);
+    check("checkpoint_io_workload", (char *)&c_params, 1, 0, 1, 1);
+
+    /* single op fallback of the shim */
+    check("iomock_workload", (char *)&i_params, 2, 0, 1, 0);
+
+    return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
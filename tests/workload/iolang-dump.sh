@@ -0,0 +1,8 @@
+#!/bin/bash
+
+if [ -z $srcdir ]; then
+    echo srcdir variable not set.
+    exit 1
+fi
+
+src/workload/codes-workload-dump --num-ranks 4 --type iolang_workload --i-meta $srcdir/doc/workload/meta.txt --i-use-relpath -s
@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+/* builds the binary cache of a small recorder trace and checks that the
+ * recorder generator reads the same ops out of it, and that it falls back
+ * to the logs when the cache is stale or its index is corrupt */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/stat.h>
+#include <codes/codes-workload.h>
+
+#define NPROCS 2
+#define MAX_OPS 64
+
+static char trace_dir[] = "/tmp/recorder-cache-test-XXXXXX";
+
+/* rank r writes nwrites blocks of wsize bytes to its own file */
+static void write_log(int rank, int nwrites, int wsize)
+{
+    char path[1024];
+    FILE *f;
+    int i;
+
+    sprintf(path, "%s/log.%d", trace_dir, rank);
+    f = fopen(path, "w");
+    assert(f);
+    fprintf(f, "1.0 open (/tmp/out.%d, %d, 420) 3 0.001\n", rank, O_CREAT);
+    for (i = 0; i < nwrites; i++)
+        fprintf(f, "%d.5 write (3, buf, %d, %d) %d 0.002\n", 2 + i, wsize,
+                i * wsize, wsize);
+    fprintf(f, "%d.0 close (3) 0 0.001\n", 3 + nwrites);
+    fclose(f);
+}
+
+/* sets the modification time of a trace file delta seconds away from the
+ * cache's */
+static void touch(char const *name, int delta)
+{
+    char path[1024];
+    struct stat st;
+    struct utimbuf t;
+    int ret;
+
+    sprintf(path, "%s/%s", trace_dir, RECORDER_CACHE_FILE);
+    ret = stat(path, &st);
+    assert(ret == 0);
+    t.actime = st.st_mtime + delta;
+    t.modtime = st.st_mtime + delta;
+    sprintf(path, "%s/%s", trace_dir, name);
+    ret = utime(path, &t);
+    assert(ret == 0);
+}
+
+/* loads all ranks and drains them, returning the op count of each and the
+ * size of its first write */
+static void replay(int *nops, int64_t *wsize)
+{
+    recorder_params p;
+    struct codes_workload_op op;
+    int r, id;
+
+    memset(&p, 0, sizeof(p));
+    strcpy(p.trace_dir_path, trace_dir);
+    p.nprocs = NPROCS;
+
+    for (r = 0; r < NPROCS; r++)
+    {
+        id = codes_workload_load("recorder_io_workload", (char *)&p, 0, r);
+        assert(id >= 0);
+    }
+    for (r = 0; r < NPROCS; r++)
+    {
+        nops[r] = 0;
+        wsize[r] = -1;
+        do
+        {
+            codes_workload_get_next(id, 0, r, &op);
+            if (op.op_type == CODES_WK_WRITE && wsize[r] < 0)
+                wsize[r] = op.u.write.size;
+            nops[r]++;
+            assert(nops[r] < MAX_OPS);
+        } while (op.op_type != CODES_WK_END);
+    }
+}
+
+int main()
+{
+    char path[1024];
+    int nops[NPROCS], ref_ops[NPROCS];
+    int64_t wsize[NPROCS];
+    uint64_t index[NPROCS + 1];
+    FILE *f;
+    size_t n;
+    int r, ret;
+
+    if (!mkdtemp(trace_dir))
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    write_log(0, 2, 4096);
+    write_log(1, 5, 1024);
+
+    /* reference: parsed from the logs */
+    replay(ref_ops, wsize);
+    assert(wsize[0] == 4096 && wsize[1] == 1024);
+
+    ret = recorder_io_workload_convert(trace_dir, NPROCS, NULL);
+    assert(ret == 0);
+    replay(nops, wsize);
+    for (r = 0; r < NPROCS; r++)
+        assert(nops[r] == ref_ops[r]);
+    assert(wsize[0] == 4096 && wsize[1] == 1024);
+
+    /* rewrite a log behind the cache's back: while the log is older the
+     * cache is used, once it is newer the log is parsed again */
+    write_log(1, 5, 512);
+    touch("log.1", -60);
+    replay(nops, wsize);
+    assert(wsize[1] == 1024);
+    touch("log.1", 120);
+    replay(nops, wsize);
+    assert(wsize[1] == 512);
+
+    /* an index entry past the end of the file only sends that rank back to
+     * its log. The index follows the 24 byte header */
+    ret = recorder_io_workload_convert(trace_dir, NPROCS, NULL);
+    assert(ret == 0);
+    write_log(0, 2, 8192);
+    sprintf(path, "%s/%s", trace_dir, RECORDER_CACHE_FILE);
+    f = fopen(path, "r+");
+    assert(f);
+    fseek(f, 24, SEEK_SET);
+    n = fread(index, sizeof(index[0]), NPROCS + 1, f);
+    assert(n == NPROCS + 1);
+    index[NPROCS] += 1000;
+    fseek(f, 24, SEEK_SET);
+    n = fwrite(index, sizeof(index[0]), NPROCS + 1, f);
+    assert(n == NPROCS + 1);
+    fclose(f);
+    touch("log.0", -60);
+    touch("log.1", -60);
+    replay(nops, wsize);
+    assert(wsize[0] == 4096 && wsize[1] == 512);
+    for (r = 0; r < NPROCS; r++)
+        assert(nops[r] == ref_ops[r]);
+
+    for (r = 0; r < NPROCS; r++)
+    {
+        sprintf(path, "%s/log.%d", trace_dir, r);
+        unlink(path);
+    }
+    sprintf(path, "%s/%s", trace_dir, RECORDER_CACHE_FILE);
+    unlink(path);
+    rmdir(trace_dir);
+    return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
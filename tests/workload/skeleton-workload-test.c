@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+/* checks the skeleton workload against the dumpi trace it is folded from:
+ * the unrolled program has the same communication and total compute time
+ * as the trace, the ranks of the second copy of the traced job talk to
+ * their own copy, and stepping back with rc2 (across loop iterations,
+ * blocks and the end of the program) re-issues the same ops */
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <codes/codes-workload.h>
+
+#define NTRACED 27
+
+struct op_list
+{
+    struct codes_workload_op *ops;
+    int n;
+    int cap;
+};
+
+static void push_op(struct op_list *l, struct codes_workload_op const *op)
+{
+    if (l->n == l->cap)
+    {
+        l->cap = l->cap ? 2 * l->cap : 1024;
+        l->ops = realloc(l->ops, l->cap * sizeof(*l->ops));
+        assert(l->ops);
+    }
+    l->ops[l->n++] = *op;
+}
+
+static int is_p2p(int op_type)
+{
+    return op_type == CODES_WK_SEND || op_type == CODES_WK_ISEND ||
+        op_type == CODES_WK_RECV || op_type == CODES_WK_IRECV;
+}
+
+static int is_collective(int op_type)
+{
+    switch (op_type)
+    {
+        case CODES_WK_BCAST:
+        case CODES_WK_REDUCE:
+        case CODES_WK_ALLGATHER:
+        case CODES_WK_ALLGATHERV:
+        case CODES_WK_ALLTOALL:
+        case CODES_WK_ALLTOALLV:
+        case CODES_WK_ALLREDUCE:
+        case CODES_WK_COL:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/* compares the communication of two ops, the peers of b being shift ranks
+ * away from the ones of a */
+static int same_comm(struct codes_workload_op const *a,
+        struct codes_workload_op const *b, int shift)
+{
+    if (a->op_type != b->op_type)
+        return 0;
+    switch (a->op_type)
+    {
+        case CODES_WK_SEND:
+        case CODES_WK_ISEND:
+            return a->u.send.dest_rank + shift == b->u.send.dest_rank &&
+                a->u.send.num_bytes == b->u.send.num_bytes &&
+                a->u.send.tag == b->u.send.tag;
+        case CODES_WK_RECV:
+        case CODES_WK_IRECV:
+            return (a->u.recv.source_rank < 0 ?
+                    b->u.recv.source_rank < 0 :
+                    a->u.recv.source_rank + shift == b->u.recv.source_rank) &&
+                a->u.recv.num_bytes == b->u.recv.num_bytes &&
+                a->u.recv.tag == b->u.recv.tag;
+        default:
+            return a->u.collective.num_bytes == b->u.collective.num_bytes;
+    }
+}
+
+/* compares two ops of skeleton programs, including requests and delays */
+static int same_op(struct codes_workload_op const *a,
+        struct codes_workload_op const *b, int shift)
+{
+    int i;
+
+    if (a->op_type != b->op_type)
+        return 0;
+    switch (a->op_type)
+    {
+        case CODES_WK_DELAY:
+            return a->u.delay.nsecs == b->u.delay.nsecs;
+        case CODES_WK_SEND:
+        case CODES_WK_ISEND:
+            return same_comm(a, b, shift) &&
+                a->u.send.req_id == b->u.send.req_id;
+        case CODES_WK_RECV:
+        case CODES_WK_IRECV:
+            return same_comm(a, b, shift) &&
+                a->u.recv.req_id == b->u.recv.req_id;
+        case CODES_WK_WAIT:
+            return a->u.wait.req_id == b->u.wait.req_id;
+        case CODES_WK_WAITALL:
+        case CODES_WK_WAITSOME:
+        case CODES_WK_WAITANY:
+            if (a->u.waits.count != b->u.waits.count)
+                return 0;
+            for (i = 0; i < a->u.waits.count; i++)
+                if (a->u.waits.req_ids[i] != b->u.waits.req_ids[i])
+                    return 0;
+            return 1;
+        case CODES_WK_END:
+            return 1;
+        default:
+            return same_comm(a, b, shift) &&
+                a->u.collective.root == b->u.collective.root;
+    }
+}
+
+/* drains a rank, the END op included */
+static void drain(int wkld_id, int app_id, int rank, struct op_list *l)
+{
+    struct codes_workload_op op;
+
+    do
+    {
+        codes_workload_get_next(wkld_id, app_id, rank, &op);
+        push_op(l, &op);
+    } while (op.op_type != CODES_WK_END);
+}
+
+/* drains a rank, regularly stepping back a few ops with rc2 and checking
+ * that the same ops are issued again */
+static void drain_rc2(int wkld_id, int app_id, int rank, struct op_list *l)
+{
+    struct codes_workload_op op;
+    int back, i;
+
+    do
+    {
+        codes_workload_get_next(wkld_id, app_id, rank, &op);
+        push_op(l, &op);
+        if (l->n % 7 == 3 || op.op_type == CODES_WK_END)
+        {
+            back = 1 + l->n % 5;
+            if (back > l->n)
+                back = l->n;
+            for (i = 0; i < back; i++)
+                codes_workload_get_next_rc2(wkld_id, app_id, rank);
+            for (i = l->n - back; i < l->n; i++)
+            {
+                codes_workload_get_next(wkld_id, app_id, rank, &op);
+                assert(same_op(&l->ops[i], &op, 0));
+            }
+        }
+    } while (op.op_type != CODES_WK_END);
+
+    /* an ended rank keeps ending, and steps back over its ENDs */
+    codes_workload_get_next(wkld_id, app_id, rank, &op);
+    assert(op.op_type == CODES_WK_END);
+    codes_workload_get_next_rc2(wkld_id, app_id, rank);
+    codes_workload_get_next_rc2(wkld_id, app_id, rank);
+    codes_workload_get_next(wkld_id, app_id, rank, &op);
+    assert(op.op_type == CODES_WK_END);
+}
+
+static double total_delay(struct op_list const *l)
+{
+    double d = 0;
+    int i;
+
+    for (i = 0; i < l->n; i++)
+        if (l->ops[i].op_type == CODES_WK_DELAY)
+            d += l->ops[i].u.delay.nsecs;
+    return d;
+}
+
+static void check_rank(char const *trace, int rank)
+{
+    dumpi_trace_params d_params;
+    skeleton_params s_params;
+    struct op_list ref = { NULL, 0, 0 }, skel = { NULL, 0, 0 },
+                   copy = { NULL, 0, 0 };
+    int d_id, s_id, i, j, ret;
+    double d_ref, d_skel;
+
+    memset(&d_params, 0, sizeof(d_params));
+    strcpy(d_params.file_name, trace);
+    d_params.num_net_traces = NTRACED;
+    d_params.nprocs = NTRACED;
+    d_id = codes_workload_load("dumpi-trace-workload", (char *)&d_params, 0,
+            rank);
+    assert(d_id >= 0);
+    drain(d_id, 0, rank, &ref);
+    ret = codes_workload_finalize("dumpi-trace-workload", (char *)&d_params,
+            0, rank);
+    assert(ret == 0);
+
+    /* a job of two copies of the traced one */
+    memset(&s_params, 0, sizeof(s_params));
+    strcpy(s_params.file_name, trace);
+    s_params.num_traced_ranks = NTRACED;
+    s_params.nprocs = 2 * NTRACED;
+    s_params.delay_tolerance = -1;
+    s_id = codes_workload_load("skeleton-workload", (char *)&s_params, 1,
+            rank);
+    assert(s_id >= 0);
+    s_id = codes_workload_load("skeleton-workload", (char *)&s_params, 1,
+            rank + NTRACED);
+    assert(s_id >= 0);
+    drain(s_id, 1, rank, &skel);
+    drain_rc2(s_id, 1, rank + NTRACED, &copy);
+
+    /* same communication, in the same order, as the trace */
+    for (i = 0, j = 0; i < ref.n; i++)
+    {
+        if (!is_p2p(ref.ops[i].op_type) &&
+                !is_collective(ref.ops[i].op_type))
+            continue;
+        while (j < skel.n && !is_p2p(skel.ops[j].op_type) &&
+                !is_collective(skel.ops[j].op_type))
+            j++;
+        assert(j < skel.n);
+        if (!same_comm(&ref.ops[i], &skel.ops[j], 0))
+        {
+            fprintf(stderr, "rank %d: trace op %d and skeleton op %d differ\n",
+                    rank, i, j);
+            assert(0);
+        }
+        j++;
+    }
+    for (; j < skel.n; j++)
+        assert(!is_p2p(skel.ops[j].op_type) &&
+                !is_collective(skel.ops[j].op_type));
+
+    /* folded delays are replaced by their mean */
+    d_ref = total_delay(&ref);
+    d_skel = total_delay(&skel);
+    assert(fabs(d_ref - d_skel) <= 1e-6 * d_ref);
+
+    /* the second copy runs the same program among its own ranks */
+    assert(copy.n == skel.n);
+    for (i = 0; i < skel.n; i++)
+        assert(same_op(&skel.ops[i], &copy.ops[i], NTRACED));
+
+    printf("rank %d: %d trace ops, %d skeleton ops\n", rank, ref.n, skel.n);
+
+    ret = codes_workload_finalize("skeleton-workload", (char *)&s_params, 1,
+            rank);
+    assert(ret == 0);
+    ret = codes_workload_finalize("skeleton-workload", (char *)&s_params, 1,
+            rank + NTRACED);
+    assert(ret == 0);
+    free(ref.ops);
+    free(skel.ops);
+    free(copy.ops);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s <dumpi trace prefix of %d ranks>\n",
+                argv[0], NTRACED);
+        return 1;
+    }
+
+    /* a corner and an interior rank of the AMG decomposition */
+    check_rank(argv[1], 0);
+    check_rank(argv[1], 13);
+
+    return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,37 @@
+#!/bin/bash
+
+# skeleton workload folded from the AMG trace: checks the programs against
+# the trace, then replays two copies of the job, which must move twice the
+# bytes of the trace, the same with an optimistic run as a sequential one
+
+if [ -z $srcdir ]; then
+         echo srcdir variable not set.
+              exit 1
+ fi
+
+source $srcdir/tests/download-traces.sh
+
+set -o pipefail
+
+trace=/tmp/df_AMG_n27_dumpi/dumpi-2014.03.03.14.55.00-
+tests/workload/skeleton-workload-test $trace || exit 1
+
+replay="src/network-workloads/model-net-mpi-replay --disable_compute=1 --workload_file=$trace"
+conf=$srcdir/src/network-workloads/conf/modelnet-mpi-test-dfly-amg-216.conf
+
+# prints "<bytes sent> <bytes received>" of a run
+bytes() {
+    "$@" | sed -n 's/.*Total bytes sent \([0-9]*\) recvd \([0-9]*\).*/\1 \2/p'
+}
+
+trace_bytes=$(bytes $replay --sync=1 --workload_type=dumpi \
+    --num_net_traces=27 -- $conf) || exit 1
+seq=$(bytes $replay --sync=1 --workload_type=skeleton --num_net_traces=54 \
+    --skeleton_traced_ranks=27 -- $conf) || exit 1
+opt=$(bytes mpirun -np 2 $replay --sync=3 --workload_type=skeleton \
+    --num_net_traces=54 --skeleton_traced_ranks=27 -- $conf) || exit 1
+
+[ -n "$trace_bytes" ] && [ -n "$seq" ] || exit 1
+set -- $trace_bytes
+[ "$seq" = "$((2 * $1)) $((2 * $2))" ] || exit 1
+[ "$seq" = "$opt" ] || exit 1